@@ -0,0 +1,43 @@
+/*
+ * hal_common_host.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ */
+#include "hal_common_host.h"
+
+#include <time.h>
+#include <unistd.h>
+
+/**
+ *  Dummy function to be called to suppress "Unused variable" warnings
+ */
+void UNUSED (int32_t arg) { }
+
+/**
+ * Wait for given amount of us - blocking function. Interrupts are emulated
+ * from their own threads so they keep running while waiting
+ * @param us time in us to wait
+ */
+void HAL_DelayUS(uint32_t us)
+{
+    usleep(us);
+}
+
+/**
+ * Get time since startup (first call to this function), used by modules that
+ * otherwise take time from task scheduler
+ * @return time in ms
+ */
+uint32_t HAL_MsSinceStartup()
+{
+    static struct timespec start = { 0, 0 };
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if ((start.tv_sec == 0) && (start.tv_nsec == 0))
+        start = now;
+
+    return (uint32_t)((now.tv_sec - start.tv_sec) * 1000 +
+                      (now.tv_nsec - start.tv_nsec) / 1000000);
+}
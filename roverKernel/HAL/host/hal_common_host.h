@@ -0,0 +1,31 @@
+/**
+ * hal_common_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Common part of HAL for host (Linux) build of kernel modules, used to run
+ *  drivers on a PC against emulated peripherals (see tools/). Selected by
+ *  defining __BOARD_HOST__ on compiler's command line.
+ */
+#include "hwconfig.h"
+
+#ifndef ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_
+#define ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_
+
+#define HAL_OK                  0
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern void         HAL_DelayUS(uint32_t us);
+extern uint32_t     HAL_MsSinceStartup();
+extern void         UNUSED (int32_t arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_COMMON_HOST_H_ */
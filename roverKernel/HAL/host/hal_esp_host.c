@@ -0,0 +1,439 @@
+/**
+ * hal_esp_host.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "hal_esp_host.h"
+
+#if defined(__HAL_USE_ESP8266__)
+
+#include "HAL/host/hal_common_host.h"
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <pthread.h>
+
+//  Serial port & its file descriptor (-1 if not opened)
+static const char *_port = ESP_HOST_PORT;
+static int _fd = -1;
+
+/*
+ * Emulated interrupt controller: interrupt thread holds the lock while running
+ * an ISR, code outside of ISRs takes it to change interrupt flags (so, like
+ * with NVIC, an ISR never runs while interrupt is being disabled). Lock is
+ * recursive as ISRs call the same HAL functions
+ */
+static pthread_mutex_t _nvic;
+//  Pipe waking interrupt thread when an interrupt is enabled or triggered
+static int _wake[2] = { -1, -1 };
+static void (*_intHandler)(void) = 0;
+static void (*_wdHandler)(void) = 0;
+static volatile bool _intEnabled = false;
+static volatile bool _txIntEnabled = false;
+static volatile bool _intPending = false;
+static bool _hwEnabled = false;
+
+//  Rx ring filled by interrupt thread, positions are free-running counters
+static uint8_t _rxRing[ESP_RX_RING_LEN];
+static volatile uint32_t _rxHead = 0;
+static volatile uint32_t _rxTail = 0;
+
+//  Tx FIFO filled from ISR, written to the port when ISR returns
+static char _txFifo[ESP_TX_FIFO_LEN];
+static uint16_t _txLen = 0;
+
+//  Watchdog timer: running flag, time (ms) it expires and last timeout used
+static volatile bool _wdRun = false;
+static volatile uint32_t _wdDue = 0;
+static uint32_t _wdTimeout = 0;
+
+/**
+ * Convert baud rate to termios speed, rates not supported by termios fall back
+ * to 115200 (pty ignores the setting anyway)
+ * @param baud baud rate
+ * @return termios speed constant
+ */
+static speed_t _HAL_ESP_Speed(uint32_t baud)
+{
+    switch (baud)
+    {
+    case 9600:      return B9600;
+    case 19200:     return B19200;
+    case 38400:     return B38400;
+    case 57600:     return B57600;
+    case 230400:    return B230400;
+    case 460800:    return B460800;
+    case 921600:    return B921600;
+    case 1000000:   return B1000000;
+    default:        return B115200;
+    }
+}
+
+/**
+ * Wake interrupt thread so a raised interrupt runs right away instead of on
+ * the next 1ms tick
+ */
+static void _HAL_ESP_Wake()
+{
+    char c = 0;
+
+    if (write(_wake[1], &c, 1) < 0)
+        return;
+}
+
+/**
+ * Write content of Tx FIFO to the port (empties the FIFO)
+ */
+static void _HAL_ESP_TxFlush()
+{
+    uint16_t off = 0;
+
+    while ((_fd >= 0) && (off < _txLen))
+    {
+        ssize_t n = write(_fd, _txFifo + off, _txLen - off);
+        if (n <= 0)
+            break;
+        off += n;
+    }
+    _txLen = 0;
+}
+
+/**
+ * Move data waiting on the port into Rx ring, as much as fits
+ */
+static void _HAL_ESP_RxFill()
+{
+    uint32_t space = ESP_RX_RING_LEN - (_rxHead - _rxTail);
+    uint32_t idx = _rxHead & (ESP_RX_RING_LEN - 1);
+    ssize_t n;
+
+    //  Read up to the end of the ring, the rest is picked up on the next pass
+    if (space > (ESP_RX_RING_LEN - idx))
+        space = ESP_RX_RING_LEN - idx;
+
+    n = read(_fd, _rxRing + idx, space);
+    if (n > 0)
+        _rxHead += n;
+}
+
+/**
+ * Check if UART interrupt should be executed: it's enabled and there's data
+ * received, Tx FIFO is empty while Tx interrupt is enabled or it's been
+ * triggered manually
+ * @return true if UART ISR should run
+ */
+static bool _HAL_ESP_IntRaised()
+{
+    if (!_intEnabled || (_intHandler == 0))
+        return false;
+
+    return _intPending || (_rxHead != _rxTail) || _txIntEnabled;
+}
+
+/**
+ * Interrupt thread, waits for data on the port, for a wake-up (interrupt
+ * enabled or triggered) or for 1ms, which is the resolution of watchdog timer,
+ * and runs ISRs that got raised in the meantime
+ * @param arg unused
+ * @return never returns
+ */
+static void* _HAL_ESP_IntThread(void *arg)
+{
+    struct pollfd pfd[2];
+    char buf[16];
+    uint8_t i;
+
+    pfd[1].fd = _wake[0];
+    pfd[1].events = POLLIN;
+
+    while (true)
+    {
+        pfd[0].fd = _fd;
+        pfd[0].events = ((_rxHead - _rxTail) < ESP_RX_RING_LEN) ? POLLIN : 0;
+        pfd[0].revents = 0;
+        pfd[1].revents = 0;
+        if (poll(pfd, 2, 1) < 0)
+            usleep(1000);
+
+        if (pfd[1].revents & POLLIN)
+            while (read(_wake[0], buf, sizeof(buf)) == sizeof(buf));
+
+        pthread_mutex_lock(&_nvic);
+
+        if (pfd[0].revents & POLLIN)
+            _HAL_ESP_RxFill();
+        //  Other side of pty closed, don't spin on it
+        else if (pfd[0].revents & (POLLHUP | POLLERR))
+            usleep(1000);
+
+        if (_wdRun && ((int32_t)(HAL_MsSinceStartup() - _wdDue) >= 0))
+        {
+            _wdRun = false;
+            if (_wdHandler != 0)
+                (*_wdHandler)();
+        }
+
+        //  Limit number of back-to-back runs so the port is read in between
+        for (i = 0; (i < 64) && _HAL_ESP_IntRaised(); i++)
+        {
+            _intPending = false;
+            (*_intHandler)();
+            _HAL_ESP_TxFlush();
+        }
+
+        pthread_mutex_unlock(&_nvic);
+    }
+
+    return 0;
+}
+
+/**
+ * Set serial port to use, has to be called before HAL_ESP_InitPort()
+ * @param path path of the port (e.g. /dev/ttyUSB0, pty of the emulator)
+ */
+void HAL_ESP_SetPort(const char *path)
+{
+    _port = path;
+}
+
+/**
+ * Open serial port communicating with ESP8266 chip - raw mode, 8 data bits, no
+ * parity, 1 stop bit, no flow control - and start interrupt thread
+ * @param baud designated speed of communication
+ * @return HAL library error code (HAL_OK, or 1 if the port can't be opened;
+ * interrupt thread is started anyway so commands time out)
+ */
+uint32_t HAL_ESP_InitPort(uint32_t baud)
+{
+    static bool started = false;
+    struct termios tio;
+    pthread_mutexattr_t attr;
+    pthread_t thread;
+
+    if (_fd >= 0)
+        close(_fd);
+
+    _fd = open(_port, O_RDWR | O_NOCTTY);
+    if (_fd < 0)
+        perror(_port);
+    else if (tcgetattr(_fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio, _HAL_ESP_Speed(baud));
+        tcsetattr(_fd, TCSANOW, &tio);
+        tcflush(_fd, TCIOFLUSH);
+    }
+
+    if (!started)
+    {
+        HAL_MsSinceStartup();
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&_nvic, &attr);
+        if (pipe(_wake) == 0)
+        {
+            fcntl(_wake[0], F_SETFL, O_NONBLOCK);
+            fcntl(_wake[1], F_SETFL, O_NONBLOCK);
+        }
+        pthread_create(&thread, 0, _HAL_ESP_IntThread, 0);
+        pthread_detach(thread);
+        started = true;
+    }
+
+    return (_fd < 0) ? 1 : HAL_OK;
+}
+
+/**
+ * Attach specific interrupt handler to ESP's UART, interrupt is left disabled
+ */
+void HAL_ESP_RegisterIntHandler(void((*intHandler)(void)))
+{
+    pthread_mutex_lock(&_nvic);
+    _intHandler = intHandler;
+    _intEnabled = false;
+    pthread_mutex_unlock(&_nvic);
+}
+
+/**
+ * Enable or disable ESP chip, only remembered (there's no CH_PD pin on host)
+ * @param enable is state of device
+ */
+void HAL_ESP_HWEnable(bool enable)
+{
+    _hwEnabled = enable;
+}
+
+/**
+ * Check whether the chip is enabled or disabled
+ */
+bool HAL_ESP_IsHWEnabled()
+{
+    return _hwEnabled;
+}
+
+/**
+ * Enable/disable UART interrupt, once this returns with [enable] false UART ISR
+ * is not running and won't run until enabled again
+ * @param enable
+ */
+void HAL_ESP_IntEnable(bool enable)
+{
+    pthread_mutex_lock(&_nvic);
+    _intEnabled = enable;
+    pthread_mutex_unlock(&_nvic);
+    if (enable)
+        _HAL_ESP_Wake();
+}
+
+/**
+ * Clear interrupt flags, nothing to clear on host
+ */
+int32_t HAL_ESP_ClearInt()
+{
+    return 0;
+}
+
+/**
+ * Enable/disable interrupt on empty Tx FIFO (raised every time ISR returns
+ * while it's enabled, as FIFO is written to the port in between)
+ * @param enable
+ */
+void HAL_ESP_TxIntEnable(bool enable)
+{
+    pthread_mutex_lock(&_nvic);
+    _txIntEnabled = enable;
+    pthread_mutex_unlock(&_nvic);
+}
+
+/**
+ * Manually trigger UART interrupt, used to run UART ISR from outside of it
+ */
+void HAL_ESP_PendInt()
+{
+    pthread_mutex_lock(&_nvic);
+    _intPending = true;
+    pthread_mutex_unlock(&_nvic);
+    _HAL_ESP_Wake();
+}
+
+/**
+ * Check if UART is busy transmitting
+ * @return true if Tx FIFO hasn't been written to the port yet
+ */
+bool HAL_ESP_UARTBusy()
+{
+    bool busy;
+
+    pthread_mutex_lock(&_nvic);
+    busy = (_txLen > 0);
+    pthread_mutex_unlock(&_nvic);
+
+    return busy;
+}
+
+/**
+ * Write a character to the port, blocking
+ * @param c character to send
+ */
+void HAL_ESP_SendChar(char c)
+{
+    pthread_mutex_lock(&_nvic);
+    _HAL_ESP_TxFlush();
+    if ((_fd < 0) || (write(_fd, &c, 1) != 1))
+        perror(_port);
+    pthread_mutex_unlock(&_nvic);
+}
+
+/**
+ * Check for free space in Tx FIFO (used from UART ISR)
+ * @return true if a character can be put with HAL_ESP_PutCharNB()
+ */
+bool HAL_ESP_TxSpace()
+{
+    return (_txLen < ESP_TX_FIFO_LEN);
+}
+
+/**
+ * Put a character into Tx FIFO without blocking (used from UART ISR), it's
+ * written to the port when ISR returns
+ * @param c character to send
+ */
+void HAL_ESP_PutCharNB(char c)
+{
+    if (_txLen < ESP_TX_FIFO_LEN)
+        _txFifo[_txLen++] = c;
+}
+
+/**
+ * Get number of received characters waiting to be read with HAL_ESP_RxGet()
+ * @return number of characters in Rx ring
+ */
+uint16_t HAL_ESP_RxCount()
+{
+    return (uint16_t)(_rxHead - _rxTail);
+}
+
+/**
+ * Read next character from Rx ring (HAL_ESP_RxCount() has to be checked first)
+ * @return received character
+ */
+char HAL_ESP_RxGet()
+{
+    return (char)_rxRing[(_rxTail++) & (ESP_RX_RING_LEN - 1)];
+}
+
+/**
+ * Get number of received characters lost because they weren't read on time,
+ * port is only read when there's space in the ring so none are ever lost
+ * @return 0
+ */
+uint32_t HAL_ESP_RxOverflows()
+{
+    return 0;
+}
+
+/**
+ * Watchdog timer for ESP module - used to reset protocol if communication hangs
+ * for too long. Handler is run from interrupt thread
+ */
+void HAL_ESP_InitWD(void((*intHandler)(void)))
+{
+    pthread_mutex_lock(&_nvic);
+    _wdHandler = intHandler;
+    _wdRun = false;
+    pthread_mutex_unlock(&_nvic);
+}
+
+/**
+ * On/Off control for WD timer
+ * @param enable desired state of timer (true-run/false-stop)
+ * @param ms time in millisec. after which the communication is interrupted,
+ * when 0 the last value is used
+ */
+void HAL_ESP_WDControl(bool enable, uint32_t ms)
+{
+    pthread_mutex_lock(&_nvic);
+    if (ms != 0)
+        _wdTimeout = ms;
+    _wdDue = HAL_MsSinceStartup() + _wdTimeout;
+    _wdRun = enable;
+    pthread_mutex_unlock(&_nvic);
+}
+
+/**
+ * Clear interrupt flag of WD timer and trigger UART interrupt, which runs as
+ * soon as watchdog ISR returns (see HAL_ESP_WDClearInt() in TM4C HAL)
+ */
+void HAL_ESP_WDClearInt()
+{
+    pthread_mutex_lock(&_nvic);
+    _wdRun = false;
+    _intPending = true;
+    pthread_mutex_unlock(&_nvic);
+}
+
+#endif  /* __HAL_USE_ESP8266__ */
@@ -0,0 +1,63 @@
+/**
+ * hal_esp_host.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  ESP8266 HAL for host (Linux) build, ESP is reached through a serial port:
+ *  pty created by tools/espEmulator or a USB-serial adapter wired to a real
+ *  module. UART interrupt and watchdog timer are emulated by a thread which
+ *  waits for data on the port, then runs registered ISRs the way NVIC would:
+ *  one at a time and never while the interrupt is disabled.
+ *
+ ****Host dependencies:
+ *      Serial port, path set with HAL_ESP_SetPort() (ESP_HOST_PORT default)
+ *      POSIX thread emulating UART7 interrupt & watchdog timer (Timer 6)
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include this module
+#if !defined(ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_) && defined(__HAL_USE_ESP8266__)
+#define ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_
+
+//  Serial port used if none is set with HAL_ESP_SetPort() (matches symlink
+//  created by 'espEmulator -L /tmp/esp0')
+#define ESP_HOST_PORT           "/tmp/esp0"
+//  Size of Rx ring buffer (power of 2), port is read only while there's space
+//  in it so characters are never lost (kernel buffers the rest)
+#define ESP_RX_RING_LEN         1024
+//  Size of emulated Tx FIFO, written to the port once ISR returns
+#define ESP_TX_FIFO_LEN         16
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+extern void        HAL_ESP_SetPort(const char *path);
+extern uint32_t    HAL_ESP_InitPort(uint32_t baud);
+extern void        HAL_ESP_RegisterIntHandler(void((*intHandler)(void)));
+extern void        HAL_ESP_HWEnable(bool enable);
+extern bool        HAL_ESP_IsHWEnabled();
+extern void        HAL_ESP_IntEnable(bool enable);
+extern int32_t     HAL_ESP_ClearInt();
+extern void        HAL_ESP_TxIntEnable(bool enable);
+extern void        HAL_ESP_PendInt();
+extern bool        HAL_ESP_UARTBusy();
+extern void        HAL_ESP_SendChar(char c);
+extern bool        HAL_ESP_TxSpace();
+extern void        HAL_ESP_PutCharNB(char c);
+extern uint16_t    HAL_ESP_RxCount();
+extern char        HAL_ESP_RxGet();
+extern uint32_t    HAL_ESP_RxOverflows();
+extern void        HAL_ESP_InitWD(void((*intHandler)(void)));
+extern void        HAL_ESP_WDControl(bool enable, uint32_t timeout);
+extern void        HAL_ESP_WDClearInt();
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* ROVERKERNEL_HAL_HOST_HAL_ESP_HOST_H_ */
@@ -21,10 +21,21 @@
 #include "driverlib/fpu.h"
 #include "driverlib/interrupt.h"
 #include "driverlib/pwm.h"
+#include "driverlib/udma.h"
+#include "driverlib/flash.h"
 
 
 uint32_t g_ui32SysClock;
 
+/// uDMA channel control table, shared by all modules using uDMA (has to be
+/// aligned on 1024-byte boundary)
+#if defined(__TI_COMPILER_VERSION__)
+#pragma DATA_ALIGN(_dmaControlTable, 1024)
+static uint8_t _dmaControlTable[1024];
+#else
+static uint8_t _dmaControlTable[1024] __attribute__ ((aligned(1024)));
+#endif
+
 /**
  *  Dummy function to be called to suppress "Unused variable" warnings
  */
@@ -77,6 +88,49 @@ uint32_t _TM4CMsToCycles(uint32_t ms)
     return (ms*(g_ui32SysClock/1000));
 }
 
+/**
+ * Enable uDMA controller and point it to the channel control table. Safe to be
+ * called from initialization of every module using uDMA, controller is only
+ * initialized on the first call
+ */
+void HAL_DMA_Init()
+{
+    static bool dmaInit = false;
+
+    if (dmaInit)
+        return;
+
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_UDMA);
+    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_UDMA);
+    while (!MAP_SysCtlPeripheralReady(SYSCTL_PERIPH_UDMA));
+    MAP_uDMAEnable();
+    MAP_uDMAControlBaseSet(_dmaControlTable);
+
+    dmaInit = true;
+}
+
+/**
+ * Erase block of internal flash
+ * @param addr start address of the block (multiple of HAL_FLASH_BLOCK)
+ * @return HAL_OK on success, -1 on failure
+ */
+int32_t HAL_FLASH_Erase(uint32_t addr)
+{
+    return MAP_FlashErase(addr);
+}
+
+/**
+ * Program data into erased internal flash
+ * @param data words to write
+ * @param addr address to write to (word-aligned)
+ * @param len number of bytes to write (multiple of 4)
+ * @return HAL_OK on success, -1 on failure
+ */
+int32_t HAL_FLASH_Write(const uint32_t *data, uint32_t addr, uint32_t len)
+{
+    return MAP_FlashProgram((uint32_t*)data, addr, len);
+}
+
 /**
  * Set desired PWM duty cycle on specific output channel
  * @param id is channel ID of PWM channel affected
@@ -11,6 +11,12 @@
 
 #define HAL_OK                  0
 
+//  Region of internal flash kept for data (excluded from application in linker
+//  command file), erased in blocks of HAL_FLASH_BLOCK bytes
+#define HAL_FLASH_DATA_BASE     0x000F0000
+#define HAL_FLASH_DATA_SIZE     0x00010000
+#define HAL_FLASH_BLOCK         0x4000
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -25,6 +31,10 @@ extern void         HAL_BOARD_CLOCK_Init();
 extern void         HAL_BOARD_Reset();
 extern void         UNUSED (int32_t arg);
 extern uint32_t     _TM4CMsToCycles(uint32_t ms);
+extern void         HAL_DMA_Init();
+extern int32_t      HAL_FLASH_Erase(uint32_t addr);
+extern int32_t      HAL_FLASH_Write(const uint32_t *data, uint32_t addr,
+                                    uint32_t len);
 
 extern void         HAL_SetPWM(uint32_t id, uint32_t pwm);
 extern uint32_t     HAL_GetPWM(uint32_t id);
@@ -16,6 +16,7 @@
 #include "inc/hw_ints.h"
 #include "inc/hw_timer.h"
 #include "inc/hw_gpio.h"
+#include "inc/hw_uart.h"
 
 #include "driverlib/gpio.h"
 #include "driverlib/pin_map.h"
@@ -24,6 +25,181 @@
 #include "utils/uartstdio.h"
 #include "driverlib/systick.h"
 #include "driverlib/timer.h"
+#include "driverlib/udma.h"
+
+//  Number of characters lost since startup (ring buffer or UART FIFO overrun)
+static volatile uint32_t _rxOverflows = 0;
+
+#if defined(__HAL_USE_ESP8266_RXDMA__)
+/*
+ * Rx ring buffer filled by uDMA. Positions in the ring are kept as free-running
+ * counters of received (head) and consumed (tail) characters, ring index is
+ * counter & (ESP_RX_RING_LEN - 1).
+ * Primary uDMA transfer fills first half of the ring and alternate transfer
+ * the second half (ping-pong), each finished half is re-armed from UART ISR
+ * while the other one is being filled.
+ */
+uint8_t HAL_ESP_RxRing[ESP_RX_RING_LEN];
+uint32_t HAL_ESP_RxTail = 0;
+//  Number of characters in all completed (and re-armed) halves of the ring
+static uint32_t _rxDone = 0;
+//  Head position seen by the last idle-line poll
+static uint32_t _rxLastHead = 0;
+
+/**
+ * Arm one half of the ring for receiving through uDMA
+ * @param alt false for primary transfer (1st half), true for alternate transfer
+ * (2nd half)
+ */
+static void _HAL_ESP_RxArm(bool alt)
+{
+    MAP_uDMAChannelTransferSet(UDMA_CH20_UART7RX |
+                               (alt ? UDMA_ALT_SELECT : UDMA_PRI_SELECT),
+                               UDMA_MODE_PINGPONG,
+                               (void*)(ESP8266_UART_BASE + UART_O_DR),
+                               (void*)(HAL_ESP_RxRing + (alt ? ESP_RX_HALF : 0)),
+                               ESP_RX_HALF);
+}
+
+/**
+ * Re-arm finished halves of the ring and compute current head position
+ * @note Has to be called with interrupts disabled or from UART ISR
+ * @return number of characters received since initialization
+ */
+static uint32_t _HAL_ESP_RxHead()
+{
+    uint32_t head;
+    bool stopped = false;
+
+    //  Finished halves are counted into done characters and re-armed
+    if (MAP_uDMAChannelModeGet(UDMA_CH20_UART7RX | UDMA_PRI_SELECT)
+            == UDMA_MODE_STOP)
+    {
+        _rxDone += ESP_RX_HALF;
+        _HAL_ESP_RxArm(false);
+        stopped = true;
+    }
+    if (MAP_uDMAChannelModeGet(UDMA_CH20_UART7RX | UDMA_ALT_SELECT)
+            == UDMA_MODE_STOP)
+    {
+        _rxDone += ESP_RX_HALF;
+        _HAL_ESP_RxArm(true);
+        stopped = true;
+    }
+    //  Channel is disabled by uDMA if both halves were filled before one of
+    //  them got re-armed
+    if (stopped && !MAP_uDMAChannelIsEnabled(UDMA_CH20_UART7RX))
+        MAP_uDMAChannelEnable(UDMA_CH20_UART7RX);
+
+    //  Add characters already transferred into the half being filled (half
+    //  waiting for its turn still has all ESP_RX_HALF transfers left)
+    head = _rxDone
+         + (ESP_RX_HALF - MAP_uDMAChannelSizeGet(UDMA_CH20_UART7RX
+                                                 | UDMA_PRI_SELECT))
+         + (ESP_RX_HALF - MAP_uDMAChannelSizeGet(UDMA_CH20_UART7RX
+                                                 | UDMA_ALT_SELECT));
+
+    return head;
+}
+
+/**
+ * Idle-line poll, periodic Timer 7 interrupt. UART ISR is triggered if new
+ * characters have arrived since the last poll but the line has been idle for
+ * the whole poll period (end of a reply) or if more than a quarter of the ring
+ * is waiting to be parsed. This way UART ISR runs once per received burst
+ * instead of every few characters
+ */
+static void _HAL_ESP_RxIdleISR()
+{
+    static uint32_t lastSeen = 0;
+    uint32_t head;
+
+    MAP_TimerIntClear(TIMER7_BASE, MAP_TimerIntStatus(TIMER7_BASE, true));
+
+    //  Sizes are only read here, halves are re-armed from UART ISR
+    head = _rxDone
+         + (ESP_RX_HALF - MAP_uDMAChannelSizeGet(UDMA_CH20_UART7RX
+                                                 | UDMA_PRI_SELECT))
+         + (ESP_RX_HALF - MAP_uDMAChannelSizeGet(UDMA_CH20_UART7RX
+                                                 | UDMA_ALT_SELECT));
+
+    if ((head != _rxLastHead) &&
+        ((head == lastSeen) || ((head - _rxLastHead) > (ESP_RX_RING_LEN / 4))))
+    {
+        _rxLastHead = head;
+        MAP_IntPendSet(INT_UART7);
+    }
+    lastSeen = head;
+}
+
+/**
+ * Configure uDMA to move received characters from UART7 into the ring buffer
+ * and start idle-line poll timer
+ */
+static void _HAL_ESP_InitRxDMA()
+{
+    HAL_DMA_Init();
+
+    _rxDone = 0;
+    _rxLastHead = 0;
+    HAL_ESP_RxTail = 0;
+
+    MAP_uDMAChannelAssign(UDMA_CH20_UART7RX);
+    MAP_uDMAChannelAttributeDisable(UDMA_CH20_UART7RX, UDMA_ATTR_ALTSELECT |
+                                    UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY |
+                                    UDMA_ATTR_REQMASK);
+    MAP_uDMAChannelControlSet(UDMA_CH20_UART7RX | UDMA_PRI_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 |
+                              UDMA_ARB_4);
+    MAP_uDMAChannelControlSet(UDMA_CH20_UART7RX | UDMA_ALT_SELECT,
+                              UDMA_SIZE_8 | UDMA_SRC_INC_NONE | UDMA_DST_INC_8 |
+                              UDMA_ARB_4);
+    _HAL_ESP_RxArm(false);
+    _HAL_ESP_RxArm(true);
+    MAP_uDMAChannelEnable(UDMA_CH20_UART7RX);
+    MAP_UARTDMAEnable(ESP8266_UART_BASE, UART_DMA_RX);
+
+    //  Idle-line poll
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER7);
+    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_TIMER7);
+    MAP_TimerConfigure(TIMER7_BASE, TIMER_CFG_PERIODIC);
+    MAP_TimerLoadSet(TIMER7_BASE, TIMER_A,
+                     (g_ui32SysClock / 1000000) * ESP_RX_IDLE_US);
+    TimerIntRegister(TIMER7_BASE, TIMER_A, _HAL_ESP_RxIdleISR);
+    MAP_TimerIntEnable(TIMER7_BASE, TIMER_TIMA_TIMEOUT);
+    MAP_IntEnable(INT_TIMER7A);
+    MAP_TimerEnable(TIMER7_BASE, TIMER_A);
+}
+
+/**
+ * Get number of received characters waiting in the ring buffer to be read by
+ * HAL_ESP_RxGet(). If uDMA has overwritten characters that weren't read yet
+ * they are dropped (counted as overflow) and reading continues from the oldest
+ * character still in the ring
+ * @return number of characters available in the ring buffer
+ */
+uint16_t HAL_ESP_RxCount()
+{
+    bool masked = MAP_IntMasterDisable();
+    uint32_t head = _HAL_ESP_RxHead(),
+             avail = head - HAL_ESP_RxTail;
+
+    if (avail > ESP_RX_RING_LEN)
+    {
+        //  Continue from the start of the newest complete half, anything
+        //  older has been (at least partially) overwritten
+        uint32_t tail = (head - ESP_RX_HALF) & ~(uint32_t)(ESP_RX_HALF - 1);
+
+        _rxOverflows += tail - HAL_ESP_RxTail;
+        HAL_ESP_RxTail = tail;
+        avail = head - tail;
+    }
+    if (!masked)
+        MAP_IntMasterEnable();
+
+    return (uint16_t)avail;
+}
+#endif  /* __HAL_USE_ESP8266_RXDMA__ */
 
 /**
  * Initialize UART port communicating with ESP8266 chip - 8 data bits, no parity,
@@ -68,15 +244,22 @@ uint32_t HAL_ESP_InitPort(uint32_t baud)
 
 /**
  * Attach specific interrupt handler to ESP's UART and configure interrupt to
- * occur on every received character
+ * occur on every received character (or, when using uDMA, when half of the
+ * ring buffer is filled and when Rx line becomes idle)
  */
 void HAL_ESP_RegisterIntHandler(void((*intHandler)(void)))
 {
     MAP_UARTDisable(ESP8266_UART_BASE);
-    //  Enable Interrupt on received data
     MAP_UARTFIFOLevelSet(ESP8266_UART_BASE,UART_FIFO_TX1_8, UART_FIFO_RX1_8 );
     UARTIntRegister(ESP8266_UART_BASE, intHandler);
-    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_RX | UART_INT_RT);
+#if defined(__HAL_USE_ESP8266_RXDMA__)
+    //  Characters are moved from FIFO by uDMA, interrupt on finished transfer
+    _HAL_ESP_InitRxDMA();
+    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_DMARX | UART_INT_OE);
+#else
+    //  Enable Interrupt on received data
+    MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_RX | UART_INT_RT | UART_INT_OE);
+#endif  /* __HAL_USE_ESP8266_RXDMA__ */
     MAP_IntDisable(INT_UART7);
     MAP_UARTEnable(ESP8266_UART_BASE);
 }
@@ -126,9 +309,44 @@ int32_t HAL_ESP_ClearInt()
     uint32_t retVal = MAP_UARTIntStatus(ESP8266_UART_BASE, true);
     //  Clear all raised interrupt flags
     MAP_UARTIntClear(ESP8266_UART_BASE, retVal);
+    //  Character arrived while UART FIFO was full
+    if (retVal & UART_INT_OE)
+        _rxOverflows++;
     return retVal;
 }
 
+/**
+ * Enable/disable interrupt on free space in Tx FIFO (level below 1/8). Interrupt
+ * is raised only on transition of FIFO level so the FIFO has to be filled
+ * before enabling it
+ * @param enable
+ */
+void HAL_ESP_TxIntEnable(bool enable)
+{
+    if (enable) MAP_UARTIntEnable(ESP8266_UART_BASE, UART_INT_TX);
+    else MAP_UARTIntDisable(ESP8266_UART_BASE, UART_INT_TX);
+}
+
+/**
+ * Manually trigger UART interrupt, used to run UART ISR from outside of it
+ * (interrupt is executed as soon as it's enabled and no other interrupt of the
+ * same or higher priority is being processed)
+ */
+void HAL_ESP_PendInt()
+{
+    MAP_IntPendSet(INT_UART7);
+}
+
+/**
+ * Get number of received characters lost because they weren't read on time
+ * (overrun of UART FIFO or Rx ring buffer)
+ * @return number of lost characters since startup
+ */
+uint32_t HAL_ESP_RxOverflows()
+{
+    return _rxOverflows;
+}
+
 /**
  * Watchdog timer for ESP module - used to reset protocol if communication hangs
  * for too long.
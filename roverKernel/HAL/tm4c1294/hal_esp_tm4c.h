@@ -8,6 +8,8 @@
  *      UART7, pins PC4(Rx), PC5(Tx)
  *      GPIO PC6(CH_PD), PC7(Reset-not implemented!)
  *      Timer 6 - watchdog timer in case UART port hangs(likes to do so)
+ *      uDMA channel 20 (UART7 Rx), Timer 7 - Rx ring buffer & idle-line poll
+ *          (only with __HAL_USE_ESP8266_RXDMA__)
  */
 #include "hwconfig.h"
 
@@ -31,6 +33,32 @@
 #define HAL_ESP_SendChar(x)     MAP_UARTCharPut(ESP8266_UART_BASE, x)
 #define HAL_ESP_CharAvail()     MAP_UARTCharsAvail(ESP8266_UART_BASE)
 #define HAL_ESP_GetChar()       MAP_UARTCharGetNonBlocking(ESP8266_UART_BASE)
+//  Non-blocking transmit, used to feed Tx FIFO from Tx interrupt
+#define HAL_ESP_TxSpace()       MAP_UARTSpaceAvail(ESP8266_UART_BASE)
+#define HAL_ESP_PutCharNB(x)    MAP_UARTCharPutNonBlocking(ESP8266_UART_BASE, x)
+
+/*
+ * Receive path used by UART ISR: HAL_ESP_RxCount() returns number of received
+ * characters waiting to be read, each of them is then read with
+ * HAL_ESP_RxGet(). With uDMA the characters are taken from the ring buffer
+ * filled by uDMA, otherwise straight from UART FIFO
+ */
+#if defined(__HAL_USE_ESP8266_RXDMA__)
+//  Size of Rx ring buffer, has to be a power of 2. Split into two halves,
+//  filled by primary and alternate uDMA transfer (ping-pong)
+#define ESP_RX_RING_LEN         1024
+#define ESP_RX_HALF             (ESP_RX_RING_LEN / 2)
+//  Period of idle-line poll in us - UART ISR is triggered when new data stops
+//  arriving for this long
+#define ESP_RX_IDLE_US          200
+
+//  Read next character from the ring (HAL_ESP_RxCount() has to be checked first)
+#define HAL_ESP_RxGet()         \
+    (HAL_ESP_RxRing[(HAL_ESP_RxTail++) & (ESP_RX_RING_LEN - 1)])
+#else
+#define HAL_ESP_RxCount()       (HAL_ESP_CharAvail() ? 1 : 0)
+#define HAL_ESP_RxGet()         HAL_ESP_GetChar()
+#endif  /* __HAL_USE_ESP8266_RXDMA__ */
 
 
 #ifdef __cplusplus
@@ -44,6 +72,14 @@ extern void        HAL_ESP_HWEnable(bool enable);
 extern bool        HAL_ESP_IsHWEnabled();
 extern void        HAL_ESP_IntEnable(bool enable);
 extern int32_t     HAL_ESP_ClearInt();
+extern void        HAL_ESP_TxIntEnable(bool enable);
+extern void        HAL_ESP_PendInt();
+#if defined(__HAL_USE_ESP8266_RXDMA__)
+extern uint8_t     HAL_ESP_RxRing[ESP_RX_RING_LEN];
+extern uint32_t    HAL_ESP_RxTail;
+extern uint16_t    HAL_ESP_RxCount();
+#endif  /* __HAL_USE_ESP8266_RXDMA__ */
+extern uint32_t    HAL_ESP_RxOverflows();
 //extern bool        HAL_ESP_CharAvail();
 //extern char        HAL_ESP_GetChar();
 extern void        HAL_ESP_InitWD(void((*intHandler)(void)));
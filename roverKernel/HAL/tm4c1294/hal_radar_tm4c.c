@@ -16,6 +16,7 @@
 #include "inc/hw_timer.h"
 #include "inc/hw_ints.h"
 #include "inc/hw_gpio.h"
+#include "inc/hw_adc.h"
 
 #include "driverlib/rom_map.h"
 #include "driverlib/rom.h"
@@ -25,6 +26,9 @@
 #include "driverlib/pwm.h"
 #include "driverlib/adc.h"
 #include "driverlib/systick.h"
+#include "driverlib/interrupt.h"
+#include "driverlib/timer.h"
+#include "driverlib/udma.h"
 
 
 /**     Radar - related macros        */
@@ -37,6 +41,23 @@
 #define RAD_MIN         54000       //Left/Down
 #define RAD_PWM_ARG     62498       //PWM generator clock
 
+/*
+ * Background sampling: Timer 5 periodically triggers ADC0 sequencer 2 (AIN3),
+ * every conversion is moved by uDMA into user's buffer. Once the transfer is
+ * finished sequencer's DMA interrupt stops the timer
+ */
+static volatile bool _sampleDone = true;
+
+/**
+ * ADC0 sequencer 2 interrupt, raised once uDMA has moved all samples
+ */
+static void _HAL_RAD_SampleISR()
+{
+    MAP_ADCIntClearEx(ADC0_BASE, ADC_INT_DMA_SS2);
+    MAP_TimerDisable(TIMER5_BASE, TIMER_A);
+    _sampleDone = true;
+}
+
 /**
  * Initialize hardware used for IR radar peripheral
  */
@@ -81,6 +102,28 @@ void HAL_RAD_Init()
     //  Configure hardware averaging of 64 samples
     MAP_ADCHardwareOversampleConfigure(ADC0_BASE, 64);
 
+    //  Background sampling of the same input, triggered by Timer 5
+    HAL_DMA_Init();
+    MAP_SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER5);
+    MAP_SysCtlPeripheralReset(SYSCTL_PERIPH_TIMER5);
+    MAP_TimerConfigure(TIMER5_BASE, TIMER_CFG_PERIODIC);
+    MAP_TimerControlTrigger(TIMER5_BASE, TIMER_A, true);
+    MAP_ADCSequenceConfigure(ADC0_BASE, 2, ADC_TRIGGER_TIMER, 1);
+    MAP_ADCSequenceStepConfigure(ADC0_BASE, 2, 0,
+                             ADC_CTL_CH3 | ADC_CTL_IE | ADC_CTL_END);
+    MAP_ADCSequenceEnable(ADC0_BASE, 2);
+    MAP_ADCSequenceDMAEnable(ADC0_BASE, 2);
+    MAP_uDMAChannelAssign(UDMA_CH16_ADC0_2);
+    MAP_uDMAChannelAttributeDisable(UDMA_CH16_ADC0_2, UDMA_ATTR_ALTSELECT |
+                                    UDMA_ATTR_USEBURST | UDMA_ATTR_HIGH_PRIORITY |
+                                    UDMA_ATTR_REQMASK);
+    MAP_uDMAChannelControlSet(UDMA_CH16_ADC0_2 | UDMA_PRI_SELECT,
+                              UDMA_SIZE_16 | UDMA_SRC_INC_NONE | UDMA_DST_INC_16 |
+                              UDMA_ARB_1);
+    ADCIntRegister(ADC0_BASE, 2, _HAL_RAD_SampleISR);
+    MAP_ADCIntEnableEx(ADC0_BASE, ADC_INT_DMA_SS2);
+    MAP_IntEnable(INT_ADC0SS2);
+
     HAL_RAD_Enable(true);
 
     //  Wait for gimbal servos to get to specified positions
@@ -162,4 +205,41 @@ uint32_t HAL_RAD_ADCTrigger()
     return retVal;
 }
 
+/**
+ * Start collecting samples of IR sensor output in the background
+ * Timer triggers a conversion every [periodUS], uDMA moves it to [buf]. Call
+ * HAL_RAD_SampleDone() to check whether all of them have been collected
+ * @param buf buffer for samples (12-bit values), has to stay valid until done
+ * @param n number of samples to collect (at most 1024)
+ * @param periodUS time between two samples in us
+ */
+void HAL_RAD_SampleStart(uint16_t *buf, uint16_t n, uint32_t periodUS)
+{
+    uint32_t tmp[4];
+
+    //  Discard conversions left in FIFO since previous run
+    while (MAP_ADCSequenceDataGet(ADC0_BASE, 2, tmp) > 0);
+
+    _sampleDone = false;
+    MAP_uDMAChannelTransferSet(UDMA_CH16_ADC0_2 | UDMA_PRI_SELECT,
+                               UDMA_MODE_BASIC,
+                               (void*)(ADC0_BASE + ADC_O_SSFIFO2),
+                               (void*)buf, n);
+    MAP_uDMAChannelEnable(UDMA_CH16_ADC0_2);
+
+    MAP_TimerLoadSet(TIMER5_BASE, TIMER_A,
+                     (g_ui32SysClock / 1000000) * periodUS);
+    MAP_TimerEnable(TIMER5_BASE, TIMER_A);
+}
+
+/**
+ * Check whether background sampling started with HAL_RAD_SampleStart() has
+ * collected all samples
+ * @return true if all samples are in the buffer
+ */
+bool HAL_RAD_SampleDone()
+{
+    return _sampleDone;
+}
+
 #endif  /* __HAL_USE_RADAR__ */
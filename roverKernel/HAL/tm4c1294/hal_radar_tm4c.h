@@ -8,6 +8,8 @@
  *      PWM - Generator 1 & 3
  *      G1:PWM Out1(PF1 - horiz. axis), G3:PWM Out4(PG0 - vert. axis)
  *      ADC0: AIN3(PE0) - sampling sensor output
+ *      Timer 5, ADC0 sequencer 2, uDMA channel 16 - background sampling of
+ *          sensor output (HAL_RAD_SampleStart)
  */
 #include "hwconfig.h"
 
@@ -27,6 +29,9 @@ extern float       HAL_RAD_GetHorAngle();
 extern void        HAL_RAD_Init();
 extern void        HAL_RAD_Enable(bool enable);
 extern uint32_t    HAL_RAD_ADCTrigger();
+extern void        HAL_RAD_SampleStart(uint16_t *buf, uint16_t n,
+                                       uint32_t periodUS);
+extern bool        HAL_RAD_SampleDone();
 
 #ifdef __cplusplus
 }
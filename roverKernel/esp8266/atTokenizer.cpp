@@ -0,0 +1,113 @@
+/**
+ * atTokenizer.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "atTokenizer.h"
+
+#include <string.h>
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+ATTokenizer::ATTokenizer() : _stateN(1), _classN(1), _state(0)
+{
+    memset((void*)_class, 0, sizeof(_class));
+    memset((void*)_next, 0, sizeof(_next));
+    memset((void*)_out, 0, sizeof(_out));
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Compile a set of tokens into the automaton. Any previously built set is
+ * discarded.
+ * @param tokens array of null-terminated tokens to look for
+ * @param tokenN number of tokens in [tokens] array (max ATT_MAX_TOKENS)
+ * @return true on success, false if token set doesn't fit into the automaton
+ */
+bool ATTokenizer::Build(const char * const *tokens, uint8_t tokenN)
+{
+    uint8_t fail[ATT_MAX_STATES] = {0},
+            queue[ATT_MAX_STATES],
+            qHead = 0, qTail = 0;
+
+    memset((void*)_class, 0, sizeof(_class));
+    memset((void*)_next, 0, sizeof(_next));
+    memset((void*)_out, 0, sizeof(_out));
+    _stateN = 1;
+    _classN = 1;
+    _state = 0;
+
+    if (tokenN > ATT_MAX_TOKENS)
+        return false;
+
+    //  Build keyword trie, state 0 is root. While building, transition to 0
+    //  means 'no child'
+    for (uint8_t t = 0; t < tokenN; t++)
+    {
+        uint8_t s = 0;
+
+        for (const uint8_t *c = (const uint8_t*)tokens[t]; *c != '\0'; c++)
+        {
+            //  Each distinct character in the token set gets its own class
+            if (_class[*c] == 0)
+            {
+                if (_classN >= ATT_MAX_CLASSES)
+                    return false;
+                _class[*c] = _classN++;
+            }
+
+            if (_next[s][_class[*c]] == 0)
+            {
+                if (_stateN >= ATT_MAX_STATES)
+                    return false;
+                _next[s][_class[*c]] = _stateN++;
+            }
+            s = _next[s][_class[*c]];
+        }
+        _out[s] |= (1UL << t);
+    }
+
+    //  Children of root fall back to root
+    for (uint8_t c = 0; c < _classN; c++)
+        if (_next[0][c] != 0)
+            queue[qTail++] = _next[0][c];
+
+    //  Breadth-first walk computing failure links; missing transitions are
+    //  replaced by the transition of the failure state, making the table
+    //  complete (deterministic automaton)
+    while (qHead < qTail)
+    {
+        uint8_t s = queue[qHead++];
+
+        //  State also matches all tokens matched by its failure state
+        _out[s] |= _out[fail[s]];
+
+        for (uint8_t c = 0; c < _classN; c++)
+        {
+            uint8_t child = _next[s][c];
+
+            if (child != 0)
+            {
+                fail[child] = _next[fail[s]][c];
+                queue[qTail++] = child;
+            }
+            else
+                _next[s][c] = _next[fail[s]][c];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Reset automaton into initial state (no partially matched tokens)
+ */
+void ATTokenizer::Reset()
+{
+    _state = 0;
+}
@@ -0,0 +1,76 @@
+/**
+ * atTokenizer.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Streaming matcher for a fixed set of tokens in the ESP8266 AT reply stream.
+ *  Token set is compiled once (at initialization) into a deterministic automaton
+ *  (Aho-Corasick: keyword trie + failure links, flattened into a full
+ *  transition table over character classes). Afterwards every received
+ *  character is consumed with a single table lookup, regardless of how many
+ *  tokens are being searched for or how long the current line is, which makes
+ *  it suitable to be run directly from UART Rx ISR.
+ *  Each state holds a bit-mask of all tokens ending in it, so overlapping
+ *  tokens (e.g. "SEND OK" and "OK") are all reported on the same character.
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Aho-Corasick automaton for up to 32 tokens, built at runtime
+ */
+
+#ifndef ROVERKERNEL_ESP8266_ATTOKENIZER_H_
+#define ROVERKERNEL_ESP8266_ATTOKENIZER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//  Limits of the automaton (memory used: ATT_MAX_STATES*ATT_MAX_CLASSES bytes
+//  for transition table + 256 bytes for character class map). Sized for the
+//  ESP8266 token set (98 states, 35 classes) with some headroom
+#define ATT_MAX_STATES      112
+#define ATT_MAX_CLASSES     36
+#define ATT_MAX_TOKENS      32
+
+/**
+ * ATTokenizer class definition
+ * Matches tokens given in Build() in a stream of characters fed one at a time
+ * through Step()
+ */
+class ATTokenizer
+{
+    public:
+        ATTokenizer();
+
+        bool        Build(const char * const *tokens, uint8_t tokenN);
+        void        Reset();
+
+        /**
+         * Consume a single character from the stream
+         * @param c received character
+         * @return bit-mask of tokens ending at this character (bit N set for
+         * N-th token passed to Build()), 0 if no token was matched
+         */
+        inline uint32_t Step(uint8_t c)
+        {
+            _state = _next[_state][_class[c]];
+            return _out[_state];
+        }
+
+    protected:
+        //  Character -> character class map (0 is class of all characters not
+        //  appearing in any token)
+        uint8_t     _class[256];
+        //  Transition table: next state for [current state][character class]
+        uint8_t     _next[ATT_MAX_STATES][ATT_MAX_CLASSES];
+        //  Bit-mask of tokens matched when entering a state
+        uint32_t    _out[ATT_MAX_STATES];
+        //  Number of used states & character classes
+        uint8_t     _stateN;
+        uint8_t     _classN;
+        //  Current state of the automaton
+        uint8_t     _state;
+};
+
+#endif /* ROVERKERNEL_ESP8266_ATTOKENIZER_H_ */
@@ -35,6 +35,58 @@ void UART7RxIntHandler(void);
 //  2048 is max allowed length for a continuous stream ESP can handle
 char _commBuf[2048];
 
+//  Pool of client objects, one per socket ID. Object is bound to _clients[]
+//  when socket opens and unbound when it closes, nothing is allocated at runtime
+static _espClient __espPool[ESP_MAX_CLI];
+
+/**
+ * Status tokens searched for in ESP replies. Index of the token in this array
+ * is its bit in the mask returned by ATTokenizer::Step()
+ */
+#define ESP_TOK_OK          0
+#define ESP_TOK_ERROR       1
+#define ESP_TOK_SENDOK      2
+#define ESP_TOK_BUSY        3
+#define ESP_TOK_FAIL        4
+#define ESP_TOK_READY       5
+#define ESP_TOK_SUCCESS     6
+#define ESP_TOK_PROMPT      7
+#define ESP_TOK_IPD         8
+#define ESP_TOK_CONNECT     9
+#define ESP_TOK_CLOSED      10
+#define ESP_TOK_WIFICONN    11
+#define ESP_TOK_WIFIGOTIP   12
+#define ESP_TOK_WIFIDISCONN 13
+#define ESP_TOK_IP          14
+#define ESP_TOK_BUFRECV     15
+#define ESP_TOK_SEGOK       16
+#define ESP_TOK_SEGFAIL     17
+#define ESP_TOK_NUM         18
+//  'busy ' matches both 'busy p...' (processing) and 'busy s...' (sending)
+static const char * const __espTokens[ESP_TOK_NUM] =
+{
+    "OK", "ERROR", "SEND OK", "busy ", "FAIL", "READY", "SUCCESS", "> ",
+    "+IPD,", ",CONNECT", ",CLOSED", "WIFI CONN", "WIFI GOT IP", "WIFI DISCONN",
+    "ip:\"", "Recv ", ",SEND OK", ",SEND FAIL"
+};
+//  Checks whether token with given ID is set in the mask
+#define ESP_TOK(MASK, ID)   (((MASK) & (1UL << (ID))) != 0)
+
+//  Timeout of each command type used until its first reply is measured (same
+//  as the fixed timeouts used before they became adaptive)
+static const uint32_t __espInitRTO[ESP_CMDT_NUM] =
+{
+    250, 250, ESP_TX_TIMEOUT, ESP_TX_TIMEOUT, ESP_TX_TIMEOUT
+};
+
+//  Latency is measured in ms since startup as kept by task scheduler (or host
+//  HAL's clock), without it timeouts stay at their initial values
+#if defined(__USE_TASK_SCHEDULER__)
+#define ESP_NOW()           ((uint32_t)msSinceStartup)
+#elif defined(__BOARD_HOST__)
+#define ESP_NOW()           HAL_MsSinceStartup()
+#endif  /* __USE_TASK_SCHEDULER__ */
+
 
 #if defined(__USE_TASK_SCHEDULER__)
 /**
@@ -114,8 +166,39 @@ void _ESP_KernelCallback(void)
         }
         break;
     /*
-     * Send message to specific TCP client
+     * Open UDP socket to remote host on given IP address and port
+     * args[] = localPort(2B)|IPaddress(7B-15B)|port(2B)|socketID(1B)
+     * retVal ESP library error code (if > 5); or socket ID (if <=5)
+     */
+    case ESP_T_CONNUDP:
+        {
+            char ipAddr[16] = {0};
+            uint16_t port, localPort;
+            uint8_t sockID;
+
+            if ((__esp._espKer.argN < 12) || (__esp._espKer.argN > 20))
+                return;
+            memcpy((void*)&localPort, (void*)__esp._espKer.args, 2);
+            //  IP address is a string between local port and remote port
+            memcpy( (void*)ipAddr,
+                    (void*)(__esp._espKer.args + 2),
+                    __esp._espKer.argN - 5);
+            memcpy( (void*)&port,
+                    (void*)(__esp._espKer.args + (__esp._espKer.argN-3)),
+                    2);
+            sockID =  __esp._espKer.args[__esp._espKer.argN-1];
+            //  If IP address is valid process request
+            if (__esp._IPtoInt(ipAddr) == 0)
+                return;
+            __esp._espKer.retVal = __esp.OpenUDPSock(ipAddr, port, localPort,
+                                                     sockID);
+        }
+        break;
+    /*
+     * Send message to specific TCP client (message is only queued, outcome is
+     * reported through send hook and event logger once it's sent)
      * args[] = socketID(1B)|message|
+     * retVal ESP_STATUS_OK if message is queued, ESP_STATUS_ERROR otherwise
      */
     case ESP_T_SENDTCP:
         {
@@ -124,25 +207,25 @@ void _ESP_KernelCallback(void)
                return;
             //  Ensure that message is null-terminated
             __esp._espKer.args[__esp._espKer.argN] = '\0';
-            //  Initiate TCP send to required client
-            __esp._espKer.retVal = __esp.GetClientBySockID(__esp._espKer.args[0])
-                                      ->SendTCP((char*)(__esp._espKer.args+1));
+            //  Queue TCP send to required client
+            if (__esp.GetClientBySockID(__esp._espKer.args[0])
+                    ->SendTCPAsync((char*)(__esp._espKer.args+1)) != 0)
+                __esp._espKer.retVal = ESP_STATUS_OK;
+            else
+                __esp._espKer.retVal = ESP_STATUS_ERROR;
         }
         break;
     /*
-     * Receive data from an opened socket and pass it to user-defined routine
+     * Pass all messages queued on an opened socket (and not yet delivered) one
+     * by one to user-defined routine
      * args[] = socketID(1B)
      */
     case ESP_T_RECVSOCK:
         {
-            _espClient  *cli;
             //  Check if socket ID is valid
             if (!__esp.ValidSocket(__esp._espKer.args[0]))
                 return;
-            cli = __esp.GetClientBySockID(__esp._espKer.args[0]);
-            __esp.custHook(__esp._espKer.args[0],
-                            (uint8_t*)(cli->RespBody),
-                            (uint16_t)((cli->RespLen)));
+            __esp._Deliver(__esp._espKer.args[0]);
             __esp._espKer.retVal = ESP_STATUS_OK;
         }
         break;
@@ -171,6 +254,8 @@ void _ESP_KernelCallback(void)
             for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
                 if (__esp._clients[i] != 0)
                     ((_espClient*)__esp._clients[i])->Close();
+            //  Wait for queued commands before powering down
+            while (__esp.CmdPending());
             //  Power down ESP chip
             __esp.Enable(false);
 #ifdef __HAL_USE_EVENTLOG__
@@ -212,6 +297,7 @@ void _ESP_KernelCallback(void)
 void ESPWDISR()
 {
     ESP8266::GetI().flowControl = ESP_STATUS_ERROR;
+    ESP8266::GetI()._wdTimeout = true;
 
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_HANG);
@@ -252,12 +338,25 @@ ESP8266* ESP8266::GetP()
  * to handle any blockage in communication and (if using task scheduler)
  * register kernel module so TS can make calls to this library.
  * @param baud baud-rate used in serial communication between ESP and hardware
- * @return error code, depending on the outcome
+ * @return error code, depending on the outcome (ESP_STATUS_ERROR if status
+ * tokens didn't fit into reply parser)
  */
 uint32_t ESP8266::InitHW(int32_t baud)
 {
     uint32_t retVal;
 
+    //  Replies can't be parsed reliably with a partial token set
+    if (!_tokOK)
+    {
+#ifdef __DEBUG_SESSION__
+        DEBUG_WRITE("ESP status tokens don't fit into tokenizer\n");
+#endif
+#ifdef __HAL_USE_EVENTLOG__
+        EMIT_EV(-1, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+        return ESP_STATUS_ERROR;
+    }
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_STARTUP);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -284,6 +383,7 @@ uint32_t ESP8266::InitHW(int32_t baud)
     wifiStatus = ESP_WIFI_NONE;
     for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
         _clients[i] = 0;
+    _txBufOK = true;
 
 #if defined(__USE_TASK_SCHEDULER__)
     //  Register module services with task scheduler
@@ -332,6 +432,185 @@ void ESP8266::AddHook(void((*funPoint)(const uint8_t, const uint8_t*, const uint
     custHook = funPoint;
 }
 
+/**
+ * Register hook to user function called every time a send queued with
+ * _espClient::SendTCPAsync() completes. Arguments passed to the hook are socket
+ * ID, handle returned by SendTCPAsync() and outcome of the send
+ * (ESP_STATUS_SENDOK or ESP_STATUS_ERROR)
+ * @note Hook is called from UART ISR, keep it short
+ * @param funPoint pointer to void function with 3 arguments
+ */
+void ESP8266::AddSendHook(void((*funPoint)(const uint8_t, const uint16_t,
+                                           const uint32_t)))
+{
+    _sendHook = funPoint;
+}
+
+/**
+ * Register hook to user function receiving data from sockets without copying
+ * Hook is called for every message received on any socket with a view of the
+ * exact +IPD payload in socket's Rx ring. If the hook returns false the message
+ * is released as soon as it returns; if it returns true it keeps the payload
+ * and has to call view->release(view) once it's done with it (hook has to
+ * copy the view structure itself if it keeps it). Until released, payload
+ * occupies space in socket's Rx ring, so views should be released promptly.
+ * When set, this hook is used instead of the one registered with AddHook()
+ * @param funPoint pointer to bool function taking a view of the message
+ */
+void ESP8266::AddViewHook(bool((*funPoint)(const struct _espRxView*)))
+{
+    _viewHook = funPoint;
+}
+
+/**
+ * Release a message handed out to hook registered with AddViewHook(). Views
+ * can be released in any order and from any context except UART ISR.
+ * Releasing a view of a socket that has been closed in the meantime is allowed
+ * and has no effect.
+ * @param view view passed to the hook (or a copy of it)
+ */
+void ESP8266::ReleaseView(const struct _espRxView *view)
+{
+    _espClient *cli = ESP8266::GetI().GetClientBySockID(view->sockID);
+
+    if ((cli != 0) && (cli->_gen == view->_gen))
+        cli->_RxRelease(view->_msg);
+}
+
+/**
+ * Select how data queued on a socket is handed to ESP
+ * In buffered mode payload is sent with AT+CIPSENDBUF: ESP copies it into its
+ * own send buffer and the send is reported as completed (ESP_STATUS_SENDOK)
+ * right away, so the next send can start without waiting for the remote side
+ * to acknowledge the previous one. Segments ESP fails to deliver afterwards
+ * are only reported to event logger. If the firmware doesn't support
+ * AT+CIPSENDBUF all sockets fall back to AT+CIPSEND.
+ * @note Setting is kept per socket ID and survives reopening of the socket
+ * @param sockID socket ID
+ * @param enable true to use buffered send, false for AT+CIPSEND
+ */
+void ESP8266::SendBuffered(uint8_t sockID, bool enable)
+{
+    if (_IDtoIndex(sockID) >= ESP_MAX_CLI)
+        return;
+
+    if (enable)
+        _txBufMask |= (1 << sockID);
+    else
+        _txBufMask &= ~(1 << sockID);
+}
+
+/**
+ * Check if sends on a socket are executed in buffered mode
+ * @param sockID socket ID
+ * @return true if socket is set to use buffered send and firmware supports it
+ */
+bool ESP8266::SendBuffered(uint8_t sockID)
+{
+    if (_IDtoIndex(sockID) >= ESP_MAX_CLI)
+        return false;
+
+    return _txBufOK && ((_txBufMask & (1 << sockID)) != 0);
+}
+
+/**
+ * Queue AT command to be sent to ESP without waiting for it
+ * Commands are issued back-to-back from UART ISR in the order they were queued
+ * (before any queued socket sends): next command is sent as soon as the
+ * previous one completes. Command completes when any of the [expect] statuses
+ * is received; on ERROR/FAIL/busy reply or if it doesn't complete within
+ * [timeout] it's issued again up to [retries] times before failing.
+ * @param cmd null-terminated command, without trailing \r\n
+ * @param expect bitwise OR of ESP_STATUS_* values completing the command
+ * @param timeout time in ms allowed for a single attempt, ESP_TIMEOUT_AUTO to
+ * derive it from the latency measured on previous commands of the same type
+ * @param retries number of times to reissue failed command
+ * @param done[optional] hook called (from UART ISR) once the command completes
+ * with the handle returned here and bitwise OR of all ESP_STATUS_* received
+ * while executing it (ESP_STATUS_ERROR set on failure, ESP_NORESPONSE set on
+ * timeout)
+ * @return handle of queued command (never 0), 0 if the queue is full or the
+ * command is too long
+ */
+uint16_t ESP8266::QueueCmd(const char *cmd, uint32_t expect, uint32_t timeout,
+                           uint8_t retries,
+                           void((*done)(const uint16_t, const uint32_t)))
+{
+    struct _espATCmd *at;
+    uint16_t len = strlen(cmd);
+
+    //  Check for space in the queue and in command buffer (+ \r\n\0)
+    if (((uint8_t)(_atQHead - _atQTail) >= ESP_AT_QLEN) ||
+        ((len + 3) > ESP_AT_CMD_LEN))
+        return 0;
+
+    at = &_atQ[_atQHead & (ESP_AT_QLEN - 1)];
+    memcpy((void*)at->cmd, (void*)cmd, len);
+    memcpy((void*)(at->cmd + len), (void*)"\r\n", 3);
+    at->expect = expect;
+    at->timeout = timeout;
+    //  Connecting a socket waits for the remote side, everything else is
+    //  answered by ESP itself
+    if (strncmp(cmd, "AT+CIPSTART", 11) == 0)
+        at->type = ESP_CMDT_CONN;
+    else
+        at->type = ESP_CMDT_AT;
+    at->retries = retries;
+    at->done = done;
+    at->status = ESP_NO_STATUS;
+    //  Handles are shared with socket sends, 0 is reserved for error
+    if (++_txHandle == 0)
+        _txHandle++;
+    at->handle = _txHandle;
+
+    //  Publish the entry only once it's complete, ISR can pick it up after this
+    _atQHead++;
+
+    //  Let UART ISR start the command if nothing is being sent at the moment
+    HAL_ESP_IntEnable(true);
+    HAL_ESP_PendInt();
+
+    return at->handle;
+}
+
+/**
+ * Check if there are any AT commands queued or in progress
+ * @return true if there are commands not yet completed
+ */
+bool ESP8266::CmdPending()
+{
+    return (_atQHead != _atQTail);
+}
+
+/**
+ * Get outcome of a command queued with QueueCmd()
+ * Completed commands are kept in the queue until their entry is reused, so the
+ * outcome should be polled shortly after the command completes
+ * @param handle handle of the command as returned by QueueCmd()
+ * @return ESP_NO_STATUS if command is still queued or in progress,
+ *         bitwise OR of ESP_STATUS_* received while executing it once it
+ *         completed (see QueueCmd()),
+ *         ESP_STATUS_ERROR | ESP_NORESPONSE if command is no longer known
+ */
+uint32_t ESP8266::CmdStatus(uint16_t handle)
+{
+    //  Walk the last ESP_AT_QLEN entries starting with the newest one
+    for (uint8_t i = 1; i <= ESP_AT_QLEN; i++)
+    {
+        uint8_t entry = _atQHead - i;
+
+        if (_atQ[entry & (ESP_AT_QLEN - 1)].handle != handle)
+            continue;
+        //  Entries from _atQTail onwards haven't completed yet
+        if ((int8_t)(entry - _atQTail) >= 0)
+            return ESP_NO_STATUS;
+
+        return _atQ[entry & (ESP_AT_QLEN - 1)].status;
+    }
+
+    return ESP_STATUS_ERROR | ESP_NORESPONSE;
+}
+
 ///-----------------------------------------------------------------------------
 ///                  Functions used with access points                  [PUBLIC]
 ///-----------------------------------------------------------------------------
@@ -498,51 +777,52 @@ void ESP8266::TCPListen(bool enable)
 uint32_t ESP8266::OpenTCPSock(char *ipAddr, uint16_t port,
                               bool keepAlive, uint8_t sockID)
 {
-    uint32_t retVal;
-    uint8_t strNum[6] = {0};
-
-    //  Can't continue if ESP is not connected
-    if (wifiStatus != ESP_WIFI_CONNECTED)
-        return ESP_STATUS_ERROR;
+    return _OpenSock(false, ipAddr, port, 0, keepAlive, sockID);
+}
 
-    //  Check if socket with this ID already exists, if not create it, if yes
-    //  fined first free socket ID and use it instead
-    if (GetClientBySockID(sockID) != 0 || (sockID >= ESP_MAX_CLI))
-    {
-        //  Find free socket number (0-(ESP_MAX_CLI-1) supported)
-        for (sockID = 0; sockID <= ESP_MAX_CLI; sockID++)
-            if (_clients[sockID] == 0)
-                break;
-        //  If loop hit ESP_MAX_CLI there are no free sockets, return error code
-        if (sockID >= ESP_MAX_CLI)
-            return ESP_STATUS_ERROR;
-    }
+/**
+ * Open UDP socket for exchanging datagrams with a host at specific IP and port
+ * Every send queued on the socket is sent as a single datagram; there's no
+ * acknowledgment or retransmission so a lost datagram never holds back the
+ * following ones
+ * @param ipAddr string containing IP address of remote host(null-terminated)
+ * @param port UDP port of remote host
+ * @param localPort[optional] local UDP port, if 0 ESP picks one
+ * @param sockID[optional] desired socket ID to assign to this socket, if
+ * not specified smallest free ID is used
+ * @return On success socket ID of UDP socket in _client vector,
+ *         On failure ESP_STATUS_ERROR error code
+ */
+uint32_t ESP8266::OpenUDPSock(char *ipAddr, uint16_t port, uint16_t localPort,
+                              uint8_t sockID)
+{
+    return _OpenSock(true, ipAddr, port, localPort, true, sockID);
+}
 
-    //  Assemble command: Open TCP socket to specified IP and port, set
-    //  keep alive interval to 7200ms
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSTART=");
-    itoa(sockID, strNum);
-    strcat(_commBuf, (char*)strNum);
-    strcat(_commBuf, ",\"TCP\",\"");
-    strcat(_commBuf, ipAddr);
-    strcat(_commBuf, "\",");
-    memset(strNum, 0, sizeof(strNum));
-    itoa(port, strNum);
-    strcat(_commBuf, (char*)strNum);
-    strcat(_commBuf, ",7200\0");
+/**
+ * Queue opening of TCP or UDP socket without waiting for ESP to connect it
+ * Socket is available through GetClientBySockID() once ESP reports it's
+ * connected, outcome of the attempt can be polled with CmdStatus(). TCP
+ * sockets are kept alive, UDP sockets use ESP-assigned local port
+ * @param udp true to open UDP socket, false for TCP
+ * @param ipAddr string containing IP address of remote host(null-terminated)
+ * @param port port of remote host
+ * @param sockID desired socket ID, if taken smallest free ID is used and
+ * returned through this pointer
+ * @return handle of queued AT+CIPSTART command,
+ *         0 if ESP is not connected to AP, there are no free sockets or the
+ *         command queue is full
+ */
+uint16_t ESP8266::OpenSockAsync(bool udp, char *ipAddr, uint16_t port,
+                                uint8_t *sockID)
+{
+    if (!_SockCmd(udp, ipAddr, port, 0, sockID))
+        return 0;
 
-    //  Execute command and check outcome
-    retVal = _SendRAW(_commBuf);
-    if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR))
-    {
-        //  If success, start listening for potential incoming data from server
-        TCPListen(true);
-        GetClientBySockID(sockID)->KeepAlive = keepAlive;
-        retVal = sockID;
-    }
+    //  Start listening so the connect event is picked up from UART ISR
+    TCPListen(true);
 
-    return retVal;
+    return QueueCmd(_commBuf);
 }
 
 /**
@@ -586,148 +866,98 @@ _espClient* ESP8266::GetClientBySockID(uint8_t id)
 
 /**
  * ESP reply message parser
- * Checks ESP reply stream for commands, actions and events and updates global
- * variables accordingly.
+ * Feeds the message through the incremental parser (same one used by UART ISR)
+ * and updates global variables accordingly.
  * @param rxBuffer string containing reply message from ESP
  * @param rxLen length of [rxBuffer] string
  * @return bitwise OR of all statuses(ESP_STATUS_*) found in the message string
  */
 uint32_t ESP8266::ParseResponse(char* rxBuffer, uint16_t rxLen)
 {
-    //  Return value
     uint32_t retVal = ESP_NO_STATUS;
-    //  Flags to be set when the parameter has been found
-    int16_t ipFlag= -1, respFlag = -1, sockOflag = -1, sockCflag = -1;
-    //  Pointer to char, used to temporary store return value of strstr function
-    char *retTemp;
 
-    //  If message is empty return here
-    if (rxLen < 1)
-        return retVal;
+    for (uint16_t i = 0; i < rxLen; i++)
+        retVal |= _ParseChar(rxBuffer[i]);
 
-    //  IP address embedded, save pointer to its first digit(as string)
-    if ((retTemp = strstr(rxBuffer,"ip:\"")) != NULL)
-        ipFlag = retTemp - rxBuffer + 4;
+    //  Include statuses of the last line even if it wasn't terminated
+    retVal |= _rxStatus;
+    _rxStatus = ESP_NO_STATUS;
 
-    //  Message from one of the sockets, save pointer to first character
-    //  (which is always message length!)
-    if ((retTemp = strstr(rxBuffer,"+IPD,")) != NULL)
-    {
-        respFlag = retTemp - rxBuffer + 5;
-        retVal |= ESP_STATUS_IPD;
-    }
+    return retVal;
+}
 
-    //  Look for general status messages returned by ESP
-    if (strstr(rxBuffer,"WIFI CONN") != NULL)
-    {
-        retVal |= ESP_STATUS_CONNECTED;
-        wifiStatus = ESP_WIFI_CONNECTING;
-    }
-    if (strstr(rxBuffer,"WIFI GOT IP") != NULL)
-        wifiStatus = ESP_WIFI_CONNECTED;
-    if (strstr(rxBuffer,"WIFI DISCONN") != NULL)
-        retVal |= ESP_STATUS_DISCN;
-    if (strstr(rxBuffer,"OK") != NULL)
-        retVal |= ESP_STATUS_OK;
-    if (strstr(rxBuffer,"busy...") != NULL)
-        retVal |= ESP_STATUS_BUSY;
-    if (strstr(rxBuffer,"FAIL") != NULL)
-        retVal |= ESP_STATUS_FAIL;
-    if (strstr(rxBuffer,"ERROR") != NULL)
-        retVal |= ESP_STATUS_ERROR;
-    if (strstr(rxBuffer,"READY") != NULL)
-        retVal |= ESP_STATUS_READY;
-    if (strstr(rxBuffer,"SEND OK") != NULL)
-        retVal |= ESP_STATUS_SENDOK;
-    if (strstr(rxBuffer,"SUCCESS") != NULL)
-        retVal |= ESP_RESPOND_SUCC;
-    if (strstr(rxBuffer,">") != NULL)
-        retVal |= ESP_STATUS_RECV;
-
-    //  If new socket is opened save socket id
-    if ((retTemp =strstr(rxBuffer,",CONNECT")) != NULL)
-    {
-        sockOflag = retTemp - rxBuffer - 1; //Sock ID position
-        //  Socket got opened, create new client for it
-        if (sockOflag >= 0)
-            _clients[rxBuffer[sockOflag] - 48] =
-                    new _espClient(rxBuffer[sockOflag] - 48, this);
+/**
+ * Get traffic counters of a socket. Counters are kept since startup, also
+ * while the socket is closed.
+ * @param sockID socket ID
+ * @param stats[out] byte/message/drop counters of the socket
+ * @return true if [sockID] is valid, false otherwise
+ */
+bool ESP8266::SockStats(uint8_t sockID, struct _espSockStats *stats)
+{
+    if (_IDtoIndex(sockID) >= ESP_MAX_CLI)
+        return false;
 
-        retVal |= ESP_STATUS_SOCKOPEN;
-    }
-    //  If socket is closed save socket id
-    if ((retTemp =strstr(rxBuffer,",CLOSED")) != NULL)
-    {
-        //  Handles a case when multiple sockets are closed at the same time
-        //  e.g. when few sockets are opened to the same server, and server
-        //  goes down
-        while (retTemp != NULL)
-        {
-            sockCflag = retTemp - rxBuffer - 1; //Sock ID position
-            //  Socket got closed, find client with this ID and delete it
-            if (sockCflag >= 0)
-            {
-                delete _clients[rxBuffer[sockCflag] - 48];
-                _clients[rxBuffer[sockCflag] - 48] = 0;
-            }
+    __espPool[sockID].Stats(stats);
+    return true;
+}
 
-            retTemp =strstr(retTemp+1,",CLOSED");
-        }
-        retVal |= ESP_STATUS_SOCKCLOSE;
-    }
+/**
+ * Get response latency statistics of a command type. Statistics are kept since
+ * startup.
+ * @param type command type, one of ESP_CMDT_* macros
+ * @param lat[out] smoothed latency, current timeout & latency histogram
+ * @return true if [type] is valid, false otherwise
+ */
+bool ESP8266::CmdLatency(uint8_t type, struct _espLatency *lat)
+{
+    if (type >= ESP_CMDT_NUM)
+        return false;
 
-    //  IP address embedded, extract it
-    if (ipFlag >= 0)
-    {
-        int i = ipFlag;
-        memset(_ipStr, 0, 16);
-        while(((rxBuffer[i] == '.') || isdigit(rxBuffer[i])) && (i < rxLen))
-            { _ipStr[i-ipFlag] = rxBuffer[i]; i++; }
+    memcpy((void*)lat, (void*)&_lat[type], sizeof(struct _espLatency));
 
-        _ipAddress = _IPtoInt(_ipStr);
-        retVal |= ESP_GOT_IP;
-    }
-    //  TCP incoming data embedded, extract it
-    //  Data format:> +IPD,socketID,length:message
-    if (respFlag >= 0)
-    {
-        int i;
-        //  Get client who sent the incoming data (based on socket ID)
-        _espClient *cli = const_cast<_espClient*>(_clients[_IDtoIndex(rxBuffer[respFlag] - 48)]);
-
-        //  respFlag points to socket ID (single digit < 5)
-        i = respFlag+2; //Skip comma and go to first digit of length
-        //  Colon marks beginning of the message, everything before it and after
-        //  the current position(i) are digits of message length
-        uint8_t cmsgLen[3] = {0};
-        //  Extract message length
-        while(rxBuffer[i++] != ':') //  ++ here so colon is skipped when done
-            cmsgLen[i-1-respFlag-2] = rxBuffer[i-1];
-        //  Convert message length string to int and save it
-        cli->RespLen = (uint16_t)lroundf(stof(cmsgLen, i-1-respFlag));
-        // i now points to the first char of the actual received message
-        //  Use raspFlag to mark starting point
-        respFlag = i;
-        //  Loop until the end of received message
-        while((i-respFlag) < cli->RespLen)
-        {
-            cli->RespBody[i - respFlag] = rxBuffer[i];
-            i++;
-        }
-        //  Set flag that new response has been received
-        cli->_respRdy = true;
-    }
+    return true;
+}
 
-    return retVal;
+/**
+ * Get number of characters received from ESP that were lost because they
+ * weren't read on time (UART FIFO or Rx ring buffer overrun)
+ * @return number of lost characters since startup
+ */
+uint32_t ESP8266::RxOverflows()
+{
+    return HAL_ESP_RxOverflows();
 }
 
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 
-ESP8266::ESP8266() : custHook(0), flowControl(ESP_NO_STATUS), _tcpServPort(0),
-                     _ipAddress(0), _servOpen(false), wifiStatus(0)
+//  Initializers follow declaration order in esp8266.h
+ESP8266::ESP8266() : flowControl(ESP_NO_STATUS), wifiStatus(0), custHook(0),
+                     _viewHook(0), _sendHook(0), _ipAddress(0),
+                     _tcpServPort(0), _servOpen(false), _sockUDP(0),
+                     _rxState(ESP_RX_LINE), _rxStatus(ESP_NO_STATUS),
+                     _rxHistIt(0), _rxSockID(0), _rxIPDLen(0), _rxIPDIt(0),
+                     _rxIPLen(0), _rxStart(0), _rxKeep(false),
+                     _rxOverflows(0), _wdTimeout(false), _txState(ESP_TX_IDLE),
+                     _txSrc(ESP_TXSRC_AT), _txStr(_txCmd), _txCli(0), _txNext(0),
+                     _txRetry(0), _txIt(0), _txHandle(0), _txBuffered(false),
+                     _txBufMask(0), _txBufOK(true), _txSegFail(0),
+                     _txAuto(false), _txType(ESP_CMDT_AT), _txSample(false),
+                     _txStart(0), _txDeadline(0), _atQHead(0), _atQTail(0)
 {
+    memset(_txCmd, 0, sizeof(_txCmd));
+    memset((void*)_lat, 0, sizeof(_lat));
+    for (uint8_t i = 0; i < ESP_CMDT_NUM; i++)
+        _lat[i].rto = __espInitRTO[i];
+    memset((void*)_atQ, 0, sizeof(_atQ));
+    memset((void*)_clients, 0, sizeof(_clients));
+    memset(_ipStr, 0, sizeof(_ipStr));
+    //  Compile status tokens into the parser automaton, InitHW() refuses to
+    //  run with a partial set (token table outgrew ATT_MAX_* limits)
+    _tokOK = _tok.Build(__espTokens, ESP_TOK_NUM);
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -756,10 +986,10 @@ bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
 
 /**
  * Send command to ESP8266 module
- * Sends command passed in the null-terminated [txBuffer]. This is a blocking
- * function, awaiting reply from ESP. Function returns when status OK or ERROR
- * or any other status passed in [flags] have been received from ESP. Timeout
- * is value at which watchdog timer interrupts the process and returns ERROR flag.
+ * Queues command passed in the null-terminated [txBuffer] (see QueueCmd) and,
+ * unless non-blocking mode is requested, waits for it to complete. Command
+ * completes when status OK or any other status passed in [flags] has been
+ * received from ESP, on ERROR/FAIL or when it times out (ERROR flag returned).
  * @param txBuffer null-terminated string with command to execute
  * @param flags bitwise OR of ESP_STATUS_* values
  * @param timeout time in ms before the sending process is interrupted by WD timer
@@ -767,48 +997,32 @@ bool ESP8266::_InStatus(const uint32_t status, const uint32_t flag)
  */
 uint32_t ESP8266::_SendRAW(const char* txBuffer, uint32_t flags, uint32_t timeout)
 {
-    uint16_t txLen = 0;
+    uint8_t entry;
+    uint16_t handle;
 
-    HAL_ESP_WDControl(false, timeout);
-
-    //  Reset global status
-    flowControl = ESP_NO_STATUS;
-    //  Wait for any ongoing transmission then flush UART port
-    while(HAL_ESP_UARTBusy());
-    _FlushUART();
-    while(HAL_ESP_UARTBusy());
+    if ((strlen(txBuffer) + 3) > ESP_AT_CMD_LEN)
+        return ESP_STATUS_ERROR;
 #ifdef __DEBUG_SESSION__
     DEBUG_WRITE("Sending: %s \n", txBuffer);
 #endif
-    //  Send char-by-char until reaching end of command
-    while (*(txBuffer + txLen) != '\0')
+
+    //  Wait for free space in the command queue
+    do
     {
-        HAL_ESP_SendChar(*(txBuffer + txLen));
-        txLen++;
+        entry = _atQHead;
+        handle = QueueCmd(txBuffer, ESP_STATUS_OK | (flags & ~(ESP_NONBLOCKING_MODE)),
+                          timeout);
     }
-    //  ESP messages terminated by \r\n
-    HAL_ESP_SendChar('\r');
-    HAL_ESP_SendChar('\n');
-
-    //  Start listening for reply
-    HAL_ESP_IntEnable(true);
+    while (handle == 0);
 
-    //  If non-blocking mode is not enabled wait for status
-    if (!(flags & ESP_NONBLOCKING_MODE))
-    {
-        //  Start watchdog timer
-        HAL_ESP_WDControl(true, timeout);
+    //  Reply is picked up asynchronously from UART ISR
+    if (flags & ESP_NONBLOCKING_MODE)
+        return ESP_NONBLOCKING_MODE;
 
-        while( !(flowControl & ESP_STATUS_OK) &&
-                !(flowControl & ESP_STATUS_ERROR) &&
-                !(flowControl & flags));
+    //  Wait for UART ISR to complete the command
+    while ((int8_t)(_atQTail - entry) <= 0);
 
-        HAL_DelayUS(1000);
-        //  Stop watchdog timer
-        HAL_ESP_WDControl(false, timeout);
-        return flowControl;
-    }
-    else return ESP_NONBLOCKING_MODE;
+    return _atQ[entry & (ESP_AT_QLEN - 1)].status;
 }
 
 /**
@@ -834,10 +1048,118 @@ void ESP8266::_RAWPortWrite(const char* buffer, uint16_t bufLen)
  */
 void ESP8266::_FlushUART()
 {
+    uint16_t n;
     char temp = 0;
     UNUSED(temp);   //    Suppress unused variable warning
-    while (HAL_ESP_CharAvail())
-        temp = HAL_ESP_GetChar();
+    while ((n = HAL_ESP_RxCount()) > 0)
+        while (n--)
+            temp = HAL_ESP_RxGet();
+}
+
+/**
+ * Open TCP or UDP socket (common part of OpenTCPSock & OpenUDPSock)
+ * @param udp true to open UDP socket, false for TCP
+ * @param ipAddr string containing IP address of remote host(null-terminated)
+ * @param port port of remote host
+ * @param localPort local port of UDP socket (0 to let ESP pick one), ignored
+ * for TCP
+ * @param keepAlive whether to maintain the socket open or drop after first
+ * transfer
+ * @param sockID desired socket ID, if taken smallest free ID is used
+ * @return On success socket ID in _client vector,
+ *         On failure ESP_STATUS_ERROR error code
+ */
+uint32_t ESP8266::_OpenSock(bool udp, char *ipAddr, uint16_t port,
+                            uint16_t localPort, bool keepAlive, uint8_t sockID)
+{
+    uint32_t retVal;
+
+    //  Can't continue if ESP is not connected or there's no free socket
+    if (!_SockCmd(udp, ipAddr, port, localPort, &sockID))
+        return ESP_STATUS_ERROR;
+
+    //  Execute command and check outcome
+    retVal = _SendRAW(_commBuf);
+    if (_InStatus(retVal, ESP_STATUS_OK) && !_InStatus(retVal, ESP_STATUS_ERROR)
+        && (GetClientBySockID(sockID) != 0))
+    {
+        //  If success, start listening for potential incoming data from server
+        TCPListen(true);
+        GetClientBySockID(sockID)->KeepAlive = keepAlive;
+        GetClientBySockID(sockID)->_udp = udp;
+        retVal = sockID;
+    }
+
+    return retVal;
+}
+
+/**
+ * Assemble AT+CIPSTART command opening TCP or UDP socket in _commBuf
+ * @param udp true to open UDP socket, false for TCP
+ * @param ipAddr string containing IP address of remote host(null-terminated)
+ * @param port port of remote host
+ * @param localPort local port of UDP socket (0 to let ESP pick one), ignored
+ * for TCP
+ * @param sockID desired socket ID, if taken smallest free ID is used and
+ * returned through this pointer
+ * @return true if command is assembled,
+ *        false if ESP is not connected to AP or there are no free sockets
+ */
+bool ESP8266::_SockCmd(bool udp, char *ipAddr, uint16_t port,
+                       uint16_t localPort, uint8_t *sockID)
+{
+    uint8_t strNum[6] = {0};
+    uint8_t id = *sockID;
+
+    //  Can't continue if ESP is not connected
+    if (wifiStatus != ESP_WIFI_CONNECTED)
+        return false;
+
+    //  Check if socket with this ID already exists, if not create it, if yes
+    //  fined first free socket ID and use it instead
+    if ((id >= ESP_MAX_CLI) || (GetClientBySockID(id) != 0))
+    {
+        //  Find free socket number (0-(ESP_MAX_CLI-1) supported)
+        for (id = 0; id < ESP_MAX_CLI; id++)
+            if (_clients[id] == 0)
+                break;
+        //  If loop hit ESP_MAX_CLI there are no free sockets, return error code
+        if (id >= ESP_MAX_CLI)
+            return false;
+    }
+    *sockID = id;
+
+    //  Type of the socket is applied to the client once ESP reports it's open
+    if (udp)
+        _sockUDP |= (1 << id);
+    else
+        _sockUDP &= ~(1 << id);
+
+    //  Assemble command: Open TCP socket to specified IP and port, set
+    //  keep alive interval to 7200ms; or open UDP socket to specified IP and
+    //  port, optionally on specified local port (remote end fixed - mode 0)
+    memset(_commBuf, 0, sizeof(_commBuf));
+    strcat(_commBuf, "AT+CIPSTART=");
+    itoa(id, strNum);
+    strcat(_commBuf, (char*)strNum);
+    strcat(_commBuf, udp ? ",\"UDP\",\"" : ",\"TCP\",\"");
+    strcat(_commBuf, ipAddr);
+    strcat(_commBuf, "\",");
+    memset(strNum, 0, sizeof(strNum));
+    itoa(port, strNum);
+    strcat(_commBuf, (char*)strNum);
+    if (!udp)
+        strcat(_commBuf, ",7200\0");
+    else if (localPort != 0)
+    {
+        strcat(_commBuf, ",");
+        memset(strNum, 0, sizeof(strNum));
+        itoa(localPort, strNum);
+        strcat(_commBuf, (char*)strNum);
+        strcat(_commBuf, ",0\0");
+    }
+
+    return true;
 }
 
 /**
@@ -883,128 +1205,785 @@ uint8_t ESP8266::_IDtoIndex(uint8_t sockID)
         return 222;
 }
 
-///-----------------------------------------------------------------------------
-/// Interrupt service routine for handling incoming data on UART (Tx)  [PRIVATE]
-///-----------------------------------------------------------------------------
-
-void UART7RxIntHandler(void)
+/**
+ * Incremental ESP reply parser, consumes a single received character
+ * Status tokens are matched by a precompiled automaton (constant work per
+ * character). Statuses found in a reply line are accumulated and returned
+ * once the line is complete, when ESP prompts for data ("> ") or when a
+ * complete +IPD payload has been received.
+ * +IPD message format: +IPD,socketID,length:payload
+ * @param c received character
+ * @return bitwise OR of statuses(ESP_STATUS_*) to publish, ESP_NO_STATUS if
+ * reply is not complete yet
+ */
+uint32_t ESP8266::_ParseChar(char c)
 {
-    //  Grab a pointer to singleton
-    ESP8266 &__esp = ESP8266::GetI();
+    uint32_t retVal = ESP_NO_STATUS,
+             tok;
+
+    switch (_rxState)
+    {
+    case ESP_RX_IPD_DATA:
+        {
+            //  Payload is copied as-is, it's never scanned for tokens
+            _espClient *cli = GetClientBySockID(_rxSockID);
 
-    static char rxBuffer[1024] ;
-    static uint16_t rxLen = 0;
+            if ((cli != 0) && _rxKeep)
+                cli->_rxBuf[(uint16_t)(_rxStart + _rxIPDIt)
+                            & (ESP_RX_BUF - 1)] = c;
+            _rxIPDIt++;
 
-    HAL_ESP_ClearInt();             //  Clear interrupt
+            if (_rxIPDIt >= _rxIPDLen)
+            {
+                //  Queue the message, or count it as dropped if there was no
+                //  space for it
+                if ((cli != 0) && _rxKeep)
+                    cli->_RxCommit(_rxStart, _rxIPDLen);
+                else if (cli != 0)
+                    cli->_stats.rxDrops++;
+                _rxState = ESP_RX_LINE;
+                retVal = _rxStatus | ESP_STATUS_IPD;
+                _rxStatus = ESP_NO_STATUS;
+            }
+        }
+        return retVal;
+    case ESP_RX_IPD_ID:
+        if (isdigit(c))
+        {
+            _rxSockID = _rxSockID*10 + (c - '0');
+            return retVal;
+        }
+        else if (c == ',')
+        {
+            _rxIPDLen = 0;
+            _rxState = ESP_RX_IPD_LEN;
+            return retVal;
+        }
+        //  Malformed header, continue parsing as a regular line
+        _rxState = ESP_RX_LINE;
+        break;
+    case ESP_RX_IPD_LEN:
+        if (isdigit(c))
+        {
+            _rxIPDLen = _rxIPDLen*10 + (c - '0');
+            return retVal;
+        }
+        else if ((c == ':') && (_rxIPDLen > 0))
+        {
+            _espClient *cli = GetClientBySockID(_rxSockID);
+
+            //  Reserve space for the payload in socket's Rx queue
+            _rxKeep = (cli != 0) && cli->_RxAlloc(_rxIPDLen, &_rxStart);
+            _rxIPDIt = 0;
+            _rxState = ESP_RX_IPD_DATA;
+            return retVal;
+        }
+        //  Malformed header, continue parsing as a regular line
+        _rxState = ESP_RX_LINE;
+        break;
+    case ESP_RX_IP:
+        if (((c == '.') || isdigit(c)) && (_rxIPLen < (sizeof(_ipStr)-1)))
+        {
+            _ipStr[_rxIPLen++] = c;
+            return retVal;
+        }
+        //  End of IP address, extract it and parse this char as usual
+        _ipStr[_rxIPLen] = '\0';
+        _ipAddress = _IPtoInt(_ipStr);
+        _rxStatus |= ESP_GOT_IP;
+        _rxState = ESP_RX_LINE;
+        break;
+    default:
+        break;
+    }
+
+    //  Keep short history, socket ID precedes ',CONNECT' and ',CLOSED'
+    _rxHist[(_rxHistIt++) & (ESP_RX_HIST-1)] = c;
 
-    //  Loop while there are characters in receiving buffer
-    while (HAL_ESP_CharAvail())
+    tok = _tok.Step((uint8_t)c);
+    if (tok != 0)
     {
-        char temp = HAL_ESP_GetChar();
-        //   Reset watchdog timer on every char - bus is active
-        HAL_ESP_WDControl(true, 0);
+        //  'n,SEND OK' & 'n,SEND FAIL' report outcome of a segment queued
+        //  earlier with AT+CIPSENDBUF, they're not a reply to the command in
+        //  progress so they mustn't set OK/SEND OK/FAIL statuses
+        if (ESP_TOK(tok, ESP_TOK_SEGOK))
+            _rxStatus |= ESP_STATUS_SEGOK;
+        else if (ESP_TOK(tok, ESP_TOK_SEGFAIL))
+            _rxStatus |= ESP_STATUS_SEGFAIL;
+        //  Look for general status messages returned by ESP
+        else
+        {
+            if (ESP_TOK(tok, ESP_TOK_OK))
+                _rxStatus |= ESP_STATUS_OK;
+            if (ESP_TOK(tok, ESP_TOK_SENDOK))
+                _rxStatus |= ESP_STATUS_SENDOK;
+            if (ESP_TOK(tok, ESP_TOK_FAIL))
+                _rxStatus |= ESP_STATUS_FAIL;
+        }
+        if (ESP_TOK(tok, ESP_TOK_ERROR))
+            _rxStatus |= ESP_STATUS_ERROR;
+        if (ESP_TOK(tok, ESP_TOK_BUSY))
+            _rxStatus |= ESP_STATUS_BUSY;
+        //  Payload of buffered send copied into ESP's buffer ('Recv n bytes')
+        if (ESP_TOK(tok, ESP_TOK_BUFRECV))
+            _rxStatus |= ESP_STATUS_BUFRECV;
+        if (ESP_TOK(tok, ESP_TOK_READY))
+            _rxStatus |= ESP_STATUS_READY;
+        if (ESP_TOK(tok, ESP_TOK_SUCCESS))
+            _rxStatus |= ESP_RESPOND_SUCC;
+        if (ESP_TOK(tok, ESP_TOK_WIFICONN))
+        {
+            _rxStatus |= ESP_STATUS_CONNECTED;
+            wifiStatus = ESP_WIFI_CONNECTING;
+        }
+        if (ESP_TOK(tok, ESP_TOK_WIFIGOTIP))
+            wifiStatus = ESP_WIFI_CONNECTED;
+        if (ESP_TOK(tok, ESP_TOK_WIFIDISCONN))
+            _rxStatus |= ESP_STATUS_DISCN;
+        //  IP address embedded, read it in following characters
+        if (ESP_TOK(tok, ESP_TOK_IP))
+        {
+            memset(_ipStr, 0, sizeof(_ipStr));
+            _rxIPLen = 0;
+            _rxState = ESP_RX_IP;
+        }
+        //  Message from one of the sockets, read header in following chars
+        if (ESP_TOK(tok, ESP_TOK_IPD))
+        {
+            _rxSockID = 0;
+            _rxState = ESP_RX_IPD_ID;
+        }
+        //  New socket is opened, create new client for it
+        if (ESP_TOK(tok, ESP_TOK_CONNECT))
+        {
+            uint8_t id = _rxHist[(_rxHistIt - 9) & (ESP_RX_HIST-1)] - '0';
 
-        rxBuffer[rxLen++] = temp;
-        //  Keep in mind buffer size
-        rxLen %= sizeof(rxBuffer);
+            if ((_IDtoIndex(id) < ESP_MAX_CLI) && (_clients[id] == 0))
+            {
+                __espPool[id]._Open(id, this);
+                __espPool[id]._udp = ((_sockUDP >> id) & 1);
+                _clients[id] = &__espPool[id];
+            }
+            _rxStatus |= ESP_STATUS_SOCKOPEN;
+        }
+        //  Socket is closed, find client with this ID and return it to the pool
+        if (ESP_TOK(tok, ESP_TOK_CLOSED))
+        {
+            uint8_t id = _rxHist[(_rxHistIt - 8) & (ESP_RX_HIST-1)] - '0';
+
+            if (_IDtoIndex(id) < ESP_MAX_CLI)
+            {
+                _TxAbort(id);
+                __espPool[id]._alive = false;
+                _clients[id] = 0;
+                _sockUDP &= ~(1 << id);
+            }
+            _rxStatus |= ESP_STATUS_SOCKCLOSE;
+        }
+        //  ESP awaits data, there's no line terminator after the prompt
+        if (ESP_TOK(tok, ESP_TOK_PROMPT))
+        {
+            retVal = _rxStatus | ESP_STATUS_RECV;
+            _rxStatus = ESP_NO_STATUS;
+        }
     }
 
-    /*
-     * If watchdog timer times out, artificially produce terminating sequence at
-     * the end of the buffer in order to trigger next if to read the content
-     */
-    if (( __esp.flowControl == ESP_STATUS_ERROR))
+    //  Reply line complete, publish all statuses found in it
+    if (c == '\n')
     {
-        rxBuffer[rxLen++] = '\r';
-        rxBuffer[rxLen++] = '\n';
+        retVal |= _rxStatus;
+        _rxStatus = ESP_NO_STATUS;
+        _tok.Reset();
+    }
+
+    return retVal;
+}
+
+/**
+ * Drop partially parsed reply (e.g. after watchdog timeout)
+ */
+void ESP8266::_ParseReset()
+{
+    _tok.Reset();
+    _rxState = ESP_RX_LINE;
+    _rxStatus = ESP_NO_STATUS;
+    _rxHistIt = 0;
+    memset(_rxHist, 0, sizeof(_rxHist));
+}
+
+/**
+ * Make statuses found by the parser visible to the rest of the library and, if
+ * data arrived on a socket, pass it to the user-defined hook
+ * @param status bitwise OR of ESP_STATUS_* to publish
+ */
+void ESP8266::_Publish(uint32_t status)
+{
+    //  If there was an error from WD timer leave it in so that we know there
+    //  was a problem
+    if (flowControl == ESP_STATUS_ERROR)
+        flowControl |= status;
+    else
+        flowControl = status;
+
 #ifdef __DEBUG_SESSION__
-        DEBUG_WRITE("WATCHDOG!!\n");
+    DEBUG_WRITE("Parsed status: 0x%x\n", status);
 #endif
+
+    //  Advance socket send in progress
+    _TxEvent(status);
+
+    //  If some data came from one of opened TCP sockets receive it and
+    //  pass it to a user-defined function for further processing (either
+    //  view hook or regular hook)
+    if (((_viewHook == 0) && (custHook == 0)) || !(status & ESP_STATUS_IPD))
+        return;
+
+    for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
+        //  Skip null pointers
+        if (GetClientByIndex(i) != 0)
+        //  Check which socket has messages not yet delivered
+        if (GetClientByIndex(i)->_rxQView != GetClientByIndex(i)->_rxQHead)
+        {
+#if defined(__USE_TASK_SCHEDULER__)
+        //  If using task scheduler, schedule receiving outside this ISR
+            volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
+            tE.AddArg(&GetClientByIndex(i)->_id, 1);
+            TaskScheduler::GetP()->SyncTask(tE);
+#else
+            //  If no task scheduler do everything in here
+            _Deliver(i);
+#endif  /* __USE_TASK_SCHEDULER__ */
+        }
+}
+
+/**
+ * Pass messages queued on a socket and not yet delivered to user-defined hook.
+ * View hook gets a pointer into socket's Rx ring and releases the message
+ * itself (or right here if it doesn't keep it); regular hook gets the same
+ * pointer and the message is released as soon as the hook returns.
+ * @param sockID socket ID
+ */
+void ESP8266::_Deliver(uint8_t sockID)
+{
+    _espClient *cli = GetClientBySockID(sockID);
+    struct _espRxView view;
+
+    if ((cli == 0) || ((_viewHook == 0) && (custHook == 0)))
+        return;
+
+    while (cli->_rxQView != cli->_rxQHead)
+    {
+        struct _espRxEntry *entry = &cli->_rxQ[cli->_rxQView & (ESP_RX_QLEN-1)];
+
+        view.sockID = sockID;
+        view.data = cli->_rxBuf + (entry->start & (ESP_RX_BUF - 1));
+        view.len = entry->len;
+        view.release = ReleaseView;
+        view._msg = cli->_rxQView;
+        view._gen = cli->_gen;
+        cli->_rxQView++;
+
+        if (_viewHook != 0)
+        {
+            if (!(*_viewHook)(&view))
+                ReleaseView(&view);
+        }
+        else
+        {
+            custHook(sockID, view.data, view.len);
+            ReleaseView(&view);
+        }
+    }
+}
+
+/**
+ * Command engine, called from UART ISR. Starts next queued command when UART
+ * is free (AT commands from QueueCmd() first, then socket sends round-robin
+ * between sockets) and writes command/payload of the one in progress into Tx
+ * FIFO (the rest is written on the next Tx interrupt)
+ */
+void ESP8266::_TxService()
+{
+    _espClient *cli;
+
+    if (_txState == ESP_TX_IDLE)
+    {
+        if (_atQHead != _atQTail)
+        {
+            struct _espATCmd *at = &_atQ[_atQTail & (ESP_AT_QLEN - 1)];
+
+            at->status = ESP_NO_STATUS;
+            _txSrc = ESP_TXSRC_AT;
+            _txStr = at->cmd;
+            _txIt = 0;
+            _txState = ESP_TX_CMD;
+            _txAuto = (at->timeout == ESP_TIMEOUT_AUTO);
+            _txType = at->type;
+            _txSample = false;
+            //  Adaptive timeout only covers waiting for the reply, it's applied
+            //  once the command has been written
+            _TxArm(_txAuto ? ESP_TX_TIMEOUT : at->timeout);
+        }
+        else for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
+        {
+            uint8_t id = (_txNext + i) % ESP_MAX_CLI;
+            uint8_t numStr[6] = {0};
+
+            cli = GetClientBySockID(id);
+            if ((cli == 0) || !cli->TxPending())
+                continue;
+
+            //  AT+CIPSEND=id,len\r\n or AT+CIPSENDBUF=id,len\r\n
+            _txBuffered = SendBuffered(id);
+            memset(_txCmd, 0, sizeof(_txCmd));
+            strcat(_txCmd, _txBuffered ? "AT+CIPSENDBUF=" : "AT+CIPSEND=");
+            itoa(id, numStr);
+            strcat(_txCmd, (char*)numStr);
+            strcat(_txCmd, ",");
+            memset(numStr, 0, sizeof(numStr));
+            itoa(cli->_txQ[cli->_txQTail & (ESP_TX_QLEN - 1)].len, numStr);
+            strcat(_txCmd, (char*)numStr);
+            strcat(_txCmd, "\r\n");
+
+            _txSrc = ESP_TXSRC_SOCK;
+            _txStr = _txCmd;
+            _txCli = id;
+            _txNext = (id + 1) % ESP_MAX_CLI;
+            _txIt = 0;
+            _txState = ESP_TX_CMD;
+            _txAuto = true;
+            _txType = ESP_CMDT_PROMPT;
+            _txSample = false;
+            _TxArm(ESP_TX_TIMEOUT);
+            break;
+        }
     }
 
-    //  Prevent parsing when buffer only contains \r\n and nothing else
-    if (rxLen == 2)
+    cli = GetClientBySockID(_txCli);
+
+    //  Fill Tx FIFO with command or payload
+    if (_txState == ESP_TX_CMD)
     {
-        if ((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
+        while ((_txStr[_txIt] != '\0') && HAL_ESP_TxSpace())
+            HAL_ESP_PutCharNB(_txStr[_txIt++]);
+        //  Socket send continues after prompt, AT command waits for reply
+        if (_txStr[_txIt] == '\0')
         {
-            HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
-            //  Reset receiving buffer and its size
-            memset(rxBuffer, '\0', sizeof(rxBuffer));
-            rxLen = 0;
-            return;
+            _txState = (_txSrc == ESP_TXSRC_SOCK) ? ESP_TX_PROMPT : ESP_TX_WAIT;
+            //  Reply to a reissued command can't be matched to the attempt
+            //  it belongs to, so it's not sampled (Karn's algorithm)
+            if (_txAuto)
+                _LatStart(_txType, (_txRetry == 0));
         }
     }
-    //  No point in starting parser for messages with such small size, return
-    else if (rxLen < 2)
+    else if ((_txState == ESP_TX_DATA) && (cli != 0))
     {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+        uint16_t len = cli->_txQ[cli->_txQTail & (ESP_TX_QLEN - 1)].len;
+
+        while ((_txIt < len) && HAL_ESP_TxSpace())
+        {
+            HAL_ESP_PutCharNB(cli->_txBuf[(uint16_t)(cli->_txTail + _txIt)
+                                          & (ESP_TX_BUF - 1)]);
+            _txIt++;
+        }
+        if (_txIt >= len)
+        {
+            _txState = ESP_TX_WAIT;
+            _LatStart(_txBuffered ? ESP_CMDT_BUFRECV : ESP_CMDT_SENDOK, true);
+        }
+    }
+
+    //  Tx interrupt is only needed while there's something left to write
+    HAL_ESP_TxIntEnable((_txState == ESP_TX_CMD) || (_txState == ESP_TX_DATA));
+}
+
+/**
+ * Advance command in progress based on statuses found in ESP reply
+ * @param status bitwise OR of ESP_STATUS_* found by the parser
+ */
+void ESP8266::_TxEvent(uint32_t status)
+{
+    //  Buffered segment already reported as sent got lost
+    if (status & ESP_STATUS_SEGFAIL)
+    {
+        _txSegFail++;
+#ifdef __HAL_USE_EVENTLOG__
+        EMIT_EV(ESP_T_SENDTCP, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+    }
+
+    if (_txState == ESP_TX_IDLE)
+        return;
+
+    //  AT command completes on any of expected statuses, fails on error
+    if (_txSrc == ESP_TXSRC_AT)
+    {
+        struct _espATCmd *at = &_atQ[_atQTail & (ESP_AT_QLEN - 1)];
+
+        at->status |= status;
+        if (status & at->expect)
+        {
+            _LatSample();
+            _TxDone(at->status);
+        }
+        //  Module didn't take the command (still busy with previous one), it's
+        //  issued again even if caller asked for no retries
+        else if ((status & ESP_STATUS_BUSY) && (_txRetry < ESP_TX_RETRY))
+        {
+            _txRetry++;
+            HAL_ESP_TxIntEnable(false);
+            _txState = ESP_TX_IDLE;
+        }
+        else if (status & (ESP_STATUS_ERROR | ESP_STATUS_FAIL | ESP_STATUS_BUSY))
+            _TxRetry(at->status | ESP_STATUS_ERROR);
         return;
     }
 
-    /*
-     *  There are 3 occasions when we want to process data in input buffer:
-     *  1) We've reached terminator sequence of the message (\r\n)
-     *  2) ESP returned '> ' (without terminator) and awaits data
-     *  3) Watchdog timer has timed out changing 'flowControl' to "error"
-     *      (on timeout WD timer also recalls this interrupt)
-     */
-    if (((rxBuffer[rxLen-2] == '\r') && (rxBuffer[rxLen-1] == '\n'))
-      || ((rxBuffer[rxLen-2] == '>') && (rxBuffer[rxLen-1] == ' ' ))
-      || ( __esp.flowControl == ESP_STATUS_ERROR) )
+    switch (_txState)
+    {
+    case ESP_TX_CMD:
+    case ESP_TX_PROMPT:
+        //  ESP awaits payload
+        if (status & ESP_STATUS_RECV)
+        {
+            _LatSample();
+            _txIt = 0;
+            _txState = ESP_TX_DATA;
+            _TxArm(ESP_TX_TIMEOUT);
+        }
+        //  ESP still processing previous request, send command again
+        else if (status & ESP_STATUS_BUSY)
+            _TxRetry(ESP_STATUS_ERROR);
+        //  Firmware without AT+CIPSENDBUF rejects it, switch all sockets to
+        //  AT+CIPSEND and issue the send again
+        else if ((status & ESP_STATUS_ERROR) && _txBuffered)
+        {
+            _txBufOK = false;
+            HAL_ESP_TxIntEnable(false);
+            _txState = ESP_TX_IDLE;
+        }
+        else if (status & (ESP_STATUS_ERROR | ESP_STATUS_FAIL))
+            _TxDone(ESP_STATUS_ERROR);
+        break;
+    case ESP_TX_DATA:
+    case ESP_TX_WAIT:
+        //  Buffered send is done once ESP has the payload, regular one when
+        //  the remote side acknowledged it
+        if (_txBuffered ? (status & ESP_STATUS_BUFRECV)
+                        : (status & ESP_STATUS_SENDOK))
+        {
+            _LatSample();
+            _TxDone(ESP_STATUS_SENDOK);
+        }
+        else if (status & (ESP_STATUS_ERROR | ESP_STATUS_FAIL))
+            _TxDone(ESP_STATUS_ERROR);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Command in progress failed, issue it again if it has retries left or finish
+ * it with given status
+ * @param status outcome of the command if it's out of retries
+ */
+void ESP8266::_TxRetry(uint32_t status)
+{
+    uint8_t retries = ESP_TX_RETRY;
+
+    if (_txSrc == ESP_TXSRC_AT)
+        retries = _atQ[_atQTail & (ESP_AT_QLEN - 1)].retries;
+
+    if (_txRetry < retries)
     {
-        HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+        //  Command stays at the head of its queue and is picked up again
+        _txRetry++;
+        HAL_ESP_TxIntEnable(false);
+        _txState = ESP_TX_IDLE;
+    }
+    else
+        _TxDone(status);
+}
+
+/**
+ * Arm watchdog for the command in progress and note its deadline, so that
+ * traffic unrelated to the command (+IPD, asynchronous messages) re-arming
+ * the watchdog doesn't postpone it (see _TxRearm)
+ * @param timeout time in ms the command is given from now
+ */
+void ESP8266::_TxArm(uint32_t timeout)
+{
+#if defined(ESP_NOW)
+    _txDeadline = ESP_NOW() + timeout;
+#endif  /* ESP_NOW */
+    HAL_ESP_WDControl(true, timeout);
+}
 
+/**
+ * Re-arm watchdog with the time left until the deadline of the command in
+ * progress (without a clock watchdog is restarted with its last timeout)
+ */
+void ESP8266::_TxRearm()
+{
+#if defined(ESP_NOW)
+    int32_t left = (int32_t)(_txDeadline - ESP_NOW());
 
-#ifdef __DEBUG_SESSION__
+    HAL_ESP_WDControl(true, (left > 0) ? (uint32_t)left : 1);
+#else
+    HAL_ESP_WDControl(true, 0);
+#endif  /* ESP_NOW */
+}
+
+/**
+ * Command in progress didn't complete in time (called on watchdog timeout)
+ */
+void ESP8266::_TxTimeout()
+{
+    //  Reply didn't arrive within adaptive timeout
+    if (_txAuto && ((_txState == ESP_TX_PROMPT) || (_txState == ESP_TX_WAIT)))
+        _LatBackoff();
+
+    if (_txSrc == ESP_TXSRC_AT)
+        _TxRetry(_atQ[_atQTail & (ESP_AT_QLEN - 1)].status
+                 | ESP_NORESPONSE | ESP_STATUS_ERROR);
+    else
+        _TxDone(ESP_STATUS_ERROR);
+}
+
+/**
+ * Finish command in progress and free UART for next one
+ * @param status outcome of the command; for socket sends either
+ * ESP_STATUS_SENDOK or ESP_STATUS_ERROR
+ */
+void ESP8266::_TxDone(uint32_t status)
+{
+    HAL_ESP_TxIntEnable(false);
+    _txState = ESP_TX_IDLE;
+    _txRetry = 0;
+
+    if (_txSrc == ESP_TXSRC_AT)
     {
-        uint16_t i;
-        for (i = 0; i < rxLen; i++)
-            DEBUG_WRITE("0x%x ", rxBuffer[i]);
-        DEBUG_WRITE("\nParsing(%d): %s\n", rxLen, rxBuffer);
+        struct _espATCmd *at = &_atQ[_atQTail & (ESP_AT_QLEN - 1)];
+
+        at->status = status;
+        _atQTail++;
+        if (at->done != 0)
+            (*at->done)(at->handle, status);
     }
-#endif
-        //  Parse data in receiving buffer - if there was an error from WD timer
-        //  leave it in so that we know there was a problem
-        if (__esp.flowControl == ESP_STATUS_ERROR)
-            __esp.flowControl |= __esp.ParseResponse(rxBuffer, rxLen);
+    else
+        _TxComplete(_txCli, status);
+}
+
+/**
+ * Remove the oldest send from socket's queue and report its outcome
+ * @param sockID socket ID
+ * @param status outcome of the send (ESP_STATUS_SENDOK or ESP_STATUS_ERROR)
+ */
+void ESP8266::_TxComplete(uint8_t sockID, uint32_t status)
+{
+    _espClient *cli = GetClientBySockID(sockID);
+    struct _espTxEntry *entry;
+
+    if ((cli == 0) || !cli->TxPending())
+        return;
+
+    entry = &(cli->_txQ[cli->_txQTail & (ESP_TX_QLEN - 1)]);
+    entry->status = status;
+    if (status == ESP_STATUS_SENDOK)
+    {
+        cli->_stats.txBytes += entry->len;
+        cli->_stats.txMsgs++;
+    }
+    else
+        cli->_stats.txDrops++;
+    cli->_txTail += entry->len;
+    cli->_txQTail++;
+
+    if (_sendHook != 0)
+        (*_sendHook)(sockID, entry->handle, status);
+
+#ifdef __HAL_USE_EVENTLOG__
+    if (status != ESP_STATUS_SENDOK)
+        EMIT_EV(ESP_T_SENDTCP, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+}
+
+/**
+ * Fail all sends queued on a socket (called when socket gets closed)
+ * @param sockID socket ID
+ */
+void ESP8266::_TxAbort(uint8_t sockID)
+{
+    _espClient *cli = GetClientBySockID(sockID);
+
+    if ((_txState != ESP_TX_IDLE) && (_txSrc == ESP_TXSRC_SOCK) &&
+        (_txCli == sockID))
+    {
+        HAL_ESP_TxIntEnable(false);
+        _txState = ESP_TX_IDLE;
+        _txRetry = 0;
+    }
+
+    while ((cli != 0) && cli->TxPending())
+        _TxComplete(sockID, ESP_STATUS_ERROR);
+}
+
+/**
+ * Start waiting for reply to the command in progress: start measuring its
+ * latency and arm watchdog with timeout of the command type
+ * @param type type of the reply waited for, one of ESP_CMDT_* macros
+ * @param sample true if latency of the reply should be sampled
+ */
+void ESP8266::_LatStart(uint8_t type, bool sample)
+{
+    _txType = type;
+    _txSample = sample;
+#if defined(ESP_NOW)
+    _txStart = ESP_NOW();
+#endif  /* ESP_NOW */
+    _TxArm(_lat[type].rto);
+}
+
+/**
+ * Reply to the command in progress arrived, update latency statistics of its
+ * type and derive new timeout from them (RFC 6298, gains 1/8 and 1/4)
+ */
+void ESP8266::_LatSample()
+{
+    if (!_txSample)
+        return;
+    _txSample = false;
+
+#if defined(ESP_NOW)
+    struct _espLatency *lat = &_lat[_txType];
+    uint32_t rtt = ESP_NOW() - _txStart, err, var;
+    uint8_t bin = 0;
+
+    //  Histogram bin is the number of significant bits of latency in ms
+    for (err = rtt; (err > 0) && (bin < (ESP_LAT_BINS - 1)); err >>= 1)
+        bin++;
+    lat->hist[bin]++;
+    lat->samples++;
+
+    //  Mean & deviation are kept in 1/8 ms
+    rtt <<= 3;
+    if (lat->samples == 1)
+    {
+        lat->srtt = rtt;
+        lat->rttvar = rtt / 2;
+    }
+    else
+    {
+        err = (lat->srtt > rtt) ? (lat->srtt - rtt) : (rtt - lat->srtt);
+        lat->rttvar = lat->rttvar - (lat->rttvar >> 2) + (err >> 2);
+        lat->srtt = lat->srtt - (lat->srtt >> 3) + (rtt >> 3);
+    }
+
+    //  Deviation term is at least the clock granularity (1ms)
+    var = 4 * lat->rttvar;
+    if (var < 8)
+        var = 8;
+    lat->rto = (lat->srtt + var + 7) >> 3;
+    if (lat->rto < ESP_RTO_MIN)
+        lat->rto = ESP_RTO_MIN;
+    else if (lat->rto > ESP_RTO_MAX)
+        lat->rto = ESP_RTO_MAX;
+#endif  /* ESP_NOW */
+}
+
+/**
+ * Reply to the command in progress didn't arrive in time, double the timeout
+ * of its type until the next reply is measured
+ */
+void ESP8266::_LatBackoff()
+{
+    struct _espLatency *lat = &_lat[_txType];
+
+    _txSample = false;
+    lat->timeouts++;
+    lat->rto = ((2 * lat->rto) > ESP_RTO_MAX) ? ESP_RTO_MAX : (2 * lat->rto);
+}
+
+///-----------------------------------------------------------------------------
+/// Interrupt service routine for handling incoming data on UART (Tx)  [PRIVATE]
+///-----------------------------------------------------------------------------
+
+void UART7RxIntHandler(void)
+{
+    //  Grab a pointer to singleton
+    ESP8266 &__esp = ESP8266::GetI();
+    uint32_t status;
+    uint16_t n;
+    bool rxChar = false;
+
+    HAL_ESP_ClearInt();             //  Clear interrupt
+
+    //  Characters were lost (FIFO or ring overrun), reply being parsed is
+    //  incomplete so drop it
+    if (HAL_ESP_RxOverflows() != __esp._rxOverflows)
+    {
+        __esp._rxOverflows = HAL_ESP_RxOverflows();
+        __esp._ParseReset();
+#ifdef __HAL_USE_EVENTLOG__
+        EMIT_EV(-1, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+    }
+
+    //  Loop while there are characters in receiving buffer, parser does
+    //  constant amount of work per character. Characters are read in batches
+    //  (whole ring buffer content when using uDMA)
+    while ((n = HAL_ESP_RxCount()) > 0)
+    {
+        bool lineOpen = true;
+        rxChar = true;
+
+        while (n--)
+        {
+            char temp = HAL_ESP_RxGet();
+
+            status = __esp._ParseChar(temp);
+
+            //  Reply complete, watchdog is not needed until next char arrives
+            lineOpen = ((status == ESP_NO_STATUS) && (temp != '\n'));
+            if (status != ESP_NO_STATUS)
+                __esp._Publish(status);
+        }
+        //  While a command is in progress watchdog runs until its deadline,
+        //  data unrelated to it mustn't postpone the timeout. Otherwise reset
+        //  watchdog after every batch - bus is active - or stop it if the
+        //  batch ended with a complete reply
+        if (__esp._txState != ESP_TX_IDLE)
+            __esp._TxRearm();
         else
-            __esp.flowControl = __esp.ParseResponse(rxBuffer, rxLen);
+            HAL_ESP_WDControl(lineOpen, lineOpen ? ESP_TX_TIMEOUT : 0);
+    }
 
-        //  If some data came from one of opened TCP sockets receive it and
-        //  pass it to a user-defined function for further processing
-        if ((__esp.custHook != 0) && (__esp.flowControl & ESP_STATUS_IPD))
+    /*
+     * If watchdog timer timed out it changed 'flowControl' to "error" and
+     * recalled this interrupt (without any new data). Publish whatever was
+     * found so far and drop partially received reply
+     */
+    if (__esp._wdTimeout)
+    {
+        __esp._wdTimeout = false;
+        if (!rxChar)
         {
-            for (uint8_t i = 0; i < ESP_MAX_CLI; i++)
-                //  Skip null pointers
-                if (__esp.GetClientByIndex(i) != 0)
-                //  Check which socket received data
-                if (__esp.GetClientByIndex(i)->Ready())
-                {
-#if defined(__USE_TASK_SCHEDULER__)
-                //  If using task scheduler, schedule receiving outside this ISR
-                    volatile TaskEntry tE(ESP_UID, ESP_T_RECVSOCK, 0);
-                    tE.AddArg(&__esp.GetClientByIndex(i)->_id, 1);
-                    TaskScheduler::GetP()->SyncTask(tE);
-#else
-                    //  If no task scheduler do everything in here
-                    _espClient* cli = __esp.GetClientByIndex(i);
-                    __esp.custHook(i, cli->RespBody, &(cli->RespLen));
-#endif  /* __USE_TASK_SCHEDULER__ */
-                }
-            }
-        //  If ESP is running in server mode or status hasn't been OK/ERROR
-        //  (because after them ESP sends no more messages) then continue
-        //  listening on serial port for new messages
-        /*if (((__esp->flowControl & ESP_STATUS_OK) ||
-             (__esp->flowControl & ESP_STATUS_ERROR))
-            && !__esp->ServerOpened())
-            HAL_ESP_IntEnable(false);*/
-
-
-        //  Reset receiving buffer and its size
-        memset(rxBuffer, '\0', sizeof(rxBuffer));
-        rxLen = 0;
+            HAL_ESP_WDControl(false, 0);    //   Stop watchdog timer
+            status = __esp._rxStatus;
+            __esp._ParseReset();
+            __esp._Publish(status);
+#ifdef __DEBUG_SESSION__
+            DEBUG_WRITE("WATCHDOG!!\n");
+#endif
+        }
+        //  Command in progress didn't complete in time
+        if (__esp._txState != ESP_TX_IDLE)
+            __esp._TxTimeout();
     }
+
+    //  Continue command in progress (Tx interrupt) or start next queued one
+    __esp._TxService();
 }
 
 #endif  /* __HAL_USE_ESP8266__ */
@@ -5,7 +5,7 @@
  *      Author: Vedran Mikov
  *
  *  ESP8266 WiFi module communication library
- *  @version 1.4.5
+ *  @version 1.13.2
  *  V1.1.4
  *  +Connect/disconnect from AP, get acquired IP as string/int
  *	+Start TCP server and allow multiple connections, keep track of
@@ -54,8 +54,69 @@
  *  +Stability improvements, different placement of watchdog resets
  *  V1.4.5 - 2.9.2017
  *  +Bugfix in parser, fixed problem with multiple sockets closing at the same time
- *
- *  TODO:Add interface to send UDP packet
+ *  V1.5.0 - 19.10.2026
+ *  +Replaced strstr-based ParseResponse with an incremental parser consuming
+ *  one character at a time from UART ISR (token automaton + sub-states for
+ *  +IPD header/payload and IP address). Parsing cost is now constant per
+ *  received character, +IPD payload is copied straight into the client buffer
+ *  and is no longer scanned for status tokens
+ *  V1.5.1 - 19.10.2026
+ *  +Optional uDMA receive path (__HAL_USE_ESP8266_RXDMA__): UART data lands in
+ *  a ping-pong ring buffer, ISR runs once per burst (idle line or half of the
+ *  ring filled) and parses the ring content in one pass
+ *  +Lost characters (FIFO/ring overrun) drop the reply being parsed and emit
+ *  an error event, total count available through RxOverflows()
+ *  V1.6.0 - 19.10.2026
+ *  +Non-blocking socket send: sends are queued per socket and executed by a
+ *  state machine in UART ISR (command & payload written from Tx interrupt),
+ *  completion is reported through a hook (AddSendHook) and failures to event
+ *  logger. Blocking AT commands wait for send in progress and hold off new
+ *  ones until they complete
+ *  V1.7.0 - 19.10.2026
+ *  +AT command queue (QueueCmd) with per-command expected statuses, timeout
+ *  and retries, executed from UART ISR back-to-back with socket sends. All
+ *  commands, including blocking ones (_SendRAW), now go through the queue so
+ *  the UART is written only from the ISR
+ *  +Closing a socket no longer waits for ESP reply
+ *  V1.8.0 - 19.10.2026
+ *  +Optional buffered send per socket (SendBuffered): payload is handed to ESP
+ *  with AT+CIPSENDBUF and the send completes as soon as ESP has copied it into
+ *  its own buffer, without waiting for 'SEND OK' from the remote side. If the
+ *  firmware rejects the command library falls back to AT+CIPSEND for all
+ *  sockets
+ *  V1.9.0 - 19.10.2026
+ *  +UDP sockets (OpenUDPSock, kernel service ESP_T_CONNUDP), sent through the
+ *  same send queue as TCP sockets, one datagram per queued send
+ *  V1.10.0 - 19.10.2026
+ *  +Clients are taken from a static pool instead of being allocated/deleted
+ *  from UART ISR on every connect/close
+ *  ++IPD payload is queued in socket's Rx ring (several messages can wait for
+ *  ESP_T_RECVSOCK), messages that don't fit are dropped and counted
+ *  +Per-socket traffic counters (SockStats)
+ *  V1.11.0 - 19.10.2026
+ *  +Zero-copy delivery of received messages (AddViewHook): hook gets a view
+ *  (pointer & length of the exact +IPD payload in socket's Rx ring) and can
+ *  keep it after returning until it calls view's release function
+ *  V1.12.0 - 19.10.2026
+ *  +Adaptive command timeouts: response latency is tracked per command type
+ *  (smoothed mean & variance, as TCP does for its retransmission timeout) and
+ *  watchdog timeout of each command is derived from it. Timeouts back off on
+ *  every missed reply, latency histograms available through CmdLatency()
+ *  V1.13.0 - 19.10.2026
+ *  +Non-blocking socket opening (OpenSockAsync), outcome of the queued
+ *  AT+CIPSTART can be polled with CmdStatus()
+ *  *Bugfix: Search for a free socket ID read past the end of client list
+ *  V1.13.1 - 19.10.2026
+ *  +Runs on host HAL (__BOARD_HOST__), latency is tracked with host's clock
+ *  V1.13.2 - 19.10.2026
+ *  *Bugfix: 'busy p...'/'busy s...' replies weren't recognized (token was
+ *  'busy...'), commands and sends rejected as busy were never retried
+ *  +Commands rejected as busy are retried up to ESP_TX_RETRY times even if
+ *  queued without retries (e.g. blocking commands)
+ *  *Bugfix: Data received while a command was in progress restarted its
+ *  watchdog, a lost reply was never timed out while a socket kept receiving
+ *  +InitHW() fails (ESP_STATUS_ERROR, error event) if status tokens don't fit
+ *  into the reply parser instead of running with a partial set
  */
 #include "hwconfig.h"
 
@@ -71,6 +132,7 @@ extern char _commBuf[2048];
 
 //  Include client library
 #include "espClient.h"
+#include "atTokenizer.h"
 
 //  Enable integration of this library with task scheduler but only if task
 //  scheduler is being compiled into this project
@@ -91,6 +153,7 @@ extern char _commBuf[2048];
     #define ESP_T_CLOSETCP  4   //  Close socket with specific ID
     #define ESP_T_REBOOT    5   //  Reboot ESP module and UART bus
     #define ESP_T_PARSE     6
+    #define ESP_T_CONNUDP   7   //  Open UDP socket to remote host
 #endif
 
 /*		Communication settings	 	*/
@@ -115,6 +178,9 @@ extern char _commBuf[2048];
 #define ESP_NORESPONSE          1<<13
 #define ESP_STATUS_IPD          1<<14
 #define ESP_GOT_IP              1<<15
+#define ESP_STATUS_BUFRECV      1<<16
+#define ESP_STATUS_SEGOK        1<<17
+#define ESP_STATUS_SEGFAIL      1<<18
 
 #define ESP_WIFI_NONE           0
 #define ESP_WIFI_CONNECTING     1
@@ -123,6 +189,97 @@ extern char _commBuf[2048];
 //  Max number of clients allowed by ESP8266
 #define ESP_MAX_CLI     5
 
+/*      States of incremental reply parser      */
+#define ESP_RX_LINE         0   //  Matching status tokens in a reply line
+#define ESP_RX_IP           1   //  Reading IP address after 'ip:"'
+#define ESP_RX_IPD_ID       2   //  Reading socket ID after '+IPD,'
+#define ESP_RX_IPD_LEN      3   //  Reading payload length of +IPD message
+#define ESP_RX_IPD_DATA     4   //  Copying +IPD payload into client buffer
+//  Size of history of received characters (power of 2), used to get socket ID
+//  preceding ',CONNECT' and ',CLOSED' tokens
+#define ESP_RX_HIST         16
+
+/*      States of asynchronous socket send (driven from UART ISR)      */
+#define ESP_TX_IDLE         0   //  No send in progress
+#define ESP_TX_CMD          1   //  Writing AT+CIPSEND command to UART
+#define ESP_TX_PROMPT       2   //  Waiting for '>' prompt
+#define ESP_TX_DATA         3   //  Writing payload to UART
+#define ESP_TX_WAIT         4   //  Waiting for 'SEND OK' ('Recv' if buffered)
+//  Time in ms allowed for writing command/payload of a send to UART (waiting
+//  for the reply has adaptive timeout) and number of retries when ESP replies
+//  it's busy
+#define ESP_TX_TIMEOUT      600
+#define ESP_TX_RETRY        3
+//  Source of the command in progress
+#define ESP_TXSRC_AT        0   //  AT command queue
+#define ESP_TXSRC_SOCK      1   //  Socket send queue
+
+/*      Command types with separately tracked response latency      */
+#define ESP_CMDT_AT         0   //  Local AT commands (reply from ESP itself)
+#define ESP_CMDT_CONN       1   //  AT+CIPSTART (reply after remote handshake)
+#define ESP_CMDT_PROMPT     2   //  AT+CIPSEND(BUF) until '>' prompt
+#define ESP_CMDT_SENDOK     3   //  Payload until 'SEND OK' (remote ACK)
+#define ESP_CMDT_BUFRECV    4   //  Buffered payload until 'Recv N bytes'
+#define ESP_CMDT_NUM        5
+//  Timeout passed to QueueCmd() to have it derived from measured latency
+#define ESP_TIMEOUT_AUTO    0
+//  Bounds of adaptive timeout in ms
+#define ESP_RTO_MIN         50
+#define ESP_RTO_MAX         5000
+//  Number of latency histogram bins: bin 0 counts replies faster than 1ms, bin
+//  N replies in [2^(N-1), 2^N) ms, last bin everything slower
+#define ESP_LAT_BINS        12
+
+/**
+ * Response latency of one command type, timeout is derived from it as
+ * srtt + 4*rttvar (RFC 6298). Only replies to commands issued once are sampled
+ */
+struct _espLatency
+{
+    uint32_t    srtt;       //  Smoothed latency in 1/8 ms
+    uint32_t    rttvar;     //  Smoothed mean deviation in 1/8 ms
+    uint32_t    rto;        //  Current timeout in ms
+    uint32_t    samples;    //  Number of replies measured
+    uint32_t    timeouts;   //  Number of replies that didn't arrive in time
+    uint32_t    hist[ESP_LAT_BINS];
+};
+
+/*      AT command queue      */
+#define ESP_AT_QLEN         8   //  Max number of queued commands (power of 2)
+#define ESP_AT_CMD_LEN      128 //  Max length of a command (incl. \r\n\0)
+
+/**
+ * Single AT command in the queue, see ESP8266::QueueCmd()
+ */
+struct _espATCmd
+{
+    char                cmd[ESP_AT_CMD_LEN];
+    uint32_t            expect;     //  Statuses completing the command
+    uint32_t            timeout;    //  Time in ms allowed for single attempt
+                                    //  (ESP_TIMEOUT_AUTO - adaptive)
+    uint8_t             type;       //  One of ESP_CMDT_* macros
+    uint8_t             retries;    //  Max number of times to reissue command
+    uint16_t            handle;     //  Handle returned to the user
+    volatile uint32_t   status;     //  Statuses received while executing
+    //  Hook called on completion
+    void                (*done)(const uint16_t, const uint32_t);
+};
+
+/**
+ * View of a message received on a socket, payload stays in socket's Rx ring
+ * until the view is released (see ESP8266::AddViewHook())
+ */
+struct _espRxView
+{
+    uint8_t             sockID;     //  Socket the message was received on
+    const uint8_t       *data;      //  Payload (followed by \0)
+    uint16_t            len;        //  Length of payload
+    //  Function to call once payload is no longer needed
+    void                (*release)(const struct _espRxView *view);
+    uint8_t             _msg;       //  Position in socket's Rx queue
+    uint8_t             _gen;       //  Socket generation (see _espClient::_gen)
+};
+
 /**
  * ESP8266 class definition
  * Object provides a high-level interface to the ESP chip. Allows basic AP func.,
@@ -136,6 +293,7 @@ class ESP8266
     /// Functions & classes needing direct access to all members
     friend class    _espClient;
     friend void     UART7RxIntHandler(void);
+    friend void     ESPWDISR(void);
     friend void     _ESP_KernelCallback(void);
 	public:
         //  Functions for returning static instance
@@ -147,6 +305,12 @@ class ESP8266
         bool        IsEnabled();
         void        AddHook(void((*funPoint)(const uint8_t, const uint8_t*,
                                              const uint16_t)));
+        void        AddSendHook(void((*funPoint)(const uint8_t, const uint16_t,
+                                                 const uint32_t)));
+        void        AddViewHook(bool((*funPoint)(const struct _espRxView*)));
+        static void ReleaseView(const struct _espRxView *view);
+        void        SendBuffered(uint8_t sockID, bool enable);
+        bool        SendBuffered(uint8_t sockID);
 		//  Functions used with access points
 		uint32_t    ConnectAP(char* APname, char* APpass, bool nonBlocking=false);
 		bool        IsConnected();
@@ -163,10 +327,24 @@ class ESP8266
 		//  Functions related to TCP clients(sockets)
 		uint32_t    OpenTCPSock(char *ipAddr, uint16_t port,
 		                        bool keepAlive=true, uint8_t sockID = 9);
+		uint32_t    OpenUDPSock(char *ipAddr, uint16_t port,
+		                        uint16_t localPort = 0, uint8_t sockID = 9);
+		uint16_t    OpenSockAsync(bool udp, char *ipAddr, uint16_t port,
+		                          uint8_t *sockID);
 		bool        ValidSocket(uint8_t id);
 		uint32_t    Send(const char* arg, ...) { return ESP_NO_STATUS; }
 		//  Miscellaneous functions
 		uint32_t 	ParseResponse(char* rxBuffer, uint16_t rxLen);
+		uint32_t    RxOverflows();
+		bool        SockStats(uint8_t sockID, struct _espSockStats *stats);
+		bool        CmdLatency(uint8_t type, struct _espLatency *lat);
+		//  Queue of AT commands executed from UART ISR
+		uint16_t    QueueCmd(const char *cmd, uint32_t expect = ESP_STATUS_OK,
+		                     uint32_t timeout = ESP_TIMEOUT_AUTO,
+		                     uint8_t retries = 0,
+		                     void((*done)(const uint16_t, const uint32_t)) = 0);
+		bool        CmdPending();
+		uint32_t    CmdStatus(uint16_t handle);
 
 		//  Status variable for error codes returned by ESP
 		volatile uint32_t	flowControl;
@@ -181,14 +359,39 @@ class ESP8266
 
 		bool        _InStatus(const uint32_t status, const uint32_t flag);
 		uint32_t	_SendRAW(const char* txBuffer, uint32_t flags = 0,
-		                     uint32_t timeout = 250);//150
+		                     uint32_t timeout = ESP_TIMEOUT_AUTO);
 		void        _RAWPortWrite(const char* buffer, uint16_t bufLen);
 		void	    _FlushUART();
+		uint32_t    _OpenSock(bool udp, char *ipAddr, uint16_t port,
+		                      uint16_t localPort, bool keepAlive, uint8_t sockID);
+		bool        _SockCmd(bool udp, char *ipAddr, uint16_t port,
+		                     uint16_t localPort, uint8_t *sockID);
 		uint32_t    _IPtoInt(char *ipAddr);
 		uint8_t     _IDtoIndex(uint8_t sockID);
+		uint32_t    _ParseChar(char c);
+		void        _ParseReset();
+		void        _Publish(uint32_t status);
+		void        _Deliver(uint8_t sockID);
+		void        _TxService();
+		void        _TxEvent(uint32_t status);
+		void        _TxRetry(uint32_t status);
+		void        _TxTimeout();
+		void        _TxArm(uint32_t timeout);
+		void        _TxRearm();
+		void        _TxDone(uint32_t status);
+		void        _TxComplete(uint8_t sockID, uint32_t status);
+		void        _TxAbort(uint8_t sockID);
+		void        _LatStart(uint8_t type, bool sample);
+		void        _LatSample();
+		void        _LatBackoff();
 
         //  Hook to user routine called when data from socket is received
         void    ((*custHook)(const uint8_t, const uint8_t*, const uint16_t));
+        //  Hook to user routine receiving views of socket data (replaces
+        //  custHook if set)
+        bool    (*_viewHook)(const struct _espRxView*);
+        //  Hook to user routine called when queued send completes
+        void    (*_sendHook)(const uint8_t, const uint16_t, const uint32_t);
 		//  IP address in decimal and string format
 		uint32_t    _ipAddress;
 		char        _ipStr[16];
@@ -200,6 +403,48 @@ class ESP8266
 		//  ESP. It's important that pointers itself are volatile, not _espClient
 		//  object because pointers get changed within ISR. Array index is socket ID!
 		_espClient volatile *_clients[ESP_MAX_CLI];
+		//  Bit-mask of socket IDs last opened as UDP sockets
+		volatile uint8_t _sockUDP;
+		//  State of incremental reply parser
+		ATTokenizer _tok;           //  Status token matcher
+		bool        _tokOK;         //  All status tokens fit into matcher
+		uint8_t     _rxState;       //  One of ESP_RX_* macros
+		uint32_t    _rxStatus;      //  Statuses found in current reply line
+		char        _rxHist[ESP_RX_HIST];   //  Last received characters
+		uint8_t     _rxHistIt;
+		uint8_t     _rxSockID;      //  Socket ID of current +IPD message
+		uint16_t    _rxIPDLen;      //  Payload length of current +IPD message
+		uint16_t    _rxIPDIt;       //  Payload bytes received so far
+		uint8_t     _rxIPLen;       //  Length of IP address string read so far
+		uint16_t    _rxStart;       //  Position of +IPD payload in Rx queue
+		bool        _rxKeep;        //  +IPD payload has space in Rx queue
+		uint32_t    _rxOverflows;   //  Lost Rx characters already reported
+		volatile bool _wdTimeout;   //  Set by watchdog, cleared by UART ISR
+		//  State of asynchronous send
+		volatile uint8_t _txState;  //  One of ESP_TX_* macros
+		uint8_t     _txSrc;         //  One of ESP_TXSRC_* macros
+		const char  *_txStr;        //  Command being written
+		uint8_t     _txCli;         //  Socket ID of send in progress
+		uint8_t     _txNext;        //  Socket to check first for next send
+		uint8_t     _txRetry;       //  Retries of send in progress
+		uint16_t    _txIt;          //  Command/payload chars written so far
+		uint16_t    _txHandle;      //  Last handle given to a queued send
+		char        _txCmd[24];     //  AT+CIPSEND command of send in progress
+		bool        _txBuffered;    //  Send in progress uses AT+CIPSENDBUF
+		uint8_t     _txBufMask;     //  Sockets set to use AT+CIPSENDBUF
+		bool        _txBufOK;       //  Firmware supports AT+CIPSENDBUF
+		uint32_t    _txSegFail;     //  Buffered segments ESP failed to send
+		bool        _txAuto;        //  Command in progress has adaptive timeout
+		uint8_t     _txType;        //  ESP_CMDT_* of reply being waited for
+		bool        _txSample;      //  Latency of the reply can be sampled
+		uint32_t    _txStart;       //  Time the reply is waited for since, ms
+		uint32_t    _txDeadline;    //  Time command in progress times out, ms
+		//  Response latency of each command type
+		struct _espLatency _lat[ESP_CMDT_NUM];
+		//  Queue of AT commands, positions are free-running counters
+		struct _espATCmd _atQ[ESP_AT_QLEN];
+		volatile uint8_t _atQHead;  //  Commands queued
+		volatile uint8_t _atQTail;  //  Commands completed
 		//  Interface with task scheduler - provides memory space and function
 		//  to call in order for task scheduler to request service from this module
 #if defined(__USE_TASK_SCHEDULER__)
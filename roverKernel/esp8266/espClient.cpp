@@ -20,20 +20,29 @@
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor                [PUBLIC]
 ///-----------------------------------------------------------------------------
-_espClient::_espClient() : KeepAlive(true), _parent(0), _id(0) ,_alive(false)
+_espClient::_espClient() : KeepAlive(true), _parent(0), _id(0) ,_alive(false),
+                           _udp(false), _gen(0)
 {
     _Clear();
+    _TxReset();
+    memset((void*)&_stats, 0, sizeof(_stats));
 }
 
 _espClient::_espClient(uint8_t id, ESP8266 *par)
-    : KeepAlive(true), _parent(par), _id(id), _alive(true)
+    : KeepAlive(true), _parent(par), _id(id), _alive(true), _udp(false),
+      _gen(0)
 {
     _Clear();
+    _TxReset();
+    memset((void*)&_stats, 0, sizeof(_stats));
 }
 _espClient::_espClient(const _espClient &arg)
-    : KeepAlive(arg.KeepAlive), _parent(arg._parent), _id(arg._id), _alive(arg._alive)
+    : KeepAlive(arg.KeepAlive), _parent(arg._parent), _id(arg._id), _alive(arg._alive),
+      _udp(arg._udp), _gen(0)
 {
     _Clear();
+    _TxReset();
+    memset((void*)&_stats, 0, sizeof(_stats));
 }
 
 void _espClient::operator= (const _espClient &arg)
@@ -41,9 +50,8 @@ void _espClient::operator= (const _espClient &arg)
     _parent = arg._parent;
     _id = arg._id;
     _alive = arg._alive;
-    _respRdy = arg._respRdy;
+    _udp = arg._udp;
     KeepAlive = arg.KeepAlive;
-    memcpy((void*)RespBody, (void*)(arg.RespBody), sizeof(RespBody));
 }
 
 ///-----------------------------------------------------------------------------
@@ -51,119 +59,210 @@ void _espClient::operator= (const _espClient &arg)
 ///-----------------------------------------------------------------------------
 
 /**
- * Send data to a client over open TCP socket
+ * Send data to a client over open TCP socket and wait until it's sent
+ * @note Blocking wrapper around SendTCPAsync()
  * @param buffer NULL-TERMINATED(!) data to send
  * @param bufferLen[optional] len of the buffer, if not provided function looks
  * for first occurrence of \0 in buffer and takes that as length
- * @return status of send process (binary or of ESP_* flags received while sending)
+ * @return status of send process: ESP_STATUS_OK | ESP_STATUS_SENDOK if data was
+ * sent, ESP_STATUS_ERROR otherwise
  */
 uint32_t _espClient::SendTCP(char *buffer, uint16_t bufferLen)
 {
-    uint16_t bufLen = bufferLen;
-    uint8_t numStr[6] = {0};
+    uint8_t entry = _txQHead;
+    uint32_t status;
 
+    if (SendTCPAsync(buffer, bufferLen) == 0)
+        return ESP_STATUS_ERROR;
+
+    //  Wait for UART ISR to finish the send; stop waiting if socket got closed
+    //  in the meantime
+    while (_alive && ((int8_t)(_txQTail - entry) <= 0));
+    if (!_alive)
+        return ESP_STATUS_ERROR;
+
+    status = _txQ[entry & (ESP_TX_QLEN - 1)].status;
+    if (status == ESP_STATUS_SENDOK)
+        status |= ESP_STATUS_OK;
+
+    return status;
+}
+
+/**
+ * Queue data to be sent to a client over open TCP socket
+ * Data is copied into socket's Tx buffer and function returns immediately.
+ * Sending is done from UART ISR (AT+CIPSEND, wait for prompt, write payload,
+ * wait for SEND OK); outcome is reported through hook registered with
+ * ESP8266::AddSendHook() and, on failure, to event logger
+ * @param buffer data to send
+ * @param bufferLen[optional] len of the buffer, if not provided function looks
+ * for first occurrence of \0 in buffer and takes that as length
+ * @return handle of queued send (never 0), 0 if the socket is closed or there
+ * is not enough space in the queue
+ */
+uint16_t _espClient::SendTCPAsync(const char *buffer, uint16_t bufferLen)
+{
     //  If buffer length is not provided find it by looking for \0 char in string
     if (bufferLen == 0)
+        bufferLen = strlen(buffer);
+
+    return SendAsync(0, 0, buffer, bufferLen);
+}
+
+/**
+ * Queue header followed by payload as a single send (on UDP socket they end up
+ * in the same datagram)
+ * @note See SendTCPAsync() for details on queued sends
+ * @param hdr header to put in front of the payload, can be 0 if [hdrLen] is 0
+ * @param hdrLen size of [hdr]
+ * @param buffer data to send
+ * @param bufferLen size of [buffer]
+ * @return handle of queued send (never 0), 0 if the socket is closed or there
+ * is not enough space in the queue
+ */
+uint16_t _espClient::SendAsync(const uint8_t *hdr, uint8_t hdrLen,
+                               const char *buffer, uint16_t bufferLen)
+{
+    uint16_t bufLen = hdrLen + bufferLen;
+    struct _espTxEntry *entry;
+
+    if (!_alive || (bufLen == 0))
+        return 0;
+    //  Check if there's space for new send
+    if (((uint8_t)(_txQHead - _txQTail) >= ESP_TX_QLEN) ||
+        ((uint16_t)(ESP_TX_BUF - (uint16_t)(_txHead - _txTail)) < bufLen))
     {
-        //  Dangerous, might end up in memory access violation
-        while (buffer[bufLen++] != '\0');   //  Find \0
-        bufLen--;   //Exclude \0 char from size of buffer
+        _stats.txDrops++;
+        return 0;
     }
 
-    memset(_commBuf, 0, sizeof(_commBuf));
-    strcat(_commBuf, "AT+CIPSEND=");
-    itoa(_id, numStr);
-    strcat(_commBuf, (char*)numStr);
-    strcat(_commBuf, ",");
-    memset(numStr, 0, sizeof(numStr));
-    itoa(bufLen, numStr);
-    strcat(_commBuf, (char*)numStr);
-
-    if (_parent->_SendRAW(_commBuf, ESP_STATUS_RECV, 600))
-    {
-        _parent->flowControl = ESP_NO_STATUS;
-        HAL_ESP_WDControl(true, 600);
+    for (uint16_t i = 0; i < hdrLen; i++)
+        _txBuf[(uint16_t)(_txHead + i) & (ESP_TX_BUF - 1)] = hdr[i];
+    for (uint16_t i = 0; i < bufferLen; i++)
+        _txBuf[(uint16_t)(_txHead + hdrLen + i) & (ESP_TX_BUF - 1)] = buffer[i];
 
-        //  If ESP is not in server mode we need to manually start listening
-        //  for incoming data from ESP
-        if (!_parent->_servOpen)
-            HAL_ESP_IntEnable(true);
+    entry = &_txQ[_txQHead & (ESP_TX_QLEN - 1)];
+    entry->len = bufLen;
+    entry->status = ESP_NO_STATUS;
+    //  Handles are unique across all sockets, 0 is reserved for error
+    if (++(_parent->_txHandle) == 0)
+        _parent->_txHandle++;
+    entry->handle = _parent->_txHandle;
 
-        //  Write data we want to send
-        _parent->_RAWPortWrite(buffer, bufLen);
+    //  Publish the entry only once it's complete, ISR can pick it up after this
+    _txHead += bufLen;
+    _txQHead++;
 
-        //  Listen for potential response
-        while (_parent->flowControl == ESP_NO_STATUS);
-    }
-    //   Stop watchdog timer (started in ISR)
-    //HAL_ESP_WDControl(false, 0);
-    return _parent->flowControl;
+    //  Let UART ISR start sending if nothing is being sent at the moment
+    HAL_ESP_IntEnable(true);
+    HAL_ESP_PendInt();
+
+    return entry->handle;
 }
+
 /**
- * Read response from TCP socket(client) saved in internal buffer
- * Internal buffer with response is filled as soon as response is received in
- * an interrupt. This function only copies response from internal buffer to a
- * user provided one and then clears internal (and data-ready flag).
- * @param buffer pointer to user-provided buffer for incoming data
+ * Check if socket has any sends queued or in progress
+ * @return true if there are sends not yet completed
+ */
+bool _espClient::TxPending()
+{
+    return (_txQHead != _txQTail);
+}
+
+/**
+ * Get the largest send (header + payload) that can be queued on the socket
+ * right now
+ * @return number of bytes a new send can have, 0 if socket is closed or its
+ * send queue is full
+ */
+uint16_t _espClient::TxFree()
+{
+    if (!_alive || ((uint8_t)(_txQHead - _txQTail) >= ESP_TX_QLEN))
+        return 0;
+
+    return (uint16_t)(ESP_TX_BUF - (uint16_t)(_txHead - _txTail));
+}
+
+/**
+ * Read the oldest message received on the socket
+ * Messages are queued in socket's Rx buffer as soon as they're received in
+ * an interrupt. This function copies the oldest one into a user provided
+ * buffer and removes it from the queue.
+ * @param buffer pointer to user-provided buffer for incoming data, has to
+ * have space for the whole message (up to ESP_RX_BUF-1 bytes)
  * @param bufferLen used to return [buffer] size to user
- * @return true: if response was present and is copied into the provided buffer
- *        false: if no response is available
+ * @return true: if a message was present and is copied into the provided buffer
+ *        false: if no message is available
  */
 bool _espClient::Receive(char *buffer, uint16_t *bufferLen)
 {
-    (*bufferLen) = 0;
+    const uint8_t *data;
+
+    (*bufferLen) = Peek(&data);
     //  Check if there's new data received
-    if (_respRdy)
-    {
-        //  Fill argument buffer
-        while(RespBody[(*bufferLen)] != 0)
-        {
-            buffer[(*bufferLen)] = RespBody[(*bufferLen)];
-            (*bufferLen)++;
-        }
-
-        //  Clear response body & flag
-        _Clear();
-
-        //  Check if it's supposed to stay open, if not force closing or schedule
-        //  closing(preferred) of socket
-        if (!KeepAlive)
-        {
-#if defined(__USE_TASK_SCHEDULER__)
-            TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_CLOSETCP, 0);
-            TaskScheduler::GetP()->AddArgs(&_id, 1);
-#else
-            Close();
-#endif
-        }
+    if ((*bufferLen) == 0)
+        return false;
 
-        return true;
-    }
-    else return false;
+    memcpy((void*)buffer, (void*)data, (*bufferLen));
+    Done();
+
+    return true;
+}
+
+/**
+ * Get the oldest message received on the socket without removing it from the
+ * queue. Message stays valid (and its space in Rx buffer reserved) until
+ * Done() is called.
+ * @param data[out] pointer to null-terminated payload in socket's Rx buffer
+ * @return length of the message, 0 if no message is available
+ */
+uint16_t _espClient::Peek(const uint8_t **data)
+{
+    struct _espRxEntry *entry;
+
+    if (!Ready())
+        return 0;
+
+    entry = &_rxQ[_rxQTail & (ESP_RX_QLEN - 1)];
+    *data = _rxBuf + (entry->start & (ESP_RX_BUF - 1));
+
+    return entry->len;
 }
 
 /**
  * Check is socket has any new data ready for user
- * @note Used when manually reading response body from member variable to check
- * whether new data is available. If used, Done() MUST be called when done
- * processing data in response body. Alternative: use Receive() function instead
+ * @note Used when manually reading messages with Peek() to check whether new
+ * data is available. If used, Done() MUST be called when done processing the
+ * message. Alternative: use Receive() function instead
  * @return true: if there's new data from that socket
  *        false: otherwise
  */
 bool _espClient::Ready()
 {
-    return _respRdy;
+    return (_rxQHead != _rxQTail);
 }
 
 /**
- * Clear response body, flags and maintain socket alive if specified
- * @note Has to be called if user manually reads response body by reading member
- * variable directly, and not through Receive() function call
+ * Remove the oldest message from the queue and maintain socket alive if
+ * specified
+ * @note Has to be called if user reads messages through Peek(), and not
+ * through Receive() function call
  */
 void _espClient::Done()
 {
-    //  Clear response body & flag
-    _Clear();
+    struct _espRxEntry *entry;
+
+    if (!Ready())
+        return;
+
+    //  Release message together with any unused space preceding it
+    entry = &_rxQ[_rxQTail & (ESP_RX_QLEN - 1)];
+    _rxTail = entry->start + entry->len + 1;
+    _rxQTail++;
+    //  Message read directly is never handed out as a view
+    if ((int8_t)(_rxQView - _rxQTail) < 0)
+        _rxQView = _rxQTail;
+
     //  Check if it's supposed to stay open, if not force closing or schedule
     //  closing(preferred) of socket
     if (!KeepAlive)
@@ -179,8 +278,10 @@ void _espClient::Done()
 
 /**
  * Force closing TCP socket with the client
+ * Close command is only queued (see ESP8266::QueueCmd), function doesn't wait
+ * for ESP to confirm it
  * @note Object is deleted in ParseResponse function, once ESP confirms closing
- * @return status of close process (binary or of ESP_* flags received while closing)
+ * @return ESP_STATUS_OK if close command is queued, ESP_STATUS_ERROR otherwise
  */
 uint32_t _espClient::Close()
 {
@@ -192,15 +293,132 @@ uint32_t _espClient::Close()
     strcat(_commBuf, (char*)strNum);
 
     _alive = false;
-    return _parent->_SendRAW(_commBuf);
+    if (_parent->QueueCmd(_commBuf) == 0)
+        return ESP_STATUS_ERROR;
+    return ESP_STATUS_OK;
+}
+
+/**
+ * Get traffic counters of the socket
+ * @param stats[out] counters since startup
+ */
+void _espClient::Stats(struct _espSockStats *stats)
+{
+    memcpy((void*)stats, (void*)&_stats, sizeof(_stats));
+}
+
+/**
+ * Check if this is a UDP socket
+ * @return true if socket was opened as UDP, false for TCP
+ */
+bool _espClient::IsUDP()
+{
+    return _udp;
+}
+
+/**
+ * Drop all queued sends (without reporting them)
+ */
+void _espClient::_TxReset()
+{
+    _txHead = 0;
+    _txTail = 0;
+    _txQHead = 0;
+    _txQTail = 0;
+    memset((void*)_txQ, 0, sizeof(_txQ));
 }
 
 /**
- * Clear response body and flag for response ready
+ * (Re)initialize pooled client object for newly opened socket. Traffic
+ * counters are kept.
+ * @param id socket ID as returned by ESP
+ * @param par parent ESP8266 object
+ */
+void _espClient::_Open(uint8_t id, ESP8266 *par)
+{
+    _parent = par;
+    _id = id;
+    _gen++;
+    _udp = false;
+    KeepAlive = true;
+    _Clear();
+    _TxReset();
+    _alive = true;
+}
+
+/**
+ * Drop all received messages
  */
 void _espClient::_Clear()
 {
-    memset((void*)RespBody, 0, sizeof(RespBody));
-    RespLen = 0;
-    _respRdy = false;
+    _rxHead = 0;
+    _rxTail = 0;
+    _rxQHead = 0;
+    _rxQTail = 0;
+    _rxQView = 0;
+    memset((void*)_rxQ, 0, sizeof(_rxQ));
+}
+
+/**
+ * Reserve space for a message in Rx buffer (called from UART ISR once length
+ * of +IPD payload is known). Message together with terminating \0 is kept
+ * contiguous: if it doesn't fit before the end of the buffer, it's placed at
+ * the beginning and the space left at the end is released with it.
+ * @param len length of the message
+ * @param start[out] position at which to write the payload
+ * @return true if space is reserved, false if Rx queue is full
+ */
+bool _espClient::_RxAlloc(uint16_t len, uint16_t *start)
+{
+    uint16_t pos = _rxHead & (ESP_RX_BUF - 1),
+             skip = 0;
+
+    if (((uint32_t)pos + len + 1) > ESP_RX_BUF)
+        skip = ESP_RX_BUF - pos;
+
+    if (((uint8_t)(_rxQHead - _rxQTail) >= ESP_RX_QLEN) ||
+        ((uint32_t)(ESP_RX_BUF - (uint16_t)(_rxHead - _rxTail)) <
+         ((uint32_t)skip + len + 1)))
+        return false;
+
+    *start = _rxHead + skip;
+    return true;
+}
+
+/**
+ * Publish message whose payload has been written at position reserved with
+ * _RxAlloc() (called from UART ISR)
+ * @param start position of the payload
+ * @param len length of the payload
+ */
+void _espClient::_RxCommit(uint16_t start, uint16_t len)
+{
+    struct _espRxEntry *entry = &_rxQ[_rxQHead & (ESP_RX_QLEN - 1)];
+
+    _rxBuf[(uint16_t)(start + len) & (ESP_RX_BUF - 1)] = '\0';
+    entry->start = start;
+    entry->len = len;
+    entry->released = false;
+    _stats.rxBytes += len;
+    _stats.rxMsgs++;
+
+    //  Publish the entry only once it's complete
+    _rxHead = start + len + 1;
+    _rxQHead++;
+}
+
+/**
+ * Release message handed out as a view. Messages leave the queue in order,
+ * so space is freed only once all older messages are released as well.
+ * @param msg position of the message in Rx queue (free-running counter)
+ */
+void _espClient::_RxRelease(uint8_t msg)
+{
+    //  Ignore messages no longer (or not yet) in the queue
+    if ((uint8_t)(msg - _rxQTail) >= (uint8_t)(_rxQHead - _rxQTail))
+        return;
+
+    _rxQ[msg & (ESP_RX_QLEN - 1)].released = true;
+    while (Ready() && _rxQ[_rxQTail & (ESP_RX_QLEN - 1)].released)
+        Done();
 }
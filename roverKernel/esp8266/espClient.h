@@ -3,6 +3,33 @@
  *
  *  Created on: Mar 4, 2017
  *      Author: Vedran Mikov
+ *
+ *  @version 1.6.0
+ *  V1.1.0 - 19.10.2026
+ *  +Per-socket send queue: SendTCPAsync() copies data into socket's Tx buffer
+ *  and returns immediately with a handle, data is sent from UART ISR by the
+ *  send state machine in ESP8266 library. SendTCP() is kept as a blocking
+ *  wrapper around it
+ *  V1.2.0 - 19.10.2026
+ *  +Close() queues AT+CIPCLOSE in ESP8266 command queue instead of waiting
+ *  for the reply
+ *  V1.3.0 - 19.10.2026
+ *  +Socket can be a UDP socket (IsUDP), each queued send is then sent as a
+ *  single datagram
+ *  +SendAsync() queues a header and payload as a single send
+ *  V1.4.0 - 19.10.2026
+ *  +Clients are taken from a static pool in ESP8266 library instead of being
+ *  allocated on every connect (object is reused when socket ID is reopened)
+ *  +Received messages are queued in a per-socket ring buffer (RespBody is
+ *  removed), each message is kept contiguous and null-terminated; read with
+ *  Peek()/Done() or Receive()
+ *  +Per-socket byte/message/drop counters (_espSockStats)
+ *  V1.5.0 - 19.10.2026
+ *  +Messages can be handed out as views (see ESP8266::AddViewHook) and
+ *  released in any order, space is freed once all older messages are released
+ *  V1.6.0 - 19.10.2026
+ *  +Tx buffer holds a full MTU-sized send (2048B), free space can be checked
+ *  before queuing a send (TxFree)
  */
 
 #ifndef ROVERKERNEL_ESP8266_ESPCLIENT_H_
@@ -14,6 +41,48 @@ class _espClient;
 
 #include "esp8266.h"
 
+//  Size of buffer holding data queued for sending on a socket and max number
+//  of sends queued at once (both have to be a power of 2)
+#define ESP_TX_BUF      2048
+#define ESP_TX_QLEN     8
+//  Size of buffer holding messages received on a socket and max number of
+//  messages queued at once (both have to be a power of 2)
+#define ESP_RX_BUF      1024
+#define ESP_RX_QLEN     8
+
+/**
+ * Single send request queued on a socket, payload is kept in socket's Tx buffer
+ */
+struct _espTxEntry
+{
+    uint16_t            handle; //  Handle returned to the user
+    uint16_t            len;    //  Length of payload
+    volatile uint32_t   status; //  ESP_STATUS_SENDOK/ESP_STATUS_ERROR when done
+};
+
+/**
+ * Single message received on a socket, payload is kept in socket's Rx buffer
+ */
+struct _espRxEntry
+{
+    uint16_t            start;  //  Position of payload in Rx buffer
+    uint16_t            len;    //  Length of payload
+    volatile bool       released;   //  View of the message released
+};
+
+/**
+ * Traffic counters of a socket, kept since startup (not reset when socket ID
+ * is reopened)
+ */
+struct _espSockStats
+{
+    uint32_t            rxBytes;    //  Payload bytes received & queued
+    uint32_t            rxMsgs;     //  Messages (+IPD) received & queued
+    uint32_t            rxDrops;    //  Messages dropped, Rx queue full
+    uint32_t            txBytes;    //  Payload bytes sent
+    uint32_t            txMsgs;     //  Sends completed successfully
+    uint32_t            txDrops;    //  Sends failed or rejected, Tx queue full
+};
 
 /**
  * _espClient class - wrapper for TCP client connected to ESP server
@@ -30,19 +99,29 @@ class _espClient
         void        operator= (const _espClient &arg);
 
         uint32_t    SendTCP(char *buffer, uint16_t bufferLen = 0);
+        uint16_t    SendTCPAsync(const char *buffer, uint16_t bufferLen = 0);
+        uint16_t    SendAsync(const uint8_t *hdr, uint8_t hdrLen,
+                              const char *buffer, uint16_t bufferLen);
+        bool        TxPending();
+        uint16_t    TxFree();
         bool        Receive(char *buffer, uint16_t *bufferLen);
+        uint16_t    Peek(const uint8_t **data);
         bool        Ready();
         void        Done();
         uint32_t    Close();
+        bool        IsUDP();
+        void        Stats(struct _espSockStats *stats);
 
         //  Keep socket alive (don't terminate it after first round of communication)
         volatile bool       KeepAlive;
-        //  Buffer for data received on this socket
-        volatile char       RespBody[1024];
-        volatile uint16_t   RespLen;
 
     private:
+        void        _Open(uint8_t id, ESP8266 *par);
         void        _Clear();
+        void        _TxReset();
+        bool        _RxAlloc(uint16_t len, uint16_t *start);
+        void        _RxCommit(uint16_t start, uint16_t len);
+        void        _RxRelease(uint8_t msg);
 
         //  Pointer to a parent device of of this client
         ESP8266         *_parent;
@@ -50,8 +129,29 @@ class _espClient
         uint8_t         _id;
         //  Specifies whether the socket is alive
         volatile bool   _alive;
-        //  Specifies whether there's a response from this client ready to read
-        volatile bool   _respRdy;
+        //  Socket is a UDP socket (opened with ESP8266::OpenUDPSock)
+        bool            _udp;
+        //  Queue of sends (filled by user, emptied from UART ISR). Positions are
+        //  free-running counters, index is counter & (size - 1)
+        uint8_t             _txBuf[ESP_TX_BUF];
+        struct _espTxEntry  _txQ[ESP_TX_QLEN];
+        volatile uint16_t   _txHead;    //  Bytes written into _txBuf
+        volatile uint16_t   _txTail;    //  Bytes sent (or dropped) from _txBuf
+        volatile uint8_t    _txQHead;   //  Sends queued
+        volatile uint8_t    _txQTail;   //  Sends completed
+        //  Queue of received messages (filled from UART ISR, emptied by user)
+        uint8_t             _rxBuf[ESP_RX_BUF];
+        struct _espRxEntry  _rxQ[ESP_RX_QLEN];
+        volatile uint16_t   _rxHead;    //  Bytes used in _rxBuf
+        volatile uint16_t   _rxTail;    //  Bytes released from _rxBuf
+        volatile uint8_t    _rxQHead;   //  Messages received
+        volatile uint8_t    _rxQTail;   //  Messages read
+        uint8_t             _rxQView;   //  Messages handed out as views
+        //  Incremented every time the socket is (re)opened, used to discard
+        //  views released after the socket was reopened
+        uint8_t             _gen;
+        //  Traffic counters
+        struct _espSockStats _stats;
 };
 
 #endif /* ROVERKERNEL_ESP8266_ESPCLIENT_H_ */
@@ -15,8 +15,12 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-//  Define platform in use in hal.h
+//  Define platform in use in hal.h. Host (Linux) build, used to run drivers
+//  against emulated peripherals (see tools/), defines __BOARD_HOST__ on
+//  compiler's command line instead
+#if !defined(__BOARD_HOST__)
 #define __BOARD_TM4C1294NCPDT__
+#endif
 
 /*
  * Compile all libraries in debug mode, allowing them to print debug data to
@@ -30,11 +34,25 @@
  * In order to enable compilation of a module uncomment that module from
  * the following list.
  */
+#if defined(__BOARD_HOST__)
+//  Only modules with a host HAL, ESP8266 runs without task scheduler there
+#define __HAL_USE_ESP8266__
+#else
 #define __HAL_USE_ESP8266__
 #define __HAL_USE_ENGINES__
 #define __HAL_USE_RADAR__
 #define __HAL_USE_TASKSCH__
 #define __HAL_USE_EVENTLOG__
+#endif  /* __BOARD_HOST__ */
+
+/*
+ * ESP8266 receives data through uDMA into a ring buffer instead of reading
+ * UART FIFO from the interrupt on every 1/8 of FIFO. Comment out to fall back
+ * to FIFO-driven receive
+ */
+#if defined(__HAL_USE_ESP8266__) && defined(__BOARD_TM4C1294NCPDT__)
+    #define __HAL_USE_ESP8266_RXDMA__
+#endif
 
 /*
  * This section configures MPU9250 sensor
@@ -43,7 +61,9 @@
  */
 //  Select communication protocol - use either one of these two
 //#define __HAL_USE_MPU9250_I2C__
+#if !defined(__BOARD_HOST__)
 #define __HAL_USE_MPU9250_SPI__
+#endif
 
 #if defined(__HAL_USE_MPU9250_SPI__) || defined(__HAL_USE_MPU9250_I2C__)
     #define __HAL_USE_MPU9250__
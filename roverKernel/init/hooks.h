@@ -23,6 +23,43 @@
 #include "libs/myLib.h"
 
 
+/**
+ * Function called for every complete message received on 'commands' data
+ * stream (see DataStream::Feed). Message is parsed and its commands scheduled,
+ * outcome is reported back to the server
+ * @param buf buffer containing the message
+ * @param len size of the message in [buf] buffer
+ */
+static void CommandReceived(const uint8_t *buf, const uint16_t len)
+{
+    Platform &plat = Platform::GetI();
+    int err;
+    uint8_t response[20] = {0};
+
+    //  Binary frame can carry multiple commands, reply with a binary frame
+    //  listing outcome & PID of each of them
+    if (CMDF_IsBinary(buf, len))
+    {
+        uint8_t binResp[CMDF_RESP_MAX];
+        uint16_t respLen;
+
+        respLen = plat.ExecuteBinary(buf, len, binResp, &err);
+        plat.commands.Send(binResp, respLen);
+        return;
+    }
+
+    strcat((char*)response, DEVICE_ID);
+    strcat((char*)response, ":");
+    //  Parse incoming command and schedule its execution
+    plat.Execute(buf, len, &err);
+    if (err == STATUS_OK)
+        strcat((char*)response, "ACK\0");
+    else
+        strcat((char*)response, "NACK\0");
+
+    plat.commands.Send(response);
+}
+
 /**
  * Function to be called when a new data is received from TCP clients on ALL
  * opened sockets at ESP. Function is called through data scheduler if enabled,
@@ -35,9 +72,18 @@ static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint
 {
     Platform &plat = Platform::GetI();
     //  Check which socket received data
-    if (sockID == plat.telemetry.socketID)
+    if (plat.mux.Active() && (sockID == plat.mux.SocketID()))
+    {
+        //  Split data into channels, each channel's hook is called for every
+        //  message received on it
+        plat.mux.Feed(buf, len);
+    }
+    else if (sockID == plat.telemetry.socketID)
     {
-        //  Receiving data through this stream happens exclusively when there
+        //  Server echoes heartbeats to keep the stream up
+        if (plat.telemetry.Heartbeat(buf, len))
+            return;
+        //  Receiving other data through this stream happens only when there
         //  is a communication problem through 'commands' stream. Received
         //  data here triggers reboot of communications module
         plat.ts->SyncTask(ESP_UID, ESP_T_REBOOT, T_ASAP, false, 1);
@@ -46,19 +92,8 @@ static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint
     }
     else if (sockID == Platform::GetI().commands.socketID)
     {
-        int err;
-        uint8_t response[20] = {0};
-
-        strcat((char*)response, DEVICE_ID);
-        strcat((char*)response, ":");
-        //  Parse incoming command and schedule its execution
-        Platform::GetI().Execute(buf, len, &err);
-        if (err == STATUS_OK)
-            strcat((char*)response, "ACK\0");
-        else
-            strcat((char*)response, "NACK\0");
-
-        Platform::GetI().commands.Send(response);
+        //  Split data into messages, CommandReceived() is called for each
+        plat.commands.Feed(buf, len);
     }
     else
     {
@@ -66,14 +101,50 @@ static void ESPDataReceived(const uint8_t sockID, const uint8_t *buf, const uint
     }
 }
 
+/**
+ * Zero-copy delivery of data received on ESP sockets (registered with
+ * ESP8266::AddViewHook). Payload is processed in place: commands are parsed
+ * and scheduled straight from socket's receive ring, so the view is released
+ * as soon as this function returns.
+ * @param view view of the received message
+ * @return false, payload is not kept after returning
+ */
+static bool ESPViewReceived(const struct _espRxView *view)
+{
+    ESPDataReceived(view->sockID, view->data, view->len);
+    return false;
+}
+
 /**
  * Function called when a radar scan is completed, dumps data to a socket Id=0
- * if socket exists
+ * if socket exists, or to radar channel of the multiplexer if it's enabled
  * @param scanData
  * @param scanLen
  */
 static void RADScanComplete(uint8_t* scanData, uint16_t* scanLen)
 {
+    Platform &plat = Platform::GetI();
+
+    //  Scan goes into the map, server only gets changes of the map. Scan has
+    //  a point for every degree starting at 0, distances in cm
+    if (plat.map.Enabled())
+    {
+        uint16_t dist[RADAR_COLS_MAX];
+        uint16_t n = (*scanLen > RADAR_COLS_MAX) ? RADAR_COLS_MAX : *scanLen;
+
+        for (uint16_t i = 0; i < n; i++)
+            dist[i] = scanData[i] * 10;
+        plat.map.InsertScan(dist, n, 0.0f, 1.0f);
+        return;
+    }
+
+    //  Scan has its own low priority channel when multiplexed
+    if (plat.mux.Active())
+    {
+        plat.mux.Send(NMUX_CH_RADAR, scanData, *scanLen);
+        return;
+    }
+
     //  Once scan is completed schedule sending data through command socket
     TaskScheduler::GetP()->SyncTask(ESP_UID, ESP_T_SENDTCP, 0);
     TaskScheduler::GetP()->AddArg<uint8_t>(P_TO_SOCK(P_COMMANDS));  //Socket ID
@@ -81,4 +152,40 @@ static void RADScanComplete(uint8_t* scanData, uint16_t* scanLen)
     TaskScheduler::GetP()->AddArgs((void*)scanData, *scanLen);
 }
 
+/**
+ * Function called when a radar raster scan is completed, sends depth image
+ * one row per message to radar channel of the multiplexer if it's enabled,
+ * or to commands stream otherwise. Every row is followed by variance of its
+ * points. Rows are sent a few at a time by platform (see
+ * Platform::SendImage()) as there's room in the send queue.
+ * Starting sequence "5*" marks a row of distances, "10*" of variances:
+ *  5*:len:row(uint16_t)|rows(uint16_t)|cols(uint16_t)|dist(uint16_t, mm) x cols\n
+ *  10*:len:row(uint16_t)|rows(uint16_t)|cols(uint16_t)|var(uint16_t, mm^2) x cols\n
+ * @param img depth image, distance in mm stored row by row
+ * @param var variance of each point of the image in mm^2
+ * @param rows number of rows in the image
+ * @param cols number of columns in the image
+ */
+static void RADImageComplete(const uint16_t* img, const uint16_t* var,
+                             uint16_t rows, uint16_t cols)
+{
+    Platform &plat = Platform::GetI();
+
+    //  Single-row images (sweeps) go into the map, server only gets changes
+    //  of the map. Interpolated points (no samples) are skipped
+    if (plat.map.Enabled() && (rows == 1))
+    {
+        uint16_t dist[RADAR_COLS_MAX];
+        float from, step;
+
+        for (uint16_t i = 0; i < cols; i++)
+            dist[i] = (var[i] == RADAR_VAR_MAX) ? 0 : img[i];
+        plat.rad->ImageAngles(&from, &step);
+        plat.map.InsertScan(dist, cols, from, step);
+        return;
+    }
+
+    plat.SendImage(img, var, rows, cols);
+}
+
 #endif /* ROVERKERNEL_INIT_HOOKS_H_ */
@@ -9,9 +9,9 @@
 #include "libs/myLib.h"
 #include "HAL/hal.h"
 #include "init/eventLog.h"
+#include "init/telemetry.h"
 
 #include <string>
-#include <sstream>
 
 //  Enable debug information printed on serial port
 //#define __DEBUG_SESSION__
@@ -28,17 +28,6 @@
     #define EMIT_EV(X, Y)  EventLog::EmitEvent(PLAT_UID, X, Y)
 #endif /* __HAL_USE_EVENTLOG__ */
 
-/**
- * Template function to convert any number into a std::string
- * @param t Number of any type
- * @return Number passed in argument t as std::string
- */
-template <typename T> inline std::string tostr(const T& t) {
-   std::ostringstream os;
-   os<<t;
-   return os.str();
-}
-
 /**
  * Callback routine to invoke service offered by this module from task scheduler
  * @note It is assumed that once this function is called task scheduler has
@@ -61,49 +50,30 @@ void _PLAT_KernelCallback(void)
     switch (__plat._platKer.serviceID)
     {
     /*
-     *  Pack & send telemetry frame
+     *  Pack & send frames of all telemetry channels that are due. Called every
+     *  TEL_TICK_MS, all due channels are sent in a single network write
      *  args[] = none
      *  retVal on of myLib.h STATUS_* macros
      */
     case PLAT_T_TEL:
         {
             /*
-             * Telemetry frame has the following format:
-             * @note numbers are represented as strings not byte values
-             * timeSinceStartup:Roll:Pitch:Yaw:distanceLeft:distanceRight:speedLeft:speedRight:accX:accY:accZ\n
+             * Telemetry frame format depends on the channel, check
+             * telemetry.cpp for the format of each channel frame
              */
             std::string telemetryFrame;
-            float rpy[3];
-
-            //  Starting sequence "1*" marks beginning of standard telemetry
-            //  frame with all sensor data
-            telemetryFrame = "1*:" + tostr(msSinceStartup) + ":";
-#ifdef __HAL_USE_MPU9250__
-            //  Get RPY orientation on degrees
-            __plat.mpu->RPY(rpy, true);
-            telemetryFrame += tostr(rpy[0])+":"+tostr(rpy[1])+":"+tostr(rpy[2])+":";
-#else
-            telemetryFrame += tostr<float>(0.0)+":"+tostr<float>(0.0)+":"+tostr<float>(0.0)+":";
-#endif
-
-            //  Get 3-axis acceleration from MPU
-            float acc[3];
-            __plat.mpu->Acceleration(acc);
+            uint8_t packed;
 
-            //  Write engine telemetry into the packet
-            telemetryFrame += tostr<float>((float)__plat.eng->GetDistance(0)) + ":";
-            telemetryFrame += tostr<float>((float)__plat.eng->GetDistance(1)) + ":";
-            telemetryFrame += tostr<float>((float)__plat.eng->wheelSpeed[0]) + ":";
-            telemetryFrame += tostr<float>((float)__plat.eng->wheelSpeed[1]) + ":";
-            telemetryFrame += tostr<float>(acc[0]) + ":";
-            telemetryFrame += tostr<float>(acc[1]) + ":";
-            telemetryFrame += tostr<float>(acc[2]) + ":";
+            packed = __plat.tlm.Pack(msSinceStartup, telemetryFrame);
 
-            telemetryFrame += '\n';
+            //  Nothing was due on this tick, no need to report anything
+            if (packed == 0)
+                return;
 
             //  Send over telemetry stream
             __plat._platKer.retVal =
-                    __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str());
+                    __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
+                                          telemetryFrame.length());
 
 #ifdef __DEBUG_SESSION__
             DEBUG_WRITE("\nSending frame(%d), len:%d \n  %s \n",     \
@@ -115,6 +85,10 @@ void _PLAT_KernelCallback(void)
             if (__plat._platKer.retVal != STATUS_OK)
                 return;
 
+            //  Event log is shipped at the pace of standard telemetry frame
+            if (!(packed & (1 << TEL_CH_BASIC)))
+                return;
+
             //  If there are any unsent events, ship them off now
             if (EventLog::GetI().EventCount() > 0)
             {
@@ -194,9 +168,14 @@ void _PLAT_KernelCallback(void)
                 telemetryFrame += tostr<int16_t>(ee.taskID) + ":";
                 telemetryFrame += tostr<uint16_t>(ee.event) + ":";
 
-                //  Send telemetry frame
-                __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
-                                               telemetryFrame.length());
+                //  Send telemetry frame, on its own channel if multiplexed
+                if (__plat.mux.Active())
+                    __plat.mux.Send(NMUX_CH_EVLOG,
+                                    (uint8_t*)telemetryFrame.c_str(),
+                                    telemetryFrame.length());
+                else
+                    __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
+                                                   telemetryFrame.length());
             }
             //  Telemetry can't affect status, it's only a best-effort to
             //  deliver data
@@ -223,47 +202,58 @@ void _PLAT_KernelCallback(void)
         }
         break;
     /*
-     * Send data about task scheduler performance and load
-     * args[] = none
+     * Send data about task scheduler performance and load. Tasks are captured
+     * in a snapshot and sent in pages, one page per PLAT_T_TS_PAGE task so the
+     * scheduler is not blocked for the whole dump
+     * args[] = [libUID(uint8_t, TS_SNAP_ALL for all)|format(uint8_t,
+     *          PLAT_TS_FMT_*)|pageSize(uint8_t, tasks per page)]
      * retVal STATUS_OK
      */
     case PLAT_T_TS_DUMP:
         {
-            std::string telemetryFrame;
-            uint32_t Ntasks = __plat.ts->NumOfTasks();
+            uint8_t libUID = TS_SNAP_ALL;
+
+            __plat._tsFmt = PLAT_TS_FMT_TEXT;
+            __plat._tsPageSize = PLAT_TS_PAGE_DEF;
+            if (__plat._platKer.argN >= 1)
+                libUID = __plat._platKer.args[0];
+            if (__plat._platKer.argN >= 2)
+                __plat._tsFmt = __plat._platKer.args[1];
+            if ((__plat._platKer.argN >= 3) && (__plat._platKer.args[2] > 0))
+                __plat._tsPageSize = __plat._platKer.args[2];
+
+            //  Restarts dump already in progress, if any. Pending page of the
+            //  old dump is removed so there's only one chain of pages
+            if (__plat._tsPagePID != 0)
+                __plat.ts->RemoveTask(__plat._tsPagePID);
+            __plat._tsPagePID = 0;
+
+            __plat._tsTotal = __plat.ts->Snapshot(__plat._tsSnap,
+                                                  PLAT_TS_SNAP_MAX, libUID);
+            __plat._tsSnapN = __plat._tsTotal;
+            if (__plat._tsSnapN > PLAT_TS_SNAP_MAX)
+                __plat._tsSnapN = PLAT_TS_SNAP_MAX;
+            __plat._tsSnapIt = 0;
+            __plat._SendTSPage();
 
-            for (uint8_t i = 0; i < Ntasks; i++)
-            {
-                const TaskEntry *task = __plat.ts->FetchNextTask(i==0);
-                if (task == 0)
-                    break;
-
-                //  Construct standard telemetry frame with event log data, format:
-                //  3*:[time]:pendingTasks
-                telemetryFrame =  "3*:";
-                telemetryFrame += "[" + tostr<uint32_t>((uint32_t)task->_timestamp) + "]:";
-                telemetryFrame += tostr<uint16_t>(task->_libuid) + ":";
-                telemetryFrame += tostr<uint16_t>(task->_task) + ":";
-                telemetryFrame += tostr<int32_t>(task->_period) + ":";
-                telemetryFrame += tostr<uint16_t>((uint16_t)task->_PID) + ":";
-
-                //  Task performance data
-                telemetryFrame += tostr<uint32_t>((uint32_t)task->_perf.taskRuns) + ":";
-                telemetryFrame += tostr<uint32_t>((uint32_t)task->_perf.startTimeMissCnt) + ":";
-                telemetryFrame += tostr<uint32_t>((uint32_t)task->_perf.startTimeMissTot) + ":";
-                telemetryFrame += tostr<uint16_t>((uint16_t)task->_perf.msAcc) + ":";
-                telemetryFrame += tostr<uint32_t>((uint32_t)task->_perf.accRT) + ":";
-                telemetryFrame += tostr<uint16_t>((uint16_t)task->_perf.maxRT) + ":";
-
-                //  Send telemetry frame
-                __plat.telemetry.Send((uint8_t*)telemetryFrame.c_str(),
-                                               telemetryFrame.length());
-            }
             //  Telemetry can't affect status, it's only a best-effort to
             //  deliver data
             __plat._platKer.retVal = STATUS_OK;
         }
         break;
+    /*
+     * Send next page of task scheduler dump started by PLAT_T_TS_DUMP
+     * args[] = none
+     * retVal STATUS_OK
+     */
+    case PLAT_T_TS_PAGE:
+        {
+            //  This is the pending page, it's out of task list by now
+            __plat._tsPagePID = 0;
+            __plat._SendTSPage();
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
     /*
      * Send information about engines, current speed, distance traveled
      * args[] = none
@@ -303,6 +293,286 @@ void _PLAT_KernelCallback(void)
             __plat._platKer.retVal = STATUS_OK;
         }
         break;
+    /*
+     * Configure period and data fields of a telemetry channel
+     * args[] = channelID(uint8_t)|period(uint32_t, ms, 0 disables)|fields(uint16_t)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_TEL_CONFIG:
+        {
+            uint32_t period;
+            uint16_t fields;
+
+            if (__plat._platKer.argN < (1 + sizeof(uint32_t) + sizeof(uint16_t)))
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&period,
+                   (void*)(__plat._platKer.args + 1),
+                   sizeof(uint32_t));
+            memcpy((void*)&fields,
+                   (void*)(__plat._platKer.args + 1 + sizeof(uint32_t)),
+                   sizeof(uint16_t));
+
+            __plat._platKer.retVal = __plat.tlm.Configure(__plat._platKer.args[0],
+                                                          period, fields);
+        }
+        break;
+    /*
+     * Select encoding of a telemetry channel
+     * args[] = channelID(uint8_t)|encoding(uint8_t, TEL_ENC_*)|
+     *          [rpyRes(float)|accRes(float)|keyInterval(uint16_t)]
+     * Resolutions and keyframe interval are needed only for TEL_ENC_DELTA
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_TEL_ENCODING:
+        {
+            float rpyRes = IMUC_DEF_RPY_RES, accRes = IMUC_DEF_ACC_RES;
+            uint16_t keyInt = IMUC_DEF_KEYINT;
+            uint8_t *args = __plat._platKer.args;
+
+            if (__plat._platKer.argN < 2)
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            if (__plat._platKer.argN >= (2 + 2*sizeof(float) + sizeof(uint16_t)))
+            {
+                memcpy((void*)&rpyRes, (void*)(args + 2), sizeof(float));
+                memcpy((void*)&accRes, (void*)(args + 2 + sizeof(float)),
+                       sizeof(float));
+                memcpy((void*)&keyInt, (void*)(args + 2 + 2*sizeof(float)),
+                       sizeof(uint16_t));
+            }
+
+            __plat._platKer.retVal = __plat.tlm.SetEncoding(args[0], args[1],
+                                                            rpyRes, accRes,
+                                                            keyInt);
+        }
+        break;
+    /*
+     * Select how telemetry stream hands data to ESP. Buffered mode (ESP's
+     * AT+CIPSENDBUF) doesn't wait for the server to acknowledge each frame;
+     * library falls back to regular send if ESP firmware doesn't support it
+     * args[] = buffered(uint8_t, 0 - regular send, 1 - buffered send)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_TEL_SENDMODE:
+        {
+            if (__plat._platKer.argN < 1)
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            __plat.telemetry.SendBuffered(__plat._platKer.args[0] != 0);
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
+    /*
+     * Configure coalescing of telemetry writes into MTU-sized datagrams
+     * args[] = deadline(uint32_t, ms, 0 - send every frame right away)|
+     *          policy(uint8_t, DS_DROP_* - what to drop when buffer is full)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_TEL_COALESCE:
+        {
+            uint32_t deadline;
+
+            if ((__plat._platKer.argN < (sizeof(uint32_t) + 1)) ||
+                (__plat._platKer.args[sizeof(uint32_t)] > DS_DROP_OLDEST))
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&deadline, (void*)__plat._platKer.args,
+                   sizeof(uint32_t));
+            __plat.telemetry.Coalesce(deadline != 0, deadline,
+                                      __plat._platKer.args[sizeof(uint32_t)]);
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
+    /*
+     * Configure length-prefixed message framing of a data stream (see
+     * DS_FRAME_MAX in dataStream.h). Reply to this command is still sent
+     * with the old setting
+     * args[] = stream(uint8_t, 0 - commands, 1 - telemetry)|
+     *          enable(uint8_t)|crc(uint8_t)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_NET_FRAMING:
+        {
+            DataStream *ds;
+
+            if (__plat._platKer.argN < 3)
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            if (__plat._platKer.args[0] == 0)
+                ds = &__plat.commands;
+            else if (__plat._platKer.args[0] == 1)
+                ds = &__plat.telemetry;
+            else
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            ds->Framing(__plat._platKer.args[1] != 0,
+                        __plat._platKer.args[2] != 0);
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
+    /*
+     * Carry all data streams as channels of a single multiplexed connection
+     * to the server (see P_MUX), sockets of commands & telemetry streams are
+     * closed. Reply to this command is sent on the new connection
+     * args[] = none
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_NET_MUX:
+        {
+            __plat.mux.Bind(P_TO_SOCK(P_MUX));
+            __plat.commands.UseMux(&__plat.mux, NMUX_CH_CMD);
+            __plat.telemetry.UseMux(&__plat.mux, NMUX_CH_TEL);
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
+    /*
+     * Configure priority & flow control of a multiplexer channel
+     * args[] = channel(uint8_t, NMUX_CH_*)|priority(uint8_t)|flow(uint8_t)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_MUX_CONFIG:
+        {
+            if (__plat._platKer.argN < 3)
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            __plat._platKer.retVal =
+                    __plat.mux.Configure(__plat._platKer.args[0],
+                                         __plat._platKer.args[1],
+                                         __plat._platKer.args[2] != 0);
+        }
+        break;
+    /*
+     * Configure store-and-forward of telemetry stream: storing frames while
+     * the connection is down, spilling them to flash once RAM backlog is full
+     * and the rate at which they're replayed. Stream counts as down once the
+     * server hasn't echoed a heartbeat for [timeout] ms (see DS_HB_MSG),
+     * liveness check is off on startup and without [timeout] it's left as is
+     * args[] = enable(uint8_t)|flash(uint8_t)|rate(uint32_t, bytes/s)|
+     *          [timeout(uint32_t, ms, 0 to only follow the socket)]
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_TEL_BACKLOG:
+        {
+            uint32_t rate;
+
+            if (__plat._platKer.argN < (2 + sizeof(uint32_t)))
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&rate, (void*)(__plat._platKer.args + 2),
+                   sizeof(uint32_t));
+            __plat.backlog.SpillToFlash(__plat._platKer.args[1] != 0);
+            __plat.telemetry.StoreForward(
+                    (__plat._platKer.args[0] != 0) ? &__plat.backlog : 0, rate);
+            if (__plat._platKer.argN >= (2 + 2 * sizeof(uint32_t)))
+            {
+                uint32_t timeout;
+
+                memcpy((void*)&timeout,
+                       (void*)(__plat._platKer.args + 2 + sizeof(uint32_t)),
+                       sizeof(uint32_t));
+                __plat.telemetry.Liveness(timeout);
+            }
+            __plat._platKer.retVal = STATUS_OK;
+        }
+        break;
+    /*
+     * Update rover's pose in occupancy grid and send the next chunk of changed
+     * cells of the map (if it's enabled). Called every PLAT_MAP_PERIOD ms
+     * args[] = none
+     * retVal none
+     */
+    case PLAT_T_MAP:
+        {
+#ifdef __HAL_USE_RADAR__
+            __plat._MapTick();
+#endif
+            return; //  Return so we don't emit an event every period
+        }
+    /*
+     * Enable or disable occupancy grid, map is cleared and rover placed in
+     * its centre. While enabled radar scans update the map and only changes
+     * of the map are sent to the server
+     * args[] = enable(uint8_t)|size(uint16_t, cells)|res(uint16_t, mm)
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_MAP_CONFIG:
+        {
+#ifdef __HAL_USE_RADAR__
+            uint16_t size, res;
+
+            if (__plat._platKer.argN < (1 + 2*sizeof(uint16_t)))
+            {
+                __plat._platKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&size, (void*)(__plat._platKer.args + 1),
+                   sizeof(uint16_t));
+            memcpy((void*)&res, (void*)(__plat._platKer.args + 3),
+                   sizeof(uint16_t));
+            __plat._platKer.retVal = __plat.map.Configure(size, res);
+            if (__plat._platKer.retVal == STATUS_OK)
+                __plat.map.Enable(__plat._platKer.args[0] != 0);
+#else
+            __plat._platKer.retVal = STATUS_PROG_ERR;
+#endif
+        }
+        break;
+    /*
+     * Mark the whole map as changed so it's sent to the server again (e.g.
+     * after server has been restarted)
+     * args[] = none
+     * retVal one of myLib.h STATUS_* macros
+     */
+    case PLAT_T_MAP_SYNC:
+        {
+#ifdef __HAL_USE_RADAR__
+            __plat.map.MarkDirty(0, 0, OG_SIZE_MAX, OG_SIZE_MAX);
+            __plat._platKer.retVal = STATUS_OK;
+#else
+            __plat._platKer.retVal = STATUS_PROG_ERR;
+#endif
+        }
+        break;
+    /*
+     * Send next rows of radar image started by SendImage()
+     * args[] = none
+     * retVal none
+     */
+    case PLAT_T_RAD_IMAGE:
+        {
+#ifdef __HAL_USE_RADAR__
+            //  This is the pending task, it's out of task list by now
+            __plat._imgPID = 0;
+            __plat._SendImageRows();
+#endif
+            return; //  Return so we don't emit an event for every few rows
+        }
     default:
         break;
     }
@@ -375,7 +645,7 @@ void Platform::InitHW()
 #ifdef __HAL_USE_ESP8266__
         esp = ESP8266::GetP();
         esp->InitHW();
-        esp->AddHook(ESPDataReceived);
+        esp->AddViewHook(ESPViewReceived);
         //  Connect to AP in non-blocking mode, allowing everything else to
         //  be initialized while ESP establishes connection in the background
         //  and reports process through interrupt
@@ -384,13 +654,25 @@ void Platform::InitHW()
         //  still connecting to AP they will gracefully fail to bind until
         //  connection is established (error handled by DataStream module)
         DataStream_InitHW();
+        telemetry.UseUDP(true);
         telemetry.BindToSocketID(P_TO_SOCK(P_TELEMETRY), true);
+        //  Frames (and event log entries) are collected into full datagrams,
+        //  stale ones are dropped first if the link can't keep up
+        telemetry.Coalesce(true, DS_DEADLINE, DS_DROP_OLDEST);
+        //  Frames written during outages are replayed once link is back.
+        //  Liveness check (server's heartbeat echo) stays off until enabled
+        //  with PLAT_T_TEL_BACKLOG, a server that doesn't echo heartbeats
+        //  would otherwise never get live telemetry
+        telemetry.StoreForward(&backlog);
 
         //  Delay binding second socket so that the two tasks have different
         //  starting times, otherwise scheduler will be asked to execute them
         //  Concurrently which ends up in one of the tasks missing its start time
         HAL_DelayUS(20000); //  20ms delay
         commands.BindToSocketID(P_TO_SOCK(P_COMMANDS), true);
+        commands.AddHook(CommandReceived);
+        //  Commands arriving over multiplexer, once it's enabled
+        mux.AddHook(NMUX_CH_CMD, CommandReceived);
 #endif
 #ifdef __HAL_USE_ENGINES__
         eng = EngineData::GetP();
@@ -406,6 +688,7 @@ void Platform::InitHW()
         rad = RadarModule::GetP();
         rad->InitHW();
         rad->AddHook(RADScanComplete);
+        rad->AddImageHook(RADImageComplete);
 #endif
 
         //  Run post-initialization stuff
@@ -420,6 +703,8 @@ void Platform::InitHW()
  * sender:libUID:serviceID:timestamp:repeats:argLen::args\r\n
  * (all parts of message except for 'args' are numbers represented as strings,
  * args value is encoded into bit field and needs can be memcpy-ed into variable)
+ * Messages starting with CMDF_MAGIC bytes are binary frames described in
+ * network/cmdFrame.h and are handled by ExecuteBinary()
  * @param buf
  * @param len
  */
@@ -436,6 +721,14 @@ void Platform::Execute(const uint8_t* buf, const uint16_t len, int *err)
     DEBUG_WRITE("Received message(%d):\n  |>%s \n", len, buf);
 #endif
 
+    //  Binary frames are handled separately, text format below is kept for
+    //  clients which don't support them
+    if (CMDF_IsBinary(buf, len))
+    {
+        ExecuteBinary(buf, len, 0, err);
+        return;
+    }
+
     //  Count number of colons in message, if it's less than 8 message is corrupted
     uint8_t cnt = 0;
     for (uint16_t i = 0; i < len; i++)
@@ -486,19 +779,433 @@ void Platform::Execute(const uint8_t* buf, const uint16_t len, int *err)
     DEBUG_WRITE("\n");
 #endif
 
+    //  Schedule task based on data provided, pass location and size of
+    //  arguments
+    _Schedule(argv[0], argv[1], argv[2], argv[3], argv[4],
+              (const uint8_t*)(buf+it), argv[5]);
+}
+
+/**
+ * Parse binary command frame (see network/cmdFrame.h) and schedule execution
+ * of all commands in it. Frame is validated in place and arguments are passed
+ * to the task scheduler straight from [buf], no field is copied or converted
+ * beforehand. Commands are scheduled only if all of them are valid; as this
+ * runs from a task no other task can execute before the whole batch is in.
+ * If task scheduler fails to add one of them, the ones already added are
+ * removed again so the batch is still all-or-none.
+ * @param buf buffer containing binary command frame
+ * @param len size of [buf]
+ * @param resp[out] (optional) buffer of at least CMDF_RESP_MAX bytes to write
+ * response frame to, pass 0 if response is not needed
+ * @param err[out] STATUS_OK if all commands were scheduled, STATUS_PROG_ERR
+ * if task scheduler failed to add one of them, STATUS_ARG_ERR otherwise
+ * @return size of response frame written to [resp], 0 if [resp] is 0
+ */
+uint16_t Platform::ExecuteBinary(const uint8_t* buf, const uint16_t len,
+                                 uint8_t *resp, int *err)
+{
+    struct _cmdHeader hdr;
+    struct _cmdEntry cmd;
+    const uint8_t *payload = buf + CMDF_HDR_LEN;
+    uint8_t status = CMDF_ST_OK,
+            cmdStat[CMDF_MAX_CMDS],
+            count = 0;
+    uint16_t pid[CMDF_MAX_CMDS] = {0},
+             it, n;
+
+    memset((void*)&hdr, 0, sizeof(hdr));
+    if (len >= CMDF_HDR_LEN)
+        CMDF_GetHeader(buf, &hdr);
+
+    //  Payload has to be complete and intact
+    if (len < CMDF_HDR_LEN)
+        status = CMDF_ST_CRC_ERR;
+    else if (hdr.version != CMDF_VERSION)
+        status = CMDF_ST_VER_ERR;
+    else if ((hdr.len > (len - CMDF_HDR_LEN)) ||
+             (crc16(payload, hdr.len, 0xFFFF) != hdr.crc))
+        status = CMDF_ST_CRC_ERR;
+
+    //  First pass: validate all commands in the frame
+    for (it = 0; (status != CMDF_ST_CRC_ERR) && (status != CMDF_ST_VER_ERR)
+                  && (it < hdr.len); it += n)
+    {
+        if (count >= CMDF_MAX_CMDS)
+        {
+            status = CMDF_ST_TOO_MANY;
+            break;
+        }
+
+        n = CMDF_GetCommand(payload + it, hdr.len - it, &cmd);
+        //  Truncated command, rest of the payload can't be parsed
+        if (n == 0)
+        {
+            cmdStat[count++] = CMDF_ST_ARG_ERR;
+            status = CMDF_ST_ARG_ERR;
+            break;
+        }
+
+        if ((cmd.libUID >= NUM_OF_MODULES) ||
+            !TaskScheduler::ValidKernModule(cmd.libUID))
+        {
+            cmdStat[count++] = CMDF_ST_ARG_ERR;
+            status = CMDF_ST_ARG_ERR;
+        }
+        else
+            cmdStat[count++] = CMDF_ST_OK;
+    }
+
+    //  Second pass: schedule all commands
+    for (it = 0, n = 0; (status == CMDF_ST_OK) && (it < count); it++)
+    {
+        n += CMDF_GetCommand(payload + n, hdr.len - n, &cmd);
+
+#ifdef __DEBUG_SESSION__
+    DEBUG_WRITE("Binary frame %d: service %d from library %d, %d B of args\n",
+                hdr.seq, cmd.serviceID, cmd.libUID, cmd.argLen);
+#endif
+
+        //  Schedule task and pass arguments directly from receive buffer
+        pid[it] = _Schedule(cmd.libUID, cmd.serviceID, cmd.time, cmd.period,
+                            cmd.repeats, cmd.args, cmd.argLen);
+        //  No memory left for the task list (SyncTaskPer returns PID 0), take
+        //  back commands already scheduled
+        if (pid[it] == 0)
+        {
+            cmdStat[it] = CMDF_ST_SCHED_ERR;
+            status = CMDF_ST_SCHED_ERR;
+            while (it-- > 0)
+            {
+                ts->RemoveTask(pid[it]);
+                pid[it] = 0;
+            }
+            break;
+        }
+    }
+
+    //  Valid commands that weren't scheduled because of another one
+    if (status != CMDF_ST_OK)
+        for (it = 0; it < count; it++)
+            if (cmdStat[it] == CMDF_ST_OK)
+                cmdStat[it] = CMDF_ST_ABORTED;
+
+    if (status == CMDF_ST_OK)
+        *err = STATUS_OK;
+    else if (status == CMDF_ST_SCHED_ERR)
+        *err = STATUS_PROG_ERR;
+    else
+        *err = STATUS_ARG_ERR;
+
+    if (resp == 0)
+        return 0;
+
+    //  Assemble response frame: status|count|count x (status|PID)
+    n = CMDF_HDR_LEN;
+    resp[n++] = status;
+    resp[n++] = count;
+    for (it = 0; it < count; it++)
+    {
+        resp[n++] = cmdStat[it];
+        memcpy((void*)(resp + n), (void*)&(pid[it]), sizeof(uint16_t));
+        n += sizeof(uint16_t);
+    }
+    hdr.version = CMDF_VERSION;
+    hdr.len = n - CMDF_HDR_LEN;
+    hdr.crc = crc16(resp + CMDF_HDR_LEN, hdr.len, 0xFFFF);
+    CMDF_PutHeader(resp, &hdr);
+
+    return n;
+}
+
+/**
+ * Schedule a command received in either text or binary format, with same
+ * overrides applied to both
+ * @param libUID UID of library to call
+ * @param serviceID service ID within the library
+ * @param time, period, repeats as in TaskScheduler::SyncTaskPer
+ * @param args arguments of the task
+ * @param argLen size of [args]
+ * @return PID assigned to the new task, 0 if task couldn't be added
+ */
+uint16_t Platform::_Schedule(uint8_t libUID, uint8_t serviceID, int32_t time,
+                             int32_t period, int32_t repeats,
+                             const uint8_t *args, uint16_t argLen)
+{
+    uint16_t pid;
+
+#ifdef __HAL_USE_RADAR__
     //  This one is special: Radar scan task needs to be repeated 160 times,
-    //  with period of 40ms(to reposition radar head)
-    if ((argv[0] == RADAR_UID) && (argv[1] == RADAR_T_SCAN))
+    //  with period long enough to reposition radar head by 1 degree
+    if ((libUID == RADAR_UID) && (serviceID == RADAR_T_SCAN))
     {
-        argv[3] = 40;
-        argv[4] = 160;
+        period = rad->SettleTime(1.0f);
+        repeats = 160;
     }
-    //  Schedule task based on data provided
-    ts->SyncTaskPer(argv[0], argv[1], argv[2], argv[3], argv[4]);
-    //  Pass location and size of arguments
-    ts->AddArgs((void*)(buf+it), argv[5]);
+#endif
+
+    pid = ts->SyncTaskPer(libUID, serviceID, time, period, repeats);
+    if ((pid != 0) && (argLen > 0))
+        ts->AddArgs((void*)args, argLen);
+
+    return pid;
 }
 
+/**
+ * Send next page of task scheduler snapshot and schedule sending of the
+ * following one, if any tasks are left
+ * Text format, one line per task:
+ * 3*:[time]:libUID:serviceID:period:PID:taskRuns:startTimeMissCnt:
+ *      startTimeMissTot:msAcc:accRT:maxRT:\n
+ * Binary format:
+ * 8*:len:total(uint16_t)|dumped(uint16_t)|offset(uint16_t)|count(uint8_t)|
+ *      count x task\n
+ *      total: number of tasks in task list (matching the filter)
+ *      dumped: number of tasks in this dump, dump was truncated to
+ *              PLAT_TS_SNAP_MAX tasks if it's less than total
+ *      task: PID(uint16_t)|libUID(1B)|serviceID(1B)|time(uint32_t)|
+ *            period(int32_t)|taskRuns(uint32_t)|startTimeMissCnt(uint32_t)|
+ *            startTimeMissTot(uint32_t)|msAcc(uint16_t)|maxRT(uint16_t)|
+ *            accRT(uint32_t)
+ */
+void Platform::_SendTSPage()
+{
+    std::string frame;
+    uint16_t end = _tsSnapIt + _tsPageSize;
+
+    if (end > _tsSnapN)
+        end = _tsSnapN;
+
+    if (_tsFmt == PLAT_TS_FMT_BIN)
+    {
+        std::string page;
+        uint8_t count = (uint8_t)(end - _tsSnapIt);
+        struct _taskSnap *t;
+
+        page.append((const char*)&_tsTotal, sizeof(uint16_t));
+        page.append((const char*)&_tsSnapN, sizeof(uint16_t));
+        page.append((const char*)&_tsSnapIt, sizeof(uint16_t));
+        page.append((const char*)&count, sizeof(uint8_t));
+
+        for (; _tsSnapIt < end; _tsSnapIt++)
+        {
+            t = &(_tsSnap[_tsSnapIt]);
+            page.append((const char*)&(t->PID), sizeof(uint16_t));
+            page.append((const char*)&(t->libuid), sizeof(uint8_t));
+            page.append((const char*)&(t->task), sizeof(uint8_t));
+            page.append((const char*)&(t->timestamp), sizeof(uint32_t));
+            page.append((const char*)&(t->period), sizeof(int32_t));
+            page.append((const char*)&(t->perf.taskRuns), sizeof(uint32_t));
+            page.append((const char*)&(t->perf.startTimeMissCnt), sizeof(uint32_t));
+            page.append((const char*)&(t->perf.startTimeMissTot), sizeof(uint32_t));
+            page.append((const char*)&(t->perf.msAcc), sizeof(uint16_t));
+            page.append((const char*)&(t->perf.maxRT), sizeof(uint16_t));
+            page.append((const char*)&(t->perf.accRT), sizeof(uint32_t));
+        }
+
+        //  Starting sequence "8*" marks binary page of task scheduler dump
+        frame = "8*:" + tostr<uint32_t>(page.length()) + ":" + page;
+        frame += '\n';
+    }
+    else
+    {
+        for (; _tsSnapIt < end; _tsSnapIt++)
+        {
+            struct _taskSnap *t = &(_tsSnap[_tsSnapIt]);
+
+            frame += "3*:";
+            frame += "[" + tostr<uint32_t>(t->timestamp) + "]:";
+            frame += tostr<uint16_t>(t->libuid) + ":";
+            frame += tostr<uint16_t>(t->task) + ":";
+            frame += tostr<int32_t>(t->period) + ":";
+            frame += tostr<uint16_t>(t->PID) + ":";
+
+            //  Task performance data
+            frame += tostr<uint32_t>(t->perf.taskRuns) + ":";
+            frame += tostr<uint32_t>(t->perf.startTimeMissCnt) + ":";
+            frame += tostr<uint32_t>(t->perf.startTimeMissTot) + ":";
+            frame += tostr<uint16_t>(t->perf.msAcc) + ":";
+            frame += tostr<uint32_t>(t->perf.accRT) + ":";
+            frame += tostr<uint16_t>(t->perf.maxRT) + ":";
+            frame += '\n';
+        }
+    }
+
+    //  Dump is bulk data, keep it out of the way of telemetry if multiplexed
+    if ((frame.length() > 0) && mux.Active())
+        mux.Send(NMUX_CH_BULK, (uint8_t*)frame.c_str(), frame.length());
+    else if (frame.length() > 0)
+        telemetry.Send((uint8_t*)frame.c_str(), frame.length());
+
+    //  Continue with next page on the next scheduler pass
+    if (_tsSnapIt < _tsSnapN)
+        _tsPagePID = ts->SyncTask(PLAT_UID, PLAT_T_TS_PAGE, -TEL_TICK_MS);
+}
+
+/**
+ * Start sending radar image to the server, one message per row of distances
+ * followed by one for variances of the same row (see RADImageComplete() in
+ * hooks.h for the format). Rows are sent by PLAT_T_RAD_IMAGE tasks, as many
+ * at a time as the socket (or multiplexer's channel) has room for, so none
+ * are lost to a full send queue. Image that is still being sent is dropped
+ * @note Image is read from radar's buffers as it's sent, it must not change
+ * until all of it is sent
+ * @param img depth image, distance in mm stored row by row
+ * @param var variance of each point of the image in mm^2
+ * @param rows number of rows in the image
+ * @param cols number of columns in the image
+ */
+void Platform::SendImage(const uint16_t *img, const uint16_t *var,
+                         uint16_t rows, uint16_t cols)
+{
+#ifdef __HAL_USE_RADAR__
+    if (_imgPID != 0)
+        ts->RemoveTask(_imgPID);
+    _imgPID = 0;
+    if (_imgIt < 2 * _imgRows)
+        _DropImage();
+
+    _img = img;
+    _imgVar = var;
+    _imgRows = rows;
+    _imgCols = cols;
+    _imgIt = 0;
+    _imgWait = 0;
+    _SendImageRows();
+#endif  /* __HAL_USE_RADAR__ */
+}
+
+#ifdef __HAL_USE_RADAR__
+/**
+ * Send rows of radar image for as long as they're accepted and schedule
+ * sending of the rest, if any. Row that didn't fit is sent again on the next
+ * task; if it keeps not fitting for PLAT_IMG_WAIT_MAX tasks (e.g. connection
+ * is down) or a new scan starts overwriting the image, the rest is dropped
+ */
+void Platform::_SendImageRows()
+{
+#ifdef __HAL_USE_ESP8266__
+    uint32_t retVal = STATUS_OK;
+
+    //  New scan writes over the image, remaining rows would mix the two
+    if (rad->RasterBusy())
+    {
+        _DropImage();
+        return;
+    }
+
+    while (_imgIt < 2 * _imgRows)
+    {
+        std::string row, frame;
+        uint16_t i = _imgIt / 2;
+        const uint16_t *data = (_imgIt & 1) ? _imgVar : _img;
+
+        row.append((const char*)&i, sizeof(uint16_t));
+        row.append((const char*)&_imgRows, sizeof(uint16_t));
+        row.append((const char*)&_imgCols, sizeof(uint16_t));
+        row.append((const char*)(data + i * _imgCols),
+                   _imgCols * sizeof(uint16_t));
+
+        frame = ((_imgIt & 1) ? "10*:" : "5*:") +
+                tostr<uint32_t>(row.length()) + ":" + row;
+        frame += '\n';
+
+        //  Radar has its own low priority channel when multiplexed, that one
+        //  reports full queue on its own. Stream's socket is checked first so
+        //  row isn't handed to a full send queue
+        if (mux.Active())
+            retVal = mux.Send(NMUX_CH_RADAR, (uint8_t*)frame.c_str(),
+                              frame.length());
+        else if (commands.TxFree() < (frame.length() + DS_FRAME_HDR))
+            retVal = DS_STATUS_FULL;
+        else
+            retVal = commands.Send((uint8_t*)frame.c_str(), frame.length());
+
+        //  Row that can never be sent is skipped
+        if ((retVal != STATUS_OK) && (retVal != STATUS_ARG_ERR))
+            break;
+        _imgIt++;
+        _imgWait = 0;
+    }
+
+    if (_imgIt >= 2 * _imgRows)
+        return;
+
+    if (++_imgWait > PLAT_IMG_WAIT_MAX)
+    {
+        _DropImage();
+        return;
+    }
+
+    //  Continue once there's room, on the next scheduler pass
+    _imgPID = ts->SyncTask(PLAT_UID, PLAT_T_RAD_IMAGE, -TEL_TICK_MS);
+#endif  /* __HAL_USE_ESP8266__ */
+}
+
+/**
+ * Give up on the rest of radar image being sent, reported as an error of
+ * PLAT_T_RAD_IMAGE in event log
+ */
+void Platform::_DropImage()
+{
+    _imgIt = 2 * _imgRows;
+#ifdef __HAL_USE_EVENTLOG__
+    EMIT_EV(PLAT_T_RAD_IMAGE, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+}
+
+/**
+ * Single tick of occupancy grid: advance rover's pose from wheel encoders and
+ * IMU yaw, then (if map is enabled) send the next chunk of changed cells. If
+ * sending fails the chunk is marked dirty again and resent later
+ */
+void Platform::_MapTick()
+{
+    float rpy[3] = {0};
+
+#ifdef __HAL_USE_ENGINES__
+    #ifdef __HAL_USE_MPU9250__
+    mpu->RPY(rpy, true);
+    #endif
+    //  Pose is tracked even while the map is off, so it stays consistent
+    map.UpdatePose(eng->GetDistance(0), eng->GetDistance(1), rpy[2]);
+#endif
+
+#ifdef __HAL_USE_ESP8266__
+    uint8_t delta[OG_DELTA_MAX];
+    uint16_t len, x, y, w, h;
+    std::string frame;
+    uint32_t retVal;
+
+    if (!map.Enabled())
+        return;
+
+    len = map.Delta(delta, sizeof(delta));
+    if (len == 0)
+        return;
+
+    //  Starting sequence "11*" marks a delta of occupancy grid
+    frame = "11*:" + tostr<uint32_t>(len) + ":";
+    frame.append((const char*)delta, len);
+    frame += '\n';
+
+    if (mux.Active())
+        retVal = mux.Send(NMUX_CH_RADAR, (uint8_t*)frame.c_str(),
+                          frame.length());
+    else
+        retVal = commands.Send((uint8_t*)frame.c_str(), frame.length());
+
+    if (retVal != STATUS_OK)
+    {
+        memcpy((void*)&x, (void*)(delta + 16), sizeof(uint16_t));
+        memcpy((void*)&y, (void*)(delta + 18), sizeof(uint16_t));
+        memcpy((void*)&w, (void*)(delta + 20), sizeof(uint16_t));
+        memcpy((void*)&h, (void*)(delta + 22), sizeof(uint16_t));
+        map.MarkDirty(x, y, w, h);
+    }
+#endif
+}
+#endif  /* __HAL_USE_RADAR__ */
+
 /**
  * Post-initialization
  * Function runs (and schedules) all post-initialization tasks on the platform
@@ -514,10 +1221,14 @@ void Platform::_PostInit()
 
 #endif
 
-    //  Schedule periodic telemetry sending every 1s
-    ts->SyncTaskPer(PLAT_UID, PLAT_T_TEL, -1000, 1000, T_PERIODIC);
+    //  Schedule periodic telemetry tick, each channel is sent at its own rate
+    ts->SyncTaskPer(PLAT_UID, PLAT_T_TEL, -1000, TEL_TICK_MS, T_PERIODIC);
     //  Startup speed loop for the engines
     ts->SyncTaskPer(ENGINES_UID, ENG_T_SPEEDLOOP, -150, 150, T_PERIODIC);
+#ifdef __HAL_USE_RADAR__
+    //  Keep rover's pose in the map up to date, and send changes of the map
+    ts->SyncTaskPer(PLAT_UID, PLAT_T_MAP, -1000, PLAT_MAP_PERIOD, T_PERIODIC);
+#endif
 
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_OK);
@@ -529,7 +1240,12 @@ void Platform::_PostInit()
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 Platform::Platform()
-    : telemetry(TCP_SERVER_IP, P_TELEMETRY), commands(TCP_SERVER_IP, P_COMMANDS)
+    : telemetry(TCP_SERVER_IP, P_TELEMETRY), commands(TCP_SERVER_IP, P_COMMANDS),
+      mux(TCP_SERVER_IP, P_MUX),
+      _tsSnapN(0), _tsSnapIt(0), _tsTotal(0), _tsPagePID(0),
+      _tsPageSize(PLAT_TS_PAGE_DEF),
+      _tsFmt(PLAT_TS_FMT_TEXT), _img(0), _imgVar(0), _imgRows(0),
+      _imgCols(0), _imgIt(0), _imgWait(0), _imgPID(0)
 {
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
@@ -7,6 +7,11 @@
  *  Platform contains high-level definition of all modules currently attached and
  *  needed on the platform. It is thought of as a single module to unify
  *  low-level drivers and provide single point for initialization of platform.
+ *  Platform also keeps an occupancy grid of rover's surroundings, built from
+ *  radar scans and rover's pose (see radar/occupancyGrid.h). Once the map is
+ *  enabled (PLAT_T_MAP_CONFIG) radar scans update the map instead of being
+ *  sent to the server, and changes of the map are sent in their place:
+ *      11*:len:delta(len B)\n
  */
 
 #ifndef ROVERKERNEL_INIT_PLATFORM_H_
@@ -16,10 +21,15 @@
 #include "engines/engines.h"
 #include "esp8266/esp8266.h"
 #include "radar/radarGP2.h"
+#include "radar/occupancyGrid.h"
 #include "mpu9250/mpu9250.h"
 #include "taskScheduler/taskScheduler.h"
 
 #include "network/dataStream.h"
+#include "network/netMux.h"
+#include "network/backlog.h"
+#include "init/telemetry.h"
+#include "network/cmdFrame.h"
 
 
 /**     TCP port definitions for standard data streams   */
@@ -31,20 +41,39 @@
 #define SOCK_TO_P(X)    ((uint16_t)X+2700)
 /*
  * Telemetry data stream
- * Telemetry includes bidirectional stream starting from rover to server containing
- * sensor data, time reference, health report etc. On received frame from rover
- * server replies with "ACK\r\n"
- * Server expects telemetry stream on TCP port 2700
+ * Telemetry includes stream starting from rover to server containing sensor
+ * data, time reference, health report etc. Telemetry is best-effort, it's sent
+ * as UDP datagrams (see DS_UDP_HDR_LEN in dataStream.h for the header) so that
+ * a lost frame doesn't hold back the following ones. Frames are coalesced, a
+ * single datagram carries all frames written within DS_DEADLINE ms
+ * While the connection is down telemetry is kept in a backlog (RAM, optionally
+ * spilling to internal flash) and replayed as "9*" messages once it's back,
+ * see DS_REPLAY_RATE in dataStream.h. UDP socket doesn't go down when the
+ * server is unreachable, so the stream counts as down once the server stops
+ * echoing heartbeats (see DS_HB_MSG in dataStream.h). Keeping telemetry on
+ * UDP was preferred to a TCP stream so a lost datagram doesn't hold back live
+ * data, the server only has to echo "HB" datagrams back to their source. The
+ * check is opt-in (PLAT_T_TEL_BACKLOG with timeout, e.g. DS_LIVE_TIMEOUT) so
+ * servers that don't echo heartbeats still get live telemetry
+ * Server expects telemetry stream on UDP port 2700
  */
 #define P_TELEMETRY     2700
 /*
  * Commands data stream
  * This stream brings commands from server to rover. On received frame from
- * server rover replies "ACK\r\n"
+ * server rover replies "ACK\r\n". Once framing is enabled (PLAT_T_NET_FRAMING)
+ * commands are length-prefixed and may be split across or share TCP segments
  * Server expects commands stream on TCP port 2701
  */
 #define P_COMMANDS      2701
-
+/*
+ * Multiplexed data stream
+ * Once enabled (PLAT_T_NET_MUX) commands, telemetry, radar scans, event log
+ * and task scheduler dumps are all carried as channels of a single TCP
+ * connection (see network/netMux.h) and the two streams above are closed
+ * Server expects multiplexed stream on TCP port 2702
+ */
+#define P_MUX           2702
 //#define TCP_SERVER_IP   (uint8_t*)"192.168.0.12\0"
 #define TCP_SERVER_IP   (uint8_t*)"192.168.0.29\0"
 
@@ -60,6 +89,36 @@
     #define PLAT_T_SOFT_REBOOT    3   //  Perform soft reboot, only reset states
     #define PLAT_T_TS_DUMP        4   //  Report task scheduler data
     #define PLAT_T_ENG_DUMP       5   //  Report telemetry from engines
+    #define PLAT_T_TEL_CONFIG     6   //  Configure telemetry channel
+    #define PLAT_T_TEL_ENCODING   7   //  Select encoding of telemetry channel
+    #define PLAT_T_TS_PAGE        8   //  Send next page of task scheduler dump
+    #define PLAT_T_TEL_SENDMODE   9   //  Select send mode of telemetry stream
+    #define PLAT_T_TEL_COALESCE   10  //  Configure coalescing of telemetry
+    #define PLAT_T_NET_FRAMING    11  //  Configure framing of data streams
+    #define PLAT_T_NET_MUX        12  //  Move data streams onto multiplexer
+    #define PLAT_T_MUX_CONFIG     13  //  Configure channel of multiplexer
+    #define PLAT_T_TEL_BACKLOG    14  //  Configure telemetry backlog
+    #define PLAT_T_MAP            15  //  Update pose & send map changes
+    #define PLAT_T_MAP_CONFIG     16  //  Enable & configure occupancy grid
+    #define PLAT_T_MAP_SYNC       17  //  Send the whole map again
+    #define PLAT_T_RAD_IMAGE      18  //  Send next rows of radar image
+
+//  Maximum number of tasks captured in a single task scheduler dump, binary
+//  pages report the number of tasks in the task list as well so server can
+//  tell when the dump was truncated
+#define PLAT_TS_SNAP_MAX    32
+//  Default number of tasks sent in a single page of task scheduler dump
+#define PLAT_TS_PAGE_DEF    4
+//  Encodings of task scheduler dump
+#define PLAT_TS_FMT_TEXT    0   //  "3*" text line per task
+#define PLAT_TS_FMT_BIN     1   //  "8*" binary page
+//  Period of updating rover's pose in the map & sending changes of the map,
+//  at most one delta (OG_DELTA_MAX bytes) is sent per period
+#define PLAT_MAP_PERIOD     50
+//  Radar image is sent a few rows per PLAT_T_RAD_IMAGE task, as many as there
+//  is room for. Rest of the image is dropped once a row has been waiting for
+//  room for PLAT_IMG_WAIT_MAX tasks (TEL_TICK_MS apart) or a new scan starts
+#define PLAT_IMG_WAIT_MAX   200
 
 //  ID of this device when exchanging messages
 const char DEVICE_ID[] = {"ROVER1"};
@@ -74,6 +133,10 @@ class Platform
         void InitHW();
 
         void Execute(const uint8_t* buf, const uint16_t len, int *err);
+        uint16_t ExecuteBinary(const uint8_t* buf, const uint16_t len,
+                               uint8_t *resp, int *err);
+        void SendImage(const uint16_t *img, const uint16_t *var,
+                       uint16_t rows, uint16_t cols);
 
         //  Task scheduler is a requirement for platform
         volatile TaskScheduler *ts;
@@ -82,6 +145,12 @@ class Platform
         ESP8266 *esp;
         DataStream telemetry;
         DataStream commands;
+        //  Configuration of telemetry channels sent over telemetry stream
+        Telemetry  tlm;
+        //  Multiplexer carrying all streams over one connection (if enabled)
+        NetMux      mux;
+        //  Telemetry written while the connection is down
+        Backlog     backlog;
 #endif
 #ifdef __HAL_USE_ENGINES__
         EngineData *eng;
@@ -91,16 +160,44 @@ class Platform
 #endif
 #ifdef __HAL_USE_RADAR__
         RadarModule *rad;
+        //  Occupancy grid built from radar scans
+        OccupancyGrid map;
 #endif
     protected:
         Platform();
         ~Platform();
 
         void    _PostInit();
+        uint16_t _Schedule(uint8_t libUID, uint8_t serviceID, int32_t time,
+                           int32_t period, int32_t repeats,
+                           const uint8_t *args, uint16_t argLen);
+        void    _SendTSPage();
+        void    _MapTick();
+        void    _SendImageRows();
+        void    _DropImage();
 
         //  Interface with task scheduler - provides memory space and function
         //  to call in order for task scheduler to request service from this module
         _kernelEntry _platKer;
+
+        //  Snapshot of task scheduler being sent out in pages
+        struct _taskSnap    _tsSnap[PLAT_TS_SNAP_MAX];
+        uint16_t            _tsSnapN;       //  Number of tasks in snapshot
+        uint16_t            _tsSnapIt;      //  Next task to send
+        uint16_t            _tsTotal;       //  Number of tasks in task list
+        uint16_t            _tsPagePID;     //  Pending PLAT_T_TS_PAGE, 0 if none
+        uint8_t             _tsPageSize;    //  Tasks per page
+        uint8_t             _tsFmt;         //  One of PLAT_TS_FMT_* macros
+
+        //  Radar image being sent out, a message per row of distances and
+        //  one per row of variances (kept in radar module's buffers)
+        const uint16_t      *_img;
+        const uint16_t      *_imgVar;
+        uint16_t            _imgRows;
+        uint16_t            _imgCols;
+        uint16_t            _imgIt;         //  Next message to send
+        uint16_t            _imgWait;       //  Tasks next message has waited
+        uint16_t            _imgPID;        //  Pending PLAT_T_RAD_IMAGE, 0 if none
 };
 
 
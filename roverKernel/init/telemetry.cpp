@@ -0,0 +1,379 @@
+/**
+ * telemetry.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "init/telemetry.h"
+
+//  Makes sense to compile only if ESP module is being used
+#if defined(__HAL_USE_ESP8266__)
+
+#include "init/platform.h"
+#include "libs/myLib.h"
+
+#ifdef __HAL_USE_EVENTLOG__
+    #include "init/eventLog.h"
+#endif  /* __HAL_USE_EVENTLOG__ */
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Default configuration replicates telemetry as it was before channels were
+ * introduced: only the standard frame is sent, once every second. All other
+ * channels are disabled until configured through PLAT_T_TEL_CONFIG
+ */
+Telemetry::Telemetry()
+{
+    memset((void*)_ch, 0, sizeof(_ch));
+
+    _ch[TEL_CH_BASIC].period = 1000;
+    _ch[TEL_CH_BASIC].fields = 0xFFFF;
+
+    //  Preselect some sensible fields so enabling a channel only requires
+    //  setting its period
+    _ch[TEL_CH_IMU].fields = TEL_IMU_RPY | TEL_IMU_ACC;
+    _ch[TEL_CH_ODO].fields = TEL_ODO_DIST;
+    _ch[TEL_CH_ENG].fields = TEL_ENG_SPEED | TEL_ENG_DRIVING;
+    _ch[TEL_CH_RADAR].fields = TEL_RAD_ANGLE;
+    _ch[TEL_CH_TS].fields = TEL_TS_TASKS | TEL_TS_EVENTS;
+    _ch[TEL_CH_ESP].fields = TEL_ESP_LAT | TEL_ESP_HIST;
+    _ch[TEL_CH_NET].fields = TEL_NET_CONN | TEL_NET_RECONN;
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Configure period and fields of a single telemetry channel
+ * @param chan ID of channel to configure, one of TEL_CH_* macros
+ * @param periodMS period of the channel in ms, 0 to disable the channel
+ * @param fields bit-mask of TEL_<channel>_* macros selecting data to send
+ * @return one of myLib.h STATUS_* error codes
+ */
+uint32_t Telemetry::Configure(uint8_t chan, uint32_t periodMS, uint16_t fields)
+{
+    if (chan >= TEL_CH_NUM)
+        return STATUS_ARG_ERR;
+
+    //  Channel can't run faster than the telemetry tick
+    if ((periodMS != 0) && (periodMS < TEL_TICK_MS))
+        periodMS = TEL_TICK_MS;
+
+    _ch[chan].period = periodMS;
+    _ch[chan].fields = fields;
+    //  Newly configured channel is due on the next tick
+    _ch[chan].nextDue = 0;
+
+    return STATUS_OK;
+}
+
+/**
+ * Select encoding of channel data
+ * Only IMU channel supports TEL_ENC_DELTA, and encodes RPY and acceleration
+ * regardless of the field mask. Changing encoding restarts the encoder so the
+ * next frame is a keyframe.
+ * @param chan ID of channel, one of TEL_CH_* macros
+ * @param enc encoding, one of TEL_ENC_* macros
+ * @param rpyRes (TEL_ENC_DELTA only) resolution of RPY in degrees per LSB
+ * @param accRes (TEL_ENC_DELTA only) resolution of acceleration per LSB
+ * @param keyInterval (TEL_ENC_DELTA only) number of samples between keyframes
+ * @return one of myLib.h STATUS_* error codes
+ */
+uint32_t Telemetry::SetEncoding(uint8_t chan, uint8_t enc, float rpyRes,
+                                float accRes, uint16_t keyInterval)
+{
+    if (chan >= TEL_CH_NUM)
+        return STATUS_ARG_ERR;
+
+    if (enc == TEL_ENC_DELTA)
+    {
+        if (chan != TEL_CH_IMU)
+            return STATUS_ARG_ERR;
+        if (!_imuCodec.Configure(rpyRes, accRes, keyInterval))
+            return STATUS_ARG_ERR;
+    }
+    else if (enc != TEL_ENC_TEXT)
+        return STATUS_ARG_ERR;
+
+    _ch[chan].encoding = enc;
+
+    return STATUS_OK;
+}
+
+/**
+ * Append frames of all channels which are due at time [now] to [frame]
+ * @param now current time in ms since startup
+ * @param frame string to which frames of due channels are appended
+ * @return bit-mask of channels that were packed (bit N for channel ID N), 0 if
+ * no channel was due
+ */
+uint8_t Telemetry::Pack(uint64_t now, std::string &frame)
+{
+    uint8_t retVal = 0;
+
+    for (uint8_t i = 0; i < TEL_CH_NUM; i++)
+    {
+        //  Skip disabled channels and the ones that aren't due yet
+        if ((_ch[i].period == 0) || (_ch[i].nextDue > now))
+            continue;
+
+        if (i == TEL_CH_BASIC)
+            _PackBasic(frame);
+        else if (_ch[i].encoding == TEL_ENC_DELTA)
+            _PackIMUDelta(now, frame);
+        else
+            _PackChannel(i, now, frame);
+
+        //  Schedule next time channel is due, don't try to catch up on missed
+        //  frames as they would only end up being sent in a burst
+        _ch[i].nextDue = now + _ch[i].period;
+        retVal |= (1 << i);
+    }
+
+    return retVal;
+}
+
+/**
+ * Check whether the channel is enabled
+ * @param chan ID of channel, one of TEL_CH_* macros
+ * @return true if channel has a non-zero period, false otherwise
+ */
+bool Telemetry::Enabled(uint8_t chan)
+{
+    if (chan >= TEL_CH_NUM)
+        return false;
+    return (_ch[chan].period != 0);
+}
+
+///-----------------------------------------------------------------------------
+///                      Private member functions                   [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Append standard telemetry frame to [frame]. Format of this frame is expected
+ * by the GUI so the field mask is ignored and all data is always sent.
+ * @note numbers are represented as strings not byte values
+ * 1*:timeSinceStartup:Roll:Pitch:Yaw:distanceLeft:distanceRight:speedLeft:speedRight:accX:accY:accZ\n
+ * @param frame string to append the frame to
+ */
+void Telemetry::_PackBasic(std::string &frame)
+{
+    Platform &plat = Platform::GetI();
+    float rpy[3] = {0}, acc[3] = {0};
+
+    //  Starting sequence "1*" marks beginning of standard telemetry
+    //  frame with all sensor data
+    frame += "1*:" + tostr(msSinceStartup) + ":";
+#ifdef __HAL_USE_MPU9250__
+    //  Get RPY orientation on degrees and 3-axis acceleration from MPU
+    plat.mpu->RPY(rpy, true);
+    plat.mpu->Acceleration(acc);
+#endif
+    frame += tostr(rpy[0])+":"+tostr(rpy[1])+":"+tostr(rpy[2])+":";
+
+#ifdef __HAL_USE_ENGINES__
+    //  Write engine telemetry into the packet
+    frame += tostr<float>((float)plat.eng->GetDistance(0)) + ":";
+    frame += tostr<float>((float)plat.eng->GetDistance(1)) + ":";
+    frame += tostr<float>((float)plat.eng->wheelSpeed[0]) + ":";
+    frame += tostr<float>((float)plat.eng->wheelSpeed[1]) + ":";
+#else
+    frame += "0:0:0:0:";
+#endif
+    frame += tostr<float>(acc[0]) + ":";
+    frame += tostr<float>(acc[1]) + ":";
+    frame += tostr<float>(acc[2]) + ":";
+
+    frame += '\n';
+}
+
+/**
+ * Append frame of a telemetry channel to [frame]. Only fields selected in the
+ * channel's field mask are included, in the order of their bits (LSB first)
+ * @note numbers are represented as strings not byte values
+ * 6*:chanID:timeSinceStartup:fieldMask:field1:field2...\n
+ * @param chan ID of channel to pack, one of TEL_CH_* macros
+ * @param now current time in ms since startup
+ * @param frame string to append the frame to
+ */
+void Telemetry::_PackChannel(uint8_t chan, uint64_t now, std::string &frame)
+{
+    Platform &plat = Platform::GetI();
+    uint16_t fields = _ch[chan].fields;
+
+    //  Starting sequence "6*" marks frame of a configurable telemetry channel
+    frame += "6*:" + tostr<uint16_t>(chan) + ":" + tostr(now) + ":";
+    frame += tostr<uint16_t>(fields) + ":";
+
+    switch (chan)
+    {
+    case TEL_CH_IMU:
+#ifdef __HAL_USE_MPU9250__
+        {
+            float data[3];
+
+            if (fields & TEL_IMU_RPY)
+            {
+                plat.mpu->RPY(data, true);
+                frame += tostr(data[0])+":"+tostr(data[1])+":"+tostr(data[2])+":";
+            }
+            if (fields & TEL_IMU_ACC)
+            {
+                plat.mpu->Acceleration(data);
+                frame += tostr(data[0])+":"+tostr(data[1])+":"+tostr(data[2])+":";
+            }
+            if (fields & TEL_IMU_GYRO)
+            {
+                plat.mpu->Gyroscope(data);
+                frame += tostr(data[0])+":"+tostr(data[1])+":"+tostr(data[2])+":";
+            }
+            if (fields & TEL_IMU_MAG)
+            {
+                plat.mpu->Magnetometer(data);
+                frame += tostr(data[0])+":"+tostr(data[1])+":"+tostr(data[2])+":";
+            }
+        }
+#endif  /* __HAL_USE_MPU9250__ */
+        break;
+    case TEL_CH_ODO:
+#ifdef __HAL_USE_ENGINES__
+        if (fields & TEL_ODO_DIST)
+        {
+            frame += tostr<float>(plat.eng->GetDistance(0)) + ":";
+            frame += tostr<float>(plat.eng->GetDistance(1)) + ":";
+        }
+        if (fields & TEL_ODO_TICKS)
+        {
+            frame += tostr<int32_t>((int32_t)plat.eng->wheelCounter[0]) + ":";
+            frame += tostr<int32_t>((int32_t)plat.eng->wheelCounter[1]) + ":";
+        }
+        if (fields & TEL_ODO_SETP)
+        {
+            frame += tostr<int32_t>((int32_t)plat.eng->wheelSetPoint[0]) + ":";
+            frame += tostr<int32_t>((int32_t)plat.eng->wheelSetPoint[1]) + ":";
+        }
+#endif  /* __HAL_USE_ENGINES__ */
+        break;
+    case TEL_CH_ENG:
+#ifdef __HAL_USE_ENGINES__
+        if (fields & TEL_ENG_SPEED)
+        {
+            frame += tostr<float>((float)plat.eng->wheelSpeed[0]) + ":";
+            frame += tostr<float>((float)plat.eng->wheelSpeed[1]) + ":";
+        }
+        if (fields & TEL_ENG_DRIVING)
+            frame += tostr<uint16_t>(plat.eng->IsDriving()) + ":";
+#endif  /* __HAL_USE_ENGINES__ */
+        break;
+    case TEL_CH_RADAR:
+#ifdef __HAL_USE_RADAR__
+        if (fields & TEL_RAD_ANGLE)
+        {
+            frame += tostr<float>(plat.rad->GetHorAngle()) + ":";
+            frame += tostr<float>(plat.rad->GetVerAngle()) + ":";
+        }
+#endif  /* __HAL_USE_RADAR__ */
+        break;
+    case TEL_CH_TS:
+        if (fields & TEL_TS_TASKS)
+            frame += tostr<uint32_t>(plat.ts->NumOfTasks()) + ":";
+#ifdef __HAL_USE_EVENTLOG__
+        if (fields & TEL_TS_EVENTS)
+            frame += tostr<uint16_t>(EventLog::GetI().EventCount()) + ":";
+#endif  /* __HAL_USE_EVENTLOG__ */
+        break;
+    case TEL_CH_ESP:
+        {
+            struct _espLatency lat;
+
+            if (fields & TEL_ESP_LAT)
+                for (uint8_t i = 0; i < ESP_CMDT_NUM; i++)
+                {
+                    plat.esp->CmdLatency(i, &lat);
+                    frame += tostr<float>((float)lat.srtt / 8.0f) + ":";
+                    frame += tostr<float>((float)lat.rttvar / 8.0f) + ":";
+                    frame += tostr<uint32_t>(lat.rto) + ":";
+                    frame += tostr<uint32_t>(lat.timeouts) + ":";
+                }
+            if (fields & TEL_ESP_HIST)
+                for (uint8_t i = 0; i < ESP_CMDT_NUM; i++)
+                {
+                    plat.esp->CmdLatency(i, &lat);
+                    for (uint8_t b = 0; b < ESP_LAT_BINS; b++)
+                        frame += tostr<uint32_t>(lat.hist[b]) + ":";
+                }
+        }
+        break;
+    case TEL_CH_NET:
+        {
+            struct _dsConnStats conn[2];
+
+            //  Once multiplexed both streams share the multiplexer's link, the
+            //  standalone streams are closed and would only report down
+            if (plat.mux.Active())
+            {
+                plat.mux.ConnStats(&conn[0]);
+                conn[1] = conn[0];
+            }
+            else
+            {
+                plat.telemetry.ConnStats(&conn[0]);
+                plat.commands.ConnStats(&conn[1]);
+            }
+            for (uint8_t i = 0; i < 2; i++)
+            {
+                if (fields & TEL_NET_CONN)
+                {
+                    frame += tostr<uint16_t>(conn[i].state) + ":";
+                    frame += tostr<uint32_t>(conn[i].since) + ":";
+                    frame += tostr<uint32_t>(conn[i].uptime / 1000) + ":";
+                }
+                if (fields & TEL_NET_RECONN)
+                {
+                    frame += tostr<uint32_t>(conn[i].reconnects) + ":";
+                    frame += tostr<uint32_t>(conn[i].failures) + ":";
+                    frame += tostr<uint32_t>(conn[i].lastTTR) + ":";
+                    frame += tostr<uint32_t>(conn[i].maxTTR) + ":";
+                }
+            }
+        }
+        break;
+    default:
+        break;
+    }
+
+    frame += '\n';
+}
+
+/**
+ * Append binary frame with delta-encoded IMU sample to [frame]
+ * @note Length is a string, sample bytes are raw output of IMUCodec::Encode()
+ * 7*:length:sampleBytes\n
+ * @param now current time in ms since startup
+ * @param frame string to append the frame to
+ */
+void Telemetry::_PackIMUDelta(uint64_t now, std::string &frame)
+{
+    uint8_t buf[IMUC_MAX_SAMPLE];
+    float rpy[3] = {0}, acc[3] = {0};
+    uint16_t len;
+
+#ifdef __HAL_USE_MPU9250__
+    Platform &plat = Platform::GetI();
+    plat.mpu->RPY(rpy, true);
+    plat.mpu->Acceleration(acc);
+#endif  /* __HAL_USE_MPU9250__ */
+
+    len = _imuCodec.Encode((uint32_t)now, rpy, acc, buf, sizeof(buf));
+
+    //  Starting sequence "7*" marks binary delta-encoded IMU frame
+    frame += "7*:" + tostr<uint16_t>(len) + ":";
+    frame.append((const char*)buf, len);
+    frame += '\n';
+}
+
+#endif  /* __HAL_USE_ESP8266__ */
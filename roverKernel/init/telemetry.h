@@ -0,0 +1,140 @@
+/**
+ * telemetry.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Telemetry channels carry sensor and system data from the rover to the
+ *  server. Each channel (IMU, odometry, engines, radar, scheduler statistics,
+ *  ESP8266 link quality, data stream connections)
+ *  has its own period and a bit-mask of fields to include in the frame, both
+ *  of which can be changed at runtime through platform service
+ *  PLAT_T_TEL_CONFIG. Platform calls Pack() on every telemetry tick and all
+ *  channels due at that tick end up in a single string which is then sent with
+ *  a single network write (one CIPSEND for all of them).
+ *
+ *  IMU channel can optionally be sent in a compact binary form (see
+ *  network/imuCodec.h) selected through platform service PLAT_T_TEL_ENCODING.
+ *
+ *  @version 1.3.1
+ *  V1.3.1 - 19.10.2026
+ *  +Network channel reports multiplexer's link once streams are multiplexed
+ *  V1.3.0 - 19.10.2026
+ *  +Network channel: connection state & reconnect statistics of data streams
+ *  V1.2.0 - 19.10.2026
+ *  +ESP8266 link channel: command response latency, timeouts & histograms
+ *  V1.1.0 - 19.10.2026
+ *  +Quantized delta encoding of IMU channel (binary "7*" frame)
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Runtime-configurable period and fields of each telemetry channel
+ *  +Channels due on the same tick are packed into a single frame
+ */
+#include "hwconfig.h"
+
+//  Makes sense to compile only if ESP module is being used
+#if !defined(ROVERKERNEL_INIT_TELEMETRY_H_) && defined(__HAL_USE_ESP8266__)
+#define ROVERKERNEL_INIT_TELEMETRY_H_
+
+#include <string>
+#include <sstream>
+
+#include "network/imuCodec.h"
+
+/**
+ * Template function to convert any number into a std::string
+ * @param t Number of any type
+ * @return Number passed in argument t as std::string
+ */
+template <typename T> inline std::string tostr(const T& t) {
+   std::ostringstream os;
+   os<<t;
+   return os.str();
+}
+
+//  Base period at which platform checks whether any of the channels are due
+//  (in ms). Channel periods are effectively rounded up to a multiple of this
+#define TEL_TICK_MS         10
+
+/**     Telemetry channel IDs   */
+#define TEL_CH_BASIC        0   //  Standard "1*" frame (as expected by GUI)
+#define TEL_CH_IMU          1   //  Orientation & raw MPU9250 measurements
+#define TEL_CH_ODO          2   //  Odometry from wheel encoders
+#define TEL_CH_ENG          3   //  Engine state
+#define TEL_CH_RADAR        4   //  Radar gimbal state
+#define TEL_CH_TS           5   //  Task scheduler & event log statistics
+#define TEL_CH_ESP          6   //  ESP8266 command latency (link quality)
+#define TEL_CH_NET          7   //  Connection state of data streams
+#define TEL_CH_NUM          8   //  Total number of channels
+
+/**     Fields available in each channel (bit-mask passed when configuring) */
+//  TEL_CH_IMU
+#define TEL_IMU_RPY         (1<<0)  //  Roll, pitch, yaw in degrees
+#define TEL_IMU_ACC         (1<<1)  //  Acceleration x,y,z
+#define TEL_IMU_GYRO        (1<<2)  //  Angular rate x,y,z
+#define TEL_IMU_MAG         (1<<3)  //  Magnetic field x,y,z
+//  TEL_CH_ODO
+#define TEL_ODO_DIST        (1<<0)  //  Distance traveled left,right (cm)
+#define TEL_ODO_TICKS       (1<<1)  //  Encoder counter left,right
+#define TEL_ODO_SETP        (1<<2)  //  Encoder set point left,right
+//  TEL_CH_ENG
+#define TEL_ENG_SPEED       (1<<0)  //  Wheel speed left,right (cm/s)
+#define TEL_ENG_DRIVING     (1<<1)  //  1 if engines are running, 0 otherwise
+//  TEL_CH_RADAR
+#define TEL_RAD_ANGLE       (1<<0)  //  Horizontal,vertical gimbal angle
+//  TEL_CH_TS
+#define TEL_TS_TASKS        (1<<0)  //  Number of tasks pending execution
+#define TEL_TS_EVENTS       (1<<1)  //  Number of entries in event log
+//  TEL_CH_ESP (each field is repeated for all ESP_CMDT_* command types)
+#define TEL_ESP_LAT         (1<<0)  //  Smoothed latency, deviation (ms),
+                                    //  timeout (ms), number of timeouts
+#define TEL_ESP_HIST        (1<<1)  //  ESP_LAT_BINS latency histogram bins
+//  TEL_CH_NET (each field is repeated for telemetry & commands stream, both
+//  report the multiplexer's link once PLAT_T_NET_MUX is enabled)
+#define TEL_NET_CONN        (1<<0)  //  State, time in state (ms), uptime (s)
+#define TEL_NET_RECONN      (1<<1)  //  Reconnects, failed attempts, last &
+                                    //  longest time to reconnect (ms)
+
+/**     Encodings of channel data   */
+#define TEL_ENC_TEXT        0   //  Numbers as strings in "6*" frame (default)
+#define TEL_ENC_DELTA       1   //  Quantized delta encoding, "7*" frame (IMU only)
+
+/**
+ * Configuration & state of a single telemetry channel
+ */
+struct _telChannel
+{
+    uint32_t period;    //  Period in ms, 0 if channel is disabled
+    uint16_t fields;    //  Bit-mask of fields to include in the frame
+    uint8_t  encoding;  //  One of TEL_ENC_* macros
+    uint64_t nextDue;   //  Time (ms since startup) at which channel is due
+};
+
+/**
+ * Telemetry class definition
+ * Keeps configuration of all telemetry channels and assembles frames of the
+ * channels that are due at a given point in time.
+ */
+class Telemetry
+{
+    public:
+        Telemetry();
+
+        uint32_t    Configure(uint8_t chan, uint32_t periodMS, uint16_t fields);
+        uint32_t    SetEncoding(uint8_t chan, uint8_t enc, float rpyRes,
+                                float accRes, uint16_t keyInterval);
+        uint8_t     Pack(uint64_t now, std::string &frame);
+        bool        Enabled(uint8_t chan);
+
+    protected:
+        void        _PackBasic(std::string &frame);
+        void        _PackChannel(uint8_t chan, uint64_t now, std::string &frame);
+        void        _PackIMUDelta(uint64_t now, std::string &frame);
+
+        //  Configuration of all available channels
+        struct _telChannel  _ch[TEL_CH_NUM];
+        //  Encoder used by IMU channel in TEL_ENC_DELTA encoding
+        IMUCodec    _imuCodec;
+};
+
+#endif /* ROVERKERNEL_INIT_TELEMETRY_H_ */
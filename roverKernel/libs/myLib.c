@@ -195,3 +195,25 @@ void itoa (int32_t num, uint8_t *str)
     }
 }
 
+/**
+ * Compute CRC-16/CCITT (polynomial 0x1021, MSB first) of a data block
+ * Pass 0xFFFF as [crc] for a new checksum, or result of the previous call to
+ * continue checksum over multiple blocks
+ * @param data pointer to data block
+ * @param len size of [data] block in bytes
+ * @param crc initial value of the checksum
+ * @return CRC of the data block
+ */
+uint16_t crc16 (const uint8_t *data, uint16_t len, uint16_t crc)
+{
+    uint8_t i;
+
+    while (len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+    }
+
+    return crc;
+}
@@ -40,6 +40,9 @@ int32_t stoiv (volatile uint8_t *nums, volatile uint8_t strLen);
 /*      Functions to convert number to string           */
 void    itoa (int32_t num, uint8_t *str);
 
+/*      Checksums           */
+uint16_t crc16 (const uint8_t *data, uint16_t len, uint16_t crc);
+
 #ifdef __cplusplus
 }
 #endif
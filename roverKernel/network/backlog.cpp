@@ -0,0 +1,266 @@
+/**
+ * backlog.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "network/backlog.h"
+
+#include <string.h>
+
+//  Address of a position in flash log (free-running offset)
+#define BL_FADDR(pos)   (HAL_FLASH_DATA_BASE + ((pos) % HAL_FLASH_DATA_SIZE))
+//  Size of a record with [len] bytes of data in flash, padded to whole words
+#define BL_FLEN(len)    ((BL_HDR + (uint32_t)(len) + 3) & ~3)
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+Backlog::Backlog() : _rHead(0), _rTail(0), _rCount(0), _flash(false),
+                     _fHead(0), _fTail(0), _fCount(0), _dropped(0)
+{
+    memset((void*)_fBuf, 0xFF, sizeof(_fBuf));
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Enable moving the oldest records to internal flash once RAM ring is full,
+ * instead of dropping them. Records already in flash are still read after
+ * spilling is disabled
+ * @param enable true to spill records to flash
+ */
+void Backlog::SpillToFlash(bool enable)
+{
+    _flash = enable;
+}
+
+/**
+ * Store a record, making room for it by spilling or dropping the oldest ones
+ * @param time timestamp of the record (e.g. ms since startup)
+ * @param data data of the record
+ * @param len length of data, records longer than BL_MAX_REC are dropped
+ */
+void Backlog::Store(uint32_t time, const uint8_t *data, uint16_t len)
+{
+    uint8_t hdr[BL_HDR];
+    uint16_t i;
+
+    if (len > BL_MAX_REC)
+    {
+        _dropped++;
+        return;
+    }
+
+    while ((BL_RAM_SIZE - (uint16_t)(_rHead - _rTail)) < (BL_HDR + len))
+        if (!_flash || !_Spill())
+            _RamDrop();
+
+    memcpy((void*)hdr, (void*)&time, sizeof(uint32_t));
+    memcpy((void*)(hdr + 4), (void*)&len, sizeof(uint16_t));
+    for (i = 0; i < BL_HDR; i++)
+        _ram[(uint16_t)(_rHead + i) & (BL_RAM_SIZE - 1)] = hdr[i];
+    for (i = 0; i < len; i++)
+        _ram[(uint16_t)(_rHead + BL_HDR + i) & (BL_RAM_SIZE - 1)] = data[i];
+
+    _rHead += BL_HDR + len;
+    _rCount++;
+}
+
+/**
+ * Get the oldest record without removing it
+ * @param time pointer to variable to store record's timestamp in
+ * @param data buffer to copy record's data into (BL_MAX_REC bytes)
+ * @param len pointer to variable to store length of data in
+ * @return true if a record was found, false if backlog is empty
+ */
+bool Backlog::Peek(uint32_t *time, uint8_t *data, uint16_t *len)
+{
+    if (_fCount > 0)
+    {
+        const uint8_t *rec;
+
+        _FlashSkip();
+        rec = (const uint8_t*)BL_FADDR(_fTail);
+        memcpy((void*)time, (void*)rec, sizeof(uint32_t));
+        memcpy((void*)len, (void*)(rec + 4), sizeof(uint16_t));
+        memcpy((void*)data, (void*)(rec + BL_HDR), *len);
+
+        return true;
+    }
+
+    if (_rCount == 0)
+        return false;
+
+    _RamRead(_rTail, (uint8_t*)time, sizeof(uint32_t));
+    _RamRead(_rTail + 4, (uint8_t*)len, sizeof(uint16_t));
+    _RamRead(_rTail + BL_HDR, data, *len);
+
+    return true;
+}
+
+/**
+ * Remove the oldest record
+ */
+void Backlog::Pop()
+{
+    uint16_t len;
+
+    if (_fCount > 0)
+    {
+        _FlashSkip();
+        memcpy((void*)&len, (void*)(BL_FADDR(_fTail) + 4), sizeof(uint16_t));
+        _fTail += BL_FLEN(len);
+        _fCount--;
+        return;
+    }
+
+    if (_rCount == 0)
+        return;
+
+    _RamRead(_rTail + 4, (uint8_t*)&len, sizeof(uint16_t));
+    _rTail += BL_HDR + len;
+    _rCount--;
+}
+
+/**
+ * Check if there are any records in the backlog
+ * @return true if backlog is empty
+ */
+bool Backlog::Empty()
+{
+    return ((_rCount == 0) && (_fCount == 0));
+}
+
+/**
+ * Get number of records in the backlog (in RAM & flash)
+ * @return number of records
+ */
+uint32_t Backlog::Count()
+{
+    return (_rCount + _fCount);
+}
+
+/**
+ * Get number of records lost since startup, either because the backlog was
+ * full or because they were too long
+ * @return number of records lost
+ */
+uint32_t Backlog::Dropped()
+{
+    return _dropped;
+}
+
+///-----------------------------------------------------------------------------
+///                      Private member functions                      [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Copy bytes out of RAM ring
+ * @param pos free-running position to read from
+ * @param dst buffer to copy data into
+ * @param len number of bytes to copy
+ */
+void Backlog::_RamRead(uint16_t pos, uint8_t *dst, uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+        dst[i] = _ram[(uint16_t)(pos + i) & (BL_RAM_SIZE - 1)];
+}
+
+/**
+ * Drop the oldest record in RAM ring
+ */
+void Backlog::_RamDrop()
+{
+    uint16_t len;
+
+    _RamRead(_rTail + 4, (uint8_t*)&len, sizeof(uint16_t));
+    _rTail += BL_HDR + len;
+    _rCount--;
+    _dropped++;
+}
+
+/**
+ * Move the oldest record in RAM ring to flash log. Block is erased when the
+ * log enters it, if that's the block holding the oldest records in flash they
+ * are dropped first
+ * @return true if record was moved, false on flash error
+ */
+bool Backlog::_Spill()
+{
+    uint16_t len;
+    uint32_t recLen;
+
+    _RamRead(_rTail + 4, (uint8_t*)&len, sizeof(uint16_t));
+    recLen = BL_FLEN(len);
+
+    //  Records don't cross block boundary, rest of the block is left erased
+    if (((_fHead % HAL_FLASH_BLOCK) + recLen) > HAL_FLASH_BLOCK)
+        _fHead += HAL_FLASH_BLOCK - (_fHead % HAL_FLASH_BLOCK);
+
+    if ((_fHead % HAL_FLASH_BLOCK) == 0)
+    {
+        if ((_fHead - _fTail) > (HAL_FLASH_DATA_SIZE - HAL_FLASH_BLOCK))
+            _FlashDropBlock();
+        if (HAL_FLASH_Erase(BL_FADDR(_fHead)) != HAL_OK)
+            return false;
+    }
+
+    //  Padding keeps erased value so it can be written over with no effect
+    memset((void*)_fBuf, 0xFF, recLen);
+    _RamRead(_rTail, (uint8_t*)_fBuf, BL_HDR + len);
+    if (HAL_FLASH_Write(_fBuf, BL_FADDR(_fHead), recLen) != HAL_OK)
+        return false;
+
+    _fHead += recLen;
+    _fCount++;
+    _rTail += BL_HDR + len;
+    _rCount--;
+
+    return true;
+}
+
+/**
+ * Move read position of flash log past the unused rest of a block (not enough
+ * room for a header or erased header)
+ */
+void Backlog::_FlashSkip()
+{
+    while (_fTail != _fHead)
+    {
+        uint32_t left = HAL_FLASH_BLOCK - (_fTail % HAL_FLASH_BLOCK);
+        uint16_t len;
+
+        if (left >= BL_HDR)
+        {
+            memcpy((void*)&len, (void*)(BL_FADDR(_fTail) + 4), sizeof(uint16_t));
+            if (len != BL_LEN_ERASED)
+                return;
+        }
+        _fTail += left;
+    }
+}
+
+/**
+ * Drop all records remaining in the block holding the oldest records in flash
+ */
+void Backlog::_FlashDropBlock()
+{
+    uint32_t end = _fTail - (_fTail % HAL_FLASH_BLOCK) + HAL_FLASH_BLOCK;
+    uint16_t len;
+
+    while ((end - _fTail) >= BL_HDR)
+    {
+        memcpy((void*)&len, (void*)(BL_FADDR(_fTail) + 4), sizeof(uint16_t));
+        if (len == BL_LEN_ERASED)
+            break;
+        _fTail += BL_FLEN(len);
+        _fCount--;
+        _dropped++;
+    }
+
+    _fTail = end;
+}
@@ -0,0 +1,80 @@
+/**
+ * backlog.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Store-and-forward backlog of timestamped records (e.g. telemetry frames)
+ *  kept while the network is down, to be replayed once it's back. Records are
+ *  kept in a RAM ring of BL_RAM_SIZE bytes. Once it's full the oldest records
+ *  are either dropped or, if spilling is enabled, moved to a circular log in
+ *  the data region of internal flash (HAL_FLASH_DATA_BASE). When the flash log
+ *  is full its oldest block is erased along with the records in it. Records
+ *  are always read oldest first (flash log, then RAM).
+ *  Record layout (in RAM and in flash):
+ *      time(uint32_t)|len(uint16_t)|data(len B)
+ *  In flash every record is padded to a multiple of 4 bytes and never crosses
+ *  a block boundary, unused rest of a block stays erased (reads as len 0xFFFF)
+ *  @note Content of flash log is not recovered after reset
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +RAM ring of timestamped records with optional spill to internal flash
+ */
+#include "hwconfig.h"
+
+#ifndef ROVERKERNEL_NETWORK_BACKLOG_H_
+#define ROVERKERNEL_NETWORK_BACKLOG_H_
+
+#include "HAL/hal.h"
+
+//  Size of RAM ring in bytes (power of 2)
+#define BL_RAM_SIZE     16384
+//  Size of record header and max size of record data
+#define BL_HDR          6
+#define BL_MAX_REC      1024
+//  Record length marking unused (erased) rest of a flash block
+#define BL_LEN_ERASED   0xFFFF
+
+/**
+ * Backlog class definition
+ */
+class Backlog
+{
+    public:
+        Backlog();
+
+        void        SpillToFlash(bool enable);
+        void        Store(uint32_t time, const uint8_t *data, uint16_t len);
+        bool        Peek(uint32_t *time, uint8_t *data, uint16_t *len);
+        void        Pop();
+        bool        Empty();
+        uint32_t    Count();
+        uint32_t    Dropped();
+
+    private:
+        void        _RamRead(uint16_t pos, uint8_t *dst, uint16_t len);
+        void        _RamDrop();
+        bool        _Spill();
+        void        _FlashSkip();
+        void        _FlashDropBlock();
+
+        //  RAM ring, positions are free-running counters, index is
+        //  counter & (size - 1)
+        uint8_t     _ram[BL_RAM_SIZE];
+        uint16_t    _rHead;     //  Bytes written
+        uint16_t    _rTail;     //  Bytes read
+        uint32_t    _rCount;    //  Records in RAM
+        //  Flash log, positions are free-running byte offsets into the data
+        //  region, offset is counter % HAL_FLASH_DATA_SIZE
+        bool        _flash;     //  Spilling to flash enabled
+        uint32_t    _fHead;
+        uint32_t    _fTail;
+        uint32_t    _fCount;    //  Records in flash
+        //  Record being written to flash, assembled as words
+        uint32_t    _fBuf[(BL_HDR + BL_MAX_REC + 3) / 4];
+        uint32_t    _dropped;   //  Records lost (backlog full or too long)
+};
+
+#endif /* ROVERKERNEL_NETWORK_BACKLOG_H_ */
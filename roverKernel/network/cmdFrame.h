@@ -0,0 +1,172 @@
+/**
+ * cmdFrame.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Binary command frame received on the commands data stream. Replaces the
+ *  text format (sender:libUID:serviceID:time:period:repeats:argLen::args) for
+ *  clients that support it; frame is validated and scheduled directly from
+ *  the socket's receive buffer without converting any of the fields from
+ *  strings. All multi-byte fields are little-endian.
+ *  Frame layout:
+ *      header(8B)|command|command|...
+ *      header:  magic(2B, 0xA5 0x5A)|version(1B)|seq(1B)|len(uint16_t)|crc(uint16_t)
+ *               len - size of the payload following the header
+ *               crc - CRC-16/CCITT (init 0xFFFF) of the payload, see crc16()
+ *      command: libUID(1B)|serviceID(1B)|time(int32_t)|period(int32_t)|
+ *               repeats(int32_t)|argLen(uint16_t)|args(argLen B)
+ *  Meaning of time/period/repeats is the same as in TaskScheduler::SyncTaskPer
+ *  Payload holds up to CMDF_MAX_CMDS commands back-to-back. Commands from one
+ *  frame are scheduled all-or-none: if any of them is invalid none is
+ *  scheduled, if task scheduler fails to add one of them the ones already
+ *  added are removed again.
+ *  Every binary frame is answered with a response frame using the same header
+ *  (seq copied from the command frame) and the following payload:
+ *      status(1B)|count(1B)|count x (status(1B)|PID(uint16_t))
+ *      status - frame status, one of CMDF_ST_* macros
+ *      count  - number of commands found in the frame, followed by status and
+ *               PID assigned by the task scheduler for each of them (PID is 0
+ *               if command wasn't scheduled)
+ *
+ *  @version 1.1.1
+ *  V1.1.1 - 19.10.2026
+ *  +Commands already scheduled are removed if task scheduler fails to add one
+ *  of the batch (CMDF_ST_SCHED_ERR)
+ *  V1.1.0 - 19.10.2026
+ *  +Multiple commands per frame, scheduled atomically
+ *  +Response frame with status & PID of each command
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Binary command frame definition & in-place validation
+ */
+
+#ifndef ROVERKERNEL_NETWORK_CMDFRAME_H_
+#define ROVERKERNEL_NETWORK_CMDFRAME_H_
+
+#include <stdint.h>
+#include <string.h>
+
+//  First two bytes of every binary frame, can't appear at the beginning of
+//  a text frame which starts with printable sender ID
+#define CMDF_MAGIC0         0xA5
+#define CMDF_MAGIC1         0x5A
+//  Version of the frame format implemented here
+#define CMDF_VERSION        1
+
+//  Size of frame header and of fixed part of the command
+#define CMDF_HDR_LEN        8
+#define CMDF_CMD_LEN        16
+
+//  Maximum number of commands in a single frame
+#define CMDF_MAX_CMDS       32
+//  Size of response payload entry and maximum size of whole response frame
+#define CMDF_RESP_ENTRY     3
+#define CMDF_RESP_MAX       (CMDF_HDR_LEN + 2 + CMDF_MAX_CMDS*CMDF_RESP_ENTRY)
+
+/**     Status codes of a frame and of individual commands in response     */
+#define CMDF_ST_OK          0   //  Scheduled
+#define CMDF_ST_ARG_ERR     1   //  Malformed command or unknown kernel module
+#define CMDF_ST_ABORTED     2   //  Valid, but not scheduled because another
+                                //  command in the same frame is invalid or
+                                //  couldn't be scheduled
+#define CMDF_ST_CRC_ERR     3   //  (Frame only) CRC or length mismatch
+#define CMDF_ST_VER_ERR     4   //  (Frame only) Unsupported frame version
+#define CMDF_ST_TOO_MANY    5   //  (Frame only) More than CMDF_MAX_CMDS commands
+#define CMDF_ST_SCHED_ERR   6   //  Valid, but task scheduler couldn't add it
+                                //  (out of memory)
+
+/**
+ * Header of a binary command frame
+ */
+struct _cmdHeader
+{
+    uint8_t  version;
+    uint8_t  seq;       //  Sequence number set by sender, echoed in reply
+    uint16_t len;       //  Length of payload following the header
+    uint16_t crc;       //  CRC-16 of the payload
+};
+
+/**
+ * Single command from the payload of a binary command frame. [args] points
+ * into the receive buffer the frame was decoded from.
+ */
+struct _cmdEntry
+{
+    uint8_t  libUID;
+    uint8_t  serviceID;
+    int32_t  time;
+    int32_t  period;
+    int32_t  repeats;
+    uint16_t argLen;
+    const uint8_t *args;
+};
+
+/**
+ * Check if buffer starts with a binary command frame
+ * @param buf received data
+ * @param len size of [buf]
+ * @return true if [buf] starts with magic bytes of a binary frame
+ */
+inline bool CMDF_IsBinary(const uint8_t *buf, uint16_t len)
+{
+    return (len >= 2) && (buf[0] == CMDF_MAGIC0) && (buf[1] == CMDF_MAGIC1);
+}
+
+/**
+ * Decode header of a binary command frame
+ * @param buf received data, starting with magic bytes
+ * @param hdr[out] decoded header
+ */
+inline void CMDF_GetHeader(const uint8_t *buf, struct _cmdHeader *hdr)
+{
+    hdr->version = buf[2];
+    hdr->seq = buf[3];
+    memcpy((void*)&(hdr->len), (void*)(buf + 4), sizeof(uint16_t));
+    memcpy((void*)&(hdr->crc), (void*)(buf + 6), sizeof(uint16_t));
+}
+
+/**
+ * Encode header of a frame
+ * @param buf buffer to write header to (CMDF_HDR_LEN bytes)
+ * @param hdr header to encode, magic bytes are added automatically
+ */
+inline void CMDF_PutHeader(uint8_t *buf, const struct _cmdHeader *hdr)
+{
+    buf[0] = CMDF_MAGIC0;
+    buf[1] = CMDF_MAGIC1;
+    buf[2] = hdr->version;
+    buf[3] = hdr->seq;
+    memcpy((void*)(buf + 4), (void*)&(hdr->len), sizeof(uint16_t));
+    memcpy((void*)(buf + 6), (void*)&(hdr->crc), sizeof(uint16_t));
+}
+
+/**
+ * Decode a single command from the payload of a binary frame
+ * @param buf pointer to the beginning of the command in the payload
+ * @param len number of payload bytes left from [buf]
+ * @param cmd[out] decoded command, its args point into [buf]
+ * @return number of bytes the command takes in the payload, 0 if the command
+ * is truncated
+ */
+inline uint16_t CMDF_GetCommand(const uint8_t *buf, uint16_t len,
+                                struct _cmdEntry *cmd)
+{
+    if (len < CMDF_CMD_LEN)
+        return 0;
+
+    cmd->libUID = buf[0];
+    cmd->serviceID = buf[1];
+    memcpy((void*)&(cmd->time), (void*)(buf + 2), sizeof(int32_t));
+    memcpy((void*)&(cmd->period), (void*)(buf + 6), sizeof(int32_t));
+    memcpy((void*)&(cmd->repeats), (void*)(buf + 10), sizeof(int32_t));
+    memcpy((void*)&(cmd->argLen), (void*)(buf + 14), sizeof(uint16_t));
+    cmd->args = buf + CMDF_CMD_LEN;
+
+    if ((len - CMDF_CMD_LEN) < cmd->argLen)
+        return 0;
+
+    return CMDF_CMD_LEN + cmd->argLen;
+}
+
+#endif /* ROVERKERNEL_NETWORK_CMDFRAME_H_ */
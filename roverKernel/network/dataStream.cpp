@@ -11,6 +11,8 @@
 
 #include "libs/myLib.h"
 #include "esp8266/esp8266.h"
+#include "network/netMux.h"
+#include "network/backlog.h"
 
 //  Enable debug information printed on serial port
 //#define __DEBUG_SESSION__
@@ -26,6 +28,14 @@
 #include "serialPort/uartHW.h"
 #endif
 
+//  Deadline of coalesced writes is measured in ms since startup as kept by
+//  task scheduler, without it buffer is flushed only when full or on Flush()
+#if defined(__USE_TASK_SCHEDULER__)
+#define DS_NOW()        ((uint32_t)msSinceStartup)
+#else
+#define DS_NOW()        0
+#endif  /* __USE_TASK_SCHEDULER__ */
+
 
 #if defined(__USE_TASK_SCHEDULER__)
 /*
@@ -55,25 +65,47 @@ void _DATAS_KernelCallback(void)
     switch (_dsKer.serviceID)
     {
     /*
-     * Keep-alive event, check if the socket is still alive, if not try to reconnect
+     * Keep-alive event, check if the socket is still alive, if not try to
+     * reconnect (without blocking, with backoff between failed attempts)
      * args[] = pointerToDatastreamObject(DataStream*)
-     * retVal ESP library error code (if > 5); or socket ID (if <=5)
+     * retVal none
      */
     case DATAS_T_KA:
         {
             //  Pointer is encoded into integer number
             uint32_t ptr = 0;
             memcpy(&ptr, (void*)_dsKer.args, 4);
-            DataStream *ds = (DataStream*)ptr;
 
-            _espClient *socket = ESP8266::GetI().GetClientBySockID(ds->socketID);
+            ((DataStream*)ptr)->_KeepAlive();
+        }
+        break;
+    /*
+     * Flush coalescing buffer of a data stream if the oldest write in it has
+     * been waiting longer than stream's deadline
+     * args[] = pointerToDatastreamObject(DataStream*)
+     * retVal none
+     */
+    case DATAS_T_FLUSH:
+        {
+            //  Pointer is encoded into integer number
+            uint32_t ptr = 0;
+            memcpy(&ptr, (void*)_dsKer.args, 4);
+
+            ((DataStream*)ptr)->_Poll();
+        }
+        break;
+    /*
+     * Move data queued on channels of a network multiplexer to its link
+     * args[] = pointerToMultiplexerObject(NetMux*)
+     * retVal none
+     */
+    case DATAS_T_MUX:
+        {
+            //  Pointer is encoded into integer number
+            uint32_t ptr = 0;
+            memcpy(&ptr, (void*)_dsKer.args, 4);
 
-            /*
-             * If socket has been closed GetClientBySockID returns 0. To reopen
-             * it we just call BindToScoketID as it already handles that
-             */
-            if (socket == 0)
-                ds->BindToSocketID(ds->socketID);
+            ((NetMux*)ptr)->_Pump();
         }
         break;
     default:
@@ -98,16 +130,44 @@ void DataStream_InitHW()
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor                 [PUBLIC]
 ///-----------------------------------------------------------------------------
-DataStream::DataStream(): socketID(0), _port(0), _socket(0), _keepAlive(false)
+DataStream::DataStream(): socketID(0), _port(0), _socket(0), _keepAlive(false),
+                          _conn(DS_CONN_DOWN), _connHandle(0), _connSince(0),
+                          _connNext(0), _connTry(0), _connWasUp(false),
+                          _buffered(false), _udp(false), _seq(0),
+                          _coalesce(false), _policy(DS_DROP_NEWEST),
+                          _deadline(DS_DEADLINE), _flushTask(false), _cLen(0),
+                          _cFrameN(0), _cSince(0), _dropped(0), _framing(false),
+                          _crc(false), _hook(0), _rxErrors(0), _mux(0),
+                          _muxCh(0), _backlog(0), _blRate(DS_REPLAY_RATE),
+                          _blCredit(0), _blLast(0), _liveTimeout(0),
+                          _liveLast(0), _hbLast(0), _liveHeard(false)
 {
     memset((void*)_serverip, 0, sizeof(_serverip));
+    memset((void*)&_cStats, 0, sizeof(_cStats));
+    _cStats.backoff = DS_BACKOFF_MIN;
+    //  Seed jitter with object's address so streams don't retry in lock-step
+    _rnd = (uint32_t)this | 1;
+    _RxReset();
 }
 
 DataStream::DataStream(uint8_t *ip, uint16_t port)
-    : socketID(0), _port(port), _socket(0), _keepAlive(false)
+    : socketID(0), _port(port), _socket(0), _keepAlive(false),
+      _conn(DS_CONN_DOWN), _connHandle(0), _connSince(0), _connNext(0),
+      _connTry(0), _connWasUp(false), _buffered(false), _udp(false), _seq(0), _coalesce(false), _policy(DS_DROP_NEWEST),
+      _deadline(DS_DEADLINE), _flushTask(false), _cLen(0), _cFrameN(0),
+      _cSince(0), _dropped(0), _framing(false), _crc(false), _hook(0),
+      _rxErrors(0), _mux(0), _muxCh(0), _backlog(0), _blRate(DS_REPLAY_RATE),
+      _blCredit(0), _blLast(0), _liveTimeout(0), _liveLast(0), _hbLast(0),
+      _liveHeard(false)
 {
     uint8_t i;
 
+    memset((void*)&_cStats, 0, sizeof(_cStats));
+    _cStats.backoff = DS_BACKOFF_MIN;
+    //  Seed jitter with object's address so streams don't retry in lock-step
+    _rnd = (uint32_t)this | 1;
+    _RxReset();
+
     //  Find ip address length
     for (i = 0; ip[i] != 0; i++);
     memcpy((void*)_serverip, (void*)ip, i);
@@ -121,6 +181,11 @@ DataStream::~DataStream()
         uint32_t arg = (uint32_t)this;
         TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_KA, (void*)&arg, sizeof(uint32_t));
     }
+    if (_flushTask)
+    {
+        uint32_t arg = (uint32_t)this;
+        TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_FLUSH, (void*)&arg, sizeof(uint32_t));
+    }
     //  Close the socket before deleting data stream
     _socket->Close();
 }
@@ -134,11 +199,14 @@ DataStream::~DataStream()
  * binds it, if it doesn't it attempts to open it with first free ID and bind
  * data stream to that ID. Socket id bound to this stream is saved internally
  * and returned from this function.
+ * Once keep-alive task is scheduled socket is never opened from this function
+ * (opening blocks until the server responds), it's opened in background by the
+ * keep-alive task instead
  * @param sockID socket ID as returned from ESP chip (0 - 4) of a socket to bind to
  * @param sched  true if we want to schedule keep-alive task from this call
  * @return socket ID to which data stream was eventually bound,
  *         111 if ESP is not connected to AP
- *         127 if cannot open socket
+ *         127 if cannot open socket (or it's being opened by keep-alive task)
  *         222 if no IP has been provided for TCP connection
  */
 uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
@@ -146,8 +214,9 @@ uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
 #if defined(__USE_TASK_SCHEDULER__)
     if (!_keepAlive && sched)
     {
-    //  Schedule periodic check for health of the underlying socket, period 4s
-    TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_KA, -4000, 4000, T_PERIODIC);
+    //  Schedule periodic check for health of the underlying socket
+    TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_KA, -DS_KA_PERIOD,
+                                      DS_KA_PERIOD, T_PERIODIC);
     TaskScheduler::GetI().AddArg<uint32_t>((uint32_t)this);
     _keepAlive = true;
     }
@@ -176,9 +245,20 @@ uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
             socketID = sockID;
             return 222;
         }
+        //  Leave it to keep-alive task to open the socket without blocking
+        if (_keepAlive)
+        {
+            socketID = sockID;
+            return 127;
+        }
         //  Attempt to open the socket and check for error codes (> max clients)
         uint32_t status;
-        status = ESP8266::GetI().OpenTCPSock((char*)_serverip, _port, 1, sockID);
+        if (_udp)
+            status = ESP8266::GetI().OpenUDPSock((char*)_serverip, _port, 0,
+                                                 sockID);
+        else
+            status = ESP8266::GetI().OpenTCPSock((char*)_serverip, _port, 1,
+                                                 sockID);
         if (status < ESP_MAX_CLI)
             socketID = status;
         else
@@ -189,32 +269,469 @@ uint8_t DataStream::BindToSocketID(uint8_t sockID, bool sched)
         }
 
         //  Get reference to opened socket
-        _socket = ESP8266::GetI().GetClientBySockID(sockID);
+        _socket = ESP8266::GetI().GetClientBySockID(socketID);
     }
+    //  Socket ID might have changed, carry send mode over to it
+    if (_conn != DS_CONN_UP)
+        _ConnUp(DS_NOW());
     //  As a confirmation return socket id
     return socketID;
 }
 
 /**
  * Send either a null terminated string with no buffer len, or any string of a
- * certain length through the stream. Function checks whether the bounded socket
- * is still alive, if not tries to reopen it.
+ * certain length through the stream.
+ * Data is only queued for sending and function returns immediately, outcome of
+ * the send is reported by ESP library (send hook & event logger)
+ * In UDP mode data is sent as a single datagram with DS_UDP_HDR_LEN header
+ * In coalescing mode (see Coalesce()) data is appended to stream's buffer and
+ * is sent together with other writes once the buffer is flushed
+ * With framing enabled (see Framing()) data is sent as a single message
+ * When carried by a multiplexer (see UseMux()) data is queued on its channel
+ * as a single message, other send modes don't apply
  * @note Wrapper for low-level espClient:: function
  * @param buffer
  * @param bufferLen
- * @param reopen set if true function also tries to reopen socket if it's closed
- * @return error-code, one of STATUS_* macros from myLib.h
+ * @param reopen unused, socket is reopened by keep-alive task
+ * @return error-code, one of STATUS_* macros from myLib.h (STATUS_OK if data
+ * is queued for sending) or, in coalescing mode, one of DS_STATUS_* macros
  */
 uint32_t DataStream::Send(uint8_t *buffer, uint16_t bufferLen, bool reopen)
 {
-    uint32_t retVal = ESP_STATUS_ERROR;
+    uint8_t hdr[DS_FRAME_HDR], hdrLen = 0;
+
+    if (bufferLen == 0)
+        bufferLen = strlen((char*)buffer);
+
+    //  Multiplexer keeps message boundaries & does its own buffering
+    if (_mux != 0)
+        return _mux->Send(_muxCh, buffer, bufferLen);
+
+    //  Keep the write until the connection is back, keep-alive task replays it
+    if ((_backlog != 0) && _keepAlive && (_conn != DS_CONN_UP))
+    {
+        _backlog->Store(DS_NOW(), buffer, bufferLen);
+        return DS_STATUS_STORED;
+    }
+
+    if (_framing && (bufferLen > DS_FRAME_MAX))
+        return STATUS_ARG_ERR;
+    hdrLen = _FrameHdr(hdr, buffer, bufferLen);
+
+    if (_coalesce)
+        return _Coalesce(hdr, hdrLen, buffer, bufferLen);
+
+    return _SendChunk(hdr, hdrLen, buffer, bufferLen);
+}
+
+/**
+ * Flush coalescing buffer: queue all buffered writes on the socket as a single
+ * send (single datagram in UDP mode)
+ * Buffer is only flushed if the socket has space for the whole chunk,
+ * otherwise data stays buffered and is flushed later
+ * @return STATUS_OK if buffer is empty, DS_STATUS_DOWN or DS_STATUS_FULL if
+ * data is still buffered because the socket is closed or its queue is full
+ */
+uint32_t DataStream::Flush()
+{
+    if (_cLen == 0)
+        return STATUS_OK;
+
+    _socket = ESP8266::GetI().GetClientBySockID(socketID);
+    if (_socket == 0)
+        return DS_STATUS_DOWN;
+    //  Don't let ESP library reject the send (and count it as dropped)
+    if (_socket->TxFree() < (_cLen + (_udp ? DS_UDP_HDR_LEN : 0)))
+        return DS_STATUS_FULL;
+    if (_SendChunk(0, 0, _cBuf, _cLen) != STATUS_OK)
+        return DS_STATUS_FULL;
+
+    _cLen = 0;
+    _cFrameN = 0;
+
+    return STATUS_OK;
+}
+
+/**
+ * Enable coalescing of writes made through Send()
+ * Writes are collected into chunks of up to DS_MTU bytes which are queued on
+ * the socket when the next write doesn't fit, when the oldest write has been
+ * waiting for [deadlineMS] or when Flush() is called. This replaces a number
+ * of small sends (each costing a full AT+CIPSEND exchange) with a few large
+ * ones. If the socket can't take the data (closed or its queue is full) writes
+ * stay buffered until the buffer is full, after which [policy] decides which
+ * writes are dropped.
+ * @param enable true to coalesce writes, false to send each one right away
+ * (anything left in the buffer is flushed or, if that fails, dropped)
+ * @param deadlineMS max time in ms a write waits in the buffer
+ * @param policy what to drop when buffer is full, one of DS_DROP_* macros
+ */
+void DataStream::Coalesce(bool enable, uint32_t deadlineMS, uint8_t policy)
+{
+    if (!enable && _coalesce)
+    {
+        Flush();
+        _dropped += _cFrameN;
+        _cLen = 0;
+        _cFrameN = 0;
+    }
+
+    _coalesce = enable;
+    _deadline = deadlineMS;
+    _policy = policy;
+
+#if defined(__USE_TASK_SCHEDULER__)
+    //  Reschedule deadline check with the new period
+    if (_flushTask)
+    {
+        uint32_t arg = (uint32_t)this;
+        TaskScheduler::GetP()->RemoveTask(DATAS_UID, DATAS_T_FLUSH, (void*)&arg, sizeof(uint32_t));
+        _flushTask = false;
+    }
+    if (enable)
+    {
+        //  Check twice per deadline so no write waits much longer than it
+        int32_t period = (deadlineMS > 1) ? (deadlineMS / 2) : 1;
+
+        TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_FLUSH, -period,
+                                          period, T_PERIODIC);
+        TaskScheduler::GetI().AddArg<uint32_t>((uint32_t)this);
+        _flushTask = true;
+    }
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Get number of writes dropped by coalescing buffer since startup
+ * @return number of dropped writes
+ */
+uint32_t DataStream::Dropped()
+{
+    return _dropped;
+}
+
+/**
+ * Enable framing of messages sent & received on the stream (see DS_FRAME_MAX
+ * in dataStream.h for the format). With framing every Send() is delivered to
+ * the other side as exactly one message, regardless of how the transport
+ * splits or merges it, and received data has to be passed through Feed().
+ * Any partially received message is dropped.
+ * @param enable true to frame messages, false to send/receive raw data
+ * @param crc true to add CRC to every message and check it on received ones
+ */
+void DataStream::Framing(bool enable, bool crc)
+{
+    _framing = enable;
+    _crc = crc;
+    _RxReset();
+}
+
+/**
+ * Register hook called once for every message received on the stream (see
+ * Feed()). Message is only valid until the hook returns.
+ * @param funPoint pointer to function taking pointer to the message & its size
+ */
+void DataStream::AddHook(void((*funPoint)(const uint8_t*, const uint16_t)))
+{
+    _hook = funPoint;
+}
+
+/**
+ * Process data received on the socket bound to the stream
+ * Data is split into messages and the hook (AddHook()) is called for each
+ * complete one: a single segment can carry several messages and a message can
+ * be split across several segments, its beginning is then kept in stream's
+ * reassembly buffer until the rest of it arrives. Messages contained in a
+ * single segment are passed to the hook in place, without copying.
+ * Without framing the whole segment is passed to the hook as one message.
+ * @param data received data (e.g. payload of +IPD message)
+ * @param len size of [data]
+ * @return number of complete messages delivered to the hook
+ */
+uint16_t DataStream::Feed(const uint8_t *data, uint16_t len)
+{
+    uint16_t i = 0, msgs = 0;
+
+    if (!_framing)
+    {
+        if ((_hook != 0) && (len > 0))
+            _hook(data, len);
+        return (len > 0);
+    }
+
+    while (i < len)
+    {
+        switch (_rState)
+        {
+        case DS_RX_LEN:
+            _rLen |= (uint16_t)(data[i] & 0x7F) << _rShift;
+            _rShift += 7;
+            //  Continuation bit, length has more bytes
+            if (data[i++] & 0x80)
+            {
+                if (_rShift < 14)
+                    break;
+                _rLen = DS_FRAME_MAX + 1;
+            }
+            //  Length can't be trusted, neither can anything following it in
+            //  this segment
+            if (_rLen > DS_FRAME_MAX)
+            {
+                _rxErrors++;
+                _RxReset();
+                return msgs;
+            }
+            _rHave = 0;
+            _rState = _crc ? DS_RX_CRC : DS_RX_DATA;
+            break;
+        case DS_RX_CRC:
+            _rCRC |= (uint16_t)data[i++] << (8 * _rHave);
+            if (++_rHave == sizeof(uint16_t))
+            {
+                _rHave = 0;
+                _rState = DS_RX_DATA;
+            }
+            break;
+        case DS_RX_DATA:
+            //  Whole message is in this segment, deliver it in place
+            if ((_rHave == 0) && ((len - i) >= _rLen))
+            {
+                i += _rLen;
+                msgs += _Deliver(data + i - _rLen);
+            }
+            else
+            {
+                uint16_t n = _rLen - _rHave;
+
+                if (n > (len - i))
+                    n = len - i;
+                memcpy((void*)(_rBuf + _rHave), (void*)(data + i), n);
+                _rHave += n;
+                i += n;
+                if (_rHave == _rLen)
+                {
+                    _rBuf[_rLen] = '\0';
+                    msgs += _Deliver(_rBuf);
+                }
+            }
+            break;
+        default:
+            _RxReset();
+            break;
+        }
+    }
+
+    //  Message with empty payload has no data to wait for
+    if ((_rState == DS_RX_DATA) && (_rLen == 0))
+        msgs += _Deliver(_rBuf);
+
+    return msgs;
+}
+
+/**
+ * Get number of received frames dropped because of invalid length or CRC
+ * @return number of dropped frames since startup
+ */
+uint32_t DataStream::RxErrors()
+{
+    return _rxErrors;
+}
+
+/**
+ * Get statistics of stream's connection to the server
+ * @param stats pointer to structure to fill
+ */
+void DataStream::ConnStats(struct _dsConnStats *stats)
+{
+    uint32_t now = DS_NOW();
+
+    memcpy((void*)stats, (void*)&_cStats, sizeof(_cStats));
+    stats->state = _conn;
+    stats->since = now - _connSince;
+    //  Include current connection in total uptime
+    if (_conn == DS_CONN_UP)
+        stats->uptime += stats->since;
+}
+
+/**
+ * Carry the stream as a channel of network multiplexer instead of its own
+ * socket. Stream's socket is closed and is no longer kept alive; everything
+ * sent through the stream is queued on the multiplexer's channel. Messages
+ * received on the channel are delivered to the multiplexer's hook of that
+ * channel (see NetMux::AddHook), not to the stream's one.
+ * @param mux multiplexer to use, 0 to go back to stream's own socket (reopened
+ * by keep-alive task)
+ * @param chan channel of the multiplexer, one of NMUX_CH_* macros
+ */
+void DataStream::UseMux(NetMux *mux, uint8_t chan)
+{
+    _espClient *socket = ESP8266::GetI().GetClientBySockID(socketID);
+    uint32_t now = DS_NOW();
+
+    if ((mux != 0) && (socket != 0))
+        socket->Close();
+    if (_conn == DS_CONN_UP)
+        _cStats.uptime += now - _connSince;
+
+    _mux = mux;
+    _muxCh = chan;
+    _conn = DS_CONN_DOWN;
+    _connSince = now;
+    _connNext = now;
+}
+
+/**
+ * Get free space in send queue of stream's socket
+ * @return number of bytes that can be queued, 0 if socket isn't open or the
+ * stream is carried by a multiplexer
+ */
+uint16_t DataStream::TxFree()
+{
+    if (_mux != 0)
+        return 0;
+
+    _socket = ESP8266::GetI().GetClientBySockID(socketID);
+    if (_socket == 0)
+        return 0;
+
+    return _socket->TxFree();
+}
+
+/**
+ * Keep writes made while the connection is down in a backlog instead of
+ * losing them (see DS_REPLAY_RATE for the replay format). Once the connection
+ * is back the backlog is replayed, oldest first, at [rate] bytes/s next to the
+ * live writes. Requires the stream to be kept alive (BindToSocketID with
+ * sched = true) and doesn't apply while the stream is carried by multiplexer.
+ * Stream in UDP mode needs liveness check (Liveness()) as well, its socket is
+ * never lost just because the server is unreachable
+ * @param backlog backlog to store writes in, 0 to stop storing them (records
+ * already in the backlog are no longer replayed)
+ * @param rate max replay rate in bytes/s
+ */
+void DataStream::StoreForward(Backlog *backlog, uint32_t rate)
+{
+    _backlog = backlog;
+    _blRate = rate;
+    _blCredit = 0;
+    _blLast = DS_NOW();
+}
+
+/**
+ * Enable liveness check of a stream in UDP mode (see DS_HB_MSG). Stream then
+ * counts as up only while the server echoes heartbeats, until the first echo
+ * it counts as down
+ * @param timeoutMS max time without an echo in ms, 0 to disable the check
+ * (stream is up whenever its socket is open)
+ */
+void DataStream::Liveness(uint32_t timeoutMS)
+{
+    _liveTimeout = timeoutMS;
+    _liveHeard = false;
+    //  First heartbeat goes out on the next keep-alive pass
+    _hbLast = DS_NOW() - DS_HB_PERIOD;
+}
+
+/**
+ * Check data received on stream's socket for heartbeat echoed by the server
+ * and note the time it was received
+ * @param data received data
+ * @param len length of [data]
+ * @return true if [data] is a heartbeat, false otherwise
+ */
+bool DataStream::Heartbeat(const uint8_t *data, uint16_t len)
+{
+    if ((len != DS_HB_LEN) || (memcmp((void*)data, (void*)DS_HB_MSG,
+                                      DS_HB_LEN) != 0))
+        return false;
+
+    _liveLast = DS_NOW();
+    _liveHeard = true;
+
+    return true;
+}
+
+/**
+ * Select send mode of the stream
+ * In buffered mode data is handed to ESP's send buffer and the next frame can
+ * be sent without waiting for the server to acknowledge the previous one,
+ * which suits high-rate streams (telemetry). ESP library falls back to regular
+ * send if the ESP firmware doesn't support it.
+ * @param enable true to use buffered send, false for regular send
+ */
+void DataStream::SendBuffered(bool enable)
+{
+    _buffered = enable;
+    ESP8266::GetI().SendBuffered(socketID, enable);
+}
+
+/**
+ * Select transport of the stream. Has to be called before the stream is bound
+ * to a socket (BindToSocketID), already opened socket is not reopened.
+ * @param enable true to send data as UDP datagrams, false to use TCP
+ */
+void DataStream::UseUDP(bool enable)
+{
+    _udp = enable;
+}
+
+/**
+ * Receive data from the stream (if there's any)
+ * @note Wrapper for low-level espClient:: function
+ * @param buffer
+ * @param bufferLen
+ * @return true: if new data was put into buffer, false otherwise
+ */
+bool DataStream::Receive(uint8_t *buffer, uint16_t *bufferLen)
+{
+    //  Check if the socket is still opened, if it isn't there's no use in
+    //  reopening it as there will be no new data to read; so just return
+    _socket = ESP8266::GetI().GetClientBySockID(socketID);
+    if (_socket == 0)
+        return false;
+
+    //  Fetch the oldest message (if any) and save it into a buffer
+    return _socket->Receive((char*)buffer, bufferLen);
+}
+
+
+///-----------------------------------------------------------------------------
+///                      Private member functions                      [PRIVATE]
+///-----------------------------------------------------------------------------
 
+/**
+ * Queue data on the socket bound to the stream as a single send
+ * @param hdr header to put in front of data (frame header), can be 0 if
+ * [hdrLen] is 0
+ * @param hdrLen size of [hdr]
+ * @param buffer data to send
+ * @param bufferLen size of [buffer]
+ * @return STATUS_OK if data is queued for sending, STATUS_PROG_ERR otherwise
+ */
+uint32_t DataStream::_SendChunk(const uint8_t *hdr, uint8_t hdrLen,
+                                const uint8_t *buffer, uint16_t bufferLen)
+{
+    uint32_t retVal = ESP_STATUS_ERROR;
+    uint8_t udpHdr[DS_UDP_HDR_LEN + DS_FRAME_HDR];
 
     _socket = ESP8266::GetI().GetClientBySockID(socketID);
 
+    if (_udp)
+    {
+        //  Number every datagram, even if it doesn't make it into the queue
+        memcpy((void*)udpHdr, (void*)&_seq, sizeof(_seq));
+        if (hdrLen > 0)
+            memcpy((void*)(udpHdr + DS_UDP_HDR_LEN), (void*)hdr, hdrLen);
+        _seq++;
+        if ((_socket != 0) &&
+            (_socket->SendAsync(udpHdr, DS_UDP_HDR_LEN + hdrLen,
+                                (char*)buffer, bufferLen) != 0))
+            retVal = ESP_STATUS_OK;
+    }
     //  Check if the socket is still opened
-    if (_socket != 0)
-        retVal = _socket->SendTCP((char*)buffer, bufferLen);
+    else if ((_socket != 0) &&
+             (_socket->SendAsync(hdr, hdrLen, (char*)buffer, bufferLen) != 0))
+        retVal = ESP_STATUS_OK;
     //  If it isn't try to reopen it; if succeeded, send data
 //    else
 //    {
@@ -243,31 +760,414 @@ uint32_t DataStream::Send(uint8_t *buffer, uint16_t bufferLen, bool reopen)
 }
 
 /**
- * Receive data from the stream (if there's any)
- * @note Wrapper for low-level espClient:: function
- * @param buffer
- * @param bufferLen
- * @return true: if new data was put into buffer, false otherwise
+ * Append a write to coalescing buffer, flushing the buffer if the write
+ * doesn't fit or if the deadline of buffered writes has passed
+ * @param hdr header to put in front of data (frame header), can be 0 if
+ * [hdrLen] is 0
+ * @param hdrLen size of [hdr]
+ * @param buffer data to send
+ * @param bufferLen size of [buffer]
+ * @return STATUS_OK if data is buffered/queued, DS_STATUS_FULL if it was
+ * dropped, DS_STATUS_DROPPED if older writes were dropped to make room for it
+ * or DS_STATUS_DOWN if it's buffered but the socket isn't open
  */
-bool DataStream::Receive(uint8_t *buffer, uint16_t *bufferLen)
+uint32_t DataStream::_Coalesce(const uint8_t *hdr, uint8_t hdrLen,
+                               const uint8_t *buffer, uint16_t bufferLen)
+{
+    uint16_t cap = DS_MTU - (_udp ? DS_UDP_HDR_LEN : 0),
+             frameLen = hdrLen + bufferLen;
+    uint32_t retVal = STATUS_OK;
+
+    //  Write larger than a chunk is sent on its own, but only once everything
+    //  buffered before it is out so the order is kept
+    if (frameLen > cap)
+    {
+        if (Flush() != STATUS_OK)
+        {
+            if (_policy == DS_DROP_NEWEST)
+            {
+                _dropped++;
+                return DS_STATUS_FULL;
+            }
+            _dropped += _cFrameN;
+            _cLen = 0;
+            _cFrameN = 0;
+            retVal = DS_STATUS_DROPPED;
+        }
+        if (_SendChunk(hdr, hdrLen, buffer, bufferLen) != STATUS_OK)
+        {
+            _dropped++;
+            return (_socket == 0) ? DS_STATUS_DOWN : DS_STATUS_FULL;
+        }
+        return retVal;
+    }
+
+    //  Write doesn't fit next to the buffered ones, send them first
+    if (((_cLen + frameLen) > cap) || (_cFrameN >= DS_MAX_FRAMES))
+        Flush();
+
+    //  Socket can't take them yet, buffer is full
+    if (((_cLen + frameLen) > cap) || (_cFrameN >= DS_MAX_FRAMES))
+    {
+        uint16_t drop = 0;
+        uint8_t n = 0;
+
+        if (_policy == DS_DROP_NEWEST)
+        {
+            _dropped++;
+            return DS_STATUS_FULL;
+        }
+
+        //  Discard as many of the oldest writes as needed to make room
+        while ((n < _cFrameN) && (((_cLen - drop + frameLen) > cap) ||
+                                  ((_cFrameN - n) >= DS_MAX_FRAMES)))
+            drop += _cFrame[n++];
+        memmove((void*)_cBuf, (void*)(_cBuf + drop), _cLen - drop);
+        memmove((void*)_cFrame, (void*)(_cFrame + n),
+                (_cFrameN - n) * sizeof(uint16_t));
+        _cLen -= drop;
+        _cFrameN -= n;
+        _dropped += n;
+        retVal = DS_STATUS_DROPPED;
+    }
+
+    if (_cLen == 0)
+        _cSince = DS_NOW();
+    memcpy((void*)(_cBuf + _cLen), (void*)hdr, hdrLen);
+    memcpy((void*)(_cBuf + _cLen + hdrLen), (void*)buffer, bufferLen);
+    _cLen += frameLen;
+    _cFrame[_cFrameN++] = frameLen;
+
+    //  Send right away if the chunk is full or the oldest write is due
+    if ((_cLen >= cap) || ((DS_NOW() - _cSince) >= _deadline))
+        Flush();
+
+    //  Data is buffered but doesn't leave the rover
+    if ((retVal == STATUS_OK) &&
+        (ESP8266::GetI().GetClientBySockID(socketID) == 0))
+        retVal = DS_STATUS_DOWN;
+
+    return retVal;
+}
+
+/**
+ * Build message framing header of a write (nothing if framing is disabled)
+ * @param hdr buffer of at least DS_FRAME_HDR bytes to write header into
+ * @param buffer data of the write
+ * @param bufferLen length of data, at most DS_FRAME_MAX bytes
+ * @return length of the header
+ */
+uint8_t DataStream::_FrameHdr(uint8_t *hdr, const uint8_t *buffer,
+                              uint16_t bufferLen)
+{
+    uint16_t len = bufferLen;
+    uint8_t hdrLen = 0;
+
+    if (!_framing)
+        return 0;
+
+    //  Prefix message with its length (varint) and CRC
+    do
+    {
+        hdr[hdrLen] = len & 0x7F;
+        len >>= 7;
+        if (len > 0)
+            hdr[hdrLen] |= 0x80;
+        hdrLen++;
+    }
+    while (len > 0);
+
+    if (_crc)
+    {
+        uint16_t crc = crc16(buffer, bufferLen, 0xFFFF);
+
+        memcpy((void*)(hdr + hdrLen), (void*)&crc, sizeof(uint16_t));
+        hdrLen += sizeof(uint16_t);
+    }
+
+    return hdrLen;
+}
+
+/**
+ * Flush coalescing buffer if the oldest write in it is past the deadline
+ * (called periodically from task scheduler)
+ */
+void DataStream::_Poll()
+{
+    if ((_cLen > 0) && ((DS_NOW() - _cSince) >= _deadline))
+        Flush();
+}
+
+/**
+ * Run connection state machine, called periodically from keep-alive task
+ * Open socket is only checked for being alive. Once it's lost, it's reopened
+ * right away and every failed attempt is followed by a randomized, exponentially
+ * growing pause before the next one. Opening is queued on ESP without waiting
+ * for the server, outcome is picked up on the following calls.
+ */
+void DataStream::_KeepAlive()
+{
+    uint32_t now = DS_NOW();
+
+    //  Connection is taken care of by the multiplexer
+    if (_mux != 0)
+        return;
+
+    //  Socket can also be opened by the other side or outside of this stream
+    if (ESP8266::GetI().GetClientBySockID(socketID) != 0)
+    {
+        //  Open UDP socket says nothing about the server, wait for its echo
+        if (!_Alive(now))
+        {
+            if (_conn == DS_CONN_UP)
+            {
+                _cStats.uptime += now - _connSince;
+#ifdef __HAL_USE_EVENTLOG__
+                EMIT_EV(DATAS_T_KA, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+            }
+            if (_conn != DS_CONN_DOWN)
+            {
+                _conn = DS_CONN_DOWN;
+                _connSince = now;
+            }
+            return;
+        }
+        if (_conn != DS_CONN_UP)
+            _ConnUp(now);
+        if (_backlog != 0)
+            _Replay(now);
+        return;
+    }
+
+    switch (_conn)
+    {
+    case DS_CONN_UP:
+        //  Connection lost, try to reopen it right away
+        _conn = DS_CONN_DOWN;
+        _cStats.uptime += now - _connSince;
+        _cStats.backoff = DS_BACKOFF_MIN;
+        _connSince = now;
+        _connNext = now;
+#ifdef __HAL_USE_EVENTLOG__
+        EMIT_EV(DATAS_T_KA, EVENT_ERROR);
+#endif  /* __HAL_USE_EVENTLOG__ */
+        _Connect(now);
+        break;
+    case DS_CONN_OPENING:
+        //  Socket would have been found above if it were opened
+        if ((ESP8266::GetI().CmdStatus(_connHandle) != ESP_NO_STATUS) ||
+            ((now - _connTry) >= DS_CONN_TIMEOUT))
+            _ConnFailed(now);
+        break;
+    case DS_CONN_DOWN:
+    default:
+        if ((int32_t)(now - _connNext) >= 0)
+            _Connect(now);
+        break;
+    }
+}
+
+/**
+ * Queue opening of the socket bound to the stream
+ * @param now current time in ms
+ */
+void DataStream::_Connect(uint32_t now)
+{
+    uint8_t id = socketID;
+
+    //  Nothing to connect to until ESP is on the network, or if stream only
+    //  waits for the server to connect
+    if ((ESP8266::GetI().wifiStatus != ESP_WIFI_CONNECTED) ||
+        (_serverip[0] == 0))
+        return;
+
+    _cStats.attempts++;
+    _connHandle = ESP8266::GetI().OpenSockAsync(_udp, (char*)_serverip, _port,
+                                                &id);
+    if (_connHandle == 0)
+    {
+        _ConnFailed(now);
+        return;
+    }
+
+    socketID = id;
+    _conn = DS_CONN_OPENING;
+    _connTry = now;
+}
+
+/**
+ * Attempt to open the socket failed, schedule next one after random time
+ * between half and full backoff and double the backoff
+ * @param now current time in ms
+ */
+void DataStream::_ConnFailed(uint32_t now)
+{
+    uint32_t half = _cStats.backoff / 2;
+
+    _cStats.failures++;
+    _conn = DS_CONN_DOWN;
+
+    //  Xorshift is plenty for spreading retries
+    _rnd ^= _rnd << 13;
+    _rnd ^= _rnd >> 17;
+    _rnd ^= _rnd << 5;
+    _connNext = now + half + (_rnd % (half + 1));
+
+    _cStats.backoff *= 2;
+    if (_cStats.backoff > DS_BACKOFF_MAX)
+        _cStats.backoff = DS_BACKOFF_MAX;
+}
+
+/**
+ * Socket bound to the stream has been opened
+ * @param now current time in ms
+ */
+void DataStream::_ConnUp(uint32_t now)
 {
-    //  Check if the socket is still opened, if it isn't there's no use in
-    //  reopening it as there will be no new data to read; so just return
     _socket = ESP8266::GetI().GetClientBySockID(socketID);
-    if (_socket!= 0)
-        return false;
+    //  Carry send mode over to the new socket
+    if (_buffered)
+        ESP8266::GetI().SendBuffered(socketID, true);
 
-    //  Check if there's response ready
-    if (_socket->Ready())
+    if (_connWasUp)
     {
-        //  Fetch response and save it into a buffer
-        memcpy((void*)buffer, (void*)(_socket->RespBody), _socket->RespLen);
-        (*bufferLen) = _socket->RespLen;
-        _socket->Done();
+        uint32_t ttr = now - _connSince;
+
+        _cStats.reconnects++;
+        _cStats.lastTTR = ttr;
+        if (ttr > _cStats.maxTTR)
+            _cStats.maxTTR = ttr;
+#ifdef __HAL_USE_EVENTLOG__
+        EMIT_EV(DATAS_T_KA, EVENT_OK);
+#endif  /* __HAL_USE_EVENTLOG__ */
+    }
+
+    _conn = DS_CONN_UP;
+    _connWasUp = true;
+    _connSince = now;
+    _cStats.backoff = DS_BACKOFF_MIN;
+    //  Replay starts with no credit, live writes go first
+    _blCredit = 0;
+    _blLast = now;
+}
+
+/**
+ * Send heartbeat if it's due and check if the server has echoed one recently
+ * enough, applies only to UDP streams with liveness check enabled
+ * @param now current time in ms
+ * @return true if stream can be considered up (or isn't checked), false if
+ * there was no echo within the timeout
+ */
+bool DataStream::_Alive(uint32_t now)
+{
+    uint8_t hdr[DS_FRAME_HDR];
+
+    if (!_udp || (_liveTimeout == 0))
         return true;
+
+    //  Heartbeat bypasses coalescing buffer, it's a datagram of its own
+    if ((now - _hbLast) >= DS_HB_PERIOD)
+    {
+        _hbLast = now;
+        _SendChunk(hdr, _FrameHdr(hdr, (const uint8_t*)DS_HB_MSG, DS_HB_LEN),
+                   (const uint8_t*)DS_HB_MSG, DS_HB_LEN);
     }
-    else
-        return false;
+
+    return _liveHeard && ((now - _liveLast) <= _liveTimeout);
+}
+
+/**
+ * Replay records stored in the backlog while the connection was down. Each
+ * record is sent as a message of its own, bypassing coalescing buffer, for as
+ * long as there is rate credit and the socket's send queue is at most half full
+ * @param now current time in ms
+ */
+void DataStream::_Replay(uint32_t now)
+{
+    //  Messages are assembled here, not on the stack (called from scheduler)
+    static uint8_t msg[DS_REPLAY_HDR + BL_MAX_REC];
+    uint8_t hdr[DS_FRAME_HDR], num[12];
+    uint32_t time, cap, dt = now - _blLast;
+    uint16_t len, msgLen;
+
+    //  Top up rate credit, allow a burst of up to a second worth of it (or
+    //  of a single largest record if that's more)
+    cap = (_blRate > sizeof(msg)) ? _blRate : sizeof(msg);
+    if (dt > 1000)
+        dt = 1000;
+    _blCredit += (_blRate * dt) / 1000;
+    if (_blCredit > cap)
+        _blCredit = cap;
+    _blLast = now;
+
+    while (!_backlog->Empty() && (TxFree() >= (ESP_TX_BUF / 2)))
+    {
+        _backlog->Peek(&time, msg + DS_REPLAY_HDR, &len);
+
+        //  Prefix "9*:time:len:" is built in front of the data
+        memcpy((void*)msg, (void*)"9*:", 3);
+        msgLen = 3;
+        //  itoa() doesn't terminate the string
+        memset((void*)num, 0, sizeof(num));
+        itoa((int32_t)time, num);
+        memcpy((void*)(msg + msgLen), (void*)num, strlen((char*)num));
+        msgLen += strlen((char*)num);
+        msg[msgLen++] = ':';
+        memset((void*)num, 0, sizeof(num));
+        itoa(len, num);
+        memcpy((void*)(msg + msgLen), (void*)num, strlen((char*)num));
+        msgLen += strlen((char*)num);
+        msg[msgLen++] = ':';
+        memmove((void*)(msg + msgLen), (void*)(msg + DS_REPLAY_HDR), len);
+        msgLen += len;
+
+        //  Record can't be framed, there's no point in keeping it
+        if (_framing && (msgLen > DS_FRAME_MAX))
+        {
+            _backlog->Pop();
+            continue;
+        }
+        if (msgLen > _blCredit)
+            break;
+        if (_SendChunk(hdr, _FrameHdr(hdr, msg, msgLen), msg, msgLen)
+                != STATUS_OK)
+            break;
+
+        _backlog->Pop();
+        _blCredit -= msgLen;
+    }
+}
+
+/**
+ * Complete message has been received, check its CRC and pass it to the hook
+ * @param msg payload of the message (_rLen bytes)
+ * @return true if message was delivered, false if it was corrupted
+ */
+bool DataStream::_Deliver(const uint8_t *msg)
+{
+    bool valid = !_crc || (crc16(msg, _rLen, 0xFFFF) == _rCRC);
+
+    if (!valid)
+        _rxErrors++;
+    else if (_hook != 0)
+        _hook(msg, _rLen);
+
+    _RxReset();
+
+    return valid;
+}
+
+/**
+ * Drop partially received message, next byte is expected to start a new one
+ */
+void DataStream::_RxReset()
+{
+    _rState = DS_RX_LEN;
+    _rShift = 0;
+    _rLen = 0;
+    _rCRC = 0;
+    _rHave = 0;
 }
 
 
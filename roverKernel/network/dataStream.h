@@ -10,7 +10,7 @@
  *  can be integrated with task scheduler to periodically check if the stream is
  *  opened and try to reconnect in case of a failure.
  *
- *  @version 1.3.2
+ *  @version 1.12.0
  *  V1.0 - 17.3.2017
  *  +Created document
  *  +Functionality: Initialize data stream with server IP & port, bind to opened
@@ -36,7 +36,44 @@
  *  V1.3.2 - 2.9.2017
  *  DataStream::Send function now offers user to choose whether to attempt to
  *  rebind closed socket
- *
+ *  V1.4.0 - 19.10.2026
+ *  +DataStream::Send queues data on the socket instead of blocking until ESP
+ *  confirms the send
+ *  V1.5.0 - 19.10.2026
+ *  +Optional buffered send mode (SendBuffered) for high-rate streams, kept
+ *  across rebinding of the stream
+ *  V1.6.0 - 19.10.2026
+ *  +Datagram mode (UseUDP): stream is bound to a UDP socket and every Send()
+ *  becomes a single self-contained datagram prefixed with a sequence number
+ *  V1.6.1 - 19.10.2026
+ *  *Bugfix: Receive() returned without data whenever the socket was open;
+ *  reads the oldest message queued on the socket
+ *  V1.7.0 - 19.10.2026
+ *  +Coalescing mode (Coalesce): small writes are collected into MTU-sized
+ *  chunks which are queued on the socket when full, when the oldest buffered
+ *  write exceeds the deadline or on Flush()
+ *  +Backpressure is reported to the caller (DS_STATUS_* codes), full buffer is
+ *  handled by dropping the newest or the oldest writes
+ *  V1.8.0 - 19.10.2026
+ *  +Message framing (Framing): every Send() is prefixed with its length (and
+ *  optionally CRC), received data is split into messages by Feed() which
+ *  reassembles messages split across segments and calls the stream's hook
+ *  once per complete message
+ *  V1.9.0 - 19.10.2026
+ *  +Keep-alive task runs a connection state machine: lost connection is
+ *  reopened without blocking (ESP8266::OpenSockAsync), failed attempts are
+ *  retried with randomized exponential backoff
+ *  +Connection statistics (ConnStats): uptime, reconnects, time to reconnect
+ *  V1.10.0 - 19.10.2026
+ *  +Stream can be carried as a channel of network multiplexer (UseMux, see
+ *  netMux.h) instead of having its own socket
+ *  V1.11.0 - 19.10.2026
+ *  +Store-and-forward (StoreForward): writes made while the connection is
+ *  down are kept in a backlog with their timestamps and replayed at a limited
+ *  rate once the connection is back
+ *  V1.12.0 - 19.10.2026
+ *  +Liveness of UDP streams (Liveness): keep-alive task sends heartbeats which
+ *  the server echoes, stream without an echo for too long counts as down
  */
 #include "hwconfig.h"
 
@@ -52,13 +89,128 @@
 #define __USE_TASK_SCHEDULER__
 #endif  /* __HAL_USE_TASKSCH__ */
 
+/*
+ * Header of a datagram sent by a stream in UDP mode:
+ *      seq(uint16_t, little-endian)|data
+ * Sequence number is incremented on every Send() call, including the ones that
+ * failed to queue the datagram, so the receiver can detect lost & reordered
+ * datagrams from gaps in the sequence
+ */
+#define DS_UDP_HDR_LEN  2
+
+/*
+ * Coalescing mode: max size of a chunk sent to the socket (including UDP
+ * header) and max number of writes buffered in a chunk. In UDP mode each chunk
+ * is a single datagram with its own sequence number
+ */
+#define DS_MTU          1460
+#define DS_MAX_FRAMES   32
+//  Default time in ms a write can wait in the buffer before it's flushed
+#define DS_DEADLINE     50
+
+/*
+ * Message framing (both directions):
+ *      len(varint, 1-2B)|[crc(uint16_t, little-endian)]|payload
+ *      len - size of payload, 7 bits per byte starting with the least
+ *            significant ones, MSB set in all bytes but the last
+ *      crc - CRC-16/CCITT (init 0xFFFF) of payload, see crc16() in myLib.h;
+ *            present only if the stream is set to use it
+ * Messages up to DS_FRAME_MAX bytes are accepted
+ */
+#define DS_FRAME_MAX    1024
+#define DS_FRAME_HDR    4   //  Max size of frame header
+//  States of message reassembly
+#define DS_RX_LEN       0   //  Reading length prefix
+#define DS_RX_CRC       1   //  Reading CRC
+#define DS_RX_DATA      2   //  Reading payload
+
+/*      Policies applied when coalescing buffer is full      */
+#define DS_DROP_NEWEST  0   //  Reject the write being made
+#define DS_DROP_OLDEST  1   //  Discard oldest buffered writes to make room
+
+/*
+ * Send status codes reported in coalescing mode (in addition to myLib.h
+ * STATUS_* codes)
+ */
+#define DS_STATUS_FULL      16  //  Buffer full, write was dropped
+#define DS_STATUS_DROPPED   17  //  Write buffered, older writes were dropped
+#define DS_STATUS_DOWN      18  //  Write buffered, but socket isn't open
+#define DS_STATUS_STORED    19  //  Write stored in backlog, socket isn't open
+
+/*
+ * States of connection to the server, driven by keep-alive task
+ */
+#define DS_CONN_DOWN    0   //  Socket closed, waiting for next attempt
+#define DS_CONN_OPENING 1   //  Socket is being opened
+#define DS_CONN_UP      2   //  Socket open
+//  Period of keep-alive task in ms
+#define DS_KA_PERIOD    250
+/*
+ * Reconnecting: first attempt is made as soon as connection is lost, every
+ * failed attempt doubles the backoff (from DS_BACKOFF_MIN up to DS_BACKOFF_MAX
+ * ms). Next attempt is made after a random time between half and full backoff
+ * so streams (and rovers) don't retry in lock-step
+ */
+#define DS_BACKOFF_MIN  500
+#define DS_BACKOFF_MAX  32000
+//  Time in ms after which attempt to open socket is considered failed
+#define DS_CONN_TIMEOUT 10000
+
+/*
+ * Store-and-forward: records of the backlog are replayed by keep-alive task as
+ * messages of their own:
+ *      9*:time:len:data
+ *      time - ms since startup at which the write was originally made
+ *      len  - length of data in bytes (data can be binary)
+ * Replay is limited to the given rate (bytes/s) and only happens while the
+ * socket's send queue is at most half full, leaving room for live writes
+ */
+#define DS_REPLAY_RATE  2048
+//  Max length of replay prefix
+#define DS_REPLAY_HDR   20
+
+/*
+ * Liveness of UDP streams: socket stays open whether or not anybody listens on
+ * the other side, so stream in UDP mode can't tell on its own that the server
+ * is gone. With liveness enabled keep-alive task sends DS_HB_MSG as a datagram
+ * of its own (numbered as any other) every DS_HB_PERIOD ms and the server is
+ * expected to send DS_HB_MSG back (raw, without sequence number) to the source
+ * address of the datagram. Stream counts as up only while an echo has been
+ * received (see Heartbeat()) within the timeout, otherwise it's down and
+ * writes go to the store-and-forward backlog. Heartbeats are sent while the
+ * stream is down too, that's how the server learns where to send the echo
+ */
+#define DS_HB_MSG       "HB"
+#define DS_HB_LEN       2
+#define DS_HB_PERIOD    1000
+//  Default time in ms without an echo after which stream counts as down
+#define DS_LIVE_TIMEOUT 3000
+
+/**
+ * Connection statistics of a data stream, times in ms
+ */
+struct _dsConnStats
+{
+    uint8_t     state;      //  One of DS_CONN_* macros
+    uint32_t    uptime;     //  Total time socket has been open
+    uint32_t    since;      //  Time in current state
+    uint32_t    attempts;   //  Attempts to open socket
+    uint32_t    failures;   //  Failed attempts
+    uint32_t    reconnects; //  Connections reestablished after being lost
+    uint32_t    lastTTR;    //  Time to reconnect after the last loss
+    uint32_t    maxTTR;     //  Longest time to reconnect
+    uint32_t    backoff;    //  Current backoff
+};
+
 //  Check if this library is set to use task scheduler
 #if defined(__USE_TASK_SCHEDULER__)
     #include "taskScheduler/taskScheduler.h"
     //  Unique identifier of this module as registered in task scheduler
     #define DATAS_UID       4
     //  Definitions of ServiceID for service offered by this module
-    #define DATAS_T_KA      0   //  Keep alive socket
+    #define DATAS_T_KA      0   //  Keep alive socket, reconnect if lost
+    #define DATAS_T_FLUSH   1   //  Flush coalescing buffer past its deadline
+    #define DATAS_T_MUX     2   //  Move data queued in multiplexer to its link
 
 //  Function to register data stream as a kernel module into the task scheduler,
 //  not implemented within the class because DataStream doesn't follow singleton
@@ -68,6 +220,11 @@ void DataStream_InitHW();
 
 #endif
 
+//  Network multiplexer, see netMux.h
+class NetMux;
+//  Store-and-forward backlog, see backlog.h
+class Backlog;
+
 /**
  * Definition of DataStream class. High level network communication object that
  * utilizes network sockets handled by ESP8266 library to establish a two-way
@@ -87,11 +244,44 @@ class DataStream
 
         uint32_t    Send(uint8_t *buffer, uint16_t bufferLen = 0, bool reopen = true);
         bool        Receive(uint8_t *buffer, uint16_t *bufferLen);
+        void        SendBuffered(bool enable);
+        void        UseUDP(bool enable);
+        void        Coalesce(bool enable, uint32_t deadlineMS = DS_DEADLINE,
+                             uint8_t policy = DS_DROP_NEWEST);
+        uint32_t    Flush();
+        uint32_t    Dropped();
+        void        Framing(bool enable, bool crc = false);
+        void        AddHook(void((*funPoint)(const uint8_t*, const uint16_t)));
+        uint16_t    Feed(const uint8_t *data, uint16_t len);
+        uint32_t    RxErrors();
+        void        ConnStats(struct _dsConnStats *stats);
+        void        UseMux(NetMux *mux, uint8_t chan);
+        uint16_t    TxFree();
+        void        StoreForward(Backlog *backlog,
+                                 uint32_t rate = DS_REPLAY_RATE);
+        void        Liveness(uint32_t timeoutMS);
+        bool        Heartbeat(const uint8_t *data, uint16_t len);
 
         //  Socket ID as returned from ESP8266
         uint8_t     socketID;
 
     private:
+        uint32_t    _SendChunk(const uint8_t *hdr, uint8_t hdrLen,
+                               const uint8_t *buffer, uint16_t bufferLen);
+        uint32_t    _Coalesce(const uint8_t *hdr, uint8_t hdrLen,
+                              const uint8_t *buffer, uint16_t bufferLen);
+        uint8_t     _FrameHdr(uint8_t *hdr, const uint8_t *buffer,
+                              uint16_t bufferLen);
+        void        _Poll();
+        void        _KeepAlive();
+        void        _Connect(uint32_t now);
+        void        _ConnFailed(uint32_t now);
+        void        _ConnUp(uint32_t now);
+        bool        _Alive(uint32_t now);
+        void        _Replay(uint32_t now);
+        bool        _Deliver(const uint8_t *msg);
+        void        _RxReset();
+
         //  String containing server IP address of underlying socket
         uint8_t     _serverip[20];
         //  Port number of server to which this stream is opened
@@ -101,6 +291,59 @@ class DataStream
         //  Turns true once this data stream has scheduled periodic checking
         //  of socket's health (whether we're still connected to the server)
         bool        _keepAlive;
+        //  Connection state machine, run by keep-alive task
+        uint8_t     _conn;          //  One of DS_CONN_* macros
+        uint16_t    _connHandle;    //  Handle of queued AT+CIPSTART
+        uint32_t    _connSince;     //  Time of last change of _conn, ms
+        uint32_t    _connNext;      //  Time of next attempt, ms
+        uint32_t    _connTry;       //  Time of attempt in progress, ms
+        bool        _connWasUp;     //  Socket has been open before
+        uint32_t    _rnd;           //  State of backoff jitter generator
+        struct _dsConnStats _cStats;
+        //  Data is sent in ESP's buffered mode (see ESP8266::SendBuffered)
+        bool        _buffered;
+        //  Stream uses UDP socket, data is sent as numbered datagrams
+        bool        _udp;
+        uint16_t    _seq;
+        //  Coalescing mode: writes are collected in _cBuf, _cFrame holds the
+        //  length of each of them (used to drop the oldest ones)
+        bool        _coalesce;
+        uint8_t     _policy;        //  One of DS_DROP_* macros
+        uint32_t    _deadline;      //  Max time a write waits in _cBuf, ms
+        bool        _flushTask;     //  Periodic flush task is scheduled
+        uint8_t     _cBuf[DS_MTU];
+        uint16_t    _cLen;
+        uint16_t    _cFrame[DS_MAX_FRAMES];
+        uint8_t     _cFrameN;
+        uint32_t    _cSince;        //  Time oldest buffered write was made, ms
+        uint32_t    _dropped;       //  Writes dropped by coalescing buffer
+        //  Message framing
+        bool        _framing;
+        bool        _crc;           //  Frames carry CRC of the payload
+        //  Hook to user routine called once per received message
+        void        ((*_hook)(const uint8_t*, const uint16_t));
+        //  State of reassembly of received message, payload of a message
+        //  split across segments is collected in _rBuf
+        uint8_t     _rState;        //  One of DS_RX_* macros
+        uint8_t     _rShift;        //  Bits of length read so far
+        uint16_t    _rLen;          //  Length of message being received
+        uint16_t    _rCRC;          //  CRC of message being received
+        uint16_t    _rHave;         //  Bytes of CRC/payload received so far
+        uint8_t     _rBuf[DS_FRAME_MAX + 1];
+        uint32_t    _rxErrors;      //  Corrupted frames dropped
+        //  Multiplexer carrying this stream (0 if stream has its own socket)
+        NetMux      *_mux;
+        uint8_t     _muxCh;         //  Channel of the multiplexer
+        //  Store-and-forward backlog (0 if writes aren't stored)
+        Backlog     *_backlog;
+        uint32_t    _blRate;        //  Replay rate, bytes/s
+        uint32_t    _blCredit;      //  Bytes that can be replayed now
+        uint32_t    _blLast;        //  Time credit was last topped up, ms
+        //  Liveness of UDP stream (0 timeout if disabled)
+        uint32_t    _liveTimeout;   //  Max time without an echo, ms
+        uint32_t    _liveLast;      //  Time last echo was received, ms
+        uint32_t    _hbLast;        //  Time last heartbeat was sent, ms
+        bool        _liveHeard;     //  Echo has been received at all
 };
 
 
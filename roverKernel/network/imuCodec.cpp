@@ -0,0 +1,252 @@
+/**
+ * imuCodec.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "imuCodec.h"
+
+#include <string.h>
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+IMUCodec::IMUCodec() : _rpyRes(IMUC_DEF_RPY_RES), _accRes(IMUC_DEF_ACC_RES),
+                       _keyInterval(IMUC_DEF_KEYINT)
+{
+    Reset();
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Configure quantization and keyframe interval of the encoder. Forces next
+ * encoded sample to be a keyframe so the receiver picks up new resolution.
+ * @param rpyRes resolution of roll-pitch-yaw angles in degrees per LSB
+ * @param accRes resolution of acceleration in units per LSB
+ * @param keyInterval number of delta-samples between two keyframes
+ * @return true if configuration is valid and applied, false otherwise
+ */
+bool IMUCodec::Configure(float rpyRes, float accRes, uint16_t keyInterval)
+{
+    if ((rpyRes <= 0.0f) || (accRes <= 0.0f) || (keyInterval == 0))
+        return false;
+
+    _rpyRes = rpyRes;
+    _accRes = accRes;
+    _keyInterval = keyInterval;
+    Reset();
+
+    return true;
+}
+
+/**
+ * Reset state of encoder/decoder. Next encoded sample is a keyframe, decoder
+ * drops all samples until it receives a keyframe.
+ */
+void IMUCodec::Reset()
+{
+    _sinceKey = 0;
+    _seq = 0;
+    _synced = false;
+    _prevTime = 0;
+    memset((void*)_prev, 0, sizeof(_prev));
+}
+
+/**
+ * Encode a single sample into a buffer
+ * @param time timestamp of the sample in ms since startup
+ * @param rpy roll-pitch-yaw orientation in degrees (3 floats)
+ * @param acc 3-axis acceleration (3 floats)
+ * @param buf buffer to write encoded sample to
+ * @param bufLen size of [buf], has to be at least IMUC_MAX_SAMPLE
+ * @return number of bytes written into [buf], 0 if [buf] is too small
+ */
+uint16_t IMUCodec::Encode(uint32_t time, const float *rpy, const float *acc,
+                          uint8_t *buf, uint16_t bufLen)
+{
+    int32_t val[IMUC_VALUES];
+    uint16_t len = 1;
+    bool key;
+
+    if (bufLen < IMUC_MAX_SAMPLE)
+        return 0;
+
+    //  Quantize all values of the sample
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        val[i] = _Quantize(rpy[i], _rpyRes);
+        val[i+3] = _Quantize(acc[i], _accRes);
+    }
+
+    key = (!_synced) || (_sinceKey >= _keyInterval);
+    buf[0] = (_seq & 0x7F) | (key ? IMUC_KEYFRAME : 0);
+
+    if (key)
+    {
+        //  Keyframe carries resolution and absolute values
+        memcpy((void*)(buf+len), (void*)&_rpyRes, sizeof(float));
+        len += sizeof(float);
+        memcpy((void*)(buf+len), (void*)&_accRes, sizeof(float));
+        len += sizeof(float);
+        len += _PutVarint(time, buf+len);
+        for (uint8_t i = 0; i < IMUC_VALUES; i++)
+            len += _PutVarint(((uint32_t)val[i] << 1) ^ (uint32_t)(val[i] >> 31),
+                              buf+len);
+        _sinceKey = 0;
+        _synced = true;
+    }
+    else
+    {
+        //  Delta frame carries only differences to the previous sample
+        len += _PutVarint(time - _prevTime, buf+len);
+        for (uint8_t i = 0; i < IMUC_VALUES; i++)
+        {
+            //  Difference wraps around (modulo 2^32) for far apart values,
+            //  decoder wraps it back the same way
+            int32_t d = (int32_t)((uint32_t)val[i] - (uint32_t)_prev[i]);
+            len += _PutVarint(((uint32_t)d << 1) ^ (uint32_t)(d >> 31), buf+len);
+        }
+        _sinceKey++;
+    }
+
+    memcpy((void*)_prev, (void*)val, sizeof(_prev));
+    _prevTime = time;
+    _seq++;
+
+    return len;
+}
+
+/**
+ * Decode a single sample from a buffer
+ * @param buf buffer holding encoded sample(s)
+ * @param bufLen number of bytes in [buf]
+ * @param time[out] timestamp of the sample in ms since startup
+ * @param rpy[out] roll-pitch-yaw orientation in degrees (3 floats)
+ * @param acc[out] 3-axis acceleration (3 floats)
+ * @return >0 number of bytes consumed from [buf], outputs are valid
+ *         <0 negative number of bytes consumed, sample is skipped because
+ *            decoder lost synchronization and is waiting for a keyframe
+ *          0 buffer is malformed or too short to contain a full sample
+ */
+int16_t IMUCodec::Decode(const uint8_t *buf, uint16_t bufLen, uint32_t *time,
+                         float *rpy, float *acc)
+{
+    int32_t val[IMUC_VALUES];
+    uint32_t tmp;
+    uint16_t len = 1;
+    uint8_t n;
+    bool key;
+
+    if (bufLen < 1)
+        return 0;
+
+    key = ((buf[0] & IMUC_KEYFRAME) != 0);
+
+    if (key)
+    {
+        if (bufLen < (1 + 2*sizeof(float)))
+            return 0;
+        memcpy((void*)&_rpyRes, (void*)(buf+len), sizeof(float));
+        len += sizeof(float);
+        memcpy((void*)&_accRes, (void*)(buf+len), sizeof(float));
+        len += sizeof(float);
+    }
+
+    //  Time is either absolute (keyframe) or difference to previous sample
+    if ((n = _GetVarint(buf+len, bufLen-len, &tmp)) == 0)
+        return 0;
+    len += n;
+    *time = key ? tmp : (_prevTime + tmp);
+
+    for (uint8_t i = 0; i < IMUC_VALUES; i++)
+    {
+        if ((n = _GetVarint(buf+len, bufLen-len, &tmp)) == 0)
+            return 0;
+        len += n;
+        //  Undo zig-zag encoding
+        val[i] = (int32_t)(tmp >> 1) ^ -(int32_t)(tmp & 1);
+        if (!key)
+            val[i] = (int32_t)((uint32_t)val[i] + (uint32_t)_prev[i]);
+    }
+
+    //  Delta frame is valid only if it directly follows previous sample
+    if (!key && (!_synced || (((_seq+1) & 0x7F) != (buf[0] & 0x7F))))
+    {
+        _synced = false;
+        return -(int16_t)len;
+    }
+
+    _synced = true;
+    _seq = buf[0] & 0x7F;
+    _prevTime = *time;
+    memcpy((void*)_prev, (void*)val, sizeof(_prev));
+
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        rpy[i] = (float)val[i] * _rpyRes;
+        acc[i] = (float)val[i+3] * _accRes;
+    }
+
+    return (int16_t)len;
+}
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                           [PROTECTED]
+///-----------------------------------------------------------------------------
+
+/**
+ * Write unsigned integer as variable-length integer (7 bits per byte, LSB
+ * group first, MSB of a byte set if more bytes follow)
+ * @param val value to write
+ * @param buf buffer to write to (needs space for up to 5 bytes)
+ * @return number of bytes written
+ */
+uint8_t IMUCodec::_PutVarint(uint32_t val, uint8_t *buf)
+{
+    uint8_t len = 0;
+
+    while (val >= 0x80)
+    {
+        buf[len++] = (uint8_t)(val | 0x80);
+        val >>= 7;
+    }
+    buf[len++] = (uint8_t)val;
+
+    return len;
+}
+
+/**
+ * Read variable-length integer written by _PutVarint()
+ * @param buf buffer to read from
+ * @param bufLen number of bytes available in [buf]
+ * @param val[out] decoded value
+ * @return number of bytes read, 0 if varint is truncated or longer than 5B
+ */
+uint8_t IMUCodec::_GetVarint(const uint8_t *buf, uint16_t bufLen, uint32_t *val)
+{
+    *val = 0;
+
+    for (uint8_t i = 0; (i < bufLen) && (i < 5); i++)
+    {
+        *val |= (uint32_t)(buf[i] & 0x7F) << (7*i);
+        if ((buf[i] & 0x80) == 0)
+            return i+1;
+    }
+
+    return 0;
+}
+
+/**
+ * Quantize value to a given resolution (round to nearest)
+ * @param val value to quantize
+ * @param res resolution (value of 1 LSB)
+ * @return quantized value
+ */
+int32_t IMUCodec::_Quantize(float val, float res)
+{
+    val /= res;
+    return (int32_t)(val >= 0.0f ? (val + 0.5f) : (val - 0.5f));
+}
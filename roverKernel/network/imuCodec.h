@@ -0,0 +1,94 @@
+/**
+ * imuCodec.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Compact encoding of MPU9250 samples (roll-pitch-yaw & acceleration) for
+ *  high-rate telemetry. Each value is quantized to a configurable fixed-point
+ *  resolution and encoded as a difference to the same value in the previous
+ *  sample. Differences are written as zig-zag variable-length integers (7 bits
+ *  per byte, MSB set on all but the last byte) so that small changes between
+ *  consecutive samples take a single byte instead of 4 bytes of a float.
+ *  Every N-th sample is a keyframe carrying absolute values and resolution, so
+ *  the receiver can (re)synchronize after a lost sample or when it connects in
+ *  the middle of the stream.
+ *  Encoding of one sample:
+ *      header(1B)|data
+ *      header: bit7 - keyframe flag, bits6-0 - sequence number (mod 128)
+ *      keyframe data:  rpyRes(float)|accRes(float)|time(varint)|6x value(zz-varint)
+ *      delta data:     dTime(varint)|6x deltaValue(zz-varint)
+ *  Values are always in order roll, pitch, yaw, accX, accY, accZ.
+ *  @note File doesn't depend on any hardware or kernel module so it can be
+ *  compiled as-is on the host side (GUI/server) to decode the data stream
+ *
+ *  @version 1.0.1
+ *  V1.0.1 - 19.10.2026
+ *  *Bugfix: deltas of values far apart overflowed int32_t, computed modulo
+ *  2^32 now (see tools/imuCodecCheck for checks of the encoding)
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Encoder & decoder for quantized, delta-encoded MPU9250 samples
+ */
+
+#ifndef ROVERKERNEL_NETWORK_IMUCODEC_H_
+#define ROVERKERNEL_NETWORK_IMUCODEC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//  Number of values in a single sample (RPY + 3-axis acceleration)
+#define IMUC_VALUES         6
+//  Header flag marking keyframe
+#define IMUC_KEYFRAME       0x80
+//  Worst-case size of an encoded sample (header, 2 floats, time and values all
+//  as 5-byte varints)
+#define IMUC_MAX_SAMPLE     (1 + 2*sizeof(float) + 5 + IMUC_VALUES*5)
+
+//  Default quantization & keyframe interval
+#define IMUC_DEF_RPY_RES    0.01f   //  Degrees per LSB
+#define IMUC_DEF_ACC_RES    0.001f  //  Acceleration unit per LSB
+#define IMUC_DEF_KEYINT     50      //  Keyframe every 50 samples (1s at 50Hz)
+
+/**
+ * IMUCodec class definition
+ * Single object is used either as an encoder (on the rover) or as a decoder
+ * (on the receiving side), it keeps the state of previous sample needed to
+ * compute/apply deltas.
+ */
+class IMUCodec
+{
+    public:
+        IMUCodec();
+
+        bool        Configure(float rpyRes, float accRes, uint16_t keyInterval);
+        void        Reset();
+
+        uint16_t    Encode(uint32_t time, const float *rpy, const float *acc,
+                           uint8_t *buf, uint16_t bufLen);
+        int16_t     Decode(const uint8_t *buf, uint16_t bufLen, uint32_t *time,
+                           float *rpy, float *acc);
+
+    protected:
+        static uint8_t  _PutVarint(uint32_t val, uint8_t *buf);
+        static uint8_t  _GetVarint(const uint8_t *buf, uint16_t bufLen,
+                                   uint32_t *val);
+        static int32_t  _Quantize(float val, float res);
+
+        //  Resolution of orientation (deg/LSB) and acceleration (unit/LSB)
+        float       _rpyRes;
+        float       _accRes;
+        //  Number of samples between two keyframes
+        uint16_t    _keyInterval;
+        //  Number of samples encoded since the last keyframe
+        uint16_t    _sinceKey;
+        //  Sequence number of next sample (encoder) or last sample (decoder)
+        uint8_t     _seq;
+        //  Set once a keyframe has been seen (decoder) or sent (encoder)
+        bool        _synced;
+        //  Quantized values & time of previous sample
+        int32_t     _prev[IMUC_VALUES];
+        uint32_t    _prevTime;
+};
+
+#endif /* ROVERKERNEL_NETWORK_IMUCODEC_H_ */
@@ -0,0 +1,510 @@
+/**
+ * netMux.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "network/netMux.h"
+
+//  Makes sense to compile only if ESP module is being used
+#if defined(__HAL_USE_ESP8266__)
+
+#include "libs/myLib.h"
+#include "esp8266/esp8266.h"
+
+/**
+ * Copy [len] bytes out of a channel's send queue starting at position [pos]
+ * @param ring send queue (NMUX_TXBUF bytes)
+ * @param pos free-running position to read from
+ * @param dst buffer to copy data into
+ * @param len number of bytes to copy
+ */
+static void _RingRead(const uint8_t *ring, uint16_t pos, uint8_t *dst,
+                      uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+        dst[i] = ring[(uint16_t)(pos + i) & (NMUX_TXBUF - 1)];
+}
+
+/**
+ * Copy [len] bytes into a channel's send queue starting at position [pos]
+ * @param ring send queue (NMUX_TXBUF bytes)
+ * @param pos free-running position to write to
+ * @param src data to copy
+ * @param len number of bytes to copy
+ */
+static void _RingWrite(uint8_t *ring, uint16_t pos, const uint8_t *src,
+                       uint16_t len)
+{
+    for (uint16_t i = 0; i < len; i++)
+        ring[(uint16_t)(pos + i) & (NMUX_TXBUF - 1)] = src[i];
+}
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Commands have the highest priority so replies are never held back by other
+ * traffic, followed by telemetry and event log. Radar scans and bulk transfers
+ * only use whatever is left. All channels use flow control.
+ * @param ip string containing IP address of the server(null-terminated)
+ * @param port TCP port of the server
+ */
+NetMux::NetMux(uint8_t *ip, uint16_t port)
+    : _link(ip, port), _bound(false), _up(false), _rr(0), _rHave(0), _rLeft(0)
+{
+    memset((void*)_ch, 0, sizeof(_ch));
+    memset((void*)_rHdr, 0, sizeof(_rHdr));
+    memset((void*)_rCredit, 0, sizeof(_rCredit));
+
+    _ch[NMUX_CH_CMD].prio = 0;
+    _ch[NMUX_CH_TEL].prio = 1;
+    _ch[NMUX_CH_EVLOG].prio = 2;
+    _ch[NMUX_CH_RADAR].prio = 3;
+    _ch[NMUX_CH_BULK].prio = 4;
+    for (uint8_t i = 0; i < NMUX_CH_NUM; i++)
+    {
+        _ch[i].flow = true;
+        _ch[i].credit = NMUX_WINDOW;
+    }
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Bind multiplexer's link to a socket (see DataStream::BindToSocketID) and
+ * start moving queued data to it. Link is kept alive and reopened by
+ * keep-alive task of the data stream
+ * @param sockID desired socket ID (0 - 4)
+ * @return return value of DataStream::BindToSocketID
+ */
+uint8_t NetMux::Bind(uint8_t sockID)
+{
+    uint8_t retVal = _link.BindToSocketID(sockID, true);
+
+#if defined(__USE_TASK_SCHEDULER__)
+    if (!_bound)
+    {
+        TaskScheduler::GetI().SyncTaskPer(DATAS_UID, DATAS_T_MUX, -NMUX_PERIOD,
+                                          NMUX_PERIOD, T_PERIODIC);
+        TaskScheduler::GetI().AddArg<uint32_t>((uint32_t)this);
+    }
+#endif  /* __USE_TASK_SCHEDULER__ */
+    _bound = true;
+
+    return retVal;
+}
+
+/**
+ * Check if multiplexer is in use (its link has been bound to a socket)
+ * @return true if Bind() has been called
+ */
+bool NetMux::Active()
+{
+    return _bound;
+}
+
+/**
+ * Get statistics of multiplexer link's connection to the server
+ * @param stats pointer to structure to fill
+ */
+void NetMux::ConnStats(struct _dsConnStats *stats)
+{
+    _link.ConnStats(stats);
+}
+
+/**
+ * Get ID of the socket carrying multiplexer's link
+ * @return socket ID
+ */
+uint8_t NetMux::SocketID()
+{
+    return _link.socketID;
+}
+
+/**
+ * Configure priority & flow control of a channel
+ * @param chan ID of channel, one of NMUX_CH_* macros
+ * @param prio priority of the channel, 0 is the highest
+ * @param flow true to send only as much as the other side granted, false to
+ * send regardless of credit (for receivers not returning credit)
+ * @return one of myLib.h STATUS_* error codes
+ */
+uint32_t NetMux::Configure(uint8_t chan, uint8_t prio, bool flow)
+{
+    if (chan >= NMUX_CH_NUM)
+        return STATUS_ARG_ERR;
+
+    _ch[chan].prio = prio;
+    _ch[chan].flow = flow;
+
+    return STATUS_OK;
+}
+
+/**
+ * Register hook called once for every message received on a channel. Message
+ * is only valid until the hook returns.
+ * @param chan ID of channel, one of NMUX_CH_* macros
+ * @param funPoint pointer to function taking pointer to the message & its size
+ */
+void NetMux::AddHook(uint8_t chan,
+                     void((*funPoint)(const uint8_t*, const uint16_t)))
+{
+    if (chan < NMUX_CH_NUM)
+        _ch[chan].hook = funPoint;
+}
+
+/**
+ * Queue message on a channel
+ * Message is copied into channel's send queue and sent (possibly in several
+ * fragments) once it's the channel's turn. Messages are kept while the link
+ * is down and sent once it's reopened
+ * @param chan ID of channel, one of NMUX_CH_* macros
+ * @param buffer message to send
+ * @param bufferLen length of the message
+ * @return STATUS_OK if message is queued, STATUS_ARG_ERR for invalid channel
+ * or message that can never fit the queue, DS_STATUS_FULL if channel's queue
+ * is currently full (message is dropped)
+ */
+uint32_t NetMux::Send(uint8_t chan, const uint8_t *buffer, uint16_t bufferLen)
+{
+    struct _muxChannel *ch;
+
+    if ((chan >= NMUX_CH_NUM) || ((bufferLen + 2) > NMUX_TXBUF))
+        return STATUS_ARG_ERR;
+
+    ch = &_ch[chan];
+    if ((uint16_t)(ch->txHead - ch->txTail) + bufferLen + 2 > NMUX_TXBUF)
+    {
+        ch->stats.dropped++;
+        return DS_STATUS_FULL;
+    }
+
+    _RingWrite(ch->txBuf, ch->txHead, (uint8_t*)&bufferLen, 2);
+    _RingWrite(ch->txBuf, ch->txHead + 2, buffer, bufferLen);
+    ch->txHead += bufferLen + 2;
+
+    _Pump();
+
+    return STATUS_OK;
+}
+
+/**
+ * Process data received on multiplexer's link
+ * Data is split into frames (which can be split across or share segments),
+ * fragments are reassembled into messages and the channel's hook is called
+ * for each complete one. Consumed data is granted back to the sender.
+ * @param data received data
+ * @param len length of received data
+ */
+void NetMux::Feed(const uint8_t *data, uint16_t len)
+{
+    uint16_t i = 0;
+
+    while (i < len)
+    {
+        uint16_t n, frameLen;
+        uint8_t chan = _rHdr[0];
+
+        //  Collect frame header
+        if (_rHave < NMUX_HDR)
+        {
+            _rHdr[_rHave++] = data[i++];
+            if (_rHave == NMUX_HDR)
+            {
+                memcpy((void*)&_rLeft, (void*)(_rHdr + 2), sizeof(uint16_t));
+                if (_rLeft == 0)
+                    _Frame(_rHdr[0]);
+            }
+            continue;
+        }
+
+        //  Payload, as much of it as there is in this segment
+        n = len - i;
+        if (n > _rLeft)
+            n = _rLeft;
+        memcpy((void*)&frameLen, (void*)(_rHdr + 2), sizeof(uint16_t));
+
+        if (chan < NMUX_CH_NUM)
+        {
+            struct _muxChannel *ch = &_ch[chan];
+
+            if (_rHdr[1] == NMUX_T_CREDIT)
+            {
+                for (uint16_t j = 0; j < n; j++)
+                    if ((frameLen - _rLeft + j) < sizeof(_rCredit))
+                        _rCredit[frameLen - _rLeft + j] = data[i + j];
+            }
+            else if ((_rHdr[1] == NMUX_T_DATA) || (_rHdr[1] == NMUX_T_MORE))
+            {
+                //  Message doesn't fit, drop it whole
+                if (!ch->rxDrop && ((ch->rxLen + n) > NMUX_RX_MAX))
+                {
+                    ch->rxDrop = true;
+                    ch->stats.dropped++;
+                }
+                if (!ch->rxDrop)
+                {
+                    memcpy((void*)(ch->rxBuf + ch->rxLen), (void*)(data + i), n);
+                    ch->rxLen += n;
+                }
+                ch->granted += n;
+            }
+        }
+
+        i += n;
+        _rLeft -= n;
+        if (_rLeft == 0)
+            _Frame(chan);
+    }
+
+    //  Return credit to the sender right away
+    _Pump();
+}
+
+/**
+ * Get traffic counters of a channel
+ * @param chan ID of channel, one of NMUX_CH_* macros
+ * @param stats pointer to structure to fill
+ * @return true if [chan] is valid, false otherwise
+ */
+bool NetMux::Stats(uint8_t chan, struct _muxStats *stats)
+{
+    if (chan >= NMUX_CH_NUM)
+        return false;
+
+    memcpy((void*)stats, (void*)&_ch[chan].stats, sizeof(struct _muxStats));
+
+    return true;
+}
+
+///-----------------------------------------------------------------------------
+///                      Private member functions                      [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Move queued data to the link
+ * Credit owed to the other side is sent first, then fragments are taken from
+ * channels in order of priority until a chunk of NMUX_CHUNK bytes is filled or
+ * NMUX_INFLIGHT bytes are waiting in the socket. All frames of one pass are
+ * handed to the socket as a single send. If the link doesn't take it the pass
+ * is undone: data stays queued and credit is refunded, to be sent on the next
+ * pass.
+ */
+void NetMux::_Pump()
+{
+    uint8_t chunk[NMUX_CHUNK];
+    uint16_t len = 0, room, queued;
+    uint8_t rr = _rr;
+    int8_t c;
+    struct _muxTxMark mark[NMUX_CH_NUM];
+
+    if (!_LinkUp())
+        return;
+
+    //  Keep most of the data in the multiplexer where it can still be
+    //  overtaken by higher priority channels
+    queued = ESP_TX_BUF - _link.TxFree();
+    if (queued >= NMUX_INFLIGHT)
+        return;
+    room = NMUX_INFLIGHT - queued;
+    if (room > NMUX_CHUNK)
+        room = NMUX_CHUNK;
+
+    for (uint8_t i = 0; i < NMUX_CH_NUM; i++)
+    {
+        struct _muxChannel *ch = &_ch[i];
+
+        mark[i].txTail = ch->txTail;
+        mark[i].txOff = ch->txOff;
+        mark[i].credit = ch->credit;
+        mark[i].granted = ch->granted;
+        mark[i].txMsgs = ch->stats.txMsgs;
+        mark[i].txBytes = ch->stats.txBytes;
+
+        //  Grant consumed data back in batches of half the window
+        if ((ch->granted >= (NMUX_WINDOW / 2)) &&
+            ((len + NMUX_HDR + sizeof(uint16_t)) <= room))
+        {
+            uint16_t grant = (ch->granted > 0xFFFF) ? 0xFFFF : ch->granted;
+
+            chunk[len++] = i;
+            chunk[len++] = NMUX_T_CREDIT;
+            chunk[len++] = sizeof(uint16_t);
+            chunk[len++] = 0;
+            memcpy((void*)(chunk + len), (void*)&grant, sizeof(uint16_t));
+            len += sizeof(uint16_t);
+            ch->granted -= grant;
+        }
+        //  Count channels blocked by the receiver
+        if (ch->flow && (ch->credit == 0) && (ch->txHead != ch->txTail))
+            ch->stats.stalls++;
+    }
+
+    while ((c = _Next()) >= 0)
+    {
+        struct _muxChannel *ch = &_ch[c];
+        uint16_t msgLen, left, frag;
+        uint8_t type;
+
+        //  Make sure there's room for a frame
+        if ((len + NMUX_HDR) >= room)
+            break;
+
+        _RingRead(ch->txBuf, ch->txTail, (uint8_t*)&msgLen, 2);
+        left = msgLen - ch->txOff;
+        frag = left;
+        if (frag > NMUX_SEG)
+            frag = NMUX_SEG;
+        if (ch->flow && (frag > ch->credit))
+            frag = ch->credit;
+        if (frag > (room - len - NMUX_HDR))
+            frag = room - len - NMUX_HDR;
+        type = (frag == left) ? NMUX_T_DATA : NMUX_T_MORE;
+
+        chunk[len++] = c;
+        chunk[len++] = type;
+        memcpy((void*)(chunk + len), (void*)&frag, sizeof(uint16_t));
+        len += sizeof(uint16_t);
+        _RingRead(ch->txBuf, ch->txTail + 2 + ch->txOff, chunk + len, frag);
+        len += frag;
+
+        ch->txOff += frag;
+        ch->stats.txBytes += frag;
+        if (ch->flow)
+            ch->credit -= frag;
+        if (type == NMUX_T_DATA)
+        {
+            ch->txTail += msgLen + 2;
+            ch->txOff = 0;
+            ch->stats.txMsgs++;
+        }
+        _rr = c;
+    }
+
+    if ((len == 0) || (_link.Send(chunk, len) == STATUS_OK))
+        return;
+
+    //  Link didn't take the chunk (socket closed or its queue full)
+    for (uint8_t i = 0; i < NMUX_CH_NUM; i++)
+    {
+        _ch[i].txTail = mark[i].txTail;
+        _ch[i].txOff = mark[i].txOff;
+        _ch[i].credit = mark[i].credit;
+        _ch[i].granted = mark[i].granted;
+        _ch[i].stats.txMsgs = mark[i].txMsgs;
+        _ch[i].stats.txBytes = mark[i].txBytes;
+    }
+    _rr = rr;
+}
+
+/**
+ * Check if the link is open, reset state of all channels if it has been
+ * reopened since the last check
+ * @return true if the link is open
+ */
+bool NetMux::_LinkUp()
+{
+    struct _dsConnStats conn;
+
+    if (!_bound)
+        return false;
+
+    _link.ConnStats(&conn);
+    if (conn.state != DS_CONN_UP)
+    {
+        _up = false;
+        return false;
+    }
+    if (!_up)
+        _Reset();
+    _up = true;
+
+    return true;
+}
+
+/**
+ * Reset state of channels for a new connection: all credit is restored,
+ * partially received messages are dropped and partially sent ones are sent
+ * again from the beginning
+ */
+void NetMux::_Reset()
+{
+    for (uint8_t i = 0; i < NMUX_CH_NUM; i++)
+    {
+        _ch[i].txOff = 0;
+        _ch[i].credit = NMUX_WINDOW;
+        _ch[i].rxLen = 0;
+        _ch[i].rxDrop = false;
+        _ch[i].granted = 0;
+    }
+    _rHave = 0;
+    _rLeft = 0;
+}
+
+/**
+ * Pick channel to send the next fragment from: highest priority channel that
+ * has data queued and credit to send it, round-robin among channels with the
+ * same priority
+ * @return ID of the channel, -1 if there's nothing to send
+ */
+int8_t NetMux::_Next()
+{
+    int8_t best = -1;
+
+    for (uint8_t i = 1; i <= NMUX_CH_NUM; i++)
+    {
+        uint8_t c = (_rr + i) % NMUX_CH_NUM;
+
+        if (_ch[c].txHead == _ch[c].txTail)
+            continue;
+        if (_ch[c].flow && (_ch[c].credit == 0))
+            continue;
+        if ((best < 0) || (_ch[c].prio < _ch[best].prio))
+            best = c;
+    }
+
+    return best;
+}
+
+/**
+ * Frame has been received completely, deliver message or apply credit
+ * @param chan channel the frame was received on
+ */
+void NetMux::_Frame(uint8_t chan)
+{
+    struct _muxChannel *ch;
+    uint8_t type = _rHdr[1];
+
+    _rHave = 0;
+    if (chan >= NMUX_CH_NUM)
+        return;
+    ch = &_ch[chan];
+
+    if (type == NMUX_T_CREDIT)
+    {
+        uint16_t grant;
+
+        memcpy((void*)&grant, (void*)_rCredit, sizeof(uint16_t));
+        memset((void*)_rCredit, 0, sizeof(_rCredit));
+        ch->credit += grant;
+    }
+    else if (type == NMUX_T_DATA)
+    {
+        if (!ch->rxDrop)
+        {
+            //  Null-terminate for text messages, buffer has space for it
+            ch->rxBuf[ch->rxLen] = 0;
+            ch->stats.rxMsgs++;
+            if (ch->hook != 0)
+                ch->hook(ch->rxBuf, ch->rxLen);
+        }
+        ch->rxLen = 0;
+        ch->rxDrop = false;
+    }
+}
+
+#endif  /* __HAL_USE_ESP8266__ */
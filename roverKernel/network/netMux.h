@@ -0,0 +1,178 @@
+/**
+ * netMux.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  Network multiplexer carries several logical channels (commands, telemetry,
+ *  radar scans, event log, bulk transfers) over a single TCP connection, so
+ *  only one ESP socket (and one keep-alive & reconnect) is needed for all of
+ *  them. Messages are split into fragments of up to NMUX_SEG bytes and each
+ *  pass of the multiplexer picks the next fragment from the highest priority
+ *  channel that has data, channels of equal priority take turns. Only a few
+ *  fragments are handed to the socket at a time (NMUX_INFLIGHT), so a short
+ *  command reply never waits behind more than that, no matter how much data
+ *  is queued on lower priority channels.
+ *  Each channel has credit-based flow control: sender may only send as many
+ *  bytes as the receiver granted it (NMUX_WINDOW initially, more is granted
+ *  with credit frames as received data is consumed). A stalled channel doesn't
+ *  hold back the other ones.
+ *  Frame format (all multi-byte fields are little-endian):
+ *      chan(1B)|type(1B)|len(uint16_t)|payload(len B)
+ *      type: NMUX_T_DATA   - last (or only) fragment of a message
+ *            NMUX_T_MORE   - fragment followed by more fragments of the same
+ *                            message on this channel
+ *            NMUX_T_CREDIT - payload is uint16_t number of bytes the receiver
+ *                            may additionally send on this channel
+ *  Both sides start with NMUX_WINDOW bytes of credit on every channel each
+ *  time the connection is (re)established, message being sent at the time the
+ *  connection is lost is sent again from its beginning.
+ *
+ *  @version 1.0.2
+ *  V1.0.2 - 19.10.2026
+ *  *Bugfix: Chunk the link failed to send was lost, its data already dequeued
+ *  and credit charged; the pass is now undone and data sent again later
+ *  V1.0.1 - 19.10.2026
+ *  +ConnStats() exposes connection statistics of multiplexer's link
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Prioritized, fragmenting multiplexer with per-channel flow control on top
+ *  of a DataStream
+ */
+#include "hwconfig.h"
+
+//  Makes sense to compile only if ESP module is being used
+#if !defined(ROVERKERNEL_NETWORK_NETMUX_H_) && defined(__HAL_USE_ESP8266__)
+#define ROVERKERNEL_NETWORK_NETMUX_H_
+
+#include "network/dataStream.h"
+
+/*      Logical channels      */
+#define NMUX_CH_CMD     0   //  Commands & replies
+#define NMUX_CH_TEL     1   //  Telemetry
+#define NMUX_CH_RADAR   2   //  Radar scans
+#define NMUX_CH_EVLOG   3   //  Event log
+#define NMUX_CH_BULK    4   //  Bulk transfers (task scheduler dumps...)
+#define NMUX_CH_NUM     5
+
+/*      Frame types      */
+#define NMUX_T_DATA     0
+#define NMUX_T_MORE     1
+#define NMUX_T_CREDIT   2
+
+//  Size of frame header
+#define NMUX_HDR        4
+//  Max payload of a single data fragment
+#define NMUX_SEG        256
+//  Max number of bytes handed to the socket in a single send
+#define NMUX_CHUNK      512
+//  Max number of bytes waiting in socket's send queue, new data is held back
+//  in the multiplexer (where it can be overtaken) until it drops below this
+#define NMUX_INFLIGHT   1024
+//  Size of send queue of each channel (power of 2), each queued message takes
+//  its length + 2 bytes
+#define NMUX_TXBUF      2048
+//  Max size of a received message
+#define NMUX_RX_MAX     1024
+//  Initial credit of each channel in bytes
+#define NMUX_WINDOW     4096
+//  Period in ms at which queued data is moved to the socket
+#define NMUX_PERIOD     10
+
+/**
+ * Traffic counters of a single channel
+ */
+struct _muxStats
+{
+    uint32_t    txMsgs;     //  Messages sent
+    uint32_t    txBytes;    //  Payload bytes sent
+    uint32_t    rxMsgs;     //  Messages received
+    uint32_t    dropped;    //  Messages dropped (queue full or too long)
+    uint32_t    stalls;     //  Times data was held back for lack of credit
+};
+
+/**
+ * Send position of a channel taken before a pass of the multiplexer, so the
+ * pass can be undone if the link doesn't take the chunk
+ */
+struct _muxTxMark
+{
+    uint16_t    txTail;
+    uint16_t    txOff;
+    uint32_t    credit;
+    uint32_t    granted;
+    uint32_t    txMsgs;
+    uint32_t    txBytes;
+};
+
+/**
+ * State of a single logical channel
+ */
+struct _muxChannel
+{
+    uint8_t     prio;       //  Priority, 0 is the highest
+    bool        flow;       //  Flow control enabled
+    //  Queue of messages to send, each stored as len(uint16_t)|data.
+    //  Positions are free-running counters, index is counter & (size - 1)
+    uint8_t     txBuf[NMUX_TXBUF];
+    uint16_t    txHead;     //  Bytes written into txBuf
+    uint16_t    txTail;     //  Bytes of completely sent messages
+    uint16_t    txOff;      //  Bytes of oldest message sent so far
+    uint32_t    credit;     //  Bytes we're allowed to send
+    //  Reassembly of received message
+    uint8_t     rxBuf[NMUX_RX_MAX + 1];
+    uint16_t    rxLen;
+    bool        rxDrop;     //  Message didn't fit, drop its remaining fragments
+    uint32_t    granted;    //  Bytes consumed but not yet granted back
+    //  Hook to user routine called once per received message
+    void        ((*hook)(const uint8_t*, const uint16_t));
+    struct _muxStats stats;
+};
+
+/**
+ * NetMux class definition
+ * Multiplexer owns the data stream used as its link, it's bound to a socket
+ * with Bind() after which the link is kept alive and reconnected by the
+ * data stream's keep-alive task.
+ */
+class NetMux
+{
+    friend void _DATAS_KernelCallback(void);
+    public:
+        NetMux(uint8_t *ip, uint16_t port);
+
+        uint8_t     Bind(uint8_t sockID);
+        bool        Active();
+        uint8_t     SocketID();
+        uint32_t    Configure(uint8_t chan, uint8_t prio, bool flow);
+        void        AddHook(uint8_t chan,
+                            void((*funPoint)(const uint8_t*, const uint16_t)));
+        uint32_t    Send(uint8_t chan, const uint8_t *buffer, uint16_t bufferLen);
+        void        Feed(const uint8_t *data, uint16_t len);
+        bool        Stats(uint8_t chan, struct _muxStats *stats);
+        void        ConnStats(struct _dsConnStats *stats);
+
+    private:
+        void        _Pump();
+        bool        _LinkUp();
+        void        _Reset();
+        int8_t      _Next();
+        void        _Frame(uint8_t chan);
+
+        //  Data stream carrying the frames
+        DataStream  _link;
+        //  Link has been bound to a socket
+        bool        _bound;
+        //  Link was open on the previous pass
+        bool        _up;
+        //  Channel served last, for round-robin among equal priorities
+        uint8_t     _rr;
+        struct _muxChannel  _ch[NMUX_CH_NUM];
+        //  State of frame parser
+        uint8_t     _rHdr[NMUX_HDR];
+        uint8_t     _rHave;     //  Bytes of header received
+        uint16_t    _rLeft;     //  Payload bytes left in the current frame
+        uint8_t     _rCredit[2];//  Payload of credit frame
+};
+
+#endif /* ROVERKERNEL_NETWORK_NETMUX_H_ */
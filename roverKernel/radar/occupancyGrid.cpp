@@ -0,0 +1,327 @@
+/**
+ * occupancyGrid.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ */
+#include "radar/occupancyGrid.h"
+
+#if defined(__HAL_USE_RADAR__)
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libs/myLib.h"
+
+//  Marks empty dirty rectangle
+#define OG_CLEAN_MIN    0xFFFF
+#define OG_CLEAN_MAX    0
+
+///-----------------------------------------------------------------------------
+///                      Class constructor                              [PUBLIC]
+///-----------------------------------------------------------------------------
+
+OccupancyGrid::OccupancyGrid() : _enabled(false)
+{
+    Configure(OG_SIZE_DEF, OG_RES_DEF);
+}
+
+///-----------------------------------------------------------------------------
+///                      Public member functions                        [PUBLIC]
+///-----------------------------------------------------------------------------
+
+/**
+ * Set size of the map and clear it, rover is placed back in its centre. Whole
+ * map is marked dirty so the server gets the cleared map as well
+ * @param size number of cells along each side (2 to OG_SIZE_MAX)
+ * @param res size of a cell in mm (at least OG_RES_MIN)
+ * @return error-code, one of STATUS_* macros from myLib.h (map is left
+ * unchanged on error)
+ */
+uint32_t OccupancyGrid::Configure(uint16_t size, uint16_t res)
+{
+    if ((size < 2) || (size > OG_SIZE_MAX) || (res < OG_RES_MIN))
+        return STATUS_ARG_ERR;
+
+    _size = size;
+    _res = res;
+    memset((void*)_cells, 0, sizeof(_cells));
+
+    _pose.x = (float)size * res / 2.0f;
+    _pose.y = _pose.x;
+    _pose.yaw = 0;
+    _odoValid = false;
+
+    _dMinX = _dMinY = OG_CLEAN_MIN;
+    _dMaxX = _dMaxY = OG_CLEAN_MAX;
+    MarkDirty(0, 0, size, size);
+
+    return STATUS_OK;
+}
+
+/**
+ * Enable updating the map from radar scans (used by platform to decide whether
+ * to send map deltas or raw scans)
+ * @param enable true to enable the map
+ */
+void OccupancyGrid::Enable(bool enable)
+{
+    _enabled = enable;
+}
+
+/**
+ * Check if the map is enabled
+ * @return true if the map is enabled
+ */
+bool OccupancyGrid::Enabled()
+{
+    return _enabled;
+}
+
+/**
+ * Advance the pose by distance traveled since the last update, along current
+ * heading. First call only takes the references: wheel distances and the yaw
+ * which becomes heading 0 of the map
+ * @param left distance traveled by left wheel since startup in cm
+ * @param right distance traveled by right wheel since startup in cm
+ * @param yaw current IMU yaw in degrees (counter-clockwise)
+ */
+void OccupancyGrid::UpdatePose(float left, float right, float yaw)
+{
+    float d;
+
+    if (!_odoValid)
+    {
+        _odo[0] = left;
+        _odo[1] = right;
+        _yaw0 = yaw;
+        _odoValid = true;
+        return;
+    }
+
+    //  Mean distance of both wheels, cm to mm
+    d = ((left - _odo[0]) + (right - _odo[1])) * 5.0f;
+    _odo[0] = left;
+    _odo[1] = right;
+
+    _pose.yaw = (yaw - _yaw0) * PI_CONST / 180.0f;
+    _pose.x += d * cosf(_pose.yaw);
+    _pose.y += d * sinf(_pose.yaw);
+}
+
+/**
+ * Get current pose of the rover in the map
+ * @param pose [out] current pose
+ */
+void OccupancyGrid::Pose(struct _ogPose *pose)
+{
+    memcpy((void*)pose, (void*)&_pose, sizeof(_pose));
+}
+
+/**
+ * Update the map with a horizontal radar scan taken at current pose. Beam of
+ * every reading is traced from the rover: cells on the way are updated as
+ * free, the one at the end as occupied (unless reading is at the end of the
+ * sensor's range)
+ * @param dist distance of each reading in mm, 0 if there's no reading
+ * @param n number of readings
+ * @param from horizontal gimbal angle of the first reading in degrees
+ * @param step angle between two readings in degrees
+ */
+void OccupancyGrid::InsertScan(const uint16_t *dist, uint16_t n, float from,
+                               float step)
+{
+    int32_t x0, y0, x1, y1;
+    float angle, r;
+    bool hit;
+
+    x0 = (int32_t)floorf(_pose.x / _res);
+    y0 = (int32_t)floorf(_pose.y / _res);
+
+    for (uint16_t i = 0; i < n; i++)
+    {
+        if (dist[i] == 0)
+            continue;
+
+        hit = (dist[i] < OG_RANGE_MAX);
+        r = hit ? dist[i] : OG_RANGE_MAX;
+        angle = _pose.yaw +
+                (from + i * step - OG_GIMBAL_FWD) * PI_CONST / 180.0f;
+
+        x1 = (int32_t)floorf((_pose.x + r * cosf(angle)) / _res);
+        y1 = (int32_t)floorf((_pose.y + r * sinf(angle)) / _res);
+        _Ray(x0, y0, x1, y1, hit);
+    }
+}
+
+/**
+ * Get log-odds of a cell being occupied
+ * @param x column of the cell
+ * @param y row of the cell
+ * @return log-odds in OG_L_ONE units, 0 (unknown) for cells outside the map
+ */
+int8_t OccupancyGrid::Cell(uint16_t x, uint16_t y)
+{
+    if ((x >= _size) || (y >= _size))
+        return 0;
+
+    return _cells[y * _size + x];
+}
+
+/**
+ * Add a rectangle of cells to the dirty region (e.g. to send it again after a
+ * delta got lost), part outside the map is ignored
+ * @param x column of top-left cell
+ * @param y row of top-left cell
+ * @param w width in cells
+ * @param h height in cells
+ */
+void OccupancyGrid::MarkDirty(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    uint16_t x1, y1;
+
+    if ((x >= _size) || (y >= _size) || (w == 0) || (h == 0))
+        return;
+
+    x1 = ((uint32_t)x + w > _size) ? (_size - 1) : (x + w - 1);
+    y1 = ((uint32_t)y + h > _size) ? (_size - 1) : (y + h - 1);
+
+    if (x < _dMinX) _dMinX = x;
+    if (x1 > _dMaxX) _dMaxX = x1;
+    if (y < _dMinY) _dMinY = y;
+    if (y1 > _dMaxY) _dMaxY = y1;
+}
+
+/**
+ * Check if there are cells changed since they were last sent
+ * @return true if dirty region isn't empty
+ */
+bool OccupancyGrid::Dirty()
+{
+    return (_dMinY <= _dMaxY);
+}
+
+/**
+ * Pack the next chunk of dirty region into a delta message (see occupancyGrid.h
+ * for the layout) and remove it from the dirty region. Chunk takes as many
+ * whole rows of the dirty rectangle as fit into the buffer
+ * @param buf buffer to pack the delta into
+ * @param maxLen size of the buffer, at least OG_DELTA_HDR + OG_SIZE_MAX
+ * @return length of the delta, 0 if there's nothing to send or buffer is too
+ * small
+ */
+uint16_t OccupancyGrid::Delta(uint8_t *buf, uint16_t maxLen)
+{
+    uint16_t w, h, rows;
+    int32_t px, py;
+
+    if (!Dirty() || (maxLen < (OG_DELTA_HDR + OG_SIZE_MAX)))
+        return 0;
+
+    w = _dMaxX - _dMinX + 1;
+    h = _dMaxY - _dMinY + 1;
+    rows = (maxLen - OG_DELTA_HDR) / w;
+    if (h > rows)
+        h = rows;
+
+    px = (int32_t)_pose.x;
+    py = (int32_t)_pose.y;
+    memcpy((void*)(buf + 0), (void*)&_size, sizeof(uint16_t));
+    memcpy((void*)(buf + 2), (void*)&_res, sizeof(uint16_t));
+    memcpy((void*)(buf + 4), (void*)&px, sizeof(int32_t));
+    memcpy((void*)(buf + 8), (void*)&py, sizeof(int32_t));
+    memcpy((void*)(buf + 12), (void*)&_pose.yaw, sizeof(float));
+    memcpy((void*)(buf + 16), (void*)&_dMinX, sizeof(uint16_t));
+    memcpy((void*)(buf + 18), (void*)&_dMinY, sizeof(uint16_t));
+    memcpy((void*)(buf + 20), (void*)&w, sizeof(uint16_t));
+    memcpy((void*)(buf + 22), (void*)&h, sizeof(uint16_t));
+
+    for (uint16_t r = 0; r < h; r++)
+        memcpy((void*)(buf + OG_DELTA_HDR + r * w),
+               (void*)&_cells[(_dMinY + r) * _size + _dMinX], w);
+
+    //  Rows sent are no longer dirty
+    _dMinY += h;
+    if (_dMinY > _dMaxY)
+    {
+        _dMinX = _dMinY = OG_CLEAN_MIN;
+        _dMaxX = _dMaxY = OG_CLEAN_MAX;
+    }
+
+    return OG_DELTA_HDR + w * h;
+}
+
+///-----------------------------------------------------------------------------
+///                      Private member functions                      [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Trace a beam between two cells (Bresenham's line, integer only), cells on
+ * the way are updated as free and the end cell as occupied if beam hit
+ * something. Cells outside the map are skipped
+ * @param x0 column of starting cell
+ * @param y0 row of starting cell
+ * @param x1 column of end cell
+ * @param y1 row of end cell
+ * @param hit true if beam ended on an obstacle
+ */
+void OccupancyGrid::_Ray(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                         bool hit)
+{
+    int32_t dx = abs(x1 - x0), dy = -abs(y1 - y0);
+    int32_t sx = (x0 < x1) ? 1 : -1, sy = (y0 < y1) ? 1 : -1;
+    int32_t err = dx + dy, e2;
+
+    while ((x0 != x1) || (y0 != y1))
+    {
+        _Update(x0, y0, OG_L_FREE);
+
+        e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+
+    _Update(x1, y1, hit ? OG_L_OCC : OG_L_FREE);
+}
+
+/**
+ * Add to log-odds of a cell, clamped at +/-OG_L_MAX. Changed cells are added
+ * to the dirty region
+ * @param x column of the cell
+ * @param y row of the cell
+ * @param delta log-odds to add (OG_L_OCC or OG_L_FREE)
+ */
+void OccupancyGrid::_Update(int32_t x, int32_t y, int8_t delta)
+{
+    int8_t *cell;
+    int16_t val;
+
+    if ((x < 0) || (y < 0) || (x >= _size) || (y >= _size))
+        return;
+
+    cell = &_cells[y * _size + x];
+    val = *cell + delta;
+    if (val > OG_L_MAX)
+        val = OG_L_MAX;
+    else if (val < -OG_L_MAX)
+        val = -OG_L_MAX;
+
+    if (val == *cell)
+        return;
+    *cell = (int8_t)val;
+
+    if (x < _dMinX) _dMinX = x;
+    if (x > _dMaxX) _dMaxX = x;
+    if (y < _dMinY) _dMinY = y;
+    if (y > _dMaxY) _dMaxY = y;
+}
+
+#endif  /* __HAL_USE_RADAR__ */
@@ -0,0 +1,121 @@
+/**
+ * occupancyGrid.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran Mikov
+ *
+ *  2D occupancy grid built on-board from radar scans and rover's pose. The
+ *  map is a square of [size] x [size] cells, [res] mm each, with the rover
+ *  starting in its centre heading along +x. Every cell holds log-odds of being
+ *  occupied in fixed point (int8_t, OG_L_ONE units per 1.0), 0 is unknown.
+ *  Pose is integrated from wheel distances (encoders) along heading given by
+ *  the IMU yaw. Every radar beam is traced from the rover to the measured
+ *  distance with integer line drawing: cells along the beam are made more
+ *  likely free, the cell at its end more likely occupied (unless the reading
+ *  is at the end of sensor's range, OG_RANGE_MAX).
+ *  Changed cells are tracked as a single dirty rectangle, which is sent to the
+ *  server in chunks of whole rows (see Delta()) so only changes of the map go
+ *  over the network. Delta message layout (all fields little-endian):
+ *      size(uint16_t)|res(uint16_t)|poseX(int32_t, mm)|poseY(int32_t, mm)|
+ *      yaw(float, rad)|x(uint16_t)|y(uint16_t)|w(uint16_t)|h(uint16_t)|
+ *      cells(int8_t) x w*h (row by row)
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Log-odds occupancy grid updated from radar scans by integer ray casting
+ *  +Pose from wheel encoders & IMU yaw, dirty-region deltas of the map
+ */
+#include "hwconfig.h"
+
+//  Compile following section only if hwconfig.h says to include radar module
+#if !defined(ROVERKERNEL_RADAR_OCCUPANCYGRID_H_) && defined(__HAL_USE_RADAR__)
+#define ROVERKERNEL_RADAR_OCCUPANCYGRID_H_
+
+#include <stdint.h>
+
+//  Largest map side in cells, map storage is OG_SIZE_MAX^2 bytes
+#define OG_SIZE_MAX     160
+//  Default map: 160 x 160 cells of 50mm (8m x 8m)
+#define OG_SIZE_DEF     160
+#define OG_RES_DEF      50
+//  Smallest cell size in mm
+#define OG_RES_MIN      10
+
+/*
+ * Log-odds in fixed point, OG_L_ONE units per 1.0. Beam makes the end cell
+ * more likely occupied by OG_L_OCC (p=0.7) and cells on the way more likely
+ * free by OG_L_FREE (p=0.4). Cells are clamped at +/-OG_L_MAX so they can
+ * still change quickly once the environment changes
+ */
+#define OG_L_ONE        16
+#define OG_L_OCC        14
+#define OG_L_FREE       (-6)
+#define OG_L_MAX        80
+
+//  Readings at or beyond this distance (in mm) didn't hit anything
+#define OG_RANGE_MAX    780
+//  Horizontal gimbal angle (in degrees) pointing straight ahead
+#define OG_GIMBAL_FWD   80.0f
+
+//  Size of delta header and max size of a single delta message
+#define OG_DELTA_HDR    24
+#define OG_DELTA_MAX    512
+
+/**
+ * Pose of the rover in the map, position is measured from the map's corner
+ * (cell 0,0), yaw counter-clockwise from +x axis
+ */
+struct _ogPose
+{
+    float       x;      //  mm
+    float       y;      //  mm
+    float       yaw;    //  rad
+};
+
+/**
+ * OccupancyGrid class definition
+ */
+class OccupancyGrid
+{
+    public:
+        OccupancyGrid();
+
+        uint32_t    Configure(uint16_t size, uint16_t res);
+        void        Enable(bool enable);
+        bool        Enabled();
+
+        void        UpdatePose(float left, float right, float yaw);
+        void        Pose(struct _ogPose *pose);
+        void        InsertScan(const uint16_t *dist, uint16_t n, float from,
+                               float step);
+        int8_t      Cell(uint16_t x, uint16_t y);
+
+        void        MarkDirty(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+        bool        Dirty();
+        uint16_t    Delta(uint8_t *buf, uint16_t maxLen);
+
+    private:
+        void        _Ray(int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                         bool hit);
+        void        _Update(int32_t x, int32_t y, int8_t delta);
+
+        //  Cells stored row by row (y * size + x)
+        int8_t      _cells[OG_SIZE_MAX * OG_SIZE_MAX];
+        uint16_t    _size;
+        uint16_t    _res;
+        bool        _enabled;
+        //  Pose, distances (cm) of each wheel at the last update and IMU yaw
+        //  (deg) at the first one, which becomes heading 0 of the map
+        struct _ogPose _pose;
+        float       _odo[2];
+        float       _yaw0;
+        bool        _odoValid;
+        //  Dirty rectangle (inclusive), empty if _dMinY > _dMaxY
+        uint16_t    _dMinX;
+        uint16_t    _dMaxX;
+        uint16_t    _dMinY;
+        uint16_t    _dMaxY;
+};
+
+#endif /* ROVERKERNEL_RADAR_OCCUPANCYGRID_H_ */
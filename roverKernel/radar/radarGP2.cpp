@@ -8,6 +8,7 @@
 
 #if defined(__HAL_USE_RADAR__)       //  Compile only if module is enabled
 
+#include <math.h>
 #include "libs/myLib.h"
 #include "HAL/hal.h"
 
@@ -22,6 +23,17 @@
 #include "serialPort/uartHW.h"
 #endif
 
+/*
+ * Default calibration of the sensor (according to datasheet graph): ADC
+ * readout and distance in mm at that readout, readouts in descending order.
+ * Readouts above the first point read as the closest distance, ones below the
+ * last point as the furthest one
+ */
+static const uint16_t _radCalADC[] =
+    { 2860, 2020, 1610, 1340, 1140, 910, 757, 640, 540, 508 };
+static const uint16_t _radCalDist[] =
+    {  100,  150,  200,  250,  300, 400, 500, 600, 700, 800 };
+
 #if defined(__USE_TASK_SCHEDULER__)
 /**
  * Callback routine to invoke service offered by this module from task scheduler
@@ -61,27 +73,8 @@ void _RADAR_KernelCallback(void)
                 //  Trigger AD conversion, wait for data-ready flag and read data
                 dist = HAL_RAD_ADCTrigger();
 
-                //  Convert ADC readout to cm (according to datasheet graph)
-                if ( dist>2860 ) dist=10;
-                else if ( (dist<=2860) && (dist>2020) )
-                    dist = interpolate(2860,10,2020,15,dist);
-                else if ( (dist<=2020) && (dist>1610) )
-                    dist = interpolate(2020,15,1610,20,dist);
-                else if ( (dist<=1610) && (dist>1340) )
-                    dist = interpolate(1610,20,1340,25,dist);
-                else if ( (dist<=1340) && (dist>1140) )
-                    dist = interpolate(1340,25,1140,30,dist);
-                else if ( (dist<=1140) && (dist>910) )
-                    dist = interpolate(1140,30,910,40,dist);
-                else if ( (dist<=910) && (dist>757) )
-                    dist = interpolate(910,40,757,50,dist);
-                else if ( (dist<=757) && (dist>640) )
-                    dist = interpolate(757,50,640,60,dist);
-                else if ( (dist<=640) && (dist>540) )
-                    dist = interpolate(640,60,540,70,dist);
-                else if ( (dist<=540) && (dist>508) )
-                    dist = interpolate(540,70,508,80,dist);
-                else if ( (dist<=508)) dist=80;
+                //  Convert ADC readout to distance, rounded to cm
+                dist = (__rD.Distance(dist) + 5) / 10;
 
                 __rD._scanData[scanLen] = (uint8_t)(dist & 0xFF);
 
@@ -155,6 +148,179 @@ void _RADAR_KernelCallback(void)
             __rD._radKer.retVal = __rD.Scan(true);
     }
         break;
+        /*
+         * Load new calibration of the sensor and rebuild ADC-to-distance table
+         * args[] = n x (adc(uint16_t)|distance(uint16_t, mm)), ADC readouts
+         *          in descending order
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_CALIBRATE:
+        {
+            uint16_t adc[RADAR_CAL_MAX], dist[RADAR_CAL_MAX];
+            uint8_t n = __rD._radKer.argN / (2 * sizeof(uint16_t));
+
+            if (((__rD._radKer.argN % (2 * sizeof(uint16_t))) != 0) ||
+                (n > RADAR_CAL_MAX))
+            {
+                __rD._radKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            for (uint8_t i = 0; i < n; i++)
+            {
+                memcpy((void*)&adc[i],
+                       (void*)(__rD._radKer.args + 4*i),
+                       sizeof(uint16_t));
+                memcpy((void*)&dist[i],
+                       (void*)(__rD._radKer.args + 4*i + 2),
+                       sizeof(uint16_t));
+            }
+
+            __rD._radKer.retVal = __rD.SetCalibration(adc, dist, n);
+        }
+        break;
+        /*
+         * Start raster scan over a grid of gimbal angles, depth image is
+         * passed to image hook once complete (see RadarModule::RasterScan)
+         * args[] = grid(struct _radGrid)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_RASTER:
+        {
+            struct _radGrid grid;
+
+            if (__rD._radKer.argN != sizeof(struct _radGrid))
+            {
+                __rD._radKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&grid, (void*)__rD._radKer.args, sizeof(grid));
+            __rD._radKer.retVal = __rD.RasterScan(&grid);
+        }
+        break;
+        /*
+         * Collect samples at current point of raster scan, once they're in
+         * filter them and move gimbal to the next point (scheduled by the scan
+         * itself)
+         * args[] = generation(uint8_t)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_RASTER_STEP:
+        {
+            //  Step of a scan that has been stopped or restarted since
+            if ((__rD._radKer.argN != 1) || !__rD._rBusy ||
+                (__rD._radKer.args[0] != __rD._rGen))
+                return;
+
+            __rD._RasterStep();
+
+            //  Return so we don't emit an event for every point
+            if (__rD._rBusy)
+                return;
+            __rD._radKer.retVal = STATUS_OK;
+        }
+        break;
+        /*
+         * Abort raster scan or sweep in progress, gimbal is left where it is
+         * args[] = none
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_RASTER_STOP:
+        {
+            __rD.StopRaster();
+            __rD._radKer.retVal = STATUS_OK;
+        }
+        break;
+        /*
+         * Start continuous sweep of horizontal axis, result is passed to image
+         * hook as a single row (see RadarModule::Sweep)
+         * args[] = from(float)|to(float)|vertical(float)|points(uint16_t)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_SWEEP:
+        {
+            float angles[3];
+            uint16_t points;
+
+            if (__rD._radKer.argN != (3*sizeof(float) + sizeof(uint16_t)))
+            {
+                __rD._radKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)angles, (void*)__rD._radKer.args, 3*sizeof(float));
+            memcpy((void*)&points,
+                   (void*)(__rD._radKer.args + 3*sizeof(float)),
+                   sizeof(uint16_t));
+            __rD._radKer.retVal = __rD.Sweep(angles[0], angles[1], angles[2],
+                                             points);
+        }
+        break;
+        /*
+         * Sample sensor during continuous sweep (scheduled by the sweep itself)
+         * args[] = generation(uint8_t)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_SWEEP_STEP:
+        {
+            //  Step of a sweep that has been stopped or restarted since
+            if ((__rD._radKer.argN != 1) || !__rD._rBusy ||
+                (__rD._radKer.args[0] != __rD._rGen))
+                return;
+
+            __rD._SweepStep();
+
+            //  Return so we don't emit an event for every sample
+            if (__rD._rBusy)
+                return;
+            __rD._radKer.retVal = STATUS_OK;
+        }
+        break;
+        /*
+         * Calibrate servo model used to derive settling times
+         * args[] = speed(float, deg/s)|dead(uint16_t, ms)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_SERVO:
+        {
+            float speed;
+            uint16_t dead;
+
+            if (__rD._radKer.argN != (sizeof(float) + sizeof(uint16_t)))
+            {
+                __rD._radKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&speed, (void*)__rD._radKer.args, sizeof(float));
+            memcpy((void*)&dead, (void*)(__rD._radKer.args + sizeof(float)),
+                   sizeof(uint16_t));
+            __rD._radKer.retVal = __rD.SetServoModel(speed, dead);
+        }
+        break;
+        /*
+         * Configure multi-sample filter of raster scan (see struct _radFilter)
+         * args[] = n(uint8_t)|mode(uint8_t)|trim(uint8_t)|period(uint16_t, us)
+         * retVal one of myLib.h STATUS_* error codes
+         */
+    case RADAR_T_FILTER:
+        {
+            uint16_t period;
+
+            if (__rD._radKer.argN != (3 + sizeof(uint16_t)))
+            {
+                __rD._radKer.retVal = STATUS_ARG_ERR;
+                break;
+            }
+
+            memcpy((void*)&period, (void*)(__rD._radKer.args + 3),
+                   sizeof(uint16_t));
+            __rD._radKer.retVal = __rD.SetFilter(__rD._radKer.args[0],
+                                                 __rD._radKer.args[1],
+                                                 __rD._radKer.args[2], period);
+        }
+        break;
     default:
         break;
     }
@@ -211,6 +377,8 @@ void RadarModule::InitHW()
     SetVerAngle(100);
     //  Reserve memory space to fit measurements
     _scanData = new uint8_t[162];
+    _img = new uint16_t[RADAR_IMG_MAX];
+    _var = new uint16_t[RADAR_IMG_MAX];
 
 #if defined(__USE_TASK_SCHEDULER__)
     //  Register module services with task scheduler
@@ -233,6 +401,288 @@ void RadarModule::AddHook(void((*funPoint)(uint8_t*, uint16_t*)))
 {
     custHook = funPoint;
 }
+
+/**
+ * Load calibration of the sensor and rebuild lookup table translating every
+ * possible ADC readout into distance. Distance between calibration points is
+ * linearly interpolated, readouts outside of calibrated range are clamped to
+ * the first/last point
+ * @param adc ADC readouts of calibration points, in descending order
+ * @param dist distances in mm at the readouts above
+ * @param n number of calibration points (2 to RADAR_CAL_MAX)
+ * @return error-code, one of STATUS_* macros from myLib.h (table is left
+ * unchanged on error)
+ */
+uint32_t RadarModule::SetCalibration(const uint16_t *adc, const uint16_t *dist,
+                                     uint8_t n)
+{
+    int32_t code;
+    uint8_t i;
+
+    if ((n < 2) || (n > RADAR_CAL_MAX))
+        return STATUS_ARG_ERR;
+    for (i = 1; i < n; i++)
+        if (adc[i] >= adc[i-1])
+            return STATUS_ARG_ERR;
+
+    //  Walk from the highest readout down, segment is advanced along the way
+    i = 0;
+    for (code = RADAR_ADC_CODES - 1; code >= 0; code--)
+    {
+        if (code >= adc[0])
+            _lut[code] = dist[0];
+        else if (code <= adc[n-1])
+            _lut[code] = dist[n-1];
+        else
+        {
+            int32_t span, delta;
+
+            while (code <= adc[i+1])
+                i++;
+
+            span = adc[i] - adc[i+1];
+            delta = ((int32_t)dist[i+1] - dist[i]) * (adc[i] - code);
+            //  Round to the nearest mm
+            _lut[code] = dist[i] + (delta + ((delta < 0) ? -span : span)/2) / span;
+        }
+    }
+
+    return STATUS_OK;
+}
+
+/**
+ * Translate ADC readout of the sensor into distance
+ * @param adc ADC readout (as returned by HAL_RAD_ADCTrigger)
+ * @return distance in mm
+ */
+uint16_t RadarModule::Distance(uint32_t adc)
+{
+    if (adc >= RADAR_ADC_CODES)
+        adc = RADAR_ADC_CODES - 1;
+
+    return _lut[adc];
+}
+
+/**
+ * Start raster scan over a grid of gimbal angles
+ * Gimbal is moved to every point of the grid, row by row in serpentine order.
+ * After the settling time samples are collected there in the background and
+ * their filtered distance stored in depth image (see SetFilter). Every point
+ * is handled by one-shot tasks (RADAR_T_RASTER_STEP) which schedule the next
+ * one, so the scan never blocks; image is passed to image hook once complete.
+ * @param grid grid to scan, at most RADAR_COLS_MAX columns and RADAR_IMG_MAX
+ * points in total; settling times set to RADAR_SETTLE_AUTO are derived from
+ * servo model
+ * @return error-code, one of STATUS_* macros from myLib.h (STATUS_PROG_ERR if
+ * a raster scan is already in progress)
+ */
+uint32_t RadarModule::RasterScan(const struct _radGrid *grid)
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    uint32_t rows, cols;
+    float dh, dv;
+
+    if (_rBusy || (_img == 0))
+        return STATUS_PROG_ERR;
+    //  Written so that NaN fails the checks as well
+    if (!(grid->hStep > 0) || !(grid->vStep > 0) ||
+        !(grid->hMin >= 0) || !(grid->hMax <= RADAR_ANGLE_MAX) ||
+        !(grid->hMin <= grid->hMax) ||
+        !(grid->vMin >= 0) || !(grid->vMax <= RADAR_ANGLE_MAX) ||
+        !(grid->vMin <= grid->vMax))
+        return STATUS_ARG_ERR;
+
+    //  Small margin so that a range which is a multiple of the step includes
+    //  its end point despite rounding
+    cols = (uint32_t)((grid->hMax - grid->hMin) / grid->hStep + 0.001f) + 1;
+    rows = (uint32_t)((grid->vMax - grid->vMin) / grid->vStep + 0.001f) + 1;
+    if ((cols > RADAR_COLS_MAX) || ((rows * cols) > RADAR_IMG_MAX))
+        return STATUS_ARG_ERR;
+
+    memcpy((void*)&_grid, (void*)grid, sizeof(_grid));
+    _imgFrom = grid->hMin;
+    _imgStep = grid->hStep;
+    _rows = rows;
+    _cols = cols;
+    _row = 0;
+    _pos = 0;
+    _rSampling = false;
+    _rBusy = true;
+    _rGen++;
+
+    //  Move to the first point, both axes move at the same time
+    dh = fabsf(HAL_RAD_GetHorAngle() - _grid.hMin);
+    dv = fabsf(HAL_RAD_GetVerAngle() - _grid.vMin);
+    HAL_RAD_Enable(true);
+    HAL_RAD_SetVerAngle(_grid.vMin);
+    HAL_RAD_SetHorAngle(_grid.hMin);
+    _ScheduleStep(RADAR_T_RASTER_STEP, SettleTime((dh > dv) ? dh : dv));
+
+    return STATUS_OK;
+#else
+    return STATUS_PROG_ERR;
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Abort raster scan or sweep in progress (if any), image hook isn't called
+ */
+void RadarModule::StopRaster()
+{
+    _rBusy = false;
+    _rGen++;
+}
+
+/**
+ * Check if a raster scan or sweep is in progress
+ * @return true if raster scan or sweep is in progress
+ */
+bool RadarModule::RasterBusy()
+{
+    return _rBusy;
+}
+
+/**
+ * Register hook to user function called every time a raster scan is completed
+ * @param funPoint pointer to a user function taking depth image, variance of
+ * its points, number of its rows and columns
+ */
+void RadarModule::AddImageHook(void((*funPoint)(const uint16_t*,
+                                                const uint16_t*, uint16_t,
+                                                uint16_t)))
+{
+    imgHook = funPoint;
+}
+
+/**
+ * Configure multi-sample filter applied at every point of a raster scan (see
+ * struct _radFilter)
+ * @param n number of samples per point (1 to RADAR_SAMPLES_MAX)
+ * @param mode one of RADAR_FILT_* modes
+ * @param trim number of lowest and highest samples dropped in trimmed mean
+ * (ignored in other modes), has to leave at least one sample
+ * @param period time between two samples in us (at least RADAR_PERIOD_MIN)
+ * @return error-code, one of STATUS_* macros from myLib.h (STATUS_PROG_ERR if
+ * a scan is in progress)
+ */
+uint32_t RadarModule::SetFilter(uint8_t n, uint8_t mode, uint8_t trim,
+                                uint16_t period)
+{
+    if (_rBusy)
+        return STATUS_PROG_ERR;
+    if ((n == 0) || (n > RADAR_SAMPLES_MAX) || (mode > RADAR_FILT_TRIM) ||
+        (period < RADAR_PERIOD_MIN))
+        return STATUS_ARG_ERR;
+    if ((mode == RADAR_FILT_TRIM) && ((2 * trim) >= n))
+        return STATUS_ARG_ERR;
+
+    _filt.n = n;
+    _filt.mode = mode;
+    _filt.trim = (mode == RADAR_FILT_TRIM) ? trim : 0;
+    _filt.period = period;
+
+    return STATUS_OK;
+}
+
+/**
+ * Get horizontal angles of the columns of the last depth image (raster scan
+ * or sweep), column i is at angle [from] + i * [step]
+ * @param from [out] angle of the first column in degrees
+ * @param step [out] angle between two columns in degrees (negative if the
+ * sweep went towards smaller angles)
+ */
+void RadarModule::ImageAngles(float *from, float *step)
+{
+    *from = _imgFrom;
+    *step = _imgStep;
+}
+
+/**
+ * Start continuous sweep of horizontal axis
+ * Gimbal is first moved to the starting angle and then sent to the end angle
+ * in a single move. While the servo travels the sensor is sampled every
+ * RADAR_SWEEP_TICK ms, angle of each sample is interpolated from its timestamp
+ * using the servo model. Samples are averaged into [points] equally spaced
+ * points, points with no sample are interpolated from their neighbors. Result
+ * is passed to image hook as a single row of distances in mm, along with
+ * variance of samples averaged into each point. A full 160 deg
+ * sweep takes about half a second (default servo model) but angular
+ * resolution is limited by sensor refresh (~38ms) and accuracy of the model.
+ * @param from starting horizontal angle
+ * @param to end horizontal angle (can be smaller than [from])
+ * @param ver vertical angle to sweep at
+ * @param points number of points in the result (2 to RADAR_COLS_MAX)
+ * @return error-code, one of STATUS_* macros from myLib.h (STATUS_PROG_ERR if
+ * a scan is already in progress)
+ */
+uint32_t RadarModule::Sweep(float from, float to, float ver, uint16_t points)
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    float dh, dv;
+
+    if (_rBusy || (_img == 0))
+        return STATUS_PROG_ERR;
+    //  Written so that NaN fails the checks as well
+    if (!(from >= 0) || !(from <= RADAR_ANGLE_MAX) ||
+        !(to >= 0) || !(to <= RADAR_ANGLE_MAX) || !(from != to) ||
+        !(ver >= 0) || !(ver <= RADAR_ANGLE_MAX) ||
+        (points < 2) || (points > RADAR_COLS_MAX))
+        return STATUS_ARG_ERR;
+
+    _swFrom = from;
+    _swTo = to;
+    _imgFrom = from;
+    _imgStep = (to - from) / (points - 1);
+    _swMoving = false;
+    _swTravel = (uint32_t)(fabsf(to - from) * 1000.0f / _servo.speed);
+    memset((void*)_swSum, 0, sizeof(_swSum));
+    memset((void*)_swSq, 0, sizeof(_swSq));
+    memset((void*)_swCnt, 0, sizeof(_swCnt));
+    _rows = 1;
+    _cols = points;
+    _rBusy = true;
+    _rGen++;
+
+    dh = fabsf(HAL_RAD_GetHorAngle() - from);
+    dv = fabsf(HAL_RAD_GetVerAngle() - ver);
+    HAL_RAD_Enable(true);
+    HAL_RAD_SetVerAngle(ver);
+    HAL_RAD_SetHorAngle(from);
+    _ScheduleStep(RADAR_T_SWEEP_STEP, SettleTime((dh > dv) ? dh : dv));
+
+    return STATUS_OK;
+#else
+    return STATUS_PROG_ERR;
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Calibrate servo model used to derive settling time of the gimbal moves
+ * (see struct _radServo)
+ * @param speed angular speed of the servo in deg/s
+ * @param dead fixed time added to every move in ms
+ * @return error-code, one of STATUS_* macros from myLib.h
+ */
+uint32_t RadarModule::SetServoModel(float speed, uint16_t dead)
+{
+    if (!(speed > 0))
+        return STATUS_ARG_ERR;
+
+    _servo.speed = speed;
+    _servo.dead = dead;
+
+    return STATUS_OK;
+}
+
+/**
+ * Get time gimbal needs to settle after moving through a given angle
+ * @param delta angle moved through in degrees (sign is ignored)
+ * @return settling time in ms, according to servo model
+ */
+uint16_t RadarModule::SettleTime(float delta)
+{
+    return _servo.dead + (uint16_t)(fabsf(delta) * 1000.0f / _servo.speed + 0.5f);
+}
 /**
  * Perform scan with radar and pass the results into the argument array
  * @param data pointer to array of min 160 sensor measurements
@@ -249,7 +699,7 @@ uint32_t RadarModule::Scan(uint8_t *data, uint16_t *length)
 	 */
 	float angle = 0,
 	      step = 0.125f;
-	uint32_t dist, 		    //  Distance in cm, value returned from ADC module
+	uint32_t dist, 		    //  Distance in mm, value returned from ADC module
 			 angleAvg = 0,	//  Temp. variable to calculate average of 8 readings
 			 angleCount = 0;//  Counts number of measurements
 
@@ -265,7 +715,7 @@ uint32_t RadarModule::Scan(uint8_t *data, uint16_t *length)
 	        HAL_RAD_SetVerAngle(100);
 
 	//  Time for sensor to position itself to starting point
-	HAL_DelayUS(30000);
+	HAL_DelayUS(1000 * SettleTime(RADAR_ANGLE_MAX));
 
 	/*
 	 * Start scan with radar turned to the right (~10�), scan from right to
@@ -279,32 +729,13 @@ uint32_t RadarModule::Scan(uint8_t *data, uint16_t *length)
 	{
 		//  Change the angle of radar
 	    HAL_RAD_SetHorAngle(angle);
-	    HAL_DelayUS(40000);	//  Settling time 40ms/1deg
+	    HAL_DelayUS(1000 * SettleTime(step));
 
 		//  Trigger AD conversion, wait for data-ready flag and read data
 	    dist = HAL_RAD_ADCTrigger();
 
-	    //  Convert ADC readout to cm (according to datasheet graph)
-	    if ( dist>2860 ) dist=10;
-	    else if ( (dist<=2860) && (dist>2020) )
-	    	dist = interpolate(2860,10,2020,15,dist);
-	    else if ( (dist<=2020) && (dist>1610) )
-	    	dist = interpolate(2020,15,1610,20,dist);
-	    else if ( (dist<=1610) && (dist>1340) )
-	    	dist = interpolate(1610,20,1340,25,dist);
-	    else if ( (dist<=1340) && (dist>1140) )
-	    	dist = interpolate(1340,25,1140,30,dist);
-	    else if ( (dist<=1140) && (dist>910) )
-	    	dist = interpolate(1140,30,910,40,dist);
-	    else if ( (dist<=910) && (dist>757) )
-	    	dist = interpolate(910,40,757,50,dist);
-	    else if ( (dist<=757) && (dist>640) )
-	    	dist = interpolate(757,50,640,60,dist);
-	    else if ( (dist<=640) && (dist>540) )
-	    	dist = interpolate(640,60,540,70,dist);
-	    else if ( (dist<=540) && (dist>508) )
-	    	dist = interpolate(540,70,508,80,dist);
-	    else if ( (dist<=508)) dist=80;
+	    //  Convert ADC readout to distance in mm
+	    dist = Distance(dist);
 
 	    //  Sum current distance with previous, to calculate average later
 	    angleAvg += dist;
@@ -313,7 +744,8 @@ uint32_t RadarModule::Scan(uint8_t *data, uint16_t *length)
 	    //  Check if the distance is to be saved to array
 	    if ((angleCount % 8) == 0)
 	    {
-	    	data[(angleCount/8)-1] = (angleAvg / 8) & 0xFF;
+	    	//  Average is kept in mm and only rounded to cm when saved
+	    	data[(angleCount/8)-1] = ((angleAvg / 8 + 5) / 10) & 0xFF;
 	    	angleAvg = 0;
 	    }
 
@@ -402,12 +834,45 @@ void RadarModule::SetVerAngle(float angle)
     HAL_RAD_SetVerAngle(angle); //  Direct call to HAL
 }
 
+/**
+ * Get current horizontal angle of radar (0° right, 160° left)
+ * @return horizontal angle in degrees
+ */
+float RadarModule::GetHorAngle()
+{
+    return HAL_RAD_GetHorAngle();   //  Direct call to HAL
+}
+
+/**
+ * Get current vertical angle of radar (0° up, 160° down)
+ * @return vertical angle in degrees
+ */
+float RadarModule::GetVerAngle()
+{
+    return HAL_RAD_GetVerAngle();   //  Direct call to HAL
+}
+
 ///-----------------------------------------------------------------------------
 ///                      Class constructor & destructor              [PROTECTED]
 ///-----------------------------------------------------------------------------
 
-RadarModule::RadarModule() : _scanComplete(false), _scanData(0), _fineScan(false)
+RadarModule::RadarModule() : imgHook(0), _scanComplete(false), _scanData(0),
+                             _fineScan(false), _rBusy(false), _rGen(0),
+                             _rows(0), _cols(0), _row(0), _pos(0),
+                             _rSampling(false), _img(0), _var(0),
+                             _imgFrom(0), _imgStep(0),
+                             _swFrom(0), _swTo(0), _swMoving(false),
+                             _swStart(0), _swTravel(0)
 {
+    _servo.speed = RADAR_SERVO_SPEED;
+    _servo.dead = RADAR_SERVO_DEAD;
+    _filt.n = RADAR_FILT_SAMPLES;
+    _filt.mode = RADAR_FILT_MEDIAN;
+    _filt.trim = 0;
+    _filt.period = RADAR_FILT_PERIOD;
+    SetCalibration(_radCalADC, _radCalDist,
+                   sizeof(_radCalADC) / sizeof(_radCalADC[0]));
+
 #ifdef __HAL_USE_EVENTLOG__
     EMIT_EV(-1, EVENT_UNINITIALIZED);
 #endif  /* __HAL_USE_EVENTLOG__ */
@@ -416,4 +881,233 @@ RadarModule::RadarModule() : _scanComplete(false), _scanData(0), _fineScan(false
 RadarModule::~RadarModule()
 {}
 
+///-----------------------------------------------------------------------------
+///                      Private member functions                      [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Single step of raster scan. Once the gimbal has settled at a point sampling
+ * is started and the step is scheduled again for when it should be done. Then
+ * samples are filtered into depth image and the gimbal is moved to the next
+ * point, next step is scheduled after the settling time of the move; on the
+ * last point scan is completed and image passed to the hook
+ */
+void RadarModule::_RasterStep()
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    uint16_t col, delay;
+
+    //  Sampling (possibly left over from an aborted scan) still in progress
+    if (!HAL_RAD_SampleDone())
+    {
+        _ScheduleStep(RADAR_T_RASTER_STEP, 1);
+        return;
+    }
+
+    if (!_rSampling)
+    {
+        _rSampling = true;
+        HAL_RAD_SampleStart(_smp, _filt.n, _filt.period);
+        //  Round up to whole ms
+        delay = ((uint32_t)_filt.n * _filt.period + 999) / 1000;
+        _ScheduleStep(RADAR_T_RASTER_STEP, delay);
+        return;
+    }
+    _rSampling = false;
+
+    //  Odd rows are scanned with decreasing horizontal angle
+    col = (_row & 1) ? (_cols - 1 - _pos) : _pos;
+    _Filter(&_img[_row * _cols + col], &_var[_row * _cols + col]);
+    _pos++;
+
+    if (_pos < _cols)
+    {
+        col = (_row & 1) ? (_cols - 1 - _pos) : _pos;
+        HAL_RAD_SetHorAngle(_grid.hMin + col * _grid.hStep);
+        delay = (_grid.settle == RADAR_SETTLE_AUTO) ?
+                SettleTime(_grid.hStep) : _grid.settle;
+    }
+    else if ((_row + 1) < _rows)
+    {
+        //  Next row starts at the end where this one finished
+        _row++;
+        _pos = 0;
+        HAL_RAD_SetVerAngle(_grid.vMin + _row * _grid.vStep);
+        delay = (_grid.rowSettle == RADAR_SETTLE_AUTO) ?
+                SettleTime(_grid.vStep) : _grid.rowSettle;
+    }
+    else
+    {
+        _rBusy = false;
+        if (imgHook != 0)
+            imgHook(_img, _var, _rows, _cols);
+        return;
+    }
+
+    _ScheduleStep(RADAR_T_RASTER_STEP, delay);
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Single step of continuous sweep: on the first one servo is sent to the end
+ * angle, on every one sensor is sampled while servo is still moving. Sweep is
+ * completed once the servo has settled at the end angle
+ */
+void RadarModule::_SweepStep()
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    uint32_t now = (uint32_t)msSinceStartup, t;
+    uint16_t dist = Distance(HAL_RAD_ADCTrigger());
+
+    if (!_swMoving)
+    {
+        HAL_RAD_SetHorAngle(_swTo);
+        _swStart = now;
+        _swMoving = true;
+    }
+
+    //  Servo is still moving towards the end angle when sample was measured
+    t = now - _swStart;
+    t = (t > RADAR_SENSOR_LAG) ? (t - RADAR_SENSOR_LAG) : 0;
+    if (t <= _swTravel)
+    {
+        float frac = (_swTravel > 0) ? ((float)t / (float)_swTravel) : 1.0f;
+        uint16_t i = (uint16_t)(frac * (_cols - 1) + 0.5f);
+
+        //  Point has plenty of samples once its count saturates
+        if (_swCnt[i] < 0xFFFF)
+        {
+            _swSum[i] += dist;
+            _swSq[i] += (uint32_t)dist * dist;
+            _swCnt[i]++;
+        }
+    }
+    else if ((now - _swStart) >= (_swTravel + _servo.dead))
+    {
+        _SweepDone();
+        return;
+    }
+
+    _ScheduleStep(RADAR_T_SWEEP_STEP, RADAR_SWEEP_TICK);
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
+/**
+ * Complete continuous sweep: average samples of every point, fill points
+ * with no samples by linear interpolation and pass result to image hook.
+ * Interpolated points get variance of RADAR_VAR_MAX, ones with a single
+ * sample variance of 0
+ */
+void RadarModule::_SweepDone()
+{
+    int32_t prev = -1;
+    uint16_t i, j;
+
+    //  Point with index 0 is at [_swFrom], _cols-1 at [_swTo]
+    for (i = 0; i < _cols; i++)
+    {
+        if (_swCnt[i] == 0)
+            continue;
+
+        _img[i] = _swSum[i] / _swCnt[i];
+        _var[i] = _Variance(_swSum[i], _swSq[i], _swCnt[i]);
+        //  Fill the gap since the previous point with samples
+        for (j = prev + 1; j < i; j++)
+        {
+            _img[j] = (prev < 0) ? _img[i] :
+                      interpolate(prev, _img[prev], i, _img[i], j);
+            _var[j] = RADAR_VAR_MAX;
+        }
+        prev = i;
+    }
+    //  Past the last point with samples (there's always at least one)
+    for (j = prev + 1; j < _cols; j++)
+    {
+        _img[j] = (prev < 0) ? 0 : _img[prev];
+        _var[j] = RADAR_VAR_MAX;
+    }
+
+    _rBusy = false;
+    if (imgHook != 0)
+        imgHook(_img, _var, 1, _cols);
+}
+
+/**
+ * Reduce samples collected at a point of raster scan to a single distance
+ * using configured filter. Variance is computed over all samples, so spikes
+ * removed by the filter still lower confidence of the point
+ * @param dist [out] filtered distance in mm
+ * @param var [out] variance of samples in mm^2
+ */
+void RadarModule::_Filter(uint16_t *dist, uint16_t *var)
+{
+    uint16_t d[RADAR_SAMPLES_MAX], tmp;
+    uint32_t sum = 0;
+    uint64_t sq = 0;
+    uint8_t n = _filt.n, i, j;
+
+    //  Translate to distance and sort (insertion sort, only a few samples)
+    for (i = 0; i < n; i++)
+    {
+        tmp = Distance(_smp[i]);
+        sum += tmp;
+        sq += (uint32_t)tmp * tmp;
+
+        for (j = i; (j > 0) && (d[j-1] > tmp); j--)
+            d[j] = d[j-1];
+        d[j] = tmp;
+    }
+    *var = _Variance(sum, sq, n);
+
+    switch (_filt.mode)
+    {
+    case RADAR_FILT_MEDIAN:
+        *dist = (n & 1) ? d[n/2] : (d[n/2 - 1] + d[n/2] + 1) / 2;
+        break;
+    case RADAR_FILT_TRIM:
+        sum = 0;
+        for (i = _filt.trim; i < (n - _filt.trim); i++)
+            sum += d[i];
+        n -= 2 * _filt.trim;
+        *dist = (sum + n/2) / n;
+        break;
+    default:
+        *dist = (sum + n/2) / n;
+        break;
+    }
+}
+
+/**
+ * Compute variance of samples from their sum and sum of squares
+ * @param sum sum of samples
+ * @param sq sum of squares of samples
+ * @param n number of samples
+ * @return variance, saturated at RADAR_VAR_MAX (also returned if n is 0)
+ */
+uint16_t RadarModule::_Variance(uint32_t sum, uint64_t sq, uint32_t n)
+{
+    uint64_t var;
+
+    if (n == 0)
+        return RADAR_VAR_MAX;
+
+    //  n * sum(x^2) - sum(x)^2 equals n^2 * variance
+    var = ((uint64_t)n * sq - (uint64_t)sum * sum) / ((uint64_t)n * n);
+
+    return (var > RADAR_VAR_MAX) ? RADAR_VAR_MAX : (uint16_t)var;
+}
+
+/**
+ * Schedule next step of a raster scan or a sweep
+ * @param task service to schedule (RADAR_T_RASTER_STEP or RADAR_T_SWEEP_STEP)
+ * @param delay time from now in ms
+ */
+void RadarModule::_ScheduleStep(uint8_t task, uint16_t delay)
+{
+#if defined(__USE_TASK_SCHEDULER__)
+    TaskScheduler::GetP()->SyncTask(RADAR_UID, task, -(int64_t)delay);
+    TaskScheduler::GetP()->AddArg<uint8_t>(_rGen);
+#endif  /* __USE_TASK_SCHEDULER__ */
+}
+
 #endif  /* __HAL_USE_RADAR__ */
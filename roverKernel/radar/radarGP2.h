@@ -6,7 +6,7 @@
  *
  *  IR-sensor based radar (on 2D gimbal)
  *  (library Infrared Proximity Sensor, Sharp GP2Y0A21YK)
- *  @version 1.3.0
+ *  @version 1.7.1
  *  v1.1
  *  +Packed sensor functions and data into a C++ object
  *  V1.2
@@ -24,6 +24,35 @@
  *  -Removed fine scanning option
  *  *Radar scan implemented through series of periodic tasks in task scheduler
  *  in order to avoid long hangs while scanning
+ *  V1.3.1 - 19.10.2026
+ *  +Added getters for current horizontal and vertical angle of the gimbal
+ *  V1.4.0 - 19.10.2026
+ *  +ADC readout is translated into distance through a lookup table (one entry
+ *  per ADC code, in mm) shared by both scan paths, built from calibration
+ *  points which can be uploaded at runtime (RADAR_T_CALIBRATE)
+ *  V1.5.0 - 19.10.2026
+ *  +Raster scan (RasterScan): gimbal is moved over a 2D grid of horizontal &
+ *  vertical angles in serpentine order, producing a depth image. Scan runs as
+ *  a series of one-shot tasks each rescheduling the next one after the
+ *  settling time, so it never blocks the task scheduler
+ *  V1.6.0 - 19.10.2026
+ *  +Settling time of a move is derived from the angle moved through a
+ *  calibratable servo model (SetServoModel, RADAR_T_SERVO) instead of fixed
+ *  40ms, used by all scans
+ *  +Continuous sweep (Sweep): servo is moved across the whole range in one go
+ *  while sensor is sampled, each sample is placed at the angle interpolated
+ *  from its timestamp
+ *  V1.7.0 - 19.10.2026
+ *  +Raster scan collects several samples at every point in the background
+ *  (timer-triggered ADC, uDMA) and reduces them with a configurable filter
+ *  (mean, median, trimmed mean - SetFilter, RADAR_T_FILTER)
+ *  +Variance of samples of every point is passed to image hook along with the
+ *  depth image as confidence of the point (raster scan & sweep)
+ *  V1.7.1 - 19.10.2026
+ *  +Getter for horizontal angles of columns of the last depth image
+ *  V1.7.2 - 19.10.2026
+ *  *Bugfix: Sample count of a sweep point wrapped after 255 samples (slow
+ *  servo, few points), point got wrong mean & variance or was left out
  */
 #include "hwconfig.h"
 
@@ -47,9 +76,99 @@
     #define RADAR_T_SETH            1   //  Set horizontal angle for radar
     #define RADAR_T_SETV            2   //  Set vertical angle of radar
     #define RADAR_T_BLOCKINGSCAN    3   //  Change of angle and measurement
+    #define RADAR_T_CALIBRATE       4   //  Load new calibration of the sensor
+    #define RADAR_T_RASTER          5   //  Start raster scan (depth image)
+    #define RADAR_T_RASTER_STEP     6   //  Measure & move to next grid point
+    #define RADAR_T_RASTER_STOP     7   //  Abort raster scan in progress
+    #define RADAR_T_SWEEP           8   //  Start continuous sweep
+    #define RADAR_T_SWEEP_STEP      9   //  Sample sensor during the sweep
+    #define RADAR_T_SERVO           10  //  Calibrate servo model
+    #define RADAR_T_FILTER          11  //  Configure multi-sample filter
 
 #endif /* __USE_TASK_SCHEDULER__ */
 
+//  Number of possible ADC readouts (12-bit ADC), size of lookup table
+#define RADAR_ADC_CODES     4096
+//  Max number of calibration points
+#define RADAR_CAL_MAX       16
+
+//  Max number of points in depth image of a raster scan, and in a single row
+#define RADAR_IMG_MAX       4096
+#define RADAR_COLS_MAX      512
+//  Limits of gimbal angles in degrees
+#define RADAR_ANGLE_MAX     160.0f
+
+/**
+ * Grid of a raster scan, angles in degrees and times in ms. Rows are
+ * vertical angles from vMin to vMax, columns horizontal angles from hMin to
+ * hMax. Even rows are scanned with increasing horizontal angle, odd ones with
+ * decreasing, so the gimbal never has to swing back across the whole row
+ */
+struct _radGrid
+{
+    float       hMin;
+    float       hMax;
+    float       hStep;
+    float       vMin;
+    float       vMax;
+    float       vStep;
+    uint16_t    settle;     //  Settling time after a horizontal step
+    uint16_t    rowSettle;  //  Settling time after moving to the next row
+};
+//  Pass as settling time of a raster scan to derive it from servo model
+#define RADAR_SETTLE_AUTO   0
+
+/**
+ * Servo model: a move through [delta] degrees settles in
+ *      dead + |delta| / speed * 1000 [ms]
+ * Dead time covers servo ringing and sensor refresh, sensor updates its
+ * output every 38 +/- 10ms so a fresh measurement at the new angle is only
+ * available that long after the servo arrives
+ */
+struct _radServo
+{
+    float       speed;      //  Angular speed of the servo in deg/s
+    uint16_t    dead;       //  Fixed time added to every move in ms
+};
+#define RADAR_SERVO_SPEED   300.0f
+#define RADAR_SERVO_DEAD    40
+
+/*
+ * Continuous sweep: sensor is sampled every RADAR_SWEEP_TICK ms while the
+ * servo moves. Sensor output lags the measurement, samples are placed at the
+ * angle the servo was at RADAR_SENSOR_LAG ms before they were taken
+ */
+#define RADAR_SWEEP_TICK    5
+#define RADAR_SENSOR_LAG    19
+
+/**
+ * Multi-sample filter of raster scan: once the gimbal settles at a point [n]
+ * samples are collected every [period] us and reduced to a single distance
+ * according to [mode]. Samples are translated to distance before filtering.
+ * Sensor refreshes its output only every ~38ms so the filter mostly removes
+ * ADC noise and spikes caused by sensor's LED pulses, not measurement error
+ */
+struct _radFilter
+{
+    uint8_t     n;          //  Samples per point
+    uint8_t     mode;       //  One of RADAR_FILT_* modes
+    uint8_t     trim;       //  Lowest & highest samples dropped (trimmed mean)
+    uint16_t    period;     //  Time between samples in us
+};
+#define RADAR_FILT_MEAN     0   //  Mean of all samples
+#define RADAR_FILT_MEDIAN   1   //  Median of samples
+#define RADAR_FILT_TRIM     2   //  Mean without [trim] lowest & highest samples
+#define RADAR_SAMPLES_MAX   64
+//  Shortest time between samples in us (conversion with 64x hardware
+//  averaging takes 32us)
+#define RADAR_PERIOD_MIN    50
+//  Default filter: median of 8 samples taken 1ms apart
+#define RADAR_FILT_SAMPLES  8
+#define RADAR_FILT_PERIOD   1000
+//  Variance (in mm^2) is saturated at this value, also reported for points
+//  that have no samples of their own
+#define RADAR_VAR_MAX       0xFFFF
+
 /**
  * Class object representing IR radar module
  * Provides a high-level interface to a radar module. Supports repositioning the
@@ -71,9 +190,28 @@ class RadarModule
 		uint32_t    Scan(bool hook = false);
 		bool        ScanReady();
 		void        ReadBuffer(uint8_t *buffer, uint16_t *bufferLen);
+		uint32_t    SetCalibration(const uint16_t *adc, const uint16_t *dist,
+		                           uint8_t n);
+		uint16_t    Distance(uint32_t adc);
+
+		uint32_t    RasterScan(const struct _radGrid *grid);
+		void        StopRaster();
+		bool        RasterBusy();
+		void        AddImageHook(void((*funPoint)(const uint16_t*,
+		                                          const uint16_t*, uint16_t,
+		                                          uint16_t)));
+		uint32_t    SetFilter(uint8_t n, uint8_t mode, uint8_t trim,
+		                      uint16_t period);
+		void        ImageAngles(float *from, float *step);
+		uint32_t    Sweep(float from, float to, float ver, uint16_t points);
+
+		uint32_t    SetServoModel(float speed, uint16_t dead);
+		uint16_t    SettleTime(float delta);
 
 		void SetHorAngle(float angle);
         void SetVerAngle(float angle);
+        float GetHorAngle();
+        float GetVerAngle();
 
         /**
          * Hook to user routine called when the scan is complete
@@ -81,6 +219,17 @@ class RadarModule
          * @param uint16_t* Length of buffer (either 160(coarse) or 1280(fine))
          */
         void    ((*custHook)(uint8_t*, uint16_t*));
+        /**
+         * Hook to user routine called when a raster scan is complete
+         * @param const uint16_t* Depth image, distance in mm of each point
+         * stored row by row (rows x cols)
+         * @param const uint16_t* Variance of samples of each point in mm^2,
+         * same layout as depth image (lower is more confident)
+         * @param uint16_t Number of rows (vertical angles)
+         * @param uint16_t Number of columns (horizontal angles)
+         */
+        void    ((*imgHook)(const uint16_t*, const uint16_t*, uint16_t,
+                            uint16_t));
 
 	protected:
         RadarModule();
@@ -94,6 +243,49 @@ class RadarModule
 		uint8_t *_scanData;
 		//  Flag for user to request fine scan
 		bool    _fineScan;
+		//  Distance in mm for every possible ADC readout
+		uint16_t _lut[RADAR_ADC_CODES];
+
+		void    _RasterStep();
+		void    _SweepStep();
+		void    _SweepDone();
+		void    _Filter(uint16_t *dist, uint16_t *var);
+		static uint16_t _Variance(uint32_t sum, uint64_t sq, uint32_t n);
+		void    _ScheduleStep(uint8_t task, uint16_t delay);
+
+		struct _radServo _servo;
+		struct _radFilter _filt;
+
+		//  State of raster scan
+		struct _radGrid _grid;
+		bool        _rBusy;
+		//  Incremented on every start/stop, steps of an older scan still in
+		//  task queue carry stale value and are ignored
+		uint8_t     _rGen;
+		uint16_t    _rows;
+		uint16_t    _cols;
+		uint16_t    _row;   //  Row being scanned
+		uint16_t    _pos;   //  Points of current row already measured
+		//  Samples of current point are being collected
+		bool        _rSampling;
+		uint16_t    _smp[RADAR_SAMPLES_MAX];
+		//  Depth image and variance of its points (allocated on startup)
+		uint16_t    *_img;
+		uint16_t    *_var;
+		//  Horizontal angle of the first column of the image and between
+		//  two columns (negative if angle decreases)
+		float       _imgFrom;
+		float       _imgStep;
+		//  State of continuous sweep, samples falling at the same point are
+		//  averaged (sum, sum of squares & count per point)
+		float       _swFrom;
+		float       _swTo;
+		bool        _swMoving;  //  Servo has been sent to the end angle
+		uint32_t    _swStart;   //  Time servo was sent to the end angle, ms
+		uint32_t    _swTravel;  //  Time servo needs to reach the end angle, ms
+		uint32_t    _swSum[RADAR_COLS_MAX];
+		uint64_t    _swSq[RADAR_COLS_MAX];
+		uint16_t    _swCnt[RADAR_COLS_MAX];
 		//  Interface with task scheduler - provides memory space and function
 		//  to call in order for task scheduler to request service from this module
 #if defined(__USE_TASK_SCHEDULER__)
@@ -5,6 +5,7 @@
  *      Author: Vedran
  */
 #include "linkedList.h"
+#include <new>
 #ifdef __DEBUG_SESSION__
 #include "serialPort/uartHW.h"
 #endif
@@ -42,18 +43,26 @@ LinkedList::~LinkedList()
  * @note If new task has same _timestamp value (time to be executed at) as the
  * task already in the list, new task is placed after the existing one
  * @param arg task to add to the list
- * @return pointer to the instance of task inside the list
+ * @return pointer to the instance of task inside the list, 0 if there's no
+ * memory left for a new node (list is unchanged)
  */
 volatile _llnode* LinkedList::AddSort(TaskEntry &arg) volatile
 {
-    volatile _llnode *tmp = new _llnode(arg),//  Create new node on the free store
+    //  Create new node on the free store
+    volatile _llnode *tmp = new (std::nothrow) _llnode(arg),
              *node = head;           //  Define starting node
 
+    //  Free store is exhausted, task can't be added
+    if (tmp == 0)
+        return 0;
+
     //  Update PID of a task -> only if it doesn't already have one
     if (tmp->data._PID == 0)
     {
         tmp->data._PID = _pidCount;
-        _pidCount++;
+        //  PID 0 is reserved for 'no PID', skip it when counter wraps around
+        if (++_pidCount == 0)
+            _pidCount = 1;
     }
     //  Find where to insert new node(worst-case: end of the list)
     while (node != 0)
@@ -237,6 +237,52 @@ const TaskEntry* TaskScheduler::FetchNextTask(bool fromStart) volatile
     return (TaskEntry*)(&(task->data));
 }
 
+/**
+ * Copy metadata of tasks currently in task list into a buffer. Whole list is
+ * walked in a single critical section so the snapshot is consistent, only
+ * fixed-size data is copied (no arguments, no allocation) to keep it short.
+ * @param buf buffer to copy task data into
+ * @param maxN maximum number of entries [buf] can hold
+ * @param libUID copy only tasks requesting service from this kernel module,
+ * pass TS_SNAP_ALL to copy all tasks
+ * @return number of tasks matching [libUID] in task list, only the first
+ * [maxN] of them are written into [buf]
+ */
+uint16_t TaskScheduler::Snapshot(struct _taskSnap *buf, uint16_t maxN,
+                                 uint8_t libUID) volatile
+{
+    uint16_t n = 0, total = 0;
+    volatile _llnode *node;
+
+    //  Sensitive task, disable all interrupts
+    IntMasterDisable();
+
+    for (node = _taskLog.head; node != 0; node = node->_next)
+    {
+        if ((libUID != TS_SNAP_ALL) && (node->data._libuid != libUID))
+            continue;
+
+        //  Keep counting tasks that don't fit into the buffer
+        total++;
+        if (n >= maxN)
+            continue;
+
+        buf[n].timestamp = node->data._timestamp;
+        buf[n].period = node->data._period;
+        buf[n].repeats = node->data._repeats;
+        buf[n].PID = node->data._PID;
+        buf[n].libuid = node->data._libuid;
+        buf[n].task = node->data._task;
+        buf[n].perf = node->data._perf;
+        n++;
+    }
+
+    //  Sensitive task done, enable interrupts again
+    IntMasterEnable();
+
+    return total;
+}
+
 /**
  * Add task to the task list in a sorted fashion (ascending sort). Tasks that
  * need to be executed sooner appear at the beginning of the list. If new task
@@ -251,10 +297,13 @@ const TaskEntry* TaskScheduler::FetchNextTask(bool fromStart) volatile
  * @param rep repeat counter. Number of times to repeat the periodic task before
  * killing it. Set to a negative number for indefinite repeat. When scheduled,
  * task WILL BE repeated at least once.
+ * @return PID assigned to the new task, 0 if task couldn't be added
  */
-void TaskScheduler::SyncTask(uint8_t libUID, uint8_t taskID,
-                             int64_t time, bool periodic, int32_t rep) volatile
+uint16_t TaskScheduler::SyncTask(uint8_t libUID, uint8_t taskID,
+                                 int64_t time, bool periodic, int32_t rep) volatile
 {
+    uint16_t retVal;
+
     //  Sensitive task, disable all interrupts
     IntMasterDisable();
 
@@ -302,8 +351,11 @@ void TaskScheduler::SyncTask(uint8_t libUID, uint8_t taskID,
             EMIT_EV(-1, EVENT_ERROR);
         }
 #endif
+        retVal = (_lastIndex != 0) ? _lastIndex->data._PID : 0;
         //  Sensitive task done, enable interrupts again
         IntMasterEnable();
+
+        return retVal;
 }
 
 /**
@@ -319,10 +371,13 @@ void TaskScheduler::SyncTask(uint8_t libUID, uint8_t taskID,
  * @param rep repeat counter. Number of times to repeat the periodic task before
  * killing it. Set to a negative number for indefinite repeat. When scheduled,
  * task WILL BE repeated at least once.
+ * @return PID assigned to the new task, 0 if task couldn't be added
  */
-void TaskScheduler::SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
-                      int32_t period, int32_t rep) volatile
+uint16_t TaskScheduler::SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
+                                    int32_t period, int32_t rep) volatile
 {
+    uint16_t retVal;
+
     //  Sensitive task, disable all interrupts
     IntMasterDisable();
     /*
@@ -368,8 +423,11 @@ void TaskScheduler::SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
             EMIT_EV(-1, EVENT_ERROR);
         }
 #endif
+        retVal = (_lastIndex != 0) ? _lastIndex->data._PID : 0;
         //  Sensitive task done, enable interrupts again
         IntMasterEnable();
+
+        return retVal;
 }
 
 /**
@@ -378,9 +436,12 @@ void TaskScheduler::SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
  * has the same execution time as the task already in the list, it's placed
  * behind the existing task.
  * @param te TaskEntry object to add the the list
+ * @return PID assigned to the new task, 0 if task couldn't be added
  */
-void TaskScheduler::SyncTask(TaskEntry te) volatile
+uint16_t TaskScheduler::SyncTask(TaskEntry te) volatile
 {
+    uint16_t retVal;
+
     //  Sensitive task, disable all interrupts
     IntMasterDisable();
 
@@ -411,8 +472,11 @@ void TaskScheduler::SyncTask(TaskEntry te) volatile
             EMIT_EV(-1, EVENT_ERROR);
         }
 #endif
+        retVal = (_lastIndex != 0) ? _lastIndex->data._PID : 0;
         //  Sensitive task done, enable interrupts again
         IntMasterEnable();
+
+        return retVal;
 }
 
 /**
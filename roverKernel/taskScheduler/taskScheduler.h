@@ -5,7 +5,7 @@
  *      Author: Vedran Mikov
  *
  *  Task scheduler library
- *  @version 2.8.0
+ *  @version 2.10.1
  *  V1.1
  *  +Implementation of queue of tasks with various parameters. Tasks identified
  *      by unique integer number (defined by higher level library)
@@ -54,6 +54,17 @@
  *  +Periodically called functions switched to inline, declared in header
  *  +Implemented kernel callback for TS, allowing enable/disable signal for
  *  SysTick timer to be sent remotely
+ *  V2.9.0 - 19.10.2026
+ *  +SyncTask() & SyncTaskPer() return PID assigned to the new task
+ *  V2.10.0 - 19.10.2026
+ *  +Snapshot() copies metadata of (filtered) tasks into a user-provided buffer
+ *  in a single critical section, safe to iterate while the list changes
+ *  V2.10.1 - 19.10.2026
+ *  +Snapshot() returns number of all matching tasks, also those that didn't
+ *  fit into the buffer
+ *  V2.10.2 - 19.10.2026
+ *  *Bugfix: Task list node was allocated with throwing new and used without a
+ *  check, SyncTask() & SyncTaskPer() now return 0 when free store is exhausted
  *
  *  TODO:
  *  Implement UTC clock feature. If at some point program finds out what the
@@ -90,6 +101,25 @@ struct _kernelEntry
 };
 
 
+/**
+ * Snapshot of a single task as taken by TaskScheduler::Snapshot(). Holds only
+ * task metadata (no arguments) so it can be copied quickly with interrupts
+ * disabled and examined later while the task list keeps changing
+ */
+struct _taskSnap
+{
+    uint32_t    timestamp;      //  Time of next execution (ms since startup)
+    int32_t     period;         //  Period of the task, 0 for non-periodic
+    int32_t     repeats;        //  Remaining repeats, negative if indefinite
+    uint16_t    PID;            //  Unique process ID
+    uint8_t     libuid;         //  Kernel module to request service from
+    uint8_t     task;           //  Service ID
+    Performance perf;           //  Performance data of the task
+};
+
+//  Pass to 'libUID' filter of TaskScheduler::Snapshot() to include all modules
+#define TS_SNAP_ALL (0xFF)
+
 //  Pass to 'repeats' argument for indefinite number of repeats
 #define T_PERIODIC  (-1)
 //  Pass to 'time' for execution as-soon-as-possible
@@ -153,13 +183,15 @@ class TaskScheduler
 
 		uint32_t            NumOfTasks() volatile;
 		const TaskEntry*    FetchNextTask(bool fromStart) volatile;
+		uint16_t            Snapshot(struct _taskSnap *buf, uint16_t maxN,
+		                             uint8_t libUID = TS_SNAP_ALL) volatile;
 
 		//  Adding new tasks
-		void SyncTask(uint8_t libUID, uint8_t taskID, int64_t time,
-		              bool periodic = false, int32_t rep = 0) volatile;
-		void SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
-		                 int32_t period, int32_t rep) volatile;
-		void SyncTask(TaskEntry te) volatile;
+		uint16_t SyncTask(uint8_t libUID, uint8_t taskID, int64_t time,
+		                  bool periodic = false, int32_t rep = 0) volatile;
+		uint16_t SyncTaskPer(uint8_t libUID, uint8_t taskID, int64_t time,
+		                     int32_t period, int32_t rep) volatile;
+		uint16_t SyncTask(TaskEntry te) volatile;
 
 		//  Add arguments for the last task added
 		void AddArgs(void* arg, uint16_t argLen) volatile;
@@ -43,8 +43,9 @@
 
 MEMORY
 {
-    /* Application stored in and executes from internal flash */
-    FLASH (RX) : origin = APP_BASE, length = 0x00100000
+    /* Application stored in and executes from internal flash, last 64kB of */
+    /* flash are kept for data (HAL_FLASH_DATA_BASE in hal_common_tm4c.h)   */
+    FLASH (RX) : origin = APP_BASE, length = 0x000F0000
     /* Application uses internal RAM for data */
     SRAM (RWX) : origin = 0x20000000, length = 0x00040000
 }
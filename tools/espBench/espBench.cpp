@@ -0,0 +1,588 @@
+/**
+ * espBench.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ *
+ *  Host-side (Linux) benchmark of ESP8266 library (roverKernel/esp8266) on
+ *  host HAL (roverKernel/HAL/host) against tools/espEmulator, so numbers are
+ *  repeatable for given emulator settings (latency, baud rate, faults). The
+ *  other end of the sockets is served by the benchmark itself on loopback.
+ *
+ *  Mode 'at' - AT command engine: rounds of independent operations, each an
+ *  AT command (keep-alive check) followed by a send on every one of [-k] TCP
+ *  sockets, are executed
+ *      serialized  caller issues the next operation once the previous one
+ *                  completed (as before the command queue: blocking calls)
+ *      queued      caller queues operations without waiting for them
+ *                  (QueueCmd & SendTCPAsync), engine in UART ISR issues them
+ *                  back to back and caller only waits when a queue is full
+ *  Reported are operations & payload bytes per second, average time caller
+ *  spends in the call issuing an operation (until it completes if serialized,
+ *  waiting for space in a full queue not included) and latency of an
+ *  operation (queued to completed, including time spent in the queue).
+ *
+ *  Mode 'send' - telemetry frames on a TCP socket: [-n] frames are sent with
+ *  AT+CIPSEND (send completes on remote's SEND OK) and with AT+CIPSENDBUF
+ *  (completes once ESP has the payload, see ESP8266::SendBuffered()), each
+ *      burst       all frames queued at once (SendTCPAsync, as DataStream
+ *                  does), gives max frames/s
+ *      paced       next frame is queued once the previous one came back from
+ *                  the echo, gives latency of a single frame
+ *  Reported are frames & payload bytes per second, latency of a frame until
+ *  its send completed and, for paced frames, until it came back (round trip
+ *  through the emulator and echo). If the firmware rejects AT+CIPSENDBUF
+ *  (emulator's -N) library falls back to AT+CIPSEND, which is reported.
+ *      -P port     serial port of the emulator (default ESP_HOST_PORT)
+ *      -e port     loopback port the sockets connect to
+ *      -m mode     benchmark to run (at, send)
+ *      -n count    number of rounds (at) or frames (send)
+ *      -k socks    number of TCP sockets (at)
+ *      -s size     payload of a single send or frame in bytes
+ *
+ *  Build: K=../../roverKernel; g++ -std=gnu++11 -Wall -O2 -D__BOARD_HOST__
+ *             -I $K espBench.cpp $K/esp8266/esp8266.cpp
+ *             $K/esp8266/espClient.cpp $K/esp8266/atTokenizer.cpp
+ *             $K/HAL/host/hal_common_host.c $K/HAL/host/hal_esp_host.c
+ *             $K/libs/myLib.c -lpthread -o espBench
+ *  Usage: ../espEmulator/espEmulator -L /tmp/esp0 -l 20 -j 5 -b 115200 &
+ *         ./espBench [-P /tmp/esp0] [-e 5611] [-m at|send] [-n 100] [-k 2]
+ *                    [-s 64]
+ *  @note Not part of the firmware build (excluded in CCS project)
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Serialized vs. queued AT commands & socket sends
+ *  +Telemetry frames with AT+CIPSEND vs. AT+CIPSENDBUF
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+#include "esp8266/esp8266.h"
+#include "HAL/hal.h"
+
+//  Time allowed for all queued operations to complete, ms
+#define BENCH_TIMEOUT   30000
+//  Max number of operations in a single run (handles are 16-bit)
+#define BENCH_MAX_OPS   30000
+
+///-----------------------------------------------------------------------------
+///                      Configuration & state                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Command-line options
+ */
+struct _benchConfig
+{
+    const char  *port;
+    uint16_t    srvPort;
+    const char  *mode;
+    uint32_t    rounds;
+    uint8_t     socks;
+    uint16_t    size;
+};
+
+/**
+ * Outcome of a single run
+ */
+struct _benchResult
+{
+    uint32_t    ops;        //  Operations completed
+    uint32_t    fails;      //  Operations completed with an error
+    uint64_t    bytes;      //  Payload bytes sent
+    uint64_t    elapsed;    //  From first operation issued to last done, us
+    uint64_t    call;       //  Time caller spent issuing operations, us
+    double      latAvg;     //  Operation latency (queued to done), ms
+    double      latMax;
+    double      echoAvg;    //  Frame latency (queued to echoed back), ms
+};
+
+static struct _benchConfig __cfg = { ESP_HOST_PORT, 5611, "at", 100, 2, 64 };
+//  Time each operation was queued & completed (us, indexed by handle), number
+//  of completed and failed operations (updated from UART ISR)
+static uint64_t __issued[65536];
+static volatile uint64_t __done[65536];
+static volatile uint32_t __doneCnt = 0;
+static volatile uint32_t __failCnt = 0;
+//  Listening socket the ESP sockets connect to, whether data received on
+//  connections is echoed back (otherwise discarded)
+static int __srv = -1;
+static bool __echo = false;
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                              [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Get time in us (monotonic)
+ */
+static uint64_t _Us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Hook called from UART ISR when a socket send completes
+ */
+static void _SendDone(const uint8_t sockID, const uint16_t handle,
+                      const uint32_t status)
+{
+    __done[handle] = _Us();
+    if (!(status & ESP_STATUS_SENDOK))
+        __failCnt++;
+    __doneCnt++;
+}
+
+/**
+ * Hook called from UART ISR when a queued AT command completes
+ */
+static void _CmdDone(const uint16_t handle, const uint32_t status)
+{
+    __done[handle] = _Us();
+    if (status & ESP_STATUS_ERROR)
+        __failCnt++;
+    __doneCnt++;
+}
+
+/**
+ * Server thread, accepts connections from ESP sockets and echoes or discards
+ * whatever is received on them
+ * @param arg unused
+ * @return never returns
+ */
+static void* _ServerThread(void *arg)
+{
+    struct pollfd pfd[1 + ESP_MAX_CLI];
+    int nfd = 1;
+    char buf[2048];
+    ssize_t n;
+
+    pfd[0].fd = __srv;
+    for (int i = 0; i < (1 + ESP_MAX_CLI); i++)
+        pfd[i].events = POLLIN;
+
+    while (poll(pfd, nfd, -1) >= 0)
+    {
+        if ((pfd[0].revents & POLLIN) && (nfd < (1 + ESP_MAX_CLI)))
+            pfd[nfd++].fd = accept(__srv, 0, 0);
+
+        for (int i = 1; i < nfd; i++)
+        {
+            if (!(pfd[i].revents & (POLLIN | POLLHUP)))
+                continue;
+            n = read(pfd[i].fd, buf, sizeof(buf));
+            if ((n > 0) && __echo && (write(pfd[i].fd, buf, n) != n))
+                perror("echo");
+            if (n > 0)
+                continue;
+            //  Connection closed, drop it from the list
+            close(pfd[i].fd);
+            pfd[i--] = pfd[--nfd];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Start server on loopback the ESP sockets connect to
+ * @param port TCP port to listen on
+ * @return true on success
+ */
+static bool _StartServer(uint16_t port)
+{
+    struct sockaddr_in addr;
+    pthread_t thread;
+    int on = 1;
+
+    __srv = socket(AF_INET, SOCK_STREAM, 0);
+    setsockopt(__srv, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(__srv, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+        (listen(__srv, ESP_MAX_CLI) < 0))
+    {
+        perror("bind");
+        return false;
+    }
+
+    return (pthread_create(&thread, 0, _ServerThread, 0) == 0);
+}
+
+/**
+ * Wait until given number of operations completed
+ * @param ops number of operations
+ * @param ms time to wait in ms
+ * @return true if they completed in time
+ */
+static bool _WaitDone(uint32_t ops, uint32_t ms)
+{
+    uint64_t start = _Us();
+
+    while (__doneCnt < ops)
+        if ((_Us() - start) > ((uint64_t)ms * 1000))
+            return false;
+
+    return true;
+}
+
+/**
+ * Fill in latency statistics of a run
+ * @param handles handles of all operations in the run
+ * @param res [out] result to fill in
+ */
+static void _Latency(const std::vector<uint16_t> &handles,
+                     struct _benchResult *res)
+{
+    double sum = 0;
+
+    res->latMax = 0;
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        double lat = (__done[handles[i]] - __issued[handles[i]]) / 1000.0;
+
+        sum += lat;
+        if (lat > res->latMax)
+            res->latMax = lat;
+    }
+    res->latAvg = handles.empty() ? 0 : (sum / handles.size());
+}
+
+/**
+ * Print one line of results
+ * @param name name of the run
+ * @param res results
+ */
+static void _Print(const char *name, const struct _benchResult *res)
+{
+    double s = res->elapsed / 1e6;
+
+    printf("  %-12s %8.1f %11.0f %9.1f %9.1f %9.1f %6u\n", name,
+           res->ops / s, res->bytes / s, (double)res->call / res->ops,
+           res->latAvg, res->latMax, res->fails);
+}
+
+///-----------------------------------------------------------------------------
+///                      Benchmarks                                    [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Run rounds of independent operations (AT command + send on every socket)
+ * @param esp ESP library
+ * @param ids socket IDs
+ * @param queued true to queue operations, false to wait for each of them
+ * @param res [out] results of the run
+ */
+static void _RunAT(ESP8266 &esp, const std::vector<uint8_t> &ids, bool queued,
+                   struct _benchResult *res)
+{
+    std::vector<uint16_t> handles;
+    std::string payload(__cfg.size, 'x');
+    uint64_t start, t;
+    uint16_t h;
+
+    memset(res, 0, sizeof(*res));
+    __doneCnt = 0;
+    __failCnt = 0;
+    start = _Us();
+
+    for (uint32_t r = 0; r < __cfg.rounds; r++)
+    {
+        //  Keep-alive check
+        do
+        {
+            t = _Us();
+            h = esp.QueueCmd("AT", ESP_STATUS_OK, ESP_TIMEOUT_AUTO,
+                             ESP_TX_RETRY, _CmdDone);
+        }
+        while (h == 0);
+        __issued[h] = t;
+        handles.push_back(h);
+        if (!queued)
+            _WaitDone(handles.size(), BENCH_TIMEOUT);
+        res->call += _Us() - t;
+
+        //  Send on every socket
+        for (size_t i = 0; i < ids.size(); i++)
+        {
+            _espClient *cli = esp.GetClientBySockID(ids[i]);
+
+            if (cli == 0)
+                continue;
+            do
+            {
+                t = _Us();
+                h = cli->SendTCPAsync(payload.c_str(), payload.length());
+            }
+            while ((h == 0) && esp.ValidSocket(ids[i]));
+            if (h == 0)
+                continue;
+            __issued[h] = t;
+            handles.push_back(h);
+            res->bytes += payload.length();
+            if (!queued)
+                _WaitDone(handles.size(), BENCH_TIMEOUT);
+            res->call += _Us() - t;
+        }
+    }
+
+    if (!_WaitDone(handles.size(), BENCH_TIMEOUT))
+        fprintf(stderr, "%u operation(s) didn't complete\n",
+                (uint32_t)handles.size() - __doneCnt);
+    res->elapsed = _Us() - start;
+    res->ops = __doneCnt;
+    res->fails = __failCnt;
+    _Latency(handles, res);
+}
+
+/**
+ * Benchmark of AT command engine, serialized vs. queued operations
+ * @param esp ESP library
+ */
+static void _BenchAT(ESP8266 &esp)
+{
+    struct _benchResult ser, que;
+    std::vector<uint8_t> ids;
+
+    for (uint8_t i = 0; i < __cfg.socks; i++)
+    {
+        uint32_t id = esp.OpenTCPSock((char*)"127.0.0.1", __cfg.srvPort);
+
+        if (esp.ValidSocket(id))
+            ids.push_back(id);
+    }
+    if (ids.size() != __cfg.socks)
+        fprintf(stderr, "Only %u socket(s) opened\n", (uint32_t)ids.size());
+
+    printf("AT command engine: %u rounds of AT + %u send(s) of %uB\n",
+           __cfg.rounds, (uint32_t)ids.size(), __cfg.size);
+    printf("  %-12s %8s %11s %9s %9s %9s %6s\n", "", "ops/s", "payload B/s",
+           "call us", "lat ms", "max ms", "fails");
+
+    _RunAT(esp, ids, false, &ser);
+    _Print("serialized", &ser);
+    _RunAT(esp, ids, true, &que);
+    _Print("queued", &que);
+    printf("  queued/serialized: x%.2f ops/s\n",
+           (que.ops * (double)ser.elapsed) / (ser.ops * (double)que.elapsed));
+
+    for (size_t i = 0; i < ids.size(); i++)
+        if (esp.ValidSocket(ids[i]))
+            esp.GetClientBySockID(ids[i])->Close();
+}
+
+/**
+ * Read whatever came back from the echo on a socket
+ * @param cli socket
+ * @return number of bytes read
+ */
+static uint32_t _Drain(_espClient *cli)
+{
+    static char buf[ESP_RX_BUF];
+    uint32_t n = 0;
+    uint16_t len;
+
+    while ((cli != 0) && cli->Receive(buf, &len))
+        n += len;
+
+    return n;
+}
+
+/**
+ * Send frames on TCP socket to the echo
+ * @param esp ESP library
+ * @param id socket ID
+ * @param paced true to send next frame once the previous one came back, false
+ * to queue all of them at once
+ * @param res [out] results of the run
+ */
+static void _RunSend(ESP8266 &esp, uint8_t id, bool paced,
+                     struct _benchResult *res)
+{
+    _espClient *cli = esp.GetClientBySockID(id);
+    std::vector<uint16_t> handles;
+    std::string frame(__cfg.size, 't');
+    uint64_t start, t, echoed = 0, sent = 0;
+    double echoSum = 0;
+    uint16_t h;
+
+    memset(res, 0, sizeof(*res));
+    __doneCnt = 0;
+    __failCnt = 0;
+    start = _Us();
+
+    for (uint32_t i = 0; (cli != 0) && (i < __cfg.rounds); i++)
+    {
+        do
+        {
+            echoed += _Drain(cli);
+            t = _Us();
+            h = cli->SendTCPAsync(frame.c_str(), frame.length());
+        }
+        while ((h == 0) && esp.ValidSocket(id));
+        if (h == 0)
+            break;
+        __issued[h] = t;
+        handles.push_back(h);
+        res->call += _Us() - t;
+        sent += frame.length();
+
+        if (!paced)
+            continue;
+        //  Wait for the frame to come back
+        while ((echoed < sent) && ((_Us() - t) < (BENCH_TIMEOUT * 1000ULL)))
+            echoed += _Drain(cli);
+        echoSum += (_Us() - t) / 1000.0;
+    }
+
+    if (!_WaitDone(handles.size(), BENCH_TIMEOUT))
+        fprintf(stderr, "%u frame(s) didn't complete\n",
+                (uint32_t)handles.size() - __doneCnt);
+    res->elapsed = _Us() - start;
+    res->ops = __doneCnt;
+    res->fails = __failCnt;
+    res->bytes = (uint64_t)__doneCnt * frame.length();
+    res->echoAvg = handles.empty() ? 0 : (echoSum / handles.size());
+    _Latency(handles, res);
+
+    //  Let the rest of the echo arrive so it isn't counted in the next run
+    t = _Us();
+    while ((echoed < sent) && ((_Us() - t) < (BENCH_TIMEOUT * 1000ULL)))
+        echoed += _Drain(cli);
+}
+
+/**
+ * Print one line of results of telemetry frames benchmark
+ * @param name name of the run
+ * @param res results
+ */
+static void _PrintSend(const char *name, const struct _benchResult *res)
+{
+    double s = res->elapsed / 1e6;
+
+    printf("  %-18s %8.1f %11.0f %9.1f %9.1f ", name, res->ops / s,
+           res->bytes / s, res->latAvg, res->latMax);
+    if (res->echoAvg > 0)
+        printf("%9.1f", res->echoAvg);
+    else
+        printf("%9s", "-");
+    printf(" %6u\n", res->fails);
+}
+
+/**
+ * Benchmark of telemetry frames, AT+CIPSEND vs. AT+CIPSENDBUF
+ * @param esp ESP library
+ */
+static void _BenchSend(ESP8266 &esp)
+{
+    struct _benchResult res[4];
+    uint32_t id = esp.OpenTCPSock((char*)"127.0.0.1", __cfg.srvPort);
+    bool bufOK;
+
+    if (!esp.ValidSocket(id))
+    {
+        fprintf(stderr, "Socket not opened\n");
+        return;
+    }
+
+    printf("Telemetry frames: %u frames of %uB on TCP socket\n", __cfg.rounds,
+           __cfg.size);
+    printf("  %-18s %8s %11s %9s %9s %9s %6s\n", "", "frames/s",
+           "payload B/s", "done ms", "max ms", "echo ms", "fails");
+
+    esp.SendBuffered(id, false);
+    _RunSend(esp, id, false, &res[0]);
+    _PrintSend("CIPSEND burst", &res[0]);
+    _RunSend(esp, id, true, &res[1]);
+    _PrintSend("CIPSEND paced", &res[1]);
+
+    esp.SendBuffered(id, true);
+    _RunSend(esp, id, false, &res[2]);
+    bufOK = esp.SendBuffered(id);
+    _PrintSend(bufOK ? "CIPSENDBUF burst" : "(fallback) burst", &res[2]);
+    _RunSend(esp, id, true, &res[3]);
+    _PrintSend(bufOK ? "CIPSENDBUF paced" : "(fallback) paced", &res[3]);
+
+    printf("  CIPSENDBUF/CIPSEND: x%.2f frames/s, x%.2f echo latency\n",
+           (res[2].ops * (double)res[0].elapsed) /
+           (res[0].ops * (double)res[2].elapsed),
+           res[3].echoAvg / res[1].echoAvg);
+
+    if (esp.ValidSocket(id))
+        esp.GetClientBySockID(id)->Close();
+}
+
+int main(int argc, char **argv)
+{
+    ESP8266 &esp = ESP8266::GetI();
+    int opt;
+
+    while ((opt = getopt(argc, argv, "P:e:m:n:k:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'P': __cfg.port = optarg; break;
+        case 'e': __cfg.srvPort = strtoul(optarg, 0, 10); break;
+        case 'm': __cfg.mode = optarg; break;
+        case 'n': __cfg.rounds = strtoul(optarg, 0, 10); break;
+        case 'k': __cfg.socks = strtoul(optarg, 0, 10); break;
+        case 's': __cfg.size = strtoul(optarg, 0, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-P port] [-e serverPort] "
+                    "[-m at|send] [-n count] [-k sockets] [-s size]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if ((__cfg.socks < 1) || (__cfg.socks > (ESP_MAX_CLI - 1)) ||
+        (__cfg.size < 1) || (__cfg.size > ESP_TX_BUF) ||
+        ((__cfg.rounds * (1 + __cfg.socks)) > BENCH_MAX_OPS))
+    {
+        fprintf(stderr, "Invalid number of sockets, size or rounds\n");
+        return 1;
+    }
+
+    __echo = (strcmp(__cfg.mode, "send") == 0);
+    if (!_StartServer(__cfg.srvPort))
+        return 1;
+
+    HAL_ESP_SetPort(__cfg.port);
+    if (!(esp.InitHW() & ESP_STATUS_OK))
+    {
+        fprintf(stderr, "ESP not responding on %s\n", __cfg.port);
+        return 1;
+    }
+    esp.ConnectAP((char*)"emulator", (char*)"password");
+    esp.AddSendHook(_SendDone);
+
+    if (strcmp(__cfg.mode, "at") == 0)
+        _BenchAT(esp);
+    else if (__echo)
+        _BenchSend(esp);
+    else
+    {
+        fprintf(stderr, "Unknown mode %s\n", __cfg.mode);
+        return 1;
+    }
+
+    return 0;
+}
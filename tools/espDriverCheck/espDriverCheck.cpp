@@ -0,0 +1,411 @@
+/**
+ * espDriverCheck.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ *
+ *  Host-side (Linux) check of ESP8266 library (roverKernel/esp8266) running
+ *  on host HAL (roverKernel/HAL/host) against tools/espEmulator. Library is
+ *  compiled unchanged, without task scheduler, with UART interrupt and
+ *  watchdog emulated by host HAL. The check serves the other end of sockets
+ *  itself: TCP and UDP echo on loopback, and a client connecting to the TCP
+ *  server started on ESP. Checked are initialization & connecting to AP,
+ *  blocking, queued and buffered (AT+CIPSENDBUF) sends on TCP socket, UDP
+ *  datagrams, incoming connection to TCP server with data both ways, closing
+ *  sockets from either side and latency tracking of AT commands.
+ *      -P port     serial port of the emulator (default ESP_HOST_PORT)
+ *      -e port     loopback port of TCP & UDP echo
+ *      -S port     port of TCP server started on ESP
+ *      -n msgs     number of messages sent in each send check
+ *  Exit code is the number of failed checks. Checks are expected to pass both
+ *  against a clean link and with faults injected by the emulator, i.e. run
+ *  once as below and once more against 'espEmulator -B 0.05 -s 3' (busy
+ *  replies, recovered by the library's retries).
+ *
+ *  Build: K=../../roverKernel; g++ -std=gnu++11 -Wall -O2 -D__BOARD_HOST__
+ *             -I $K espDriverCheck.cpp $K/esp8266/esp8266.cpp
+ *             $K/esp8266/espClient.cpp $K/esp8266/atTokenizer.cpp
+ *             $K/HAL/host/hal_common_host.c $K/HAL/host/hal_esp_host.c
+ *             $K/libs/myLib.c -lpthread -o espDriverCheck
+ *  Usage: ../espEmulator/espEmulator -L /tmp/esp0 &
+ *         ./espDriverCheck [-P /tmp/esp0] [-e 5601] [-S 5602] [-n 50]
+ *  @note Not part of the firmware build (excluded in CCS project)
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +ESP8266 library on host HAL against the emulator: AP, TCP/UDP sockets,
+ *  TCP server, buffered sends & command latency
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+
+#include "esp8266/esp8266.h"
+#include "HAL/hal.h"
+
+//  Time allowed for data to make it through emulator and back, ms
+#define CHK_TIMEOUT     3000
+
+///-----------------------------------------------------------------------------
+///                      Configuration & state                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Command-line options
+ */
+struct _chkConfig
+{
+    const char  *port;
+    uint16_t    echoPort;
+    uint16_t    servPort;
+    uint32_t    msgs;
+};
+
+static struct _chkConfig __cfg = { ESP_HOST_PORT, 5601, 5602, 50 };
+static uint32_t __fails = 0;
+//  Listening TCP socket & UDP socket of the echo
+static int __echoTCP = -1;
+static int __echoUDP = -1;
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                              [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Report outcome of a single check
+ * @param ok true if check passed
+ * @param name description of the check
+ */
+static void _Check(bool ok, const char *name)
+{
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok)
+        __fails++;
+}
+
+/**
+ * Wait until condition becomes true
+ * @param cond function object returning true once done
+ * @param ms time to wait in ms
+ * @return true if condition became true in time
+ */
+template <class F>
+static bool _Wait(F cond, uint32_t ms)
+{
+    uint32_t start = HAL_MsSinceStartup();
+
+    while (!cond())
+    {
+        if ((HAL_MsSinceStartup() - start) > ms)
+            return false;
+        HAL_DelayUS(1000);
+    }
+
+    return true;
+}
+
+/**
+ * Open loopback socket bound to given port
+ * @param udp true for UDP socket, false for listening TCP socket
+ * @param port port to bind to
+ * @return socket, -1 on error
+ */
+static int _Bind(bool udp, uint16_t port)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0), on = 1;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+        (!udp && (listen(fd, 4) < 0)))
+    {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/**
+ * Echo thread, returns everything received on TCP connections and UDP socket
+ * back to the sender
+ * @param arg unused
+ * @return never returns
+ */
+static void* _EchoThread(void *arg)
+{
+    struct pollfd pfd[2 + ESP_MAX_CLI];
+    int nfd = 2;
+    char buf[2048];
+
+    pfd[0].fd = __echoTCP;
+    pfd[1].fd = __echoUDP;
+    for (int i = 0; i < (2 + ESP_MAX_CLI); i++)
+        pfd[i].events = POLLIN;
+
+    while (poll(pfd, nfd, -1) >= 0)
+    {
+        if ((pfd[0].revents & POLLIN) && (nfd < (2 + ESP_MAX_CLI)))
+            pfd[nfd++].fd = accept(__echoTCP, 0, 0);
+
+        if (pfd[1].revents & POLLIN)
+        {
+            struct sockaddr_in from;
+            socklen_t fromLen = sizeof(from);
+            ssize_t n = recvfrom(__echoUDP, buf, sizeof(buf), 0,
+                                 (struct sockaddr*)&from, &fromLen);
+            if (n > 0)
+                sendto(__echoUDP, buf, n, 0, (struct sockaddr*)&from, fromLen);
+        }
+
+        for (int i = 2; i < nfd; i++)
+        {
+            ssize_t n;
+
+            if (!(pfd[i].revents & (POLLIN | POLLHUP)))
+                continue;
+            n = read(pfd[i].fd, buf, sizeof(buf));
+            if (n > 0)
+            {
+                write(pfd[i].fd, buf, n);
+                continue;
+            }
+            //  Connection closed, drop it from the list
+            close(pfd[i].fd);
+            pfd[i--] = pfd[--nfd];
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Read all messages queued on a socket and append them to [out]
+ * @param cli socket to read from
+ * @param out string to append to
+ * @return number of messages read
+ */
+static uint32_t _Drain(_espClient *cli, std::string &out)
+{
+    static char buf[ESP_RX_BUF];
+    uint16_t len;
+    uint32_t n = 0;
+
+    while ((cli != 0) && cli->Receive(buf, &len))
+    {
+        out.append(buf, len);
+        n++;
+    }
+
+    return n;
+}
+
+/**
+ * Generate message number [i] of a send check
+ * @param tag prefix identifying the check
+ * @param i sequence number
+ * @return message text
+ */
+static std::string _Msg(const char *tag, uint32_t i)
+{
+    char buf[64];
+
+    snprintf(buf, sizeof(buf), "%s%04u:", tag, i);
+    return std::string(buf) + std::string(i % 97, 'a' + (i % 26)) + "\n";
+}
+
+///-----------------------------------------------------------------------------
+///                      Checks                                        [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Send messages on TCP socket to the echo and compare what came back
+ * @param esp ESP library
+ * @param id socket ID
+ * @param async true to queue all sends at once, false to send one by one
+ * @param name description of the check
+ */
+static void _EchoTCP(ESP8266 &esp, uint8_t id, bool async, const char *name)
+{
+    std::string sent, rcvd;
+    _espClient *cli = esp.GetClientBySockID(id);
+    bool ok = (cli != 0);
+
+    for (uint32_t i = 0; ok && (i < __cfg.msgs); i++)
+    {
+        std::string msg = _Msg(async ? "Q" : "B", i);
+
+        if (async)
+            //  Queue is full now and then, wait for space
+            ok = _Wait([&]() { return (cli->TxFree() >= msg.length()) &&
+                                      (cli->SendTCPAsync(msg.c_str(),
+                                                 msg.length()) != 0); },
+                       CHK_TIMEOUT);
+        else
+            ok = ((cli->SendTCP((char*)msg.c_str(), msg.length()) &
+                   ESP_STATUS_SENDOK) != 0);
+        sent += msg;
+        _Drain(cli, rcvd);
+    }
+
+    ok = ok && _Wait([&]() { _Drain(cli, rcvd); return (rcvd.length() >=
+                                                        sent.length()); },
+                     CHK_TIMEOUT);
+    _Check(ok && (rcvd == sent), name);
+}
+
+/**
+ * Send datagrams on UDP socket to the echo, every one has to come back as a
+ * single message
+ * @param esp ESP library
+ */
+static void _EchoUDP(ESP8266 &esp)
+{
+    uint32_t id = esp.OpenUDPSock((char*)"127.0.0.1", __cfg.echoPort);
+    _espClient *cli = esp.GetClientBySockID(id);
+    bool ok = (cli != 0);
+    char buf[ESP_RX_BUF];
+    uint16_t len;
+
+    _Check(ok, "UDP socket opened");
+    for (uint32_t i = 0; ok && (i < __cfg.msgs); i++)
+    {
+        std::string msg = _Msg("U", i);
+
+        ok = ((cli->SendTCP((char*)msg.c_str(), msg.length()) &
+               ESP_STATUS_SENDOK) != 0);
+        ok = ok && _Wait([&]() { return cli->Receive(buf, &len); },
+                         CHK_TIMEOUT);
+        ok = ok && (std::string(buf, len) == msg);
+    }
+    _Check(ok, "UDP datagrams echoed one by one");
+
+    if (cli != 0)
+        cli->Close();
+    _Check(_Wait([&]() { return !esp.ValidSocket(id); }, CHK_TIMEOUT),
+           "UDP socket closed");
+}
+
+/**
+ * Start TCP server on ESP, connect to it from host, exchange data and close
+ * connection from host side
+ * @param esp ESP library
+ */
+static void _Server(ESP8266 &esp)
+{
+    struct sockaddr_in addr;
+    _espClient *cli = 0;
+    std::string rcvd, hello("hello rover\n"), reply("hello server\n");
+    char buf[64];
+    ssize_t n;
+    int fd;
+
+    _Check((esp.StartTCPServer(__cfg.servPort) & ESP_STATUS_OK) != 0,
+           "TCP server started");
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(__cfg.servPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        perror("connect");
+    write(fd, hello.c_str(), hello.length());
+
+    //  Incoming connection shows up as a new client
+    _Check(_Wait([&]() {
+        for (uint8_t i = 0; (cli == 0) && (i < ESP_MAX_CLI); i++)
+            cli = esp.GetClientByIndex(i);
+        _Drain(cli, rcvd);
+        return (rcvd == hello); }, CHK_TIMEOUT),
+           "incoming connection & data received on ESP");
+
+    n = -1;
+    if ((cli != 0) && (cli->SendTCP((char*)reply.c_str(), reply.length()) &
+                       ESP_STATUS_SENDOK))
+    {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        if (poll(&pfd, 1, CHK_TIMEOUT) > 0)
+            n = read(fd, buf, sizeof(buf));
+    }
+    _Check((n > 0) && (std::string(buf, n) == reply),
+           "reply from ESP received on host");
+
+    close(fd);
+    _Check(_Wait([&]() { return esp.GetClientByIndex(0) == 0; }, CHK_TIMEOUT),
+           "connection closed by host removed from ESP");
+    esp.StopTCPServer();
+}
+
+int main(int argc, char **argv)
+{
+    ESP8266 &esp = ESP8266::GetI();
+    struct _espLatency lat;
+    pthread_t thread;
+    uint32_t id;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "P:e:S:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'P': __cfg.port = optarg; break;
+        case 'e': __cfg.echoPort = strtoul(optarg, 0, 10); break;
+        case 'S': __cfg.servPort = strtoul(optarg, 0, 10); break;
+        case 'n': __cfg.msgs = strtoul(optarg, 0, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-P port] [-e echoPort] "
+                    "[-S serverPort] [-n msgs]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    __echoTCP = _Bind(false, __cfg.echoPort);
+    __echoUDP = _Bind(true, __cfg.echoPort);
+    if ((__echoTCP < 0) || (__echoUDP < 0))
+        return 1;
+    pthread_create(&thread, 0, _EchoThread, 0);
+
+    HAL_ESP_SetPort(__cfg.port);
+    _Check((esp.InitHW() & ESP_STATUS_OK) != 0,
+           "initialized (AT, ATE0, AT+CIPMUX=1)");
+    esp.ConnectAP((char*)"emulator", (char*)"password");
+    _Check(esp.IsConnected(), "connected to AP, got IP address");
+
+    id = esp.OpenTCPSock((char*)"127.0.0.1", __cfg.echoPort);
+    _Check(esp.ValidSocket(id), "TCP socket opened");
+    _EchoTCP(esp, id, false, "blocking sends (AT+CIPSEND) echoed in order");
+    _EchoTCP(esp, id, true, "queued sends (AT+CIPSEND) echoed in order");
+    esp.SendBuffered(id, true);
+    _EchoTCP(esp, id, true, "queued sends (AT+CIPSENDBUF) echoed in order");
+    esp.SendBuffered(id, false);
+    if (esp.ValidSocket(id))
+        esp.GetClientBySockID(id)->Close();
+    _Check(_Wait([&]() { return !esp.ValidSocket(id); }, CHK_TIMEOUT),
+           "TCP socket closed");
+
+    _EchoUDP(esp);
+    _Server(esp);
+
+    _Check(esp.CmdLatency(ESP_CMDT_AT, &lat) && (lat.samples > 0),
+           "latency of AT commands measured on host clock");
+
+    printf("%u check(s) failed\n", __fails);
+
+    return __fails;
+}
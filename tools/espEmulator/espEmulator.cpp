@@ -0,0 +1,953 @@
+/**
+ * espEmulator.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ *
+ *  Host-side (Linux) emulator of ESP8266 running AT firmware, used to test and
+ *  benchmark ESP8266 library without the real module. Emulator creates a
+ *  pseudo-terminal and behaves like the module on the other end of UART7: the
+ *  slave side of the pty (path printed on startup, optionally symlinked with
+ *  -L) is opened by the host build of the firmware or any serial tool.
+ *  Sockets opened through the emulator are bridged to real TCP/UDP sockets on
+ *  loopback (IP address given in AT+CIPSTART is ignored, only port is used),
+ *  TCP server started with AT+CIPSERVER listens on loopback as well.
+ *
+ *  Implemented AT subset (as used by ESP8266 library):
+ *      AT, ATE0/ATE1, AT+RST, AT+CWMODE(_DEF), AT+CWJAP(_DEF), AT+CWQAP,
+ *      AT+CIPSTA?, AT+CIPMUX, AT+CIPSTO, AT+CIPSERVER, AT+CIPSTART (TCP, UDP),
+ *      AT+CIPSEND, AT+CIPSENDBUF, AT+CIPCLOSE
+ *  and asynchronous messages: +IPD, n,CONNECT, n,CLOSED, n,SEND OK
+ *
+ *  Link quality can be degraded in a repeatable way (fixed random seed):
+ *      -l ms       latency added to every reply and +IPD message
+ *      -j ms       random jitter added on top of latency
+ *      -w ms       network round trip: replies waiting for the remote side
+ *                  (SEND OK of AT+CIPSEND, CONNECT of AT+CIPSTART) are
+ *                  delayed this much more; asynchronous n,SEND OK of
+ *                  AT+CIPSENDBUF as well, without holding back other output
+ *      -b baud     UART baud rate, limits rate at which emulator outputs data
+ *                  (10 bits per byte); 0 for unlimited
+ *      -B prob     probability of replying 'busy p...' to a command
+ *      -T prob     probability of dropping \r\n terminator of a reply
+ *      -C rate     spontaneous n,CLOSED of an open socket, events per second
+ *      -N          firmware without AT+CIPSENDBUF (replies ERROR)
+ *      -s seed     seed of random generator
+ *  Statistics (commands, sends, throughput, injected faults and time driver
+ *  needed to recover from them) are printed on SIGINT/SIGTERM, and every
+ *  -p seconds if set.
+ *  Recovery time of a fault is measured from injecting it to the next command
+ *  completing with OK/SEND OK.
+ *
+ *  Build: g++ -std=gnu++11 -Wall -O2 espEmulator.cpp -o espEmulator
+ *  Usage: ./espEmulator [-L /tmp/esp0] [-l 20] [-j 10] [-w 30] [-b 115200]
+ *                       [-B 0.01] [-T 0.01] [-C 0.1] [-N] [-s 1] [-p 5] [-v]
+ *  @note Not part of the firmware build (excluded in CCS project)
+ *
+ *  @version 1.1.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +AT command subset, TCP/UDP sockets & TCP server bridged to loopback
+ *  +Latency, baud-rate limiting and fault injection, statistics
+ *  V1.1.0 - 19.10.2026
+ *  +Network round trip (-w) on replies waiting for the remote side
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <deque>
+
+//  Max number of links, same as ESP firmware in multiple-connection mode
+#define EMU_MAX_LINK    5
+//  Max size of payload in a single +IPD message & AT+CIPSEND
+#define EMU_MAX_IPD     1460
+#define EMU_MAX_SEND    2048
+//  Max length of a command line
+#define EMU_MAX_LINE    256
+//  IP address reported to the driver
+#define EMU_IP          "127.0.0.1"
+
+///-----------------------------------------------------------------------------
+///                      Configuration & state                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Command line options
+ */
+struct _emuConfig
+{
+    const char  *link;      //  Path of symlink to pty slave, 0 if not used
+    uint32_t    latency;    //  Added to every reply, ms
+    uint32_t    jitter;     //  Random jitter on top of latency, ms
+    uint32_t    rtt;        //  Network round trip, ms
+    uint32_t    baud;       //  UART baud rate, 0 for unlimited
+    double      pBusy;      //  Probability of 'busy p...' reply
+    double      pTerm;      //  Probability of dropping reply terminator
+    double      closeRate;  //  Spontaneous closes per second
+    bool        noSendBuf;  //  Reject AT+CIPSENDBUF
+    uint32_t    seed;       //  Random seed
+    uint32_t    period;     //  Period of printing statistics, s (0 - off)
+    bool        verbose;    //  Log UART traffic to stderr
+};
+
+/**
+ * Single socket (link) opened through the emulator
+ */
+struct _emuLink
+{
+    int         fd;         //  Host socket, -1 if link is closed
+    bool        udp;        //  UDP link
+    uint32_t    segSent;    //  Last segment ID used with AT+CIPSENDBUF
+};
+
+/**
+ * Chunk of data waiting to be written to UART
+ */
+struct _emuOut
+{
+    uint64_t    due;        //  Time at which chunk can be written, us
+    std::string data;
+};
+
+/**
+ * Statistics printed on exit
+ */
+struct _emuStats
+{
+    uint64_t    start;      //  Time emulator started, us
+    uint32_t    commands;   //  Commands received
+    uint32_t    sends;      //  Completed AT+CIPSEND(BUF)
+    uint64_t    txBytes;    //  Payload bytes sent from driver to sockets
+    uint32_t    ipds;       //  +IPD messages delivered to driver
+    uint64_t    rxBytes;    //  Payload bytes delivered to driver
+    uint32_t    faultBusy;  //  Injected 'busy p...'
+    uint32_t    faultTerm;  //  Injected missing terminators
+    uint32_t    faultClose; //  Injected spontaneous closes
+    uint32_t    recovered;  //  Faults after which driver recovered
+    uint64_t    recSum;     //  Sum of recovery times, us
+    uint64_t    recMax;     //  Longest recovery time, us
+};
+
+//  States of UART input
+#define EMU_IN_CMD      0   //  Reading command line
+#define EMU_IN_DATA     1   //  Reading payload of AT+CIPSEND(BUF)
+
+static struct _emuConfig __cfg;
+static struct _emuStats __stats;
+static struct _emuLink __link[EMU_MAX_LINK];
+static std::deque<struct _emuOut> __out;
+//  Segment ACKs of buffered sends waiting for network round trip
+static std::deque<struct _emuOut> __acks;
+static int __uart = -1;         //  pty master
+static int __server = -1;       //  TCP server listening socket
+static uint16_t __serverPort;
+static bool __echo = true;      //  Echo commands (ATE1)
+static bool __wifi = false;     //  Connected to AP
+static uint8_t __inState = EMU_IN_CMD;
+static std::string __line;      //  Command being received
+static std::string __payload;   //  Payload of send being received
+static uint16_t __sendLen;      //  Expected payload length
+static uint8_t __sendLink;      //  Link the payload is sent to
+static bool __sendBuf;          //  Payload is sent with AT+CIPSENDBUF
+static uint64_t __lastDue;      //  Due time of last queued output chunk
+static uint64_t __uartFree;     //  Time UART finishes previous write, us
+static uint64_t __faultTime;    //  Time of unrecovered fault, 0 if none
+static volatile sig_atomic_t __quit = 0;
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                              [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Get monotonic time in microseconds
+ */
+static uint64_t _Now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000ULL + ts.tv_nsec/1000;
+}
+
+/**
+ * Get random number in range [0, 1)
+ */
+static double _Rand()
+{
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+/**
+ * Note that a fault has been injected, recovery time is measured from the
+ * first unrecovered fault
+ */
+static void _Fault()
+{
+    if (__faultTime == 0)
+        __faultTime = _Now();
+}
+
+/**
+ * Note that a command completed successfully, driver recovered from any
+ * previous fault
+ */
+static void _Success()
+{
+    if (__faultTime != 0)
+    {
+        uint64_t rec = _Now() - __faultTime;
+
+        __stats.recovered++;
+        __stats.recSum += rec;
+        if (rec > __stats.recMax)
+            __stats.recMax = rec;
+        __faultTime = 0;
+    }
+}
+
+/**
+ * Queue data to be written to UART after configured latency. Chunks are
+ * written in the order they were queued.
+ * @param data data to write
+ * @param delayed true to apply latency & jitter, false to write right away
+ * (e.g. echo)
+ * @param rtt true to delay chunk by network round trip as well
+ */
+static void _Write(const std::string &data, bool delayed = true,
+                   bool rtt = false)
+{
+    struct _emuOut out;
+
+    out.due = _Now();
+    if (rtt)
+        out.due += (uint64_t)__cfg.rtt * 1000;
+    if (delayed)
+    {
+        out.due += (uint64_t)__cfg.latency * 1000;
+        if (__cfg.jitter > 0)
+            out.due += (uint64_t)(_Rand() * __cfg.jitter * 1000);
+    }
+    //  Keep chunks in order even when jitter says otherwise
+    if (out.due < __lastDue)
+        out.due = __lastDue;
+    __lastDue = out.due;
+    out.data = data;
+    __out.push_back(out);
+}
+
+/**
+ * Queue a reply line to be written to UART, optionally dropping its
+ * terminator (fault injection)
+ * @param line reply line including \r\n terminator
+ * @param rtt true if reply waits for the remote side (network round trip)
+ */
+static void _Reply(const std::string &line, bool rtt = false)
+{
+    size_t len = line.size();
+
+    if ((__cfg.pTerm > 0) && (len >= 2) && (line.compare(len-2, 2, "\r\n") == 0)
+        && (_Rand() < __cfg.pTerm))
+    {
+        __stats.faultTerm++;
+        _Fault();
+        _Write(line.substr(0, len-2), true, rtt);
+        return;
+    }
+    _Write(line, true, rtt);
+}
+
+/**
+ * Write as many of due output chunks to UART as baud rate allows
+ * @return time in ms until next chunk can be written, -1 if nothing is queued
+ */
+static int _Flush()
+{
+    uint64_t now = _Now();
+
+    //  Segment ACKs join the output once they're due
+    while (!__acks.empty() && (__acks.front().due <= now))
+    {
+        _Write(__acks.front().data, false);
+        __acks.pop_front();
+    }
+    if (__out.empty() && !__acks.empty())
+        return (int)((__acks.front().due - now + 999) / 1000);
+
+    while (!__out.empty())
+    {
+        struct _emuOut &out = __out.front();
+        ssize_t n;
+
+        if (out.due > now)
+            return (int)((out.due - now + 999) / 1000);
+        //  Wait until UART has "transmitted" previous data at given baud rate
+        if (__uartFree > now)
+            return (int)((__uartFree - now + 999) / 1000);
+
+        n = write(__uart, out.data.data(), out.data.size());
+        if (n < 0)
+            return ((errno == EAGAIN) || (errno == EIO)) ? 1 : -1;
+        if (__cfg.verbose)
+            fprintf(stderr, "<< %.*s\n", (int)n, out.data.data());
+        if (__cfg.baud > 0)
+            __uartFree = now + (uint64_t)n * 10 * 1000000ULL / __cfg.baud;
+        out.data.erase(0, n);
+        if (out.data.empty())
+            __out.pop_front();
+    }
+    if (!__acks.empty())
+        return (int)((__acks.front().due - now + 999) / 1000);
+
+    return -1;
+}
+
+/**
+ * Convert number to string
+ */
+static std::string _Str(uint32_t num)
+{
+    char buf[12];
+
+    snprintf(buf, sizeof(buf), "%u", num);
+    return std::string(buf);
+}
+
+/**
+ * Split comma-separated arguments of a command, quotes are removed
+ * @param args string following '=' in the command
+ * @param argv[out] arguments
+ * @param maxArgs max number of arguments in [argv]
+ * @return number of arguments found
+ */
+static int _Args(const std::string &args, std::string *argv, int maxArgs)
+{
+    int argc = 0;
+    bool quoted = false;
+
+    if (args.empty())
+        return 0;
+
+    argv[0].clear();
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        char c = args[i];
+
+        if (c == '"')
+            quoted = !quoted;
+        else if ((c == ',') && !quoted)
+        {
+            if (++argc >= maxArgs)
+                return argc;
+            argv[argc].clear();
+        }
+        else
+            argv[argc] += c;
+    }
+
+    return argc + 1;
+}
+
+/**
+ * Close link and report it to the driver
+ * @param id link ID
+ * @param report true to send 'n,CLOSED' to the driver
+ */
+static void _CloseLink(uint8_t id, bool report)
+{
+    if (__link[id].fd < 0)
+        return;
+
+    close(__link[id].fd);
+    __link[id].fd = -1;
+    if (report)
+        _Write(_Str(id) + ",CLOSED\r\n");
+}
+
+/**
+ * Open host socket for a link (loopback, port from AT+CIPSTART)
+ * @param udp true for UDP socket
+ * @param port remote port
+ * @param localPort local port of UDP socket, 0 for any
+ * @return socket or -1 on failure
+ */
+static int _OpenSocket(bool udp, uint16_t port, uint16_t localPort)
+{
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, udp ? SOCK_DGRAM : SOCK_STREAM, 0),
+        one = 1;
+
+    if (fd < 0)
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (udp && (localPort != 0))
+    {
+        addr.sin_port = htons(localPort);
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            return -1;
+        }
+    }
+
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    if (!udp)
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    return fd;
+}
+
+///-----------------------------------------------------------------------------
+///                      AT command interpreter                        [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Execute a single command line received on UART
+ * @param line command without \r\n
+ */
+static void _Command(const std::string &line)
+{
+    std::string argv[6];
+    std::string cmd = line, args;
+    size_t eq = line.find('=');
+    int argc = 0;
+
+    if (line.empty())
+        return;
+
+    __stats.commands++;
+    if (__echo)
+        _Write(line + "\r\n", false);
+
+    if (eq != std::string::npos)
+    {
+        cmd = line.substr(0, eq);
+        args = line.substr(eq + 1);
+        argc = _Args(args, argv, 6);
+    }
+
+    //  Module is busy processing previous command (fault injection)
+    if ((__cfg.pBusy > 0) && (_Rand() < __cfg.pBusy))
+    {
+        __stats.faultBusy++;
+        _Fault();
+        _Reply("busy p...\r\n");
+        return;
+    }
+
+    if ((cmd == "AT") || (cmd == "AT+CWMODE") || (cmd == "AT+CWMODE_DEF") ||
+        (cmd == "AT+CIPMUX") || (cmd == "AT+CIPSTO"))
+        _Reply("\r\nOK\r\n");
+    else if ((cmd == "ATE0") || (cmd == "ATE1"))
+    {
+        __echo = (cmd == "ATE1");
+        _Reply("\r\nOK\r\n");
+    }
+    else if (cmd == "AT+RST")
+    {
+        for (uint8_t i = 0; i < EMU_MAX_LINK; i++)
+            _CloseLink(i, false);
+        __wifi = false;
+        __echo = true;
+        _Reply("\r\nOK\r\n");
+        _Reply("\r\nready\r\n");
+    }
+    else if ((cmd == "AT+CWJAP") || (cmd == "AT+CWJAP_DEF"))
+    {
+        __wifi = true;
+        _Reply("WIFI CONNECTED\r\n");
+        _Reply("WIFI GOT IP\r\n");
+        _Reply("\r\nOK\r\n");
+    }
+    else if (cmd == "AT+CWQAP")
+    {
+        for (uint8_t i = 0; i < EMU_MAX_LINK; i++)
+            _CloseLink(i, true);
+        __wifi = false;
+        _Reply("\r\nOK\r\n");
+        _Reply("WIFI DISCONNECT\r\n");
+    }
+    else if (cmd == "AT+CIPSTA?")
+    {
+        _Reply("+CIPSTA:ip:\"" EMU_IP "\"\r\n");
+        _Reply("+CIPSTA:gateway:\"" EMU_IP "\"\r\n");
+        _Reply("+CIPSTA:netmask:\"255.0.0.0\"\r\n");
+        _Reply("\r\nOK\r\n");
+    }
+    else if ((cmd == "AT+CIPSERVER") && (argc >= 1))
+    {
+        if (__server >= 0)
+        {
+            close(__server);
+            __server = -1;
+        }
+        if ((argv[0] == "1") && (argc >= 2))
+        {
+            struct sockaddr_in addr;
+            int one = 1;
+
+            __serverPort = (uint16_t)atoi(argv[1].c_str());
+            memset(&addr, 0, sizeof(addr));
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(__serverPort);
+            __server = socket(AF_INET, SOCK_STREAM, 0);
+            setsockopt(__server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            if ((bind(__server, (struct sockaddr*)&addr, sizeof(addr)) < 0) ||
+                (listen(__server, EMU_MAX_LINK) < 0))
+            {
+                close(__server);
+                __server = -1;
+                _Reply("\r\nERROR\r\n");
+                return;
+            }
+        }
+        _Reply("\r\nOK\r\n");
+    }
+    else if ((cmd == "AT+CIPSTART") && (argc >= 4))
+    {
+        uint8_t id = (uint8_t)atoi(argv[0].c_str());
+        bool udp = (argv[1] == "UDP");
+        uint16_t localPort = 0;
+
+        if ((id >= EMU_MAX_LINK) || !__wifi || (!udp && (argv[1] != "TCP")))
+        {
+            _Reply("\r\nERROR\r\n");
+            return;
+        }
+        if (__link[id].fd >= 0)
+        {
+            _Reply("ALREADY CONNECTED\r\n\r\nERROR\r\n");
+            return;
+        }
+        if (udp && (argc >= 5))
+            localPort = (uint16_t)atoi(argv[4].c_str());
+
+        __link[id].fd = _OpenSocket(udp, (uint16_t)atoi(argv[3].c_str()),
+                                    localPort);
+        __link[id].udp = udp;
+        __link[id].segSent = 0;
+        if (__link[id].fd < 0)
+        {
+            _Reply("\r\nERROR\r\n" + _Str(id) + ",CLOSED\r\n");
+            return;
+        }
+        _Reply(_Str(id) + ",CONNECT\r\n", !udp);
+        _Reply("\r\nOK\r\n");
+        _Success();
+    }
+    else if (((cmd == "AT+CIPSEND") || (cmd == "AT+CIPSENDBUF")) && (argc >= 2))
+    {
+        uint8_t id = (uint8_t)atoi(argv[0].c_str());
+        int len = atoi(argv[1].c_str());
+
+        __sendBuf = (cmd == "AT+CIPSENDBUF");
+        if (__sendBuf && __cfg.noSendBuf)
+        {
+            _Reply("\r\nERROR\r\n");
+            return;
+        }
+        if ((id >= EMU_MAX_LINK) || (__link[id].fd < 0))
+        {
+            _Reply("link is not valid\r\n\r\nERROR\r\n");
+            return;
+        }
+        if ((len <= 0) || (len > EMU_MAX_SEND))
+        {
+            _Reply("\r\nERROR\r\n");
+            return;
+        }
+
+        __sendLink = id;
+        __sendLen = (uint16_t)len;
+        __payload.clear();
+        __inState = EMU_IN_DATA;
+        //  Buffered send reports ID of next segment and last acknowledged one
+        if (__sendBuf)
+            _Reply(_Str(__link[id].segSent + 1) + "," +
+                   _Str(__link[id].segSent) + "\r\n");
+        //  Prompt has no line terminator
+        _Write("\r\nOK\r\n> ");
+    }
+    else if ((cmd == "AT+CIPCLOSE") && (argc >= 1))
+    {
+        uint8_t id = (uint8_t)atoi(argv[0].c_str());
+
+        if ((id >= EMU_MAX_LINK) || (__link[id].fd < 0))
+        {
+            _Reply("UNLINK\r\n\r\nERROR\r\n");
+            return;
+        }
+        _CloseLink(id, true);
+        _Reply("\r\nOK\r\n");
+        _Success();
+    }
+    else
+        _Reply("\r\nERROR\r\n");
+}
+
+/**
+ * Payload of AT+CIPSEND(BUF) has been received, send it over the link
+ */
+static void _SendPayload()
+{
+    struct _emuLink *link = &__link[__sendLink];
+    ssize_t n = -1;
+
+    __inState = EMU_IN_CMD;
+
+    if (link->fd >= 0)
+        n = send(link->fd, __payload.data(), __payload.size(), MSG_NOSIGNAL);
+
+    if (n != (ssize_t)__payload.size())
+    {
+        _Reply("\r\nSEND FAIL\r\n");
+        return;
+    }
+
+    __stats.sends++;
+    __stats.txBytes += n;
+    _Reply("\r\nRecv " + _Str(n) + " bytes\r\n");
+    if (__sendBuf)
+    {
+        struct _emuOut ack;
+
+        //  Segment is acknowledged asynchronously, once the remote side
+        //  acknowledged it
+        link->segSent++;
+        ack.due = _Now() + (uint64_t)(__cfg.latency + __cfg.rtt) * 1000;
+        ack.data = _Str(link->segSent) + ",SEND OK\r\n";
+        __acks.push_back(ack);
+    }
+    else
+        _Reply("\r\nSEND OK\r\n", !link->udp);
+    _Success();
+}
+
+/**
+ * Consume data received on UART (written by the driver)
+ * @param buf received data
+ * @param len number of bytes in [buf]
+ */
+static void _UartInput(const char *buf, ssize_t len)
+{
+    if (__cfg.verbose)
+        fprintf(stderr, ">> %.*s\n", (int)len, buf);
+
+    for (ssize_t i = 0; i < len; i++)
+    {
+        if (__inState == EMU_IN_DATA)
+        {
+            __payload += buf[i];
+            if (__payload.size() >= __sendLen)
+                _SendPayload();
+            continue;
+        }
+
+        if (buf[i] == '\n')
+        {
+            //  Strip \r preceding \n
+            if (!__line.empty() && (__line[__line.size()-1] == '\r'))
+                __line.erase(__line.size()-1);
+            _Command(__line);
+            __line.clear();
+        }
+        else if (__line.size() < EMU_MAX_LINE)
+            __line += buf[i];
+    }
+}
+
+/**
+ * Read data arrived on a link and deliver it to the driver as +IPD message
+ * @param id link ID
+ */
+static void _LinkInput(uint8_t id)
+{
+    char buf[EMU_MAX_IPD];
+    ssize_t n = recv(__link[id].fd, buf, sizeof(buf), 0);
+
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        return;
+    //  Remote side closed TCP connection (UDP never 'closes')
+    if ((n == 0) && !__link[id].udp)
+    {
+        _CloseLink(id, true);
+        return;
+    }
+    if (n <= 0)
+        return;
+
+    __stats.ipds++;
+    __stats.rxBytes += n;
+    _Write("\r\n+IPD," + _Str(id) + "," + _Str(n) + ":" + std::string(buf, n));
+}
+
+/**
+ * Accept incoming connection on TCP server, assign lowest free link ID to it
+ */
+static void _Accept()
+{
+    int fd = accept(__server, 0, 0),
+        one = 1;
+
+    if (fd < 0)
+        return;
+
+    for (uint8_t id = 0; id < EMU_MAX_LINK; id++)
+        if (__link[id].fd < 0)
+        {
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            __link[id].fd = fd;
+            __link[id].udp = false;
+            __link[id].segSent = 0;
+            _Write(_Str(id) + ",CONNECT\r\n");
+            return;
+        }
+
+    //  No free links
+    close(fd);
+}
+
+/**
+ * Spontaneously close a random open link (fault injection)
+ * @param dt time since last call in seconds
+ */
+static void _InjectClose(double dt)
+{
+    uint8_t open[EMU_MAX_LINK], openN = 0;
+
+    if ((__cfg.closeRate <= 0) || (_Rand() >= (__cfg.closeRate * dt)))
+        return;
+
+    for (uint8_t id = 0; id < EMU_MAX_LINK; id++)
+        if (__link[id].fd >= 0)
+            open[openN++] = id;
+    if (openN == 0)
+        return;
+
+    __stats.faultClose++;
+    _Fault();
+    _CloseLink(open[rand() % openN], true);
+}
+
+/**
+ * Print statistics collected since startup
+ */
+static void _PrintStats()
+{
+    double elapsed = (double)(_Now() - __stats.start) / 1e6;
+
+    if (elapsed <= 0)
+        elapsed = 1e-6;
+
+    fprintf(stderr,
+            "--- %.1fs: %u commands, %u sends (%.1f/s, %.0f B/s), "
+            "%u +IPD (%.0f B/s)\n",
+            elapsed, __stats.commands, __stats.sends,
+            __stats.sends / elapsed, __stats.txBytes / elapsed,
+            __stats.ipds, __stats.rxBytes / elapsed);
+    fprintf(stderr,
+            "--- faults: %u busy, %u terminator, %u closed; recovered %u "
+            "(avg %.1fms, max %.1fms)\n",
+            __stats.faultBusy, __stats.faultTerm, __stats.faultClose,
+            __stats.recovered,
+            __stats.recovered ?
+                    (double)__stats.recSum / __stats.recovered / 1000.0 : 0.0,
+            (double)__stats.recMax / 1000.0);
+}
+
+static void _Signal(int sig)
+{
+    (void)sig;
+    __quit = 1;
+}
+
+/**
+ * Create pseudo-terminal acting as UART7 and configure it as raw serial line
+ * @return file descriptor of pty slave kept open by emulator, -1 on failure
+ */
+static int _OpenUart()
+{
+    struct termios tio;
+    const char *name;
+    int slave;
+
+    __uart = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((__uart < 0) || (grantpt(__uart) < 0) || (unlockpt(__uart) < 0) ||
+        ((name = ptsname(__uart)) == 0))
+        return -1;
+
+    //  Keep slave open so the master doesn't see EIO while driver reconnects
+    slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0)
+        return -1;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(__uart, F_SETFL, fcntl(__uart, F_GETFL) | O_NONBLOCK);
+
+    printf("ESP8266 emulator on %s\n", name);
+    if (__cfg.link != 0)
+    {
+        unlink(__cfg.link);
+        if (symlink(name, __cfg.link) == 0)
+            printf("Linked to %s\n", __cfg.link);
+    }
+    fflush(stdout);
+
+    return slave;
+}
+
+///-----------------------------------------------------------------------------
+///                      Entry point                                    [PUBLIC]
+///-----------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    uint64_t lastTick, lastPrint;
+    int opt, slave;
+
+    memset(&__cfg, 0, sizeof(__cfg));
+    __cfg.seed = 1;
+    while ((opt = getopt(argc, argv, "L:l:j:w:b:B:T:C:Ns:p:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'L': __cfg.link = optarg; break;
+        case 'l': __cfg.latency = strtoul(optarg, 0, 10); break;
+        case 'j': __cfg.jitter = strtoul(optarg, 0, 10); break;
+        case 'w': __cfg.rtt = strtoul(optarg, 0, 10); break;
+        case 'b': __cfg.baud = strtoul(optarg, 0, 10); break;
+        case 'B': __cfg.pBusy = atof(optarg); break;
+        case 'T': __cfg.pTerm = atof(optarg); break;
+        case 'C': __cfg.closeRate = atof(optarg); break;
+        case 'N': __cfg.noSendBuf = true; break;
+        case 's': __cfg.seed = strtoul(optarg, 0, 10); break;
+        case 'p': __cfg.period = strtoul(optarg, 0, 10); break;
+        case 'v': __cfg.verbose = true; break;
+        default:
+            fprintf(stderr, "Usage: %s [-L link] [-l latencyMs] [-j jitterMs] "
+                    "[-w rttMs] [-b baud] [-B pBusy] [-T pDropTerm] "
+                    "[-C closePerSec] [-N] [-s seed] [-p statsPeriodSec] "
+                    "[-v]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(__cfg.seed);
+    for (uint8_t i = 0; i < EMU_MAX_LINK; i++)
+        __link[i].fd = -1;
+
+    if ((slave = _OpenUart()) < 0)
+    {
+        perror("pty");
+        return 1;
+    }
+
+    signal(SIGINT, _Signal);
+    signal(SIGTERM, _Signal);
+    signal(SIGPIPE, SIG_IGN);
+
+    //  Module announces itself after power-up
+    _Write("\r\nready\r\n");
+
+    memset(&__stats, 0, sizeof(__stats));
+    __stats.start = lastTick = lastPrint = _Now();
+
+    while (!__quit)
+    {
+        struct pollfd pfd[2 + EMU_MAX_LINK];
+        uint8_t pfdLink[2 + EMU_MAX_LINK];
+        int nfds = 0, timeout;
+        uint64_t now;
+
+        //  Poll at least every 100ms for fault injection & statistics
+        timeout = _Flush();
+        if ((timeout < 0) || (timeout > 100))
+            timeout = 100;
+
+        pfd[nfds].fd = __uart;
+        pfd[nfds++].events = POLLIN;
+        if (__server >= 0)
+        {
+            pfd[nfds].fd = __server;
+            pfd[nfds++].events = POLLIN;
+        }
+        for (uint8_t i = 0; i < EMU_MAX_LINK; i++)
+            if (__link[i].fd >= 0)
+            {
+                pfdLink[nfds] = i;
+                pfd[nfds].fd = __link[i].fd;
+                pfd[nfds++].events = POLLIN;
+            }
+
+        if (poll(pfd, nfds, timeout) < 0)
+            continue;
+
+        for (int i = 0; i < nfds; i++)
+        {
+            if (!(pfd[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            if (pfd[i].fd == __uart)
+            {
+                char buf[512];
+                ssize_t n = read(__uart, buf, sizeof(buf));
+
+                if (n > 0)
+                    _UartInput(buf, n);
+            }
+            else if (pfd[i].fd == __server)
+                _Accept();
+            else if (__link[pfdLink[i]].fd == pfd[i].fd)
+                _LinkInput(pfdLink[i]);
+        }
+
+        now = _Now();
+        _InjectClose((double)(now - lastTick) / 1e6);
+        lastTick = now;
+        if ((__cfg.period > 0) &&
+            ((now - lastPrint) >= (uint64_t)__cfg.period * 1000000ULL))
+        {
+            _PrintStats();
+            lastPrint = now;
+        }
+    }
+
+    _PrintStats();
+    for (uint8_t i = 0; i < EMU_MAX_LINK; i++)
+        _CloseLink(i, false);
+    if (__server >= 0)
+        close(__server);
+    close(slave);
+    close(__uart);
+    if (__cfg.link != 0)
+        unlink(__cfg.link);
+
+    return 0;
+}
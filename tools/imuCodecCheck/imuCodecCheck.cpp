@@ -0,0 +1,568 @@
+/**
+ * imuCodecCheck.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Vedran
+ *
+ *  Host-side (Linux) check of IMU codec (roverKernel/network/imuCodec.h).
+ *  Trace of MPU9250 samples is encoded and decoded back exactly as on the
+ *  rover and the server, decoded values are compared against the originals
+ *  (error has to stay within half of the quantization step) and size of the
+ *  encoded stream is compared to raw binary samples (time + 6 floats, 28B) and
+ *  to the text IMU telemetry channel (values printed as by tostr()).
+ *  After the trace, edge cases of the encoding are checked: varint lengths &
+ *  truncated/overlong varints, zig-zag extremes and wrap-around of deltas,
+ *  keyframe interval, decoder joining mid-stream & losing a sample, wrap of
+ *  the sequence number, change of resolution and truncated samples.
+ *
+ *  Trace is either read from a CSV file, one sample per line:
+ *      time(ms),roll,pitch,yaw(deg),accX,accY,accZ(g)
+ *  or generated (rover driving around at 50Hz: slow turns, roll & pitch
+ *  wobble, sensor noise, yaw wrapping at +-180deg) with a fixed seed.
+ *      -f file     CSV trace to use instead of generated one
+ *      -n samples  number of samples to generate (default 3000, 60s)
+ *      -r res      orientation resolution in deg/LSB
+ *      -a res      acceleration resolution in g/LSB
+ *      -k n        keyframe interval
+ *      -s seed     seed of random generator
+ *  Exit code is the number of failed checks.
+ *
+ *  Build: g++ -std=gnu++11 -Wall -O2 -I ../../roverKernel imuCodecCheck.cpp
+ *             ../../roverKernel/network/imuCodec.cpp -o imuCodecCheck
+ *  Usage: ./imuCodecCheck [-f trace.csv] [-n 3000] [-r 0.01] [-a 0.001]
+ *                         [-k 50] [-s 1]
+ *  @note Not part of the firmware build (excluded in CCS project)
+ *
+ *  @version 1.0.0
+ *  V1.0.0 - 19.10.2026
+ *  +Created document
+ *  +Round-trip of an IMU trace with compression ratio & error statistics
+ *  +Edge cases of keyframes, sequence numbers & varints
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <string>
+#include <sstream>
+#include <vector>
+
+#include "network/imuCodec.h"
+
+//  Size of a raw binary sample: time(uint32_t) + 6x float
+#define CHK_RAW_SAMPLE  (sizeof(uint32_t) + IMUC_VALUES * sizeof(float))
+
+///-----------------------------------------------------------------------------
+///                      Configuration & state                         [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Single sample of the trace
+ */
+struct _chkSample
+{
+    uint32_t    time;
+    float       rpy[3];
+    float       acc[3];
+};
+
+/**
+ * Command-line options
+ */
+struct _chkConfig
+{
+    const char  *file;
+    uint32_t    samples;
+    float       rpyRes;
+    float       accRes;
+    uint16_t    keyInt;
+    uint32_t    seed;
+};
+
+/**
+ * Codec with access to its varint helpers
+ */
+class _chkCodec : public IMUCodec
+{
+    public:
+        using IMUCodec::_PutVarint;
+        using IMUCodec::_GetVarint;
+};
+
+static struct _chkConfig __cfg = { 0, 3000, IMUC_DEF_RPY_RES, IMUC_DEF_ACC_RES,
+                                   IMUC_DEF_KEYINT, 1 };
+static uint32_t __fails = 0;
+
+///-----------------------------------------------------------------------------
+///                      Helper functions                              [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Report outcome of a single check
+ * @param ok true if check passed
+ * @param name description of the check
+ */
+static void _Check(bool ok, const char *name)
+{
+    printf("  %-4s %s\n", ok ? "ok" : "FAIL", name);
+    if (!ok)
+        __fails++;
+}
+
+/**
+ * Normally distributed random number (Box-Muller)
+ * @param sigma standard deviation
+ * @return random number
+ */
+static double _Gauss(double sigma)
+{
+    double u1 = (rand() + 1.0) / (RAND_MAX + 2.0);
+    double u2 = (rand() + 1.0) / (RAND_MAX + 2.0);
+
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+/**
+ * Generate trace of a rover driving around, sampled at 50Hz
+ * @param trace [out] generated samples
+ */
+static void _Generate(std::vector<struct _chkSample> &trace)
+{
+    double yaw = 170.0, rate = 0.0;
+
+    for (uint32_t i = 0; i < __cfg.samples; i++)
+    {
+        struct _chkSample s;
+        double t = i * 0.02;
+
+        //  Turn rate changes every few seconds, yaw wraps at +-180
+        if ((i % 150) == 0)
+            rate = _Gauss(30.0);
+        yaw += rate * 0.02 + _Gauss(0.02);
+        if (yaw > 180.0)
+            yaw -= 360.0;
+        else if (yaw < -180.0)
+            yaw += 360.0;
+
+        s.time = i * 20 + (rand() % 3);
+        s.rpy[0] = (float)(2.0 * sin(t * 1.3) + _Gauss(0.05));
+        s.rpy[1] = (float)(1.5 * sin(t * 0.7 + 1.0) + _Gauss(0.05));
+        s.rpy[2] = (float)yaw;
+        s.acc[0] = (float)(0.05 * sin(t * 0.5) + _Gauss(0.01));
+        s.acc[1] = (float)(0.02 * rate / 30.0 + _Gauss(0.01));
+        s.acc[2] = (float)(1.0 + _Gauss(0.01));
+        trace.push_back(s);
+    }
+}
+
+/**
+ * Read trace from CSV file
+ * @param path path of the file
+ * @param trace [out] samples read from the file
+ * @return true on success, false if file can't be opened or has no samples
+ */
+static bool _Load(const char *path, std::vector<struct _chkSample> &trace)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+
+    if (f == 0)
+        return false;
+
+    while (fgets(line, sizeof(line), f) != 0)
+    {
+        struct _chkSample s;
+
+        //  Header and malformed lines are skipped
+        if (sscanf(line, "%u,%f,%f,%f,%f,%f,%f", &s.time, &s.rpy[0],
+                   &s.rpy[1], &s.rpy[2], &s.acc[0], &s.acc[1], &s.acc[2]) == 7)
+            trace.push_back(s);
+    }
+    fclose(f);
+
+    return !trace.empty();
+}
+
+/**
+ * Length of a sample in text IMU telemetry channel (values as printed by
+ * tostr(), each followed by ':')
+ * @param s sample
+ * @return length in bytes
+ */
+static size_t _TextLen(const struct _chkSample &s)
+{
+    std::ostringstream ss;
+
+    for (uint8_t i = 0; i < 3; i++)
+        ss << s.rpy[i] << ":";
+    for (uint8_t i = 0; i < 3; i++)
+        ss << s.acc[i] << ":";
+
+    return ss.str().length();
+}
+
+/**
+ * Encode a sample into a stream
+ * @param enc encoder
+ * @param s sample to encode
+ * @param out [out] encoded sample
+ * @return length of encoded sample
+ */
+static uint16_t _Encode(IMUCodec &enc, const struct _chkSample &s,
+                        std::vector<uint8_t> &out)
+{
+    uint8_t buf[IMUC_MAX_SAMPLE];
+    uint16_t len = enc.Encode(s.time, s.rpy, s.acc, buf, sizeof(buf));
+
+    out.assign(buf, buf + len);
+
+    return len;
+}
+
+/**
+ * Check if decoded sample matches the original within quantization error
+ * @param a original sample
+ * @param b decoded sample
+ * @param rpyRes orientation resolution
+ * @param accRes acceleration resolution
+ * @return true if time is exact and values are within half of resolution
+ */
+static bool _Match(const struct _chkSample &a, const struct _chkSample &b,
+                   float rpyRes, float accRes)
+{
+    if (a.time != b.time)
+        return false;
+
+    //  Tolerance includes float rounding of value * resolution
+    for (uint8_t i = 0; i < 3; i++)
+        if ((fabs(a.rpy[i] - b.rpy[i]) > (rpyRes / 2.0 + fabs(a.rpy[i]) * 1e-6)) ||
+            (fabs(a.acc[i] - b.acc[i]) > (accRes / 2.0 + fabs(a.acc[i]) * 1e-6)))
+            return false;
+
+    return true;
+}
+
+///-----------------------------------------------------------------------------
+///                      Checks                                        [PRIVATE]
+///-----------------------------------------------------------------------------
+
+/**
+ * Round-trip the whole trace and print compression & error statistics
+ * @param trace samples to encode
+ */
+static void _RoundTrip(const std::vector<struct _chkSample> &trace)
+{
+    IMUCodec enc, dec;
+    std::vector<uint8_t> stream;
+    size_t text = 0, keys = 0, keyBytes = 0, pos = 0, n = 0;
+    double maxRpy = 0, maxAcc = 0;
+    bool ok = true;
+    uint16_t dMin = 0xFFFF, dMax = 0;
+
+    if (!enc.Configure(__cfg.rpyRes, __cfg.accRes, __cfg.keyInt))
+    {
+        _Check(false, "configure encoder");
+        return;
+    }
+
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        std::vector<uint8_t> sample;
+        uint16_t len = _Encode(enc, trace[i], sample);
+
+        if (sample[0] & IMUC_KEYFRAME)
+        {
+            keys++;
+            keyBytes += len;
+        }
+        else
+        {
+            dMin = (len < dMin) ? len : dMin;
+            dMax = (len > dMax) ? len : dMax;
+        }
+        text += _TextLen(trace[i]);
+        stream.insert(stream.end(), sample.begin(), sample.end());
+    }
+
+    //  Decoder reads the stream back to back, as received
+    while (pos < stream.size())
+    {
+        struct _chkSample s;
+        int16_t len = dec.Decode(&stream[pos], stream.size() - pos, &s.time,
+                                 s.rpy, s.acc);
+
+        if (len <= 0)
+        {
+            ok = false;
+            break;
+        }
+        if (!_Match(trace[n], s, __cfg.rpyRes, __cfg.accRes))
+            ok = false;
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            maxRpy = fmax(maxRpy, fabs(trace[n].rpy[i] - s.rpy[i]));
+            maxAcc = fmax(maxAcc, fabs(trace[n].acc[i] - s.acc[i]));
+        }
+        pos += len;
+        n++;
+    }
+
+    printf("Trace: %zu samples, rpy %g deg/LSB, acc %g g/LSB, keyframe every "
+           "%u\n", trace.size(), __cfg.rpyRes, __cfg.accRes, __cfg.keyInt);
+    printf("  raw binary  %8zu B (%5.2f B/sample)\n",
+           trace.size() * CHK_RAW_SAMPLE, (double)CHK_RAW_SAMPLE);
+    printf("  text        %8zu B (%5.2f B/sample)\n", text,
+           (double)text / trace.size());
+    printf("  encoded     %8zu B (%5.2f B/sample), %zu keyframes "
+           "(%5.2f B each)\n", stream.size(),
+           (double)stream.size() / trace.size(), keys,
+           keys ? (double)keyBytes / keys : 0.0);
+    printf("  ratio       %5.2fx vs raw binary, %5.2fx vs text\n",
+           (double)(trace.size() * CHK_RAW_SAMPLE) / stream.size(),
+           (double)text / stream.size());
+    printf("  delta frame %u to %u B, %5.2f B on average\n", dMin, dMax,
+           (trace.size() > keys) ? (double)(stream.size() - keyBytes) /
+                                   (trace.size() - keys) : 0.0);
+    printf("  max error   rpy %g deg, acc %g g\n", maxRpy, maxAcc);
+
+    _Check(ok && (n == trace.size()),
+           "decoded trace matches within half of resolution");
+}
+
+/**
+ * Varint lengths at every 7-bit boundary, truncated & overlong varints
+ */
+static void _Varints()
+{
+    static const uint32_t val[] = { 0, 1, 0x7F, 0x80, 0x3FFF, 0x4000, 0x1FFFFF,
+                                    0x200000, 0xFFFFFFF, 0x10000000,
+                                    0xFFFFFFFF };
+    static const uint8_t len[] = { 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5 };
+    uint8_t buf[8];
+    uint32_t out;
+    bool ok = true, trunc = true;
+
+    for (uint8_t i = 0; i < sizeof(len); i++)
+    {
+        uint8_t n = _chkCodec::_PutVarint(val[i], buf);
+
+        if ((n != len[i]) || (_chkCodec::_GetVarint(buf, n, &out) != n) ||
+            (out != val[i]))
+            ok = false;
+        //  Missing last byte can't be mistaken for a shorter value
+        if ((n > 1) && (_chkCodec::_GetVarint(buf, n - 1, &out) != 0))
+            trunc = false;
+    }
+    _Check(ok, "varint length & value at 7-bit boundaries (1-5 bytes)");
+    _Check(trunc, "truncated varint is rejected");
+
+    memset(buf, 0x80, sizeof(buf));
+    _Check(_chkCodec::_GetVarint(buf, sizeof(buf), &out) == 0,
+           "varint longer than 5 bytes is rejected");
+}
+
+/**
+ * Deltas at the extremes of int32_t: zig-zag of INT32_MIN/MAX and deltas that
+ * wrap around (from +max to -max)
+ */
+static void _Extremes()
+{
+    IMUCodec enc, dec;
+    //  Largest floats below 2^31, exact in float and int32_t
+    const float big = 2147483520.0f;
+    const float seq[] = { 0.0f, big, -big, big, -1.0f, 0.0f };
+    std::vector<uint8_t> sample;
+    bool ok = true;
+    uint16_t maxLen = 0, len;
+
+    enc.Configure(1.0f, 1.0f, 100);
+    for (uint8_t i = 0; i < sizeof(seq) / sizeof(seq[0]); i++)
+    {
+        struct _chkSample s, d;
+
+        s.time = i == 0 ? 0xFFFFFFF0 : (0xFFFFFFF0 + i * 8);
+        for (uint8_t j = 0; j < 3; j++)
+            s.rpy[j] = s.acc[j] = seq[i];
+        len = _Encode(enc, s, sample);
+        if (len > maxLen)
+            maxLen = len;
+        if ((dec.Decode(&sample[0], len, &d.time, d.rpy, d.acc) != len) ||
+            !_Match(s, d, 1.0f, 1.0f))
+            ok = false;
+    }
+    _Check(ok, "values at +-2^31 and time wrapping past 2^32");
+    _Check(maxLen <= IMUC_MAX_SAMPLE, "sample fits IMUC_MAX_SAMPLE");
+}
+
+/**
+ * Keyframe interval, decoder joining mid-stream and losing a sample
+ * @param trace samples to use
+ */
+static void _Keyframes(const std::vector<struct _chkSample> &trace)
+{
+    IMUCodec enc, dec, late;
+    std::vector<std::vector<uint8_t> > s(12);
+    struct _chkSample d;
+    bool ok = true;
+    int16_t r;
+
+    enc.Configure(__cfg.rpyRes, __cfg.accRes, 4);
+    for (uint8_t i = 0; i < s.size(); i++)
+    {
+        _Encode(enc, trace[i], s[i]);
+        //  Keyframe followed by 4 deltas
+        if (((s[i][0] & IMUC_KEYFRAME) != 0) != ((i % 5) == 0))
+            ok = false;
+    }
+    _Check(ok, "first sample and every (interval+1)th is a keyframe");
+
+    //  Late decoder skips deltas until the next keyframe
+    ok = true;
+    for (uint8_t i = 2; i < s.size(); i++)
+    {
+        r = late.Decode(&s[i][0], s[i].size(), &d.time, d.rpy, d.acc);
+        if ((i < 5) ? (r != -(int16_t)s[i].size()) :
+                      ((r != (int16_t)s[i].size()) ||
+                       !_Match(trace[i], d, __cfg.rpyRes, __cfg.accRes)))
+            ok = false;
+    }
+    _Check(ok, "decoder joining mid-stream waits for keyframe");
+
+    //  Sample 6 is lost, 7-9 can't be applied, 10 is a keyframe
+    ok = true;
+    for (uint8_t i = 0; i < s.size(); i++)
+    {
+        if (i == 6)
+            continue;
+        r = dec.Decode(&s[i][0], s[i].size(), &d.time, d.rpy, d.acc);
+        if (((i > 6) && (i < 10)) ? (r >= 0) :
+                ((r <= 0) || !_Match(trace[i], d, __cfg.rpyRes, __cfg.accRes)))
+            ok = false;
+    }
+    _Check(ok, "lost sample drops following deltas until keyframe");
+}
+
+/**
+ * Sequence number wrapping at 128 and change of resolution mid-stream
+ * @param trace samples to use
+ */
+static void _Sequence(const std::vector<struct _chkSample> &trace)
+{
+    IMUCodec enc, dec;
+    std::vector<uint8_t> sample;
+    struct _chkSample d;
+    bool ok = true, key = true;
+    float res = __cfg.rpyRes;
+    size_t n = trace.size() < 400 ? trace.size() : 400;
+
+    enc.Configure(__cfg.rpyRes, __cfg.accRes, 1000);
+    for (size_t i = 0; i < n; i++)
+    {
+        //  Coarser resolution half-way, next sample has to be a keyframe
+        if (i == n / 2)
+        {
+            res = __cfg.rpyRes * 10;
+            enc.Configure(res, __cfg.accRes * 10, 1000);
+        }
+        _Encode(enc, trace[i], sample);
+        if (((sample[0] & IMUC_KEYFRAME) != 0) != ((i == 0) || (i == n / 2)))
+            key = false;
+        if ((dec.Decode(&sample[0], sample.size(), &d.time, d.rpy, d.acc) !=
+                (int16_t)sample.size()) ||
+            !_Match(trace[i], d, res, (i < n / 2) ? __cfg.accRes :
+                                                    __cfg.accRes * 10))
+            ok = false;
+    }
+    _Check(ok, "sequence number wraps at 128 without losing sync");
+    _Check(key, "resolution change forces keyframe, decoder follows it");
+}
+
+/**
+ * Truncated samples and too small encoder buffer
+ * @param trace samples to use
+ */
+static void _Truncated(const std::vector<struct _chkSample> &trace)
+{
+    IMUCodec enc;
+    std::vector<uint8_t> s[2];
+    uint8_t small[IMUC_MAX_SAMPLE - 1];
+    struct _chkSample d;
+    bool ok = true;
+
+    enc.Configure(__cfg.rpyRes, __cfg.accRes, __cfg.keyInt);
+    _Encode(enc, trace[0], s[0]);
+    _Encode(enc, trace[1], s[1]);
+
+    for (uint8_t k = 0; k < 2; k++)
+        for (uint16_t l = 0; l < s[k].size(); l++)
+        {
+            IMUCodec dec;
+
+            //  Delta needs decoder synced by the keyframe first
+            if (k == 1)
+                dec.Decode(&s[0][0], s[0].size(), &d.time, d.rpy, d.acc);
+            if (dec.Decode(&s[k][0], l, &d.time, d.rpy, d.acc) != 0)
+                ok = false;
+        }
+    _Check(ok, "truncated keyframe & delta are rejected");
+    _Check(enc.Encode(0, trace[0].rpy, trace[0].acc, small, sizeof(small)) == 0,
+           "encoder refuses buffer smaller than IMUC_MAX_SAMPLE");
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<struct _chkSample> trace;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:n:r:a:k:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'f': __cfg.file = optarg; break;
+        case 'n': __cfg.samples = strtoul(optarg, 0, 10); break;
+        case 'r': __cfg.rpyRes = strtof(optarg, 0); break;
+        case 'a': __cfg.accRes = strtof(optarg, 0); break;
+        case 'k': __cfg.keyInt = strtoul(optarg, 0, 10); break;
+        case 's': __cfg.seed = strtoul(optarg, 0, 10); break;
+        default:
+            fprintf(stderr, "Usage: %s [-f trace.csv] [-n samples] "
+                    "[-r rpyRes] [-a accRes] [-k keyInterval] [-s seed]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    srand(__cfg.seed);
+    if (__cfg.file != 0)
+    {
+        if (!_Load(__cfg.file, trace))
+        {
+            fprintf(stderr, "No samples in %s\n", __cfg.file);
+            return 1;
+        }
+    }
+    else
+        _Generate(trace);
+
+    //  Edge cases need a few samples of their own
+    if (trace.size() < 12)
+    {
+        fprintf(stderr, "Trace needs at least 12 samples\n");
+        return 1;
+    }
+
+    _RoundTrip(trace);
+    printf("Edge cases:\n");
+    _Varints();
+    _Extremes();
+    _Keyframes(trace);
+    _Sequence(trace);
+    _Truncated(trace);
+
+    printf("%u check(s) failed\n", __fails);
+
+    return __fails;
+}